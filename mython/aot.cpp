@@ -0,0 +1,1013 @@
+#include "aot.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace aot {
+
+namespace {
+
+using runtime::ObjectHolder;
+using Statement = runtime::Executable;
+using CompareFunction = bool (*)(const ObjectHolder&, const ObjectHolder&, runtime::Context&);
+
+const string SELF = "self"s;
+const string INIT_METHOD = "__init__"s;
+const string OBJECT_TYPE = "runtime::ObjectHolder"s;
+
+// Статический тип значения. Bottom - тип переменной, которой пока не найдено ни одного
+// присваивания при выводе типов. Instance - экземпляр известного класса
+enum class Type {
+    Bottom,
+    Int,
+    Bool,
+    Str,
+    Instance,
+    Unknown,
+};
+
+struct ValueType {
+    Type type = Type::Bottom;
+    // Класс экземпляра для Type::Instance
+    const runtime::Class* cls = nullptr;
+
+    bool operator==(const ValueType& other) const {
+        return type == other.type && cls == other.cls;
+    }
+
+    bool operator!=(const ValueType& other) const {
+        return !(*this == other);
+    }
+};
+
+const ValueType INT{Type::Int};
+const ValueType BOOL{Type::Bool};
+const ValueType STR{Type::Str};
+const ValueType UNKNOWN{Type::Unknown};
+
+ValueType Join(const ValueType& lhs, const ValueType& rhs) {
+    if (lhs.type == Type::Bottom) {
+        return rhs;
+    }
+    if (rhs.type == Type::Bottom || lhs == rhs) {
+        return lhs;
+    }
+    return UNKNOWN;
+}
+
+// Тип C++, в котором хранится значение типа type
+const string& CppType(const ValueType& type) {
+    static const string int_type = "int"s;
+    static const string bool_type = "bool"s;
+    switch (type.type) {
+        case Type::Int:
+            return int_type;
+        case Type::Bool:
+            return bool_type;
+        default:
+            return OBJECT_TYPE;
+    }
+}
+
+// Значение выражения: выражение C++ без побочных эффектов (константа, переменная
+// либо временная переменная) и его тип
+struct Value {
+    string code;
+    ValueType type;
+};
+
+struct CompareOp {
+    CompareFunction function;
+    string_view generic;
+    string_view native;
+};
+
+const CompareOp COMPARE_OPS[] = {
+    {&runtime::Equal, "runtime::Equal"sv, "=="sv},
+    {&runtime::NotEqual, "runtime::NotEqual"sv, "!="sv},
+    {&runtime::Less, "runtime::Less"sv, "<"sv},
+    {&runtime::Greater, "runtime::Greater"sv, ">"sv},
+    {&runtime::LessOrEqual, "runtime::LessOrEqual"sv, "<="sv},
+    {&runtime::GreaterOrEqual, "runtime::GreaterOrEqual"sv, ">="sv},
+};
+
+const CompareOp& FindCompareOp(const ast::Comparison& comparison) {
+    if (const auto* function = comparison.GetComparator().target<CompareFunction>()) {
+        for (const auto& op : COMPARE_OPS) {
+            if (op.function == *function) {
+                return op;
+            }
+        }
+    }
+    throw UnsupportedProgram("Unsupported comparison"s);
+}
+
+// Строковый литерал C++ со значением value
+string CppString(const string& value) {
+    ostringstream out;
+    out << '"';
+    for (const char c : value) {
+        switch (c) {
+            case '"':
+                out << "\\\""sv;
+                break;
+            case '\\':
+                out << "\\\\"sv;
+                break;
+            case '\n':
+                out << "\\n"sv;
+                break;
+            case '\t':
+                out << "\\t"sv;
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+                    const auto code = static_cast<unsigned char>(c);
+                    out << '\\' << static_cast<char>('0' + (code >> 6))
+                        << static_cast<char>('0' + ((code >> 3) & 7))
+                        << static_cast<char>('0' + (code & 7));
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << "\"s"sv;
+    return out.str();
+}
+
+// Вызывает visit для каждого выражения-операнда узла node
+template <typename Visitor>
+void ForEachOperand(const Statement& node, Visitor visit) {
+    if (const auto* print = dynamic_cast<const ast::Print*>(&node)) {
+        for (const auto& arg : print->GetArgs()) {
+            visit(*arg);
+        }
+    } else if (const auto* call = dynamic_cast<const ast::MethodCall*>(&node)) {
+        for (const auto& arg : call->GetArgs()) {
+            visit(*arg);
+        }
+        visit(*call->GetObject());
+    } else if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&node)) {
+        for (const auto& arg : instance->GetArgs()) {
+            visit(*arg);
+        }
+    } else if (const auto* unary = dynamic_cast<const ast::UnaryOperation*>(&node)) {
+        visit(*unary->GetArg());
+    } else if (const auto* binary = dynamic_cast<const ast::BinaryOperation*>(&node)) {
+        visit(*binary->GetLhs());
+        visit(*binary->GetRhs());
+    } else if (const auto* ret = dynamic_cast<const ast::Return*>(&node)) {
+        visit(*ret->GetStatement());
+    } else if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&node)) {
+        visit(field->GetObject());
+        visit(*field->GetValue());
+    }
+}
+
+bool IsLeaf(const Statement& expression) {
+    if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&expression)) {
+        return variable->GetDottedIds().size() == 1;
+    }
+    return dynamic_cast<const ast::NumericConst*>(&expression)
+           || dynamic_cast<const ast::StringConst*>(&expression)
+           || dynamic_cast<const ast::BoolConst*>(&expression)
+           || dynamic_cast<const ast::None*>(&expression);
+}
+
+bool IsSubclass(const runtime::Class* cls, const runtime::Class& base) {
+    for (; cls != nullptr; cls = cls->GetParent()) {
+        if (cls == &base) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Сведения о программе, общие для всех функций: классы, методы и константы
+class ProgramEmitter {
+public:
+    explicit ProgramEmitter(const Statement& program)
+        : program_(program) {
+        CollectClasses(program);
+    }
+
+    void Emit(ostream& out);
+
+    const vector<const runtime::Class*>& GetClasses() const {
+        return classes_;
+    }
+
+    size_t ClassIndex(const runtime::Class& cls) const {
+        return class_index_.at(&cls);
+    }
+
+    size_t MethodIndex(const runtime::Method& method) const {
+        return method_index_.at(&method);
+    }
+
+    // Возвращает имя константы-строки с именем поля либо метода name
+    string Name(const string& name) {
+        names_.insert(name);
+        return "name_"s + name;
+    }
+
+    // Возвращает имя константы-объекта со строкой value
+    string StringConstant(const string& value) {
+        const auto [it, inserted] = strings_.emplace(value, strings_.size());
+        return "str_"s + to_string(it->second);
+    }
+
+private:
+    void CollectClasses(const Statement& statement) {
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            for (const auto& child : compound->GetStatements()) {
+                CollectClasses(*child);
+            }
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            CollectClasses(*if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                CollectClasses(*if_else->GetElseBody());
+            }
+        } else if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&statement)) {
+            const runtime::Class& cls = definition->GetClass();
+            class_index_[&cls] = classes_.size();
+            classes_.push_back(&cls);
+            for (const auto& method : cls.GetMethods()) {
+                method_index_[&method] = methods_.size();
+                methods_.push_back(&method);
+                const auto* body =
+                    dynamic_cast<const ast::MethodBody*>(&ast::GetMethodBody(method));
+                if (body == nullptr) {
+                    throw UnsupportedProgram("Unsupported method body"s);
+                }
+                CollectClasses(*body->GetBody());
+            }
+        }
+    }
+
+    const Statement& program_;
+    vector<const runtime::Class*> classes_;
+    unordered_map<const runtime::Class*, size_t> class_index_;
+    vector<const runtime::Method*> methods_;
+    unordered_map<const runtime::Method*, size_t> method_index_;
+    set<string> names_;
+    map<string, size_t> strings_;
+};
+
+// Сведения о переменной функции
+struct Variable {
+    ValueType type;
+    // Переменную читают в точках, где значение присвоено не на каждом пути, поэтому
+    // присваивание отмечается во флаге assigned_<имя>
+    bool checked = false;
+};
+
+// Переменные, которым присвоено значение на каждом пути к точке функции
+struct Assigned {
+    set<string> names;
+    // false в коде после return
+    bool reachable = true;
+};
+
+/*
+ * Переводит в функцию C++ метод класса либо код верхнего уровня программы.
+ * Выражения вычисляются во временные переменные в порядке обхода дерева,
+ * поэтому порядок вычисления и побочных эффектов совпадает с интерпретатором
+ */
+class FunctionEmitter {
+public:
+    // cls и method равны nullptr для кода верхнего уровня
+    FunctionEmitter(ProgramEmitter& program, const runtime::Class* cls,
+                    const runtime::Method* method, const Statement& body)
+        : program_(program)
+        , cls_(cls)
+        , method_(method)
+        , body_(body) {
+    }
+
+    void Emit(ostream& out) {
+        DeclareVariables();
+        InferTypes();
+        Assigned assigned;
+        for (const auto& [name, variable] : variables_) {
+            if (IsParameter(name)) {
+                assigned.names.insert(name);
+            }
+        }
+        FindUncheckedReads(body_, assigned);
+
+        indent_ = 1;
+        EmitStatement(body_);
+
+        if (method_ == nullptr) {
+            out << "void RunProgram(runtime::Context& context) {\n"sv;
+        } else {
+            out << "// "sv << cls_->GetName() << '.' << method_->name << '(';
+            for (size_t i = 0; i < method_->formal_params.size(); ++i) {
+                out << (i > 0 ? ", "sv : ""sv) << method_->formal_params[i];
+            }
+            out << ")\n"sv;
+            out << "runtime::ObjectHolder method_"sv << program_.MethodIndex(*method_)
+                << "(runtime::ClassInstance& self, runtime::Context& context"sv;
+            for (size_t i = 0; i < method_->formal_params.size(); ++i) {
+                out << ", runtime::ObjectHolder arg_"sv << i;
+            }
+            out << ") {\n"sv;
+        }
+        if (uses_self_value_ || (method_ != nullptr && variables_.count(SELF))) {
+            out << "    "sv << (self_is_variable_ ? ""sv : "const "sv)
+                << "runtime::ObjectHolder v_self = runtime::ObjectHolder::Share(self);\n"sv;
+        }
+        for (const auto& [name, variable] : variables_) {
+            if (name == SELF && method_ != nullptr) {
+                continue;
+            }
+            const string& type = CppType(variable.type);
+            out << "    "sv << type << " v_"sv << name;
+            if (type == "int"s) {
+                out << " = 0"sv;
+            } else if (type == "bool"s) {
+                out << " = false"sv;
+            }
+            out << ";\n"sv;
+            if (variable.checked) {
+                out << "    bool assigned_"sv << name << " = false;\n"sv;
+            }
+        }
+        if (method_ != nullptr) {
+            for (size_t i = 0; i < method_->formal_params.size(); ++i) {
+                out << "    v_"sv << method_->formal_params[i] << " = arg_"sv << i << ";\n"sv;
+            }
+        }
+        out << code_.str();
+        if (method_ != nullptr) {
+            out << "    return runtime::ObjectHolder::None();\n"sv;
+        }
+        out << "}\n"sv;
+    }
+
+private:
+    bool IsParameter(const string& name) const {
+        if (method_ == nullptr) {
+            return false;
+        }
+        return name == SELF
+               || find(method_->formal_params.begin(), method_->formal_params.end(), name)
+                      != method_->formal_params.end();
+    }
+
+    // self - экземпляр, для которого вызван метод, если метод не присваивает self
+    // и не имеет параметра с этим именем
+    bool IsSelf(const string& name) const {
+        return method_ != nullptr && name == SELF && !self_is_variable_;
+    }
+
+    void DeclareVariables() {
+        if (method_ != nullptr) {
+            for (const auto& param : method_->formal_params) {
+                variables_[param].type = UNKNOWN;
+            }
+        }
+        CollectAssignments(body_);
+        self_is_variable_ = method_ != nullptr && variables_.count(SELF) > 0;
+        if (self_is_variable_) {
+            variables_[SELF].type = UNKNOWN;
+        }
+    }
+
+    void CollectAssignments(const Statement& statement) {
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            for (const auto& child : compound->GetStatements()) {
+                CollectAssignments(*child);
+            }
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            CollectAssignments(*if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                CollectAssignments(*if_else->GetElseBody());
+            }
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            assignments_.push_back(assignment);
+            variables_[assignment->GetVar()];
+        } else if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&statement)) {
+            variables_[definition->GetClass().GetName()].type = UNKNOWN;
+        }
+    }
+
+    // Тип переменной - объединение типов всех присваиваемых ей значений
+    void InferTypes() {
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto* assignment : assignments_) {
+                Variable& variable = variables_.at(assignment->GetVar());
+                const ValueType type = Join(variable.type, TypeOf(*assignment->GetValue()));
+                if (type != variable.type) {
+                    variable.type = type;
+                    changed = true;
+                }
+            }
+        }
+        for (auto& [name, variable] : variables_) {
+            if (variable.type.type == Type::Bottom) {
+                variable.type = UNKNOWN;
+            }
+        }
+    }
+
+    ValueType VariableType(const string& name) const {
+        if (IsSelf(name)) {
+            return UNKNOWN;
+        }
+        const auto it = variables_.find(name);
+        return it == variables_.end() ? UNKNOWN : it->second.type;
+    }
+
+    ValueType TypeOf(const Statement& expression) const {
+        if (dynamic_cast<const ast::NumericConst*>(&expression)
+            || dynamic_cast<const ast::Sub*>(&expression)
+            || dynamic_cast<const ast::Mult*>(&expression)
+            || dynamic_cast<const ast::Div*>(&expression)) {
+            return INT;
+        }
+        if (dynamic_cast<const ast::BoolConst*>(&expression)
+            || dynamic_cast<const ast::Comparison*>(&expression)
+            || dynamic_cast<const ast::Not*>(&expression)) {
+            return BOOL;
+        }
+        if (dynamic_cast<const ast::StringConst*>(&expression)
+            || dynamic_cast<const ast::Stringify*>(&expression)) {
+            return STR;
+        }
+        if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&expression)) {
+            const auto& ids = variable->GetDottedIds();
+            return ids.size() == 1 ? VariableType(ids[0]) : UNKNOWN;
+        }
+        if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&expression)) {
+            return {Type::Instance, &instance->GetClass()};
+        }
+        if (const auto* add = dynamic_cast<const ast::Add*>(&expression)) {
+            const ValueType lhs = TypeOf(*add->GetLhs());
+            const ValueType rhs = TypeOf(*add->GetRhs());
+            if (lhs.type == Type::Bottom || rhs.type == Type::Bottom) {
+                return {};
+            }
+            if (lhs == rhs && (lhs == INT || lhs == STR)) {
+                return lhs;
+            }
+            return UNKNOWN;
+        }
+        if (dynamic_cast<const ast::And*>(&expression) || dynamic_cast<const ast::Or*>(&expression)) {
+            const auto& operation = static_cast<const ast::BinaryOperation&>(expression);
+            return Join(TypeOf(*operation.GetLhs()), TypeOf(*operation.GetRhs()));
+        }
+        return UNKNOWN;
+    }
+
+    // Находит чтения переменных, которым значение присвоено не на каждом пути
+    void FindUncheckedReads(const Statement& statement, Assigned& assigned) {
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            for (const auto& child : compound->GetStatements()) {
+                FindUncheckedReads(*child, assigned);
+            }
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            FindUncheckedOperandReads(*assignment->GetValue(), assigned);
+            assigned.names.insert(assignment->GetVar());
+        } else if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&statement)) {
+            assigned.names.insert(definition->GetClass().GetName());
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            FindUncheckedOperandReads(*if_else->GetCondition(), assigned);
+            Assigned else_assigned = assigned;
+            FindUncheckedReads(*if_else->GetIfBody(), assigned);
+            if (if_else->GetElseBody()) {
+                FindUncheckedReads(*if_else->GetElseBody(), else_assigned);
+            }
+            if (!else_assigned.reachable) {
+                return;
+            }
+            if (!assigned.reachable) {
+                assigned = std::move(else_assigned);
+                return;
+            }
+            set<string> both;
+            set_intersection(assigned.names.begin(), assigned.names.end(),
+                             else_assigned.names.begin(), else_assigned.names.end(),
+                             inserter(both, both.end()));
+            assigned.names = std::move(both);
+        } else {
+            FindUncheckedOperandReads(statement, assigned);
+            if (dynamic_cast<const ast::Return*>(&statement)) {
+                assigned.reachable = false;
+            }
+        }
+    }
+
+    void FindUncheckedOperandReads(const Statement& expression, const Assigned& assigned) {
+        if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&expression)) {
+            const string& name = variable->GetDottedIds()[0];
+            const auto it = variables_.find(name);
+            if (assigned.reachable && !IsSelf(name) && it != variables_.end()
+                && !assigned.names.count(name)) {
+                it->second.checked = true;
+                unchecked_reads_.insert(variable);
+            }
+            return;
+        }
+        ForEachOperand(expression, [this, &assigned](const Statement& operand) {
+            FindUncheckedOperandReads(operand, assigned);
+        });
+    }
+
+    void Line(const string& line) {
+        code_ << string(indent_ * 4, ' ') << line << '\n';
+    }
+
+    string NewTemp() {
+        return "t"s + to_string(temp_count_++);
+    }
+
+    // Вычисляет code во временную переменную типа type
+    Value Temp(const ValueType& type, const string& code) {
+        const string name = NewTemp();
+        Line("const "s + CppType(type) + " "s + name + " = "s + code + ";"s);
+        return {name, type};
+    }
+
+    static string Boxed(const Value& value) {
+        switch (value.type.type) {
+            case Type::Int:
+                return "aot::BoxInt("s + value.code + ")"s;
+            case Type::Bool:
+                return "aot::BoxBool("s + value.code + ")"s;
+            default:
+                return value.code;
+        }
+    }
+
+    // Значение value в представлении типа type. Тип значения не шире type
+    static string Converted(const Value& value, const ValueType& type) {
+        if (type.type == Type::Int || type.type == Type::Bool) {
+            return value.code;
+        }
+        return Boxed(value);
+    }
+
+    // Условие инструкции if (см. runtime::IsTrue)
+    static string Truth(const Value& value) {
+        switch (value.type.type) {
+            case Type::Int:
+                return value.code + " != 0"s;
+            case Type::Bool:
+                return value.code;
+            default:
+                return "runtime::IsTrue("s + value.code + ")"s;
+        }
+    }
+
+    // Логическое значение операнда and, or либо not (см. runtime::LogicalValue)
+    static string Logical(const Value& value) {
+        switch (value.type.type) {
+            case Type::Int:
+                return "("s + value.code + " != 0)"s;
+            case Type::Bool:
+                return value.code;
+            default:
+                return "runtime::LogicalValue("s + value.code + ")"s;
+        }
+    }
+
+    void EmitStatement(const Statement& statement) {
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            for (const auto& child : compound->GetStatements()) {
+                EmitStatement(*child);
+            }
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            const Value value = EmitExpression(*assignment->GetValue());
+            EmitAssignment(assignment->GetVar(), value);
+        } else if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&statement)) {
+            const runtime::Class& cls = definition->GetClass();
+            EmitAssignment(cls.GetName(),
+                           {"class_"s + to_string(program_.ClassIndex(cls)), UNKNOWN});
+        } else if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&statement)) {
+            EmitFieldAssignment(*field);
+        } else if (const auto* print = dynamic_cast<const ast::Print*>(&statement)) {
+            EmitPrint(*print);
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            const Value condition = EmitExpression(*if_else->GetCondition());
+            Line("if ("s + Truth(condition) + ") {"s);
+            EmitBlock(*if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                Line("} else {"s);
+                EmitBlock(*if_else->GetElseBody());
+            }
+            Line("}"s);
+        } else if (const auto* ret = dynamic_cast<const ast::Return*>(&statement)) {
+            const Value value = EmitExpression(*ret->GetStatement());
+            // Инструкция return вне метода выбрасывает значение, как и ast::Return
+            Line((method_ != nullptr ? "return "s : "throw "s) + Boxed(value) + ";"s);
+        } else {
+            EmitExpression(statement);
+        }
+    }
+
+    void EmitBlock(const Statement& statement) {
+        ++indent_;
+        EmitStatement(statement);
+        --indent_;
+    }
+
+    void EmitAssignment(const string& name, const Value& value) {
+        const Variable& variable = variables_.at(name);
+        Line("v_"s + name + " = "s + Converted(value, variable.type) + ";"s);
+        if (variable.checked) {
+            Line("assigned_"s + name + " = true;"s);
+        }
+    }
+
+    void EmitFieldAssignment(const ast::FieldAssignment& field) {
+        const string name = program_.Name(field.GetFieldName());
+        const auto& ids = field.GetObject().GetDottedIds();
+        if (ids.size() == 1 && IsSelf(ids[0])) {
+            const Value value = EmitExpression(*field.GetValue());
+            Line("self.Fields()["s + name + "] = "s + Boxed(value) + ";"s);
+            return;
+        }
+        const string object = Boxed(EmitVariable(field.GetObject()));
+        Line("runtime::CheckFieldOwner("s + object + ");"s);
+        const Value value = EmitExpression(*field.GetValue());
+        Line("runtime::SetField("s + object + ", "s + name + ", "s + Boxed(value) + ");"s);
+    }
+
+    void EmitPrint(const ast::Print& print) {
+        const string out = "context.GetOutputStream()"s;
+        bool first = true;
+        for (const auto& arg : print.GetArgs()) {
+            const Value value = EmitExpression(*arg);
+            const string separator = first ? ""s : " << ' '"s;
+            if (value.type == INT) {
+                Line(out + separator + " << "s + value.code + ";"s);
+            } else if (value.type == BOOL) {
+                Line(out + separator + " << ("s + value.code + " ? \"True\" : \"False\");"s);
+            } else {
+                if (!first) {
+                    Line(out + separator + ";"s);
+                }
+                Line("runtime::PrintValue("s + value.code + ", context);"s);
+            }
+            first = false;
+        }
+        Line(out + " << '\\n';"s);
+    }
+
+    Value EmitExpression(const Statement& expression) {
+        if (const auto* number = dynamic_cast<const ast::NumericConst*>(&expression)) {
+            return {to_string(number->GetValue().GetValue()), INT};
+        }
+        if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&expression)) {
+            return {boolean->GetValue().GetValue() ? "true"s : "false"s, BOOL};
+        }
+        if (const auto* str = dynamic_cast<const ast::StringConst*>(&expression)) {
+            return {program_.StringConstant(str->GetValue().GetValue()), STR};
+        }
+        if (dynamic_cast<const ast::None*>(&expression)) {
+            return {"runtime::ObjectHolder::None()"s, UNKNOWN};
+        }
+        if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&expression)) {
+            return EmitVariable(*variable);
+        }
+        if (const auto* call = dynamic_cast<const ast::MethodCall*>(&expression)) {
+            return EmitMethodCall(*call);
+        }
+        if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&expression)) {
+            return EmitNewInstance(*instance);
+        }
+        if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&expression)) {
+            const Value value = EmitExpression(*stringify->GetArg());
+            if (value.type == INT) {
+                return Temp(STR, "aot::MakeString(std::to_string("s + value.code + "))"s);
+            }
+            return Temp(STR, "runtime::Stringify("s + Boxed(value) + ", context)"s);
+        }
+        if (const auto* negation = dynamic_cast<const ast::Not*>(&expression)) {
+            const Value value = EmitExpression(*negation->GetArg());
+            return Temp(BOOL, "!"s + Logical(value));
+        }
+        if (dynamic_cast<const ast::And*>(&expression) || dynamic_cast<const ast::Or*>(&expression)) {
+            return EmitLogical(static_cast<const ast::BinaryOperation&>(expression),
+                               dynamic_cast<const ast::Or*>(&expression) != nullptr);
+        }
+        if (const auto* operation = dynamic_cast<const ast::BinaryOperation*>(&expression)) {
+            return EmitBinaryOperation(*operation);
+        }
+        if (dynamic_cast<const ast::NativeCall*>(&expression)) {
+            throw UnsupportedProgram("Native function calls can't be compiled"s);
+        }
+        throw UnsupportedProgram("Unsupported statement"s);
+    }
+
+    Value EmitVariable(const ast::VariableValue& variable) {
+        const auto& ids = variable.GetDottedIds();
+        const string& name = ids[0];
+        Value value;
+        size_t next_id = 1;
+        if (IsSelf(name)) {
+            if (ids.size() > 1) {
+                value = Temp(UNKNOWN, "aot::GetField(self, "s + program_.Name(ids[1]) + ")"s);
+                next_id = 2;
+            } else {
+                uses_self_value_ = true;
+                value = {"v_self"s, UNKNOWN};
+            }
+        } else if (!variables_.count(name)) {
+            // Переменной нигде не присваивается значение
+            Line("aot::ThrowUnknownName();"s);
+            value = {"runtime::ObjectHolder::None()"s, UNKNOWN};
+        } else {
+            if (unchecked_reads_.count(&variable)) {
+                Line("if (!assigned_"s + name + ") {"s);
+                Line("    aot::ThrowUnknownName();"s);
+                Line("}"s);
+            }
+            value = {"v_"s + name, variables_.at(name).type};
+        }
+        for (; next_id < ids.size(); ++next_id) {
+            value = Temp(UNKNOWN, "runtime::GetField("s + Boxed(value) + ", "s
+                                      + program_.Name(ids[next_id]) + ")"s);
+        }
+        return value;
+    }
+
+    // Метод, который вызывается у получателя класса cls. Если получатель может
+    // быть экземпляром подкласса, метод не должен быть в них переопределён
+    const runtime::Method* ResolveMethod(const runtime::Class& cls, const string& name,
+                                         size_t argument_count, bool exact_class) const {
+        const runtime::Method* method = cls.GetMethod(name);
+        if (method == nullptr || method->formal_params.size() != argument_count) {
+            return nullptr;
+        }
+        if (!exact_class) {
+            for (const auto* other : program_.GetClasses()) {
+                if (IsSubclass(other, cls) && other->GetMethod(name) != method) {
+                    return nullptr;
+                }
+            }
+        }
+        return method;
+    }
+
+    string DirectCall(const runtime::Method& method, const string& self,
+                      const vector<string>& args) const {
+        string call = "method_"s + to_string(program_.MethodIndex(method)) + "("s + self
+                      + ", context"s;
+        for (const auto& arg : args) {
+            call += ", "s + arg;
+        }
+        return call + ")"s;
+    }
+
+    static string ArgumentList(const vector<string>& args) {
+        string list = "{"s;
+        for (size_t i = 0; i < args.size(); ++i) {
+            list += (i > 0 ? ", "s : ""s) + args[i];
+        }
+        return list + "}"s;
+    }
+
+    Value EmitMethodCall(const ast::MethodCall& call) {
+        // Как и ast::MethodCall, сначала вычисляются параметры, затем объект
+        vector<string> args;
+        for (const auto& arg : call.GetArgs()) {
+            args.push_back(Boxed(EmitExpression(*arg)));
+        }
+        const string& name = call.GetMethod();
+
+        const auto* variable = dynamic_cast<const ast::VariableValue*>(call.GetObject().get());
+        if (variable != nullptr && variable->GetDottedIds().size() == 1
+            && IsSelf(variable->GetDottedIds()[0])) {
+            if (const auto* method = ResolveMethod(*cls_, name, args.size(), false)) {
+                return Temp(UNKNOWN, DirectCall(*method, "self"s, args));
+            }
+            return Temp(UNKNOWN, "self.Call("s + program_.Name(name) + ", "s + ArgumentList(args)
+                                     + ", context)"s);
+        }
+
+        const Value object = EmitExpression(*call.GetObject());
+        if (object.type.type == Type::Instance) {
+            if (const auto* method = ResolveMethod(*object.type.cls, name, args.size(), true)) {
+                return Temp(UNKNOWN, DirectCall(*method, "aot::AsInstance("s + object.code + ")"s,
+                                                args));
+            }
+        }
+        return Temp(UNKNOWN, "runtime::CallMethod("s + Boxed(object) + ", "s + program_.Name(name)
+                                 + ", "s + ArgumentList(args) + ", context)"s);
+    }
+
+    Value EmitNewInstance(const ast::NewInstance& instance) {
+        const runtime::Class& cls = instance.GetClass();
+        const Value object = Temp({Type::Instance, &cls},
+                                  "aot::NewInstance(class_"s + to_string(program_.ClassIndex(cls))
+                                      + ")"s);
+        // Параметры вычисляются, только если у класса есть подходящий __init__
+        if (const auto* init = ResolveMethod(cls, INIT_METHOD, instance.GetArgs().size(), true)) {
+            vector<string> args;
+            for (const auto& arg : instance.GetArgs()) {
+                args.push_back(Boxed(EmitExpression(*arg)));
+            }
+            Line(DirectCall(*init, "aot::AsInstance("s + object.code + ")"s, args) + ";"s);
+        }
+        return object;
+    }
+
+    // Результат and либо or - значение одного из операндов. Как и ast::And и ast::Or,
+    // выбранный левый операнд вычисляется повторно
+    Value EmitLogical(const ast::BinaryOperation& operation, bool is_or) {
+        const ValueType type = TypeOf(operation);
+        const Value lhs = EmitExpression(*operation.GetLhs());
+        const string result = NewTemp();
+        Line(CppType(type) + " "s + result + ";"s);
+        Line("if ("s + (is_or ? ""s : "!"s) + Logical(lhs) + ") {"s);
+        ++indent_;
+        const Value again = IsLeaf(*operation.GetLhs()) ? lhs : EmitExpression(*operation.GetLhs());
+        Line(result + " = "s + Converted(again, type) + ";"s);
+        --indent_;
+        Line("} else {"s);
+        ++indent_;
+        const Value rhs = EmitExpression(*operation.GetRhs());
+        Line(result + " = "s + Converted(rhs, type) + ";"s);
+        --indent_;
+        Line("}"s);
+        return {result, type};
+    }
+
+    Value EmitBinaryOperation(const ast::BinaryOperation& operation) {
+        const Value lhs = EmitExpression(*operation.GetLhs());
+        const Value rhs = EmitExpression(*operation.GetRhs());
+        const bool ints = lhs.type == INT && rhs.type == INT;
+        if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&operation)) {
+            const CompareOp& op = FindCompareOp(*comparison);
+            const string native = " "s + string(op.native) + " "s;
+            if (ints || (lhs.type == BOOL && rhs.type == BOOL)) {
+                return Temp(BOOL, lhs.code + native + rhs.code);
+            }
+            if (lhs.type == STR && rhs.type == STR) {
+                return Temp(BOOL, "aot::StringValue("s + lhs.code + ")"s + native
+                                      + "aot::StringValue("s + rhs.code + ")"s);
+            }
+            return Temp(BOOL, string(op.generic) + "("s + Boxed(lhs) + ", "s + Boxed(rhs)
+                                  + ", context)"s);
+        }
+        if (dynamic_cast<const ast::Add*>(&operation)) {
+            if (ints) {
+                return Temp(INT, lhs.code + " + "s + rhs.code);
+            }
+            if (lhs.type == STR && rhs.type == STR) {
+                return Temp(STR, "aot::MakeString(aot::StringValue("s + lhs.code
+                                     + ") + aot::StringValue("s + rhs.code + "))"s);
+            }
+            return Temp(UNKNOWN, "runtime::Add("s + Boxed(lhs) + ", "s + Boxed(rhs)
+                                     + ", context)"s);
+        }
+        string function;
+        string native;
+        if (dynamic_cast<const ast::Sub*>(&operation)) {
+            function = "aot::Sub"s;
+            native = " - "s;
+        } else if (dynamic_cast<const ast::Mult*>(&operation)) {
+            function = "aot::Mult"s;
+            native = " * "s;
+        } else if (dynamic_cast<const ast::Div*>(&operation)) {
+            function = "aot::Div"s;
+        } else {
+            throw UnsupportedProgram("Unsupported operation"s);
+        }
+        if (ints) {
+            return Temp(INT, native.empty() ? function + "("s + lhs.code + ", "s + rhs.code + ")"s
+                                            : lhs.code + native + rhs.code);
+        }
+        return Temp(INT, function + "("s + Boxed(lhs) + ", "s + Boxed(rhs) + ")"s);
+    }
+
+    ProgramEmitter& program_;
+    const runtime::Class* cls_;
+    const runtime::Method* method_;
+    const Statement& body_;
+
+    map<string, Variable> variables_;
+    vector<const ast::Assignment*> assignments_;
+    unordered_set<const ast::VariableValue*> unchecked_reads_;
+    bool self_is_variable_ = false;
+    bool uses_self_value_ = false;
+
+    ostringstream code_;
+    size_t indent_ = 0;
+    size_t temp_count_ = 0;
+};
+
+void ProgramEmitter::Emit(ostream& out) {
+    // Константы имён и строк становятся известны по мере перевода функций
+    ostringstream functions;
+    for (const auto* cls : classes_) {
+        for (const auto& method : cls->GetMethods()) {
+            const auto& body =
+                static_cast<const ast::MethodBody&>(ast::GetMethodBody(method));
+            FunctionEmitter(*this, cls, &method, *body.GetBody()).Emit(functions);
+            functions << '\n';
+        }
+    }
+    FunctionEmitter(*this, nullptr, nullptr, program_).Emit(functions);
+
+    out << "// Программа на C++, полученная из программы на Mython (см. aot.h)\n"sv;
+    out << "#include \"aot_runtime.h\"\n\n#include <iostream>\n#include <string>\n#include <vector>\n\n"sv;
+    out << "namespace {\n\nusing namespace std::literals;\n\n"sv;
+    for (const auto& name : names_) {
+        out << "const std::string name_"sv << name << " = "sv << CppString(name) << ";\n"sv;
+    }
+    vector<const string*> strings(strings_.size());
+    for (const auto& [value, index] : strings_) {
+        strings[index] = &value;
+    }
+    for (size_t i = 0; i < strings.size(); ++i) {
+        out << "const runtime::ObjectHolder str_"sv << i << " = aot::MakeString("sv
+            << CppString(*strings[i]) << ");\n"sv;
+    }
+    out << '\n';
+    for (size_t i = 0; i < classes_.size(); ++i) {
+        out << "runtime::ObjectHolder class_"sv << i << ";  // "sv << classes_[i]->GetName() << '\n';
+    }
+    out << '\n';
+    for (size_t i = 0; i < methods_.size(); ++i) {
+        out << "runtime::ObjectHolder method_"sv << i
+            << "(runtime::ClassInstance& self, runtime::Context& context"sv;
+        for (size_t j = 0; j < methods_[i]->formal_params.size(); ++j) {
+            out << ", runtime::ObjectHolder arg_"sv << j;
+        }
+        out << ");\n"sv;
+    }
+    out << '\n' << functions.str() << '\n';
+
+    // Функции для вызовов через ClassInstance::Call
+    for (size_t i = 0; i < methods_.size(); ++i) {
+        out << "runtime::ObjectHolder call_"sv << i
+            << "(runtime::ClassInstance& self, const std::vector<runtime::ObjectHolder>& args,\n"sv
+            << "                             runtime::Context& context) {\n"sv
+            << "    return method_"sv << i << "(self, context"sv;
+        for (size_t j = 0; j < methods_[i]->formal_params.size(); ++j) {
+            out << ", args["sv << j << ']';
+        }
+        out << ");\n}\n\n"sv;
+    }
+
+    out << "void DefineClasses(aot::CompiledMethods& methods) {\n"sv;
+    for (size_t i = 0; i < classes_.size(); ++i) {
+        const runtime::Class& cls = *classes_[i];
+        out << "    class_"sv << i << " = methods.DefineClass("sv << CppString(cls.GetName())
+            << ", {\n"sv;
+        for (const auto& method : cls.GetMethods()) {
+            out << "        {"sv << CppString(method.name) << ", {"sv;
+            for (size_t j = 0; j < method.formal_params.size(); ++j) {
+                out << (j > 0 ? ", "sv : ""sv) << CppString(method.formal_params[j]);
+            }
+            out << "}, &call_"sv << method_index_.at(&method) << "},\n"sv;
+        }
+        out << "    }, "sv;
+        if (cls.GetParent() != nullptr) {
+            out << "class_"sv << class_index_.at(cls.GetParent());
+        } else {
+            out << "runtime::ObjectHolder::None()"sv;
+        }
+        out << ");\n"sv;
+    }
+    out << "}\n\n}  // namespace\n\n"sv;
+
+    out << "int main() {\n"sv
+        << "    try {\n"sv
+        << "        aot::CompiledMethods methods;\n"sv
+        << "        DefineClasses(methods);\n"sv
+        << "        runtime::SimpleContext context(std::cout);\n"sv
+        << "        context.SetCallAccelerator(&methods);\n"sv
+        << "        RunProgram(context);\n"sv
+        << "    } catch (const std::exception& e) {\n"sv
+        << "        std::cerr << e.what() << std::endl;\n"sv
+        << "        return 1;\n"sv
+        << "    }\n"sv
+        << "    return 0;\n"sv
+        << "}\n"sv;
+}
+
+}  // namespace
+
+void EmitCpp(const runtime::Executable& program, ostream& out) {
+    ProgramEmitter(program).Emit(out);
+}
+
+}  // namespace aot
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <iosfwd>
+#include <stdexcept>
+
+namespace aot {
+
+    // Программа содержит конструкцию, которую нельзя перевести в C++:
+    // вызов нативной функции хост-программы либо узлы режима профилирования
+    class UnsupportedProgram : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /*
+     * Транслятор программ Mython в C++ (ahead-of-time).
+     *
+     * Обходит дерево программы program, полученное от ParseProgram без профилирования
+     * и нативных функций, и выводит в out исходный текст самостоятельной программы на C++.
+     * Её вывод и сообщения об ошибках совпадают с выводом интерпретатора. Каждый метод
+     * становится функцией C++, а классы и экземпляры - объектами runtime::Class
+     * и runtime::ClassInstance (см. aot_runtime.h).
+     *
+     * Типы переменных выводятся по присваиваниям. Переменные, которым присваиваются
+     * только целые либо только логические значения, хранятся в int и bool, и операции
+     * над ними выполняются без объектов. Вызовы методов self и экземпляров, класс которых
+     * известен при трансляции, становятся прямыми вызовами функций, если метод
+     * не переопределён в подклассах.
+     *
+     * Сборка переведённой программы (из каталога mython):
+     *   ./mython --emit-cpp=program.cpp < program.my
+     *   c++ -std=c++17 -O2 -pthread -I. program.cpp runtime.cpp operations.cpp sampler.cpp
+     */
+    void EmitCpp(const runtime::Executable& program, std::ostream& out);
+
+}  // namespace aot
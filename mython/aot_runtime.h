@@ -0,0 +1,177 @@
+#pragma once
+
+#include "operations.h"
+#include "runtime.h"
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Библиотека поддержки программ, переведённых в C++ транслятором aot (см. aot.h).
+ * Объекты переведённой программы - те же runtime::Object, Class и ClassInstance,
+ * что и у интерпретатора, а операции над значениями неизвестного типа выполняются
+ * функциями operations.h. Поэтому результаты и исключения совпадают с обходом дерева.
+ *
+ * Переведённая программа компонуется с runtime.cpp, operations.cpp и sampler.cpp
+ */
+namespace aot {
+
+    // Скомпилированный метод: получатель self и фактические параметры args
+    using MethodFunction = runtime::ObjectHolder (*)(runtime::ClassInstance& self,
+        const std::vector<runtime::ObjectHolder>& args, runtime::Context& context);
+
+    // Метод класса переведённой программы
+    struct MethodDefinition {
+        std::string name;
+        std::vector<std::string> formal_params;
+        MethodFunction function = nullptr;
+    };
+
+    // Тело метода, выполняющее скомпилированную функцию. Нужно лишь для вызовов без
+    // ускорителя CompiledMethods: параметры берутся из таблицы символов вызова
+    class CompiledBody : public runtime::Executable {
+    public:
+        CompiledBody(MethodFunction function, std::vector<std::string> formal_params)
+            : function_(function)
+            , formal_params_(std::move(formal_params)) {
+        }
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure,
+            runtime::Context& context) override {
+            std::vector<runtime::ObjectHolder> args;
+            args.reserve(formal_params_.size());
+            for (const auto& param : formal_params_) {
+                args.push_back(closure.at(param));
+            }
+            return function_(*closure.at("self").TryAs<runtime::ClassInstance>(), args, context);
+        }
+
+    private:
+        MethodFunction function_;
+        std::vector<std::string> formal_params_;
+    };
+
+    // Классы переведённой программы. Как ускоритель вызовов выполняет
+    // скомпилированные методы, не создавая Closure
+    class CompiledMethods : public runtime::CallAccelerator {
+    public:
+        // Создаёт класс name с методами methods. Пустой parent - базовый класс
+        runtime::ObjectHolder DefineClass(std::string name, std::vector<MethodDefinition> methods,
+            const runtime::ObjectHolder& parent) {
+            std::vector<runtime::Method> class_methods;
+            class_methods.reserve(methods.size());
+            for (auto& method : methods) {
+                runtime::Method& class_method = class_methods.emplace_back();
+                class_method.name = std::move(method.name);
+                class_method.formal_params = method.formal_params;
+                class_method.body = std::make_unique<CompiledBody>(
+                    method.function, std::move(method.formal_params));
+            }
+            auto cls = runtime::ObjectHolder::Own(runtime::Class(std::move(name),
+                std::move(class_methods), parent.TryAs<runtime::Class>()));
+            for (size_t i = 0; i < methods.size(); ++i) {
+                const auto& class_method = cls.TryAs<runtime::Class>()->GetMethods()[i];
+                functions_[&class_method] = methods[i].function;
+            }
+            return cls;
+        }
+
+        std::optional<runtime::ObjectHolder> TryCall(runtime::ClassInstance& self,
+            const runtime::Method& method, const std::vector<runtime::ObjectHolder>& args,
+            runtime::Context& context) override {
+            const auto it = functions_.find(&method);
+            if (it == functions_.end()) {
+                return std::nullopt;
+            }
+            return it->second(self, args, context);
+        }
+
+    private:
+        std::unordered_map<const runtime::Method*, MethodFunction> functions_;
+    };
+
+    // Создаёт экземпляр класса cls без вызова __init__
+    inline runtime::ObjectHolder NewInstance(const runtime::ObjectHolder& cls) {
+        return runtime::ObjectHolder::Own(
+            runtime::ClassInstance(static_cast<const runtime::Class&>(*cls)));
+    }
+
+    inline runtime::ClassInstance& AsInstance(const runtime::ObjectHolder& object) {
+        return static_cast<runtime::ClassInstance&>(*object);
+    }
+
+    inline runtime::ObjectHolder BoxInt(int value) {
+        return runtime::ObjectHolder::Own(runtime::Number{value});
+    }
+
+    // Значения Bool неизменяемы, поэтому True и False создаются однажды
+    inline runtime::ObjectHolder BoxBool(bool value) {
+        static const runtime::ObjectHolder true_value = runtime::ObjectHolder::Own(runtime::Bool{true});
+        static const runtime::ObjectHolder false_value = runtime::ObjectHolder::Own(runtime::Bool{false});
+        return value ? true_value : false_value;
+    }
+
+    inline runtime::ObjectHolder MakeString(std::string value) {
+        return runtime::ObjectHolder::Own(runtime::String{std::move(value)});
+    }
+
+    // Значение объекта, который заведомо является строкой
+    inline const std::string& StringValue(const runtime::ObjectHolder& object) {
+        return static_cast<const runtime::String&>(*object).GetValue();
+    }
+
+    // Чтение переменной до присваивания, как и у ast::VariableValue
+    [[noreturn]] inline void ThrowUnknownName() {
+        throw std::runtime_error("Unknown name");
+    }
+
+    // Поле экземпляра self. Если поля нет, исключение выбрасывает runtime::GetField
+    inline runtime::ObjectHolder GetField(runtime::ClassInstance& self, const std::string& name) {
+        const auto it = self.Fields().find(name);
+        if (it == self.Fields().end()) {
+            return runtime::GetField(runtime::ObjectHolder::Share(self), name);
+        }
+        return it->second;
+    }
+
+    // Разность, произведение и частное значений неизвестного типа. Результат - всегда число,
+    // а для других операндов исключение выбрасывают функции operations.h
+    inline int Sub(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs) {
+        const auto* lhs_number = lhs.TryAs<runtime::Number>();
+        const auto* rhs_number = rhs.TryAs<runtime::Number>();
+        if (lhs_number && rhs_number) {
+            return lhs_number->GetValue() - rhs_number->GetValue();
+        }
+        return runtime::Sub(lhs, rhs).TryAs<runtime::Number>()->GetValue();
+    }
+
+    inline int Mult(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs) {
+        const auto* lhs_number = lhs.TryAs<runtime::Number>();
+        const auto* rhs_number = rhs.TryAs<runtime::Number>();
+        if (lhs_number && rhs_number) {
+            return lhs_number->GetValue() * rhs_number->GetValue();
+        }
+        return runtime::Mult(lhs, rhs).TryAs<runtime::Number>()->GetValue();
+    }
+
+    inline int Div(int lhs, int rhs) {
+        if (rhs == 0) {
+            return runtime::Div(BoxInt(lhs), BoxInt(rhs)).TryAs<runtime::Number>()->GetValue();
+        }
+        return lhs / rhs;
+    }
+
+    inline int Div(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs) {
+        const auto* lhs_number = lhs.TryAs<runtime::Number>();
+        const auto* rhs_number = rhs.TryAs<runtime::Number>();
+        if (lhs_number && rhs_number) {
+            return Div(lhs_number->GetValue(), rhs_number->GetValue());
+        }
+        return runtime::Div(lhs, rhs).TryAs<runtime::Number>()->GetValue();
+    }
+
+}  // namespace aot
@@ -0,0 +1,88 @@
+#include "batch.h"
+
+#include "program.h"
+#include "work_stealing_pool.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+ScriptResult RunScript(const string& path, const BatchOptions& options) {
+    ScriptResult result;
+    result.path = path;
+    ostringstream output;
+    try {
+        ifstream input(path);
+        if (!input) {
+            throw runtime_error("Can't open "s + path);
+        }
+        const auto program = CompiledProgram::Compile(input);
+
+        runtime::SimpleContext context{output};
+        optional<runtime::ExecutionBudget::Clock::time_point> deadline;
+        if (options.timeout) {
+            deadline = runtime::ExecutionBudget::Clock::now() + *options.timeout;
+        }
+        runtime::ExecutionBudget budget(options.max_steps, deadline);
+        if (options.max_steps || deadline) {
+            context.SetBudget(&budget);
+        }
+        program.Run(context);
+    } catch (const exception& e) {
+        result.ok = false;
+        result.error = e.what();
+    }
+    result.output = output.str();
+    return result;
+}
+
+}  // namespace
+
+void RunBatch(const vector<string>& paths, const BatchOptions& options,
+              const function<void(size_t index, const ScriptResult& result)>& on_result) {
+    vector<optional<ScriptResult>> results(paths.size());
+    mutex results_mutex;
+    condition_variable result_ready;
+
+    WorkStealingPool pool(options.jobs);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        pool.Submit([&, i] {
+            ScriptResult result = RunScript(paths[i], options);
+            {
+                lock_guard lock(results_mutex);
+                results[i] = std::move(result);
+            }
+            result_ready.notify_one();
+        });
+    }
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        ScriptResult result;
+        {
+            unique_lock lock(results_mutex);
+            result_ready.wait(lock, [&results, i] {
+                return results[i].has_value();
+            });
+            result = std::move(*results[i]);
+            results[i].reset();
+        }
+        on_result(i, result);
+    }
+    pool.Wait();
+}
+
+void WriteFramedResult(ostream& out, size_t index, const ScriptResult& result) {
+    string payload = result.output;
+    if (!result.ok) {
+        payload += "error: "s + result.error + '\n';
+    }
+    out << "#mython "sv << index << ' ' << (result.ok ? "ok"sv : "error"sv) << ' '
+        << payload.size() << ' ' << result.path << '\n'
+        << payload;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Параметры пакетного выполнения программ
+struct BatchOptions {
+    // Число потоков. 0 - по числу процессоров
+    size_t jobs = 0;
+    // Ограничения, действующие на каждую программу отдельно
+    std::optional<std::uint64_t> max_steps;
+    std::optional<std::chrono::milliseconds> timeout;
+};
+
+// Результат выполнения одной программы пакета
+struct ScriptResult {
+    std::string path;
+    // Вывод программы. При ошибке - вывод, сделанный до неё
+    std::string output;
+    bool ok = true;
+    // Описание ошибки чтения, разбора или выполнения программы
+    std::string error;
+};
+
+/*
+ * Выполняет программы из файлов paths на пуле потоков с перехватом задач.
+ * Каждая программа разбирается и выполняется отдельной задачей со своими
+ * runtime::Context и runtime::Closure.
+ * on_result вызывается в потоке, вызвавшем RunBatch, в порядке следования путей в paths,
+ * как только становится готов результат очередной программы
+ */
+void RunBatch(const std::vector<std::string>& paths, const BatchOptions& options,
+              const std::function<void(size_t index, const ScriptResult& result)>& on_result);
+
+/*
+ * Выводит результат в поток с кадрами. Кадр состоит из строки заголовка
+ *   #mython <index> <ok|error> <payload_size> <path>
+ * и следующих за ней payload_size байт: вывода программы, а при ошибке -
+ * ещё и строки "error: <описание>"
+ */
+void WriteFramedResult(std::ostream& out, size_t index, const ScriptResult& result);
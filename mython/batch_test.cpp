@@ -0,0 +1,158 @@
+#include "batch.h"
+#include "test_runner_p.h"
+#include "work_stealing_pool.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Каталог с файлами программ, удаляемый при разрушении
+class TempScripts {
+public:
+    TempScripts()
+        : dir_(filesystem::temp_directory_path()
+               / ("mython_batch_test_"s + to_string(getpid()) + "_"s + to_string(counter_++))) {
+        filesystem::create_directories(dir_);
+    }
+
+    TempScripts(const TempScripts&) = delete;
+    TempScripts& operator=(const TempScripts&) = delete;
+
+    ~TempScripts() {
+        error_code ignored;
+        filesystem::remove_all(dir_, ignored);
+    }
+
+    string Add(const string& name, const string& source) {
+        const auto path = dir_ / name;
+        ofstream(path) << source;
+        return path.string();
+    }
+
+private:
+    inline static atomic<int> counter_{0};
+    filesystem::path dir_;
+};
+
+void TestPoolRunsNestedTasks() {
+    constexpr int OUTER = 100;
+    constexpr int INNER = 10;
+    atomic<int> done{0};
+    WorkStealingPool pool(4);
+    for (int i = 0; i < OUTER; ++i) {
+        pool.Submit([&pool, &done] {
+            for (int j = 0; j < INNER; ++j) {
+                pool.Submit([&done] {
+                    ++done;
+                });
+            }
+            ++done;
+        });
+    }
+    pool.Wait();
+    ASSERT_EQUAL(done.load(), OUTER * (INNER + 1));
+
+    // После Wait пул продолжает принимать задачи
+    pool.Submit([&done] {
+        ++done;
+    });
+    pool.Wait();
+    ASSERT_EQUAL(done.load(), OUTER * (INNER + 1) + 1);
+}
+
+void TestPoolRethrowsTaskError() {
+    WorkStealingPool pool(2);
+    atomic<int> done{0};
+    for (int i = 0; i < 10; ++i) {
+        pool.Submit([i, &done] {
+            if (i == 3) {
+                throw runtime_error("task failed"s);
+            }
+            ++done;
+        });
+    }
+    ASSERT_THROWS(pool.Wait(), runtime_error);
+    ASSERT_EQUAL(done.load(), 9);
+    ASSERT_DOESNT_THROW(pool.Wait());
+}
+
+void TestBatchKeepsInputOrder() {
+    TempScripts scripts;
+    vector<string> paths;
+    for (int i = 0; i < 20; ++i) {
+        paths.push_back(scripts.Add("s"s + to_string(i) + ".my"s, "print "s + to_string(i) + "\n"s));
+    }
+    paths.push_back(scripts.Add("parse_error.my"s, "x = = 1\n"s));
+    paths.push_back(scripts.Add("runtime_error.my"s, "print 1\nx = y\n"s));
+    paths.push_back(scripts.Add("missing.my"s, ""s) + ".absent"s);
+
+    BatchOptions options;
+    options.jobs = 4;
+    vector<ScriptResult> results;
+    RunBatch(paths, options, [&results](size_t index, const ScriptResult& result) {
+        ASSERT_EQUAL(index, results.size());
+        results.push_back(result);
+    });
+
+    ASSERT_EQUAL(results.size(), paths.size());
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_EQUAL(results[i].path, paths[i]);
+        ASSERT(results[i].ok);
+        ASSERT_EQUAL(results[i].output, to_string(i) + "\n"s);
+    }
+    ASSERT(!results[20].ok);
+    ASSERT(!results[21].ok);
+    ASSERT_EQUAL(results[21].output, "1\n"s);
+    ASSERT(!results[22].ok);
+}
+
+void TestBatchBudgetIsPerScript() {
+    TempScripts scripts;
+    const string endless = scripts.Add("endless.my"s, R"(class Loop:
+  def run():
+    return self.run()
+
+l = Loop()
+l.run()
+)"s);
+    const string quick = scripts.Add("quick.my"s, "print 'done'\n"s);
+
+    BatchOptions options;
+    options.jobs = 2;
+    options.max_steps = 1000;
+    vector<ScriptResult> results;
+    RunBatch({endless, quick, quick}, options, [&results](size_t, const ScriptResult& result) {
+        results.push_back(result);
+    });
+    ASSERT(!results[0].ok);
+    ASSERT(results[1].ok);
+    ASSERT(results[2].ok);
+    ASSERT_EQUAL(results[2].output, "done\n"s);
+}
+
+void TestFramedOutput() {
+    ScriptResult ok{"a.my"s, "hello\n"s, true, {}};
+    ScriptResult failed{"b.my"s, "x\n"s, false, "boom"s};
+    ostringstream out;
+    WriteFramedResult(out, 0, ok);
+    WriteFramedResult(out, 1, failed);
+    ASSERT_EQUAL(out.str(), "#mython 0 ok 6 a.my\nhello\n#mython 1 error 14 b.my\nx\nerror: boom\n"s);
+}
+
+}  // namespace
+
+void RunBatchTests(TestRunner& tr) {
+    RUN_TEST(tr, TestPoolRunsNestedTasks);
+    RUN_TEST(tr, TestPoolRethrowsTaskError);
+    RUN_TEST(tr, TestBatchKeepsInputOrder);
+    RUN_TEST(tr, TestBatchBudgetIsPerScript);
+    RUN_TEST(tr, TestFramedOutput);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Общие средства бенчмарков: подсчёт вывода, пиковый объём памяти
+// и выполнение замеров в отдельном процессе
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+
+namespace bench {
+
+    // Буфер потока, который только подсчитывает записанные байты
+    class CountingBuffer : public std::streambuf {
+    public:
+        std::uint64_t GetCount() const {
+            return count_;
+        }
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                ++count_;
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        std::streamsize xsputn(const char*, std::streamsize count) override {
+            count_ += count;
+            return count;
+        }
+
+    private:
+        std::uint64_t count_ = 0;
+    };
+
+    // Возвращает пиковый объём резидентной памяти процесса в килобайтах
+    inline long PeakRssKb() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    /*
+     * Выполняет func в дочернем процессе и возвращает строку, которую она вернула.
+     * Так пиковый объём памяти одного замера не зависит от предыдущих.
+     * Если func выбросила исключение или процесс завершился аварийно,
+     * выбрасывает std::runtime_error
+     */
+    inline std::string RunInChild(const std::function<std::string()>& func) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::runtime_error("pipe failed");
+        }
+        std::cout.flush();
+        const pid_t pid = fork();
+        if (pid < 0) {
+            throw std::runtime_error("fork failed");
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            std::string message;
+            try {
+                message = "+" + func();
+            } catch (const std::exception& e) {
+                message = "-" + std::string(e.what());
+            }
+            for (size_t pos = 0; pos < message.size();) {
+                const ssize_t n = write(fds[1], message.data() + pos, message.size() - pos);
+                if (n <= 0) {
+                    break;
+                }
+                pos += n;
+            }
+            close(fds[1]);
+            _exit(0);
+        }
+
+        close(fds[1]);
+        std::string message;
+        char buffer[256];
+        for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;) {
+            message.append(buffer, n);
+        }
+        close(fds[0]);
+        int status = 0;
+        waitpid(pid, &status, 0);
+
+        if (message.empty()) {
+            throw std::runtime_error("benchmark process crashed");
+        }
+        if (message[0] != '+') {
+            throw std::runtime_error(message.substr(1));
+        }
+        return message.substr(1);
+    }
+
+}  // namespace bench
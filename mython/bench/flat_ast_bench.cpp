@@ -0,0 +1,220 @@
+// Сравнение обхода исходного дерева и плоского дерева (см. flat_ast.h) на программах
+// корпуса bench/corpus. Для каждой программы и способа выполнения выводятся лучшее время
+// из нескольких запусков и аппаратные счётчики лучшего запуска: промахи кэша, обращения
+// к кэшу и выполненные инструкции. Если счётчики недоступны (нет прав на perf_event_open
+// либо виртуальная машина их не предоставляет), вместо значений выводится n/a.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/flat_ast_bench.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o flat_ast_bench
+// Запуск:
+//   ./flat_ast_bench [--corpus=bench/corpus] [--repeat=5] [программа.my ...]
+
+#include "flat_ast.h"
+#include "program.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    string corpus = "bench/corpus"s;
+    int repeat = 5;
+    vector<fs::path> programs;
+};
+
+Options ParseCommandLine(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg.rfind("--"s, 0) != 0) {
+            options.programs.emplace_back(arg);
+            continue;
+        }
+        const auto eq = arg.find('=');
+        const string name = arg.substr(0, eq);
+        const string value = eq == string::npos ? ""s : arg.substr(eq + 1);
+        if (name == "--corpus"s) {
+            options.corpus = value;
+        } else if (name == "--repeat"s) {
+            options.repeat = max(stoi(value), 1);
+        } else {
+            throw invalid_argument("Unknown option "s + arg);
+        }
+    }
+    return options;
+}
+
+// Аппаратный счётчик текущего потока. Если открыть его не удалось, Read возвращает nullopt
+class PerfCounter {
+public:
+    explicit PerfCounter(uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    ~PerfCounter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void Start() {
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void Stop() {
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    optional<uint64_t> Read() const {
+        uint64_t value = 0;
+        if (fd_ < 0 || read(fd_, &value, sizeof(value)) != sizeof(value)) {
+            return nullopt;
+        }
+        return value;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+constexpr array<uint64_t, 3> COUNTERS = {PERF_COUNT_HW_CACHE_MISSES,
+                                         PERF_COUNT_HW_CACHE_REFERENCES,
+                                         PERF_COUNT_HW_INSTRUCTIONS};
+
+struct Measurement {
+    double seconds = 0;
+    array<optional<uint64_t>, COUNTERS.size()> counters;
+    string output;
+};
+
+// Выполняет программу source. Если flat, методы выполняются обходом плоских деревьев
+Measurement Measure(const string& source, bool flat) {
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    flat::FlatTreeWalker walker;
+    ostringstream output;
+    runtime::SimpleContext context(output);
+    if (flat) {
+        context.SetCallAccelerator(&walker);
+    }
+
+    array<optional<PerfCounter>, COUNTERS.size()> counters;
+    for (size_t i = 0; i < COUNTERS.size(); ++i) {
+        counters[i].emplace(COUNTERS[i]);
+    }
+    const auto start = chrono::steady_clock::now();
+    for (auto& counter : counters) {
+        counter->Start();
+    }
+    program.Run(context);
+    for (auto& counter : counters) {
+        counter->Stop();
+    }
+    Measurement result;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < COUNTERS.size(); ++i) {
+        result.counters[i] = counters[i]->Read();
+    }
+    result.output = output.str();
+    return result;
+}
+
+Measurement MeasureBest(const string& source, bool flat, int repeat) {
+    Measurement best = Measure(source, flat);
+    for (int i = 1; i < repeat; ++i) {
+        Measurement current = Measure(source, flat);
+        if (current.seconds < best.seconds) {
+            best = std::move(current);
+        }
+    }
+    return best;
+}
+
+void PrintCounter(const optional<uint64_t>& value) {
+    cout << setw(14);
+    if (value) {
+        cout << *value;
+    } else {
+        cout << "n/a"sv;
+    }
+}
+
+void PrintMeasurement(const string& name, const string& engine, const Measurement& m) {
+    cout << left << setw(16) << name << setw(6) << engine << right << setw(10) << fixed
+         << setprecision(2) << m.seconds * 1000;
+    for (const auto& value : m.counters) {
+        PrintCounter(value);
+    }
+    cout << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = ParseCommandLine(argc, argv);
+        if (options.programs.empty()) {
+            for (const auto& entry : fs::directory_iterator(options.corpus)) {
+                if (entry.path().extension() == ".my"s) {
+                    options.programs.push_back(entry.path());
+                }
+            }
+            sort(options.programs.begin(), options.programs.end());
+        }
+
+        cout << left << setw(16) << "program"sv << setw(6) << "tree"sv << right << setw(10)
+             << "ms"sv << setw(14) << "cache-misses"sv << setw(14) << "cache-refs"sv
+             << setw(14) << "instructions"sv << '\n';
+        for (const auto& path : options.programs) {
+            ifstream file(path);
+            const string source{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+            const Measurement ast = MeasureBest(source, false, options.repeat);
+            const Measurement flat = MeasureBest(source, true, options.repeat);
+            if (ast.output != flat.output) {
+                throw runtime_error(path.string() + ": outputs differ"s);
+            }
+            const string name = path.stem().string();
+            PrintMeasurement(name, "ast"s, ast);
+            PrintMeasurement(name, "flat"s, flat);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+    return 0;
+}
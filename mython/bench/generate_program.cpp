@@ -0,0 +1,29 @@
+// Генератор больших программ Mython для проверки масштабируемости.
+// Один и тот же набор аргументов всегда даёт один и тот же текст программы.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -I. bench/generate_program.cpp bench/program_generator.cpp \
+//       -o generate_program
+// Запуск: ./generate_program <classes|lines|inheritance|chain|library> <size> > program.my
+
+#include "bench/program_generator.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "Usage: "sv << argv[0] << " <classes|lines|inheritance|chain|library> <size>"sv
+             << endl;
+        return 1;
+    }
+    try {
+        bench::GenerateProgram(bench::ParseShape(argv[1]), stoull(argv[2]), cout);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
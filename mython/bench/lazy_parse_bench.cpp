@@ -0,0 +1,117 @@
+// Время до первого вывода и память при разборе тел методов сразу и при отложенном разборе
+// (см. ParseOptions::lazy_methods). Программы формы library (bench/program_generator.h)
+// объявляют много методов, но вызывают лишь немногие из них. Каждый замер выполняется
+// в отдельном процессе. Результаты выводятся в формате CSV.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/lazy_parse_bench.cpp bench/program_generator.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o lazy_parse_bench
+// Запуск: ./lazy_parse_bench [max_size] > lazy_parse.csv
+
+#include "bench/bench_util.h"
+#include "bench/program_generator.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start, Clock::time_point end = Clock::now()) {
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+// Буфер потока, запоминающий время первой записи
+class FirstOutputBuffer : public bench::CountingBuffer {
+public:
+    [[nodiscard]] optional<Clock::time_point> GetFirstOutput() const {
+        return first_output_;
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        Mark();
+        return CountingBuffer::overflow(ch);
+    }
+
+    streamsize xsputn(const char* data, streamsize count) override {
+        Mark();
+        return CountingBuffer::xsputn(data, count);
+    }
+
+private:
+    void Mark() {
+        if (!first_output_) {
+            first_output_ = Clock::now();
+        }
+    }
+
+    optional<Clock::time_point> first_output_;
+};
+
+const vector<size_t> SIZES = {1000, 5000, 20000};
+
+// Выполняет один замер и возвращает строку CSV без размера и режима
+string Measure(size_t size, bool lazy) {
+    const string source = bench::GenerateProgram(bench::ProgramShape::Library, size);
+    istringstream input(source);
+
+    const auto start = Clock::now();
+    parse::LexerOptions lexer_options;
+    lexer_options.defer_method_bodies = lazy;
+    parse::Lexer lexer(input, lexer_options);
+    const auto tree = ParseProgram(lexer);
+    const double parse_ms = ElapsedMs(start);
+    const long parse_rss = bench::PeakRssKb();
+
+    FirstOutputBuffer buffer;
+    ostream output(&buffer);
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    const double total_ms = ElapsedMs(start);
+    const auto first_output = buffer.GetFirstOutput();
+
+    ostringstream out;
+    out << source.size() << ',' << parse_ms << ','
+        << (first_output ? ElapsedMs(start, *first_output) : total_ms) << ',' << total_ms
+        << ',' << parse_rss << ',' << bench::PeakRssKb() << ',' << buffer.GetCount();
+    return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const size_t max_size = argc > 1 ? stoull(argv[1]) : SIZE_MAX;
+
+        cout << "size,mode,source_bytes,parse_ms,first_output_ms,total_ms,"
+                "rss_after_parse_kb,peak_rss_kb,output_bytes\n"sv;
+        for (const size_t size : SIZES) {
+            if (size > max_size) {
+                break;
+            }
+            for (const bool lazy : {false, true}) {
+                const string row = bench::RunInChild([size, lazy] {
+                    return Measure(size, lazy);
+                });
+                cout << size << ',' << (lazy ? "lazy"sv : "eager"sv) << ',' << row << endl;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Генератор нагрузки для сервера Mython (mython --serve=<socket>).
+// Несколько соединений параллельно отправляют запросы и измеряют задержку каждого ответа.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/load_generator.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o load_generator
+// Запуск:
+//   ./load_generator --socket=<path> [--connections=8] [--requests=1000]
+//                    [--mode=source|id] [--program=file.my]
+// В режиме source каждый запрос передаёт текст программы, в режиме id - идентификатор,
+// полученный заранее через COMPILE.
+
+#include "server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const string DEFAULT_PROGRAM = R"(class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+f = Fib()
+print input, f.calc(10)
+)"s;
+
+struct Options {
+    string socket;
+    size_t connections = 8;
+    size_t requests = 1000;
+    bool by_id = false;
+    string program = DEFAULT_PROGRAM;
+};
+
+Options ParseCommandLine(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const auto eq = arg.find('=');
+        const string name = arg.substr(0, eq);
+        const string value = eq == string::npos ? ""s : arg.substr(eq + 1);
+        if (name == "--socket"s) {
+            options.socket = value;
+        } else if (name == "--connections"s) {
+            options.connections = max<size_t>(1, stoull(value));
+        } else if (name == "--requests"s) {
+            options.requests = stoull(value);
+        } else if (name == "--mode"s) {
+            options.by_id = value == "id"s;
+        } else if (name == "--program"s) {
+            ifstream file(value);
+            options.program.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        } else {
+            throw invalid_argument("Unknown option "s + arg);
+        }
+    }
+    if (options.socket.empty()) {
+        throw invalid_argument("--socket is required"s);
+    }
+    return options;
+}
+
+double Percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t index = min(sorted.size() - 1, static_cast<size_t>(p / 100 * sorted.size()));
+    return sorted[index];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = ParseCommandLine(argc, argv);
+        string program_id;
+        if (options.by_id) {
+            program_id = MythonClient(options.socket).Compile(options.program);
+        }
+
+        vector<double> latencies_us;
+        size_t errors = 0;
+        mutex results_mutex;
+        vector<thread> threads;
+        const auto start = chrono::steady_clock::now();
+        for (size_t c = 0; c < options.connections; ++c) {
+            threads.emplace_back([&, c] {
+                MythonClient client(options.socket);
+                vector<double> local;
+                size_t local_errors = 0;
+                for (size_t i = c; i < options.requests; i += options.connections) {
+                    const string input = to_string(i);
+                    const auto request_start = chrono::steady_clock::now();
+                    const RunReply reply = options.by_id ? client.Exec(program_id, input)
+                                                         : client.Run(options.program, input);
+                    local.push_back(chrono::duration<double, micro>(chrono::steady_clock::now()
+                                                                    - request_start)
+                                        .count());
+                    local_errors += !reply.ok;
+                }
+                lock_guard lock(results_mutex);
+                latencies_us.insert(latencies_us.end(), local.begin(), local.end());
+                errors += local_errors;
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+        sort(latencies_us.begin(), latencies_us.end());
+        cout << fixed << setprecision(1);
+        cout << "requests: "sv << latencies_us.size() << ", errors: "sv << errors << '\n';
+        cout << "throughput: "sv << latencies_us.size() / elapsed.count() << " req/s\n"sv;
+        cout << "latency us: p50 "sv << Percentile(latencies_us, 50) << ", p90 "sv
+             << Percentile(latencies_us, 90) << ", p99 "sv << Percentile(latencies_us, 99)
+             << ", max "sv << (latencies_us.empty() ? 0 : latencies_us.back()) << endl;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
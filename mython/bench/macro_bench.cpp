@@ -0,0 +1,271 @@
+// Макробенчмарки: выполнение программ Mython из корпуса bench/corpus.
+// Для каждой программы и каждого способа выполнения измеряются время, пиковый объём
+// резидентной памяти, число размещённых объектов и объём вывода. Результаты сравниваются
+// с сохранённым базовым замером.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/macro_bench.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o macro_bench
+// Запуск:
+//   ./macro_bench [--corpus=bench/corpus] [--baseline=bench/corpus/baseline.tsv]
+//                 [--write-baseline=file] [--runs=3] [--threshold=10]
+// Код возврата равен 1, если хотя бы один показатель ухудшился сильнее порога.
+
+#include "bench/bench_util.h"
+#include "census.h"
+#include "jit.h"
+#include "program.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Способ выполнения скомпилированной программы
+struct Engine {
+    string name;
+    function<void(const CompiledProgram&, runtime::Context&)> run;
+};
+
+const vector<Engine>& GetEngines() {
+    static const vector<Engine> engines = {
+        {"ast"s,
+         [](const CompiledProgram& program, runtime::Context& context) {
+             program.Run(context);
+         }},
+        {"ast-interpreter-stack"s,
+         [](const CompiledProgram& program, runtime::Context& context) {
+             runtime::Closure closure;
+             program.Run(closure, context, runtime::InterpreterStackOptions{});
+         }},
+        {"ast-jit"s,
+         [](const CompiledProgram& program, runtime::Context& context) {
+             jit::MethodJit method_jit;
+             context.SetCallAccelerator(&method_jit);
+             program.Run(context);
+             context.SetCallAccelerator(nullptr);
+         }},
+        {"ast-vm"s,
+         [](const CompiledProgram& program, runtime::Context& context) {
+             vm::BytecodeVm bytecode_vm;
+             context.SetCallAccelerator(&bytecode_vm);
+             program.Run(context);
+             context.SetCallAccelerator(nullptr);
+         }},
+    };
+    return engines;
+}
+
+struct Measurement {
+    double wall_ms = 0;
+    long peak_rss_kb = 0;
+    uint64_t allocations = 0;
+    uint64_t output_bytes = 0;
+};
+
+Measurement Measure(const string& source, const Engine& engine, int runs) {
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+
+    Measurement result;
+    vector<double> times;
+    for (int i = 0; i < runs; ++i) {
+        bench::CountingBuffer buffer;
+        ostream output(&buffer);
+        runtime::SimpleContext context{output};
+        const auto start = chrono::steady_clock::now();
+        engine.run(program, context);
+        const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        times.push_back(elapsed.count());
+        result.output_bytes = buffer.GetCount();
+    }
+    nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    result.wall_ms = times[times.size() / 2];
+
+    result.peak_rss_kb = bench::PeakRssKb();
+
+    // Учёт размещений замедляет выполнение, поэтому делается отдельным запуском после замеров
+    bench::CountingBuffer buffer;
+    ostream output(&buffer);
+    runtime::SimpleContext context{output};
+    profile::HeapCensus census;
+    census.Start();
+    engine.run(program, context);
+    census.Stop();
+    for (const auto& site : census.TakeSnapshot().sites) {
+        result.allocations += site.allocations;
+    }
+    return result;
+}
+
+// Выполняет замер в дочернем процессе, чтобы пиковый объём памяти относился
+// только к одной программе
+Measurement MeasureInChild(const string& source, const Engine& engine, int runs) {
+    istringstream in(bench::RunInChild([&source, &engine, runs] {
+        const Measurement m = Measure(source, engine, runs);
+        ostringstream out;
+        out << m.wall_ms << ' ' << m.peak_rss_kb << ' ' << m.allocations << ' ' << m.output_bytes;
+        return out.str();
+    }));
+    Measurement m;
+    in >> m.wall_ms >> m.peak_rss_kb >> m.allocations >> m.output_bytes;
+    return m;
+}
+
+using Key = pair<string, string>;  // программа, способ выполнения
+using Baseline = map<Key, Measurement>;
+
+// Базовый замер хранится в виде строк, разделённых табуляцией:
+// program engine wall_ms peak_rss_kb allocations output_bytes
+Baseline ReadBaseline(const string& path) {
+    Baseline baseline;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        istringstream fields(line);
+        Key key;
+        Measurement m;
+        if (fields >> key.first >> key.second >> m.wall_ms >> m.peak_rss_kb >> m.allocations
+                   >> m.output_bytes) {
+            baseline[key] = m;
+        }
+    }
+    return baseline;
+}
+
+void WriteBaseline(const string& path, const Baseline& results) {
+    ofstream out(path);
+    if (!out) {
+        throw runtime_error("Can't open "s + path);
+    }
+    out << "# program\tengine\twall_ms\tpeak_rss_kb\tallocations\toutput_bytes\n"sv;
+    for (const auto& [key, m] : results) {
+        out << key.first << '\t' << key.second << '\t' << fixed << setprecision(1) << m.wall_ms
+            << '\t' << m.peak_rss_kb << '\t' << m.allocations << '\t' << m.output_bytes << '\n';
+    }
+}
+
+// Возвращает изменение в процентах относительно базового значения
+double PercentChange(double base, double current) {
+    return base == 0 ? 0 : (current - base) / base * 100;
+}
+
+string FormatChange(double base, double current) {
+    ostringstream out;
+    out << showpos << fixed << setprecision(1) << PercentChange(base, current) << '%';
+    return out.str();
+}
+
+struct Options {
+    string corpus = "bench/corpus"s;
+    string baseline = "bench/corpus/baseline.tsv"s;
+    string write_baseline;
+    int runs = 3;
+    double threshold = 10;
+};
+
+Options ParseCommandLine(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const auto eq = arg.find('=');
+        const string name = arg.substr(0, eq);
+        const string value = eq == string::npos ? ""s : arg.substr(eq + 1);
+        if (name == "--corpus"s) {
+            options.corpus = value;
+        } else if (name == "--baseline"s) {
+            options.baseline = value;
+        } else if (name == "--write-baseline"s) {
+            options.write_baseline = value;
+        } else if (name == "--runs"s) {
+            options.runs = max(1, stoi(value));
+        } else if (name == "--threshold"s) {
+            options.threshold = stod(value);
+        } else {
+            throw invalid_argument("Unknown option "s + arg);
+        }
+    }
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = ParseCommandLine(argc, argv);
+        const Baseline baseline = ReadBaseline(options.baseline);
+
+        vector<fs::path> programs;
+        for (const auto& entry : fs::directory_iterator(options.corpus)) {
+            if (entry.path().extension() == ".my"s) {
+                programs.push_back(entry.path());
+            }
+        }
+        sort(programs.begin(), programs.end());
+
+        cout << left << setw(20) << "program"sv << setw(24) << "engine"sv << right << setw(12)
+             << "wall_ms"sv << setw(12) << "rss_kb"sv << setw(12) << "allocs"sv << setw(12)
+             << "output"sv << "  vs baseline (wall, rss, allocs, output)\n"sv;
+
+        Baseline results;
+        bool regressed = false;
+        for (const auto& path : programs) {
+            ifstream file(path);
+            const string source{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+            for (const auto& engine : GetEngines()) {
+                const Key key{path.stem().string(), engine.name};
+                const Measurement m = MeasureInChild(source, engine, options.runs);
+                results[key] = m;
+
+                cout << left << setw(20) << key.first << setw(24) << key.second << right
+                     << fixed << setprecision(1) << setw(12) << m.wall_ms << setw(12)
+                     << m.peak_rss_kb << setw(12) << m.allocations << setw(12)
+                     << m.output_bytes;
+                if (const auto it = baseline.find(key); it != baseline.end()) {
+                    const Measurement& base = it->second;
+                    cout << "  "sv << FormatChange(base.wall_ms, m.wall_ms) << ' '
+                         << FormatChange(base.peak_rss_kb, m.peak_rss_kb) << ' '
+                         << FormatChange(base.allocations, m.allocations) << ' '
+                         << FormatChange(base.output_bytes, m.output_bytes);
+                    // Число размещений и объём вывода детерминированы, поэтому для них
+                    // регрессией считается любой рост
+                    if (PercentChange(base.wall_ms, m.wall_ms) > options.threshold
+                        || PercentChange(base.peak_rss_kb, m.peak_rss_kb) > options.threshold
+                        || m.allocations > base.allocations
+                        || m.output_bytes != base.output_bytes) {
+                        cout << "  REGRESSION"sv;
+                        regressed = true;
+                    }
+                } else {
+                    cout << "  (no baseline)"sv;
+                }
+                cout << endl;
+            }
+        }
+
+        if (!options.write_baseline.empty()) {
+            WriteBaseline(options.write_baseline, results);
+        }
+        return regressed ? 1 : 0;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+}
@@ -0,0 +1,239 @@
+// Микробенчмарки лексера, парсера и операций времени выполнения Mython.
+// Результаты выводятся в формате JSON, чтобы их можно было сравнивать между версиями.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/micro_bench.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o micro_bench
+// Запуск: ./micro_bench [фильтр по имени] > micro.json
+
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+#include "statement.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+// Минимальное время одного замера
+constexpr auto MIN_MEASURE_TIME = chrono::milliseconds(100);
+// Количество замеров, из которых берётся медиана
+constexpr int MEASURE_COUNT = 5;
+
+// Не даёт компилятору выбросить вычисление результата
+volatile size_t sink = 0;
+
+struct Result {
+    string name;
+    double value = 0;
+    string unit;
+    size_t iterations = 0;
+};
+
+// Возвращает медианное время одной итерации body в наносекундах
+double MeasureNsPerOp(const function<void()>& body, size_t& iterations) {
+    iterations = 1;
+    for (;;) {
+        const auto start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            body();
+        }
+        if (Clock::now() - start >= MIN_MEASURE_TIME) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    vector<double> samples;
+    for (int i = 0; i < MEASURE_COUNT; ++i) {
+        const auto start = Clock::now();
+        for (size_t j = 0; j < iterations; ++j) {
+            body();
+        }
+        const chrono::duration<double, nano> elapsed = Clock::now() - start;
+        samples.push_back(elapsed.count() / iterations);
+    }
+    nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Контекст, отбрасывающий вывод
+class NullContext : public runtime::Context {
+public:
+    std::ostream& GetOutputStream() override {
+        output_.str({});
+        return output_;
+    }
+
+private:
+    ostringstream output_;
+};
+
+// Строка генерируемой программы и количество узлов дерева, которое из неё получается
+constexpr string_view GENERATED_LINE = "x = a + b * 2 - 'abc'\n"sv;
+constexpr size_t NODES_PER_LINE = 8;
+
+string GenerateSource(size_t lines) {
+    string source;
+    source.reserve(lines * GENERATED_LINE.size());
+    for (size_t i = 0; i < lines; ++i) {
+        source += GENERATED_LINE;
+    }
+    return source;
+}
+
+unique_ptr<runtime::Executable> ParseString(const string& source) {
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    return ParseProgram(lexer);
+}
+
+class Benchmarks {
+public:
+    explicit Benchmarks(string filter)
+        : filter_(std::move(filter)) {
+    }
+
+    void Run(const string& name, const string& unit, double ops_per_iteration,
+             const function<void()>& body) {
+        if (name.find(filter_) == string::npos) {
+            return;
+        }
+        size_t iterations = 0;
+        const double ns = MeasureNsPerOp(body, iterations);
+        double value = ns / ops_per_iteration;
+        if (unit != "ns/op"s) {
+            // Пропускная способность: единиц в секунду
+            value = ops_per_iteration / ns * 1e9;
+        }
+        results_.push_back({name, value, unit, iterations});
+        cerr << name << ": "sv << value << ' ' << unit << endl;
+    }
+
+    void PrintJson(ostream& out) const {
+        out << "{\n  \"benchmarks\": [\n"sv;
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const auto& r = results_[i];
+            out << "    {\"name\": \""sv << r.name << "\", \"value\": "sv << r.value
+                << ", \"unit\": \""sv << r.unit << "\", \"iterations\": "sv << r.iterations
+                << '}' << (i + 1 < results_.size() ? ",\n"sv : "\n"sv);
+        }
+        out << "  ]\n}\n"sv;
+    }
+
+private:
+    string filter_;
+    vector<Result> results_;
+};
+
+void RunFrontEndBenchmarks(Benchmarks& benchmarks) {
+    constexpr size_t LINES = 2000;
+    const string source = GenerateSource(LINES);
+
+    benchmarks.Run("lexer"s, "MB/s"s, source.size() / 1e6, [&source] {
+        istringstream input(source);
+        parse::Lexer lexer(input);
+        sink = sink + lexer.CurrentLine();
+    });
+
+    benchmarks.Run("parser"s, "nodes/s"s, LINES * NODES_PER_LINE, [&source] {
+        istringstream input(source);
+        parse::Lexer lexer(input);
+        sink = sink + (ParseProgram(lexer) != nullptr);
+    });
+}
+
+void RunRuntimeBenchmarks(Benchmarks& benchmarks) {
+    NullContext context;
+    runtime::Closure closure;
+    ParseString(R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+  def get():
+    return self.x
+
+  def same(other):
+    return self.x == other.x
+
+  def __eq__(other):
+    return self.x == other.x
+
+p = Point(1)
+q = Point(1)
+s = 'hello'
+)"s)->Execute(closure, context);
+
+    auto& point = *closure.at("p"s).TryAs<runtime::ClassInstance>();
+    const runtime::ObjectHolder other = closure.at("q"s);
+
+    benchmarks.Run("method_call_no_args"s, "ns/op"s, 1, [&] {
+        sink = sink + (point.Call("get"s, {}, context).Get() != nullptr);
+    });
+    benchmarks.Run("method_call_one_arg"s, "ns/op"s, 1, [&] {
+        sink = sink + (point.Call("same"s, {other}, context).Get() != nullptr);
+    });
+
+    ast::VariableValue field_read(vector<string>{"p"s, "x"s});
+    benchmarks.Run("field_read"s, "ns/op"s, 1, [&] {
+        sink = sink + (field_read.Execute(closure, context).Get() != nullptr);
+    });
+
+    ast::FieldAssignment field_write(ast::VariableValue("p"s), "x"s,
+                                     make_unique<ast::NumericConst>(runtime::Number{2}));
+    benchmarks.Run("field_write"s, "ns/op"s, 1, [&] {
+        sink = sink + (field_write.Execute(closure, context).Get() != nullptr);
+    });
+
+    ast::Add concat(make_unique<ast::VariableValue>("s"s),
+                    make_unique<ast::StringConst>(runtime::String{", world"s}));
+    benchmarks.Run("string_concat"s, "ns/op"s, 1, [&] {
+        sink = sink + (concat.Execute(closure, context).Get() != nullptr);
+    });
+
+    const auto one = runtime::ObjectHolder::Own(runtime::Number{1});
+    const auto two = runtime::ObjectHolder::Own(runtime::Number{2});
+    const auto abc = runtime::ObjectHolder::Own(runtime::String{"abc"s});
+    const auto abd = runtime::ObjectHolder::Own(runtime::String{"abd"s});
+    benchmarks.Run("equal_numbers"s, "ns/op"s, 1, [&] {
+        sink = sink + runtime::Equal(one, two, context);
+    });
+    benchmarks.Run("less_strings"s, "ns/op"s, 1, [&] {
+        sink = sink + runtime::Less(abc, abd, context);
+    });
+    const runtime::ObjectHolder p = closure.at("p"s);
+    benchmarks.Run("equal_instances_dunder"s, "ns/op"s, 1, [&] {
+        sink = sink + runtime::Equal(p, other, context);
+    });
+
+    constexpr size_t PRINT_ARGS = 4;
+    vector<unique_ptr<ast::Statement>> print_args;
+    for (size_t i = 0; i < PRINT_ARGS; ++i) {
+        print_args.push_back(make_unique<ast::VariableValue>("s"s));
+    }
+    ast::Print print_line(std::move(print_args));
+    benchmarks.Run("print_values"s, "values/s"s, PRINT_ARGS, [&] {
+        sink = sink + (print_line.Execute(closure, context).Get() != nullptr);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmarks benchmarks(argc > 1 ? argv[1] : ""s);
+    RunFrontEndBenchmarks(benchmarks);
+    RunRuntimeBenchmarks(benchmarks);
+    benchmarks.PrintJson(cout);
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Профиль пар инструкций байт-кода на программах корпуса bench/corpus.
+// Программы выполняются виртуальной машиной без суперинструкций, и для каждой пары
+// инструкций, выполненных подряд, выводится её доля среди всех диспетчеризаций.
+// Самые частые пары - кандидаты в суперинструкции (см. FuseInstructions в bytecode.cpp).
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/opcode_profile.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o opcode_profile
+// Запуск:
+//   ./opcode_profile [--corpus=bench/corpus] [--top=20] [программа.my ...]
+
+#include "program.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    string corpus = "bench/corpus"s;
+    size_t top = 20;
+    vector<fs::path> programs;
+};
+
+Options ParseCommandLine(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg.rfind("--"s, 0) != 0) {
+            options.programs.emplace_back(arg);
+            continue;
+        }
+        const auto eq = arg.find('=');
+        const string name = arg.substr(0, eq);
+        const string value = eq == string::npos ? ""s : arg.substr(eq + 1);
+        if (name == "--corpus"s) {
+            options.corpus = value;
+        } else if (name == "--top"s) {
+            options.top = stoul(value);
+        } else {
+            throw invalid_argument("Unknown option "s + arg);
+        }
+    }
+    return options;
+}
+
+using PairKey = pair<vm::OpCode, vm::OpCode>;
+
+void PrintPairs(const map<PairKey, uint64_t>& pairs, uint64_t dispatches, size_t top) {
+    vector<pair<PairKey, uint64_t>> sorted(pairs.begin(), pairs.end());
+    sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second > rhs.second;
+    });
+    for (size_t i = 0; i < sorted.size() && i < top; ++i) {
+        const auto& [key, count] = sorted[i];
+        const string name = string(vm::OpCodeName(key.first)) + " + "s
+                            + string(vm::OpCodeName(key.second));
+        cout << "  "sv << left << setw(36) << name << right << setw(12) << count << setw(8)
+             << fixed << setprecision(1) << 100.0 * count / max<uint64_t>(dispatches, 1)
+             << "%\n"sv;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = ParseCommandLine(argc, argv);
+        if (options.programs.empty()) {
+            for (const auto& entry : fs::directory_iterator(options.corpus)) {
+                if (entry.path().extension() == ".my"s) {
+                    options.programs.push_back(entry.path());
+                }
+            }
+            sort(options.programs.begin(), options.programs.end());
+        }
+
+        map<PairKey, uint64_t> total;
+        uint64_t total_dispatches = 0;
+        for (const auto& path : options.programs) {
+            ifstream file(path);
+            istringstream input(
+                string{istreambuf_iterator<char>(file), istreambuf_iterator<char>()});
+            const CompiledProgram program = CompiledProgram::Compile(input);
+
+            vm::VmOptions vm_options;
+            vm_options.count_dispatches = true;
+            vm_options.superinstructions = false;
+            vm::BytecodeVm bytecode_vm(vm_options);
+            ostringstream output;
+            runtime::SimpleContext context(output);
+            context.SetCallAccelerator(&bytecode_vm);
+            program.Run(context);
+
+            const vm::VmStats stats = bytecode_vm.GetStats();
+            map<PairKey, uint64_t> pairs;
+            for (const auto& pair_count : bytecode_vm.GetPairCounts()) {
+                pairs[{pair_count.first, pair_count.second}] = pair_count.count;
+                total[{pair_count.first, pair_count.second}] += pair_count.count;
+            }
+            total_dispatches += stats.dispatches;
+
+            cout << path.stem().string() << ": "sv << stats.dispatches << " dispatches\n"sv;
+            PrintPairs(pairs, stats.dispatches, options.top);
+        }
+        cout << "total: "sv << total_dispatches << " dispatches\n"sv;
+        PrintPairs(total, total_dispatches, options.top);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+    return 0;
+}
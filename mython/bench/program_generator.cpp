@@ -0,0 +1,234 @@
+#include "program_generator.h"
+
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace bench {
+
+namespace {
+
+// Линейный конгруэнтный генератор. В отличие от распределений стандартной библиотеки
+// даёт одинаковую последовательность на любой платформе
+class Random {
+public:
+    explicit Random(uint64_t seed)
+        : state_(seed) {
+    }
+
+    // Возвращает число от 0 до bound - 1
+    size_t Next(size_t bound) {
+        state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<size_t>((state_ >> 33) % bound);
+    }
+
+private:
+    uint64_t state_;
+};
+
+constexpr uint64_t SEED = 20240229;
+
+// Родитель класса i - класс (i - 1) / 2, поэтому глубина иерархии растёт как log2(size)
+void GenerateManyClasses(size_t size, ostream& out) {
+    Random random(SEED);
+    for (size_t i = 0; i < size; ++i) {
+        out << "class C"sv << i;
+        if (i > 0) {
+            out << "(C"sv << (i - 1) / 2 << ')';
+        }
+        out << ":\n"sv;
+        if (i == 0) {
+            out << "  def __init__():\n    self.value = 0\n\n"sv;
+        }
+        out << "  def m"sv << i << "(x):\n"sv
+            << "    self.value = self.value + x * "sv << random.Next(10) + 1 << "\n"sv
+            << "    return self.value\n\n"sv
+            << "  def __str__():\n    return 'C"sv << i << ":' + str(self.value)\n\n"sv;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        out << "o = C"sv << i << "()\n"sv;
+        out << "o.m"sv << i << '(' << random.Next(100) << ")\n"sv;
+        if (i > 0) {
+            out << "o.m"sv << (i - 1) / 2 << '(' << random.Next(100) << ")\n"sv;
+        }
+        if (i % 100 == 0) {
+            out << "print o\n"sv;
+        }
+    }
+}
+
+// Строки сценария изменяют 100 переменных. Выражения не увеличивают значения переменных
+// неограниченно, поэтому сценарий любой длины обходится без переполнения
+void GenerateLongScript(size_t size, ostream& out) {
+    constexpr size_t VARIABLES = 100;
+    Random random(SEED);
+    size_t lines = 0;
+    for (size_t i = 0; i < VARIABLES && lines < size; ++i, ++lines) {
+        out << 'v' << i << " = "sv << random.Next(1000) << '\n';
+    }
+    for (; lines < size; ++lines) {
+        const size_t target = random.Next(VARIABLES);
+        const size_t lhs = random.Next(VARIABLES);
+        const size_t rhs = random.Next(VARIABLES);
+        if (lines % 1000 == 999) {
+            out << "print v"sv << target << ", v"sv << lhs << '\n';
+            continue;
+        }
+        switch (random.Next(4)) {
+            case 0:
+                out << 'v' << target << " = (v"sv << lhs << " + v"sv << rhs << ") / 2 + "sv
+                    << random.Next(10) << '\n';
+                break;
+            case 1: {
+                const size_t weight = random.Next(7) + 1;
+                out << 'v' << target << " = (v"sv << lhs << " * "sv << weight << " + "sv
+                    << random.Next(100) << ") / "sv << weight + 1 << '\n';
+                break;
+            }
+            case 2:
+                out << 's' << target % 10 << " = str(v"sv << lhs << ") + 'x'\n"sv;
+                break;
+            default:
+                out << 'v' << target << " = v"sv << lhs << " / 2 + "sv << random.Next(50) << '\n';
+                break;
+        }
+    }
+}
+
+// Класс L(i) объявляет метод level(i); экземпляр самого глубокого класса вызывает методы
+// корня, середины и самого глубокого уровня
+void GenerateDeepInheritance(size_t size, ostream& out) {
+    for (size_t i = 0; i < size; ++i) {
+        out << "class L"sv << i;
+        if (i > 0) {
+            out << "(L"sv << i - 1 << ')';
+        }
+        out << ":\n"sv;
+        if (i == 0) {
+            out << "  def __init__():\n    self.calls = 0\n\n"sv
+                << "  def touch():\n    self.calls = self.calls + 1\n    return self.calls\n\n"sv;
+        }
+        out << "  def level"sv << i << "():\n    self.touch()\n    return "sv << i << "\n\n"sv;
+    }
+    if (size == 0) {
+        return;
+    }
+    const size_t last = size - 1;
+    out << "o = L"sv << last << "()\n"sv;
+    for (size_t i = 0; i < 100; ++i) {
+        out << "o.level0()\no.level"sv << last / 2 << "()\no.level"sv << last << "()\n"sv;
+    }
+    out << "print o.calls\n"sv;
+}
+
+void PrintChain(size_t length, ostream& out) {
+    out << "head"sv;
+    for (size_t i = 0; i < length; ++i) {
+        out << ".next"sv;
+    }
+}
+
+// Звено i списка создаётся переменной n(i), затем переменные перезаписываются,
+// и звенья остаются доступны только через head.next.next...
+void GenerateDottedChain(size_t size, ostream& out) {
+    out << "class Link:\n  def __init__(value):\n    self.value = value\n    self.next = None\n\n"sv;
+    out << "head = Link(0)\ntail = head\n"sv;
+    for (size_t i = 1; i <= size; ++i) {
+        out << "n = Link("sv << i << ")\ntail.next = n\ntail = n\n"sv;
+    }
+    out << "n = None\ntail = None\n"sv;
+    for (size_t i = 0; i < 100; ++i) {
+        PrintChain(size, out);
+        out << ".value = "sv << i << '\n';
+        out << "x = "sv;
+        PrintChain(size, out);
+        out << ".value\n"sv;
+    }
+    out << "print x\n"sv;
+}
+
+// Каждый класс объявляет LIBRARY_METHODS методов с ветвлениями и арифметикой.
+// Создаётся экземпляр каждого десятого класса, и у него вызывается один метод
+void GenerateLibrary(size_t size, ostream& out) {
+    constexpr size_t LIBRARY_METHODS = 8;
+    Random random(SEED);
+    for (size_t i = 0; i < size; ++i) {
+        out << "class M"sv << i << ":\n  def __init__(seed):\n    self.seed = seed\n\n"sv;
+        for (size_t j = 0; j < LIBRARY_METHODS; ++j) {
+            const size_t k = random.Next(9) + 1;
+            out << "  def f"sv << j << "(a, b):\n"sv
+                << "    x = a * "sv << k << " + b\n"sv
+                << "    if x > self.seed:\n"sv
+                << "      x = x - self.seed / "sv << k << "\n"sv
+                << "    else:\n"sv
+                << "      x = x + "sv << random.Next(100) << "\n"sv
+                << "    self.seed = (self.seed + x) / 2\n"sv
+                << "    return 'M"sv << i << ".f"sv << j << ": ' + str(x)\n\n"sv;
+        }
+    }
+    for (size_t i = 0; i < size; i += 10) {
+        out << "o = M"sv << i << '(' << random.Next(100) << ")\n"sv
+            << "print o.f"sv << random.Next(LIBRARY_METHODS) << '(' << random.Next(100) << ", "sv
+            << random.Next(100) << ")\n"sv;
+    }
+}
+
+}  // namespace
+
+string_view ShapeName(ProgramShape shape) {
+    switch (shape) {
+        case ProgramShape::ManyClasses:
+            return "classes"sv;
+        case ProgramShape::LongScript:
+            return "lines"sv;
+        case ProgramShape::DeepInheritance:
+            return "inheritance"sv;
+        case ProgramShape::DottedChain:
+            return "chain"sv;
+        case ProgramShape::Library:
+            return "library"sv;
+    }
+    return {};
+}
+
+ProgramShape ParseShape(string_view name) {
+    for (auto shape : {ProgramShape::ManyClasses, ProgramShape::LongScript,
+                       ProgramShape::DeepInheritance, ProgramShape::DottedChain,
+                       ProgramShape::Library}) {
+        if (ShapeName(shape) == name) {
+            return shape;
+        }
+    }
+    throw invalid_argument("Unknown program shape "s + string(name));
+}
+
+void GenerateProgram(ProgramShape shape, size_t size, ostream& out) {
+    switch (shape) {
+        case ProgramShape::ManyClasses:
+            GenerateManyClasses(size, out);
+            break;
+        case ProgramShape::LongScript:
+            GenerateLongScript(size, out);
+            break;
+        case ProgramShape::DeepInheritance:
+            GenerateDeepInheritance(size, out);
+            break;
+        case ProgramShape::DottedChain:
+            GenerateDottedChain(size, out);
+            break;
+        case ProgramShape::Library:
+            GenerateLibrary(size, out);
+            break;
+    }
+}
+
+string GenerateProgram(ProgramShape shape, size_t size) {
+    ostringstream out;
+    GenerateProgram(shape, size, out);
+    return out.str();
+}
+
+}  // namespace bench
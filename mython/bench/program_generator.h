@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace bench {
+
+    // Форма генерируемой программы Mython
+    enum class ProgramShape {
+        // size классов, унаследованных друг от друга деревом небольшой глубины,
+        // с созданием экземпляра каждого класса и вызовами методов
+        ManyClasses,
+        // Сценарий из size строк присваиваний и арифметических выражений без классов
+        LongScript,
+        // Цепочка наследования глубиной size и вызовы методов, объявленных на разной глубине
+        DeepInheritance,
+        // Связный список из size объектов, поля которого читаются и изменяются
+        // через точечную запись длиной size
+        DottedChain,
+        // size классов по нескольку методов, из которых программа вызывает лишь немногие,
+        // как в сгенерированных модулях
+        Library,
+    };
+
+    // Возвращает имя формы, используемое в командной строке:
+    // classes, lines, inheritance, chain, library
+    std::string_view ShapeName(ProgramShape shape);
+
+    // Возвращает форму по имени. Если имя неизвестно, выбрасывает std::invalid_argument
+    ProgramShape ParseShape(std::string_view name);
+
+    // Выводит в out программу Mython заданной формы и размера.
+    // Для одних и тех же аргументов текст программы всегда одинаков
+    void GenerateProgram(ProgramShape shape, size_t size, std::ostream& out);
+
+    std::string GenerateProgram(ProgramShape shape, size_t size);
+
+}  // namespace bench
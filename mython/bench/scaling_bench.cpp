@@ -0,0 +1,107 @@
+// Зависимость времени лексического и синтаксического разбора, времени выполнения и памяти
+// от размера программы. Программы создаются bench/program_generator.h, каждый замер
+// выполняется в отдельном процессе. Результаты выводятся в формате CSV для построения графиков.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/scaling_bench.cpp bench/program_generator.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o scaling_bench
+// Запуск: ./scaling_bench [classes|lines|inheritance|chain|library] [max_size] > scaling.csv
+
+#include "bench/bench_util.h"
+#include "bench/program_generator.h"
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+struct Series {
+    bench::ProgramShape shape;
+    vector<size_t> sizes;
+};
+
+const vector<Series> SERIES = {
+    {bench::ProgramShape::ManyClasses, {1000, 2500, 5000, 10000}},
+    {bench::ProgramShape::LongScript, {10000, 100000, 1000000}},
+    {bench::ProgramShape::DeepInheritance, {10, 100, 1000}},
+    {bench::ProgramShape::DottedChain, {10, 100, 1000}},
+    {bench::ProgramShape::Library, {1000, 5000, 20000}},
+};
+
+// Выполняет один замер и возвращает строку CSV без формы и размера
+string Measure(bench::ProgramShape shape, size_t size) {
+    const string source = bench::GenerateProgram(shape, size);
+    istringstream input(source);
+
+    auto start = Clock::now();
+    parse::Lexer lexer(input);
+    const double lex_ms = ElapsedMs(start);
+    const long lex_rss = bench::PeakRssKb();
+
+    start = Clock::now();
+    const auto tree = ParseProgram(lexer);
+    const double parse_ms = ElapsedMs(start);
+    const long parse_rss = bench::PeakRssKb();
+
+    bench::CountingBuffer buffer;
+    ostream output(&buffer);
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    start = Clock::now();
+    tree->Execute(closure, context);
+    const double exec_ms = ElapsedMs(start);
+
+    ostringstream out;
+    out << source.size() << ',' << lex_ms << ',' << parse_ms << ',' << exec_ms << ','
+        << lex_rss << ',' << parse_rss << ',' << bench::PeakRssKb() << ','
+        << buffer.GetCount();
+    return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        optional<bench::ProgramShape> only;
+        if (argc > 1) {
+            only = bench::ParseShape(argv[1]);
+        }
+        const size_t max_size = argc > 2 ? stoull(argv[2]) : SIZE_MAX;
+
+        cout << "shape,size,source_bytes,lex_ms,parse_ms,exec_ms,"
+                "rss_after_lex_kb,rss_after_parse_kb,peak_rss_kb,output_bytes\n"sv;
+        for (const auto& series : SERIES) {
+            if (only && *only != series.shape) {
+                continue;
+            }
+            for (const size_t size : series.sizes) {
+                if (size > max_size) {
+                    break;
+                }
+                const string row = bench::RunInChild([&series, size] {
+                    return Measure(series.shape, size);
+                });
+                cout << bench::ShapeName(series.shape) << ',' << size << ',' << row << endl;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
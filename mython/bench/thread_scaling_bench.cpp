@@ -0,0 +1,89 @@
+// Замер пропускной способности CompiledProgram при запуске с 1 до N потоков.
+// Программа компилируется один раз, каждый поток выполняет её со своими Context и Closure.
+//
+// Сборка (из каталога mython):
+//   g++ -std=c++17 -O2 -pthread -I. bench/thread_scaling_bench.cpp \
+//       $(ls *.cpp | grep -v -e main.cpp -e _test.cpp) -o thread_scaling_bench
+// Запуск: ./thread_scaling_bench [max_threads] [runs_per_thread]
+
+#include "program.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const string WORKLOAD = R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+f = Fib()
+print f.calc(15)
+)"s;
+
+// Контекст, отбрасывающий весь вывод программы
+class NullContext : public runtime::Context {
+public:
+    std::ostream& GetOutputStream() override {
+        output_.str({});
+        return output_;
+    }
+
+private:
+    std::ostringstream output_;
+};
+
+double MeasureRunsPerSecond(const CompiledProgram& program, int thread_count,
+                            int runs_per_thread) {
+    vector<thread> threads;
+    const auto start = chrono::steady_clock::now();
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&program, runs_per_thread] {
+            NullContext context;
+            for (int run = 0; run < runs_per_thread; ++run) {
+                program.Run(context);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return thread_count * runs_per_thread / elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int max_threads
+        = argc > 1 ? stoi(argv[1]) : static_cast<int>(max(1u, thread::hardware_concurrency()));
+    const int runs_per_thread = argc > 2 ? stoi(argv[2]) : 200;
+
+    istringstream input(WORKLOAD);
+    const auto program = CompiledProgram::Compile(input);
+
+    cout << "threads  runs/s      speedup  efficiency"s << endl;
+    double single = 0.0;
+    for (int threads = 1; threads <= max_threads; ++threads) {
+        const double rate = MeasureRunsPerSecond(program, threads, runs_per_thread);
+        if (threads == 1) {
+            single = rate;
+        }
+        const double speedup = rate / single;
+        cout << setw(7) << threads << "  "s << setw(10) << fixed << setprecision(1) << rate
+             << "  "s << setw(7) << setprecision(2) << speedup << "  "s << setw(9)
+             << setprecision(2) << speedup / threads << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,1585 @@
+#include "bytecode.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+using runtime::ObjectHolder;
+using Statement = runtime::Executable;
+using CompareFunction = bool (*)(const ObjectHolder&, const ObjectHolder&, runtime::Context&);
+
+const string SELF = "self"s;
+const string INIT_METHOD = "__init__"s;
+
+constexpr size_t MAX_OPERAND = numeric_limits<uint16_t>::max();
+
+// Статический тип значения. Bottom - тип переменной, которой не присвоено значение
+// ни на одном пути к точке метода, либо значения в недостижимом коде
+enum class Type {
+    Bottom,
+    Int,
+    Str,
+    Bool,
+    Unknown,
+};
+
+Type Join(Type lhs, Type rhs) {
+    if (lhs == Type::Bottom) {
+        return rhs;
+    }
+    if (rhs == Type::Bottom || lhs == rhs) {
+        return lhs;
+    }
+    return Type::Unknown;
+}
+
+// Варианты инструкции сравнения: общий, для чисел, для чисел без упаковки и для строк
+struct CompareOps {
+    CompareFunction function;
+    OpCode generic;
+    OpCode ints;
+    OpCode unboxed;
+    OpCode strings;
+};
+
+constexpr CompareOps COMPARE_OPS[] = {
+    {&runtime::Equal, OpCode::Equal, OpCode::EqualInt, OpCode::EqualUnboxed, OpCode::EqualStr},
+    {&runtime::NotEqual, OpCode::NotEqual, OpCode::NotEqualInt, OpCode::NotEqualUnboxed,
+     OpCode::NotEqualStr},
+    {&runtime::Less, OpCode::Less, OpCode::LessInt, OpCode::LessUnboxed, OpCode::LessStr},
+    {&runtime::Greater, OpCode::Greater, OpCode::GreaterInt, OpCode::GreaterUnboxed,
+     OpCode::GreaterStr},
+    {&runtime::LessOrEqual, OpCode::LessOrEqual, OpCode::LessOrEqualInt,
+     OpCode::LessOrEqualUnboxed, OpCode::LessOrEqualStr},
+    {&runtime::GreaterOrEqual, OpCode::GreaterOrEqual, OpCode::GreaterOrEqualInt,
+     OpCode::GreaterOrEqualUnboxed, OpCode::GreaterOrEqualStr},
+};
+
+const CompareOps* FindCompareOps(const ast::Comparison& comparison) {
+    const auto* function = comparison.GetComparator().target<CompareFunction>();
+    if (function == nullptr) {
+        return nullptr;
+    }
+    for (const auto& ops : COMPARE_OPS) {
+        if (ops.function == *function) {
+            return &ops;
+        }
+    }
+    return nullptr;
+}
+
+// Сведения о переменной метода (self, параметре либо локальной переменной) в точке метода
+struct Local {
+    // Значение присвоено на каждом пути к точке
+    bool assigned = false;
+    Type type = Type::Bottom;
+    // Значение находится в регистре-объекте r и (или) в регистре-числе n. Присвоенная
+    // переменная хранится хотя бы в одном из них
+    bool boxed = false;
+    bool unboxed = false;
+};
+
+// Сведения о переменных в точке метода. Переменные индексируются номерами их регистров
+struct FlowState {
+    vector<Local> locals;
+    // false в коде после return
+    bool reachable = true;
+};
+
+// Инструкции, согласующие хранение переменных в конце пути со слиянием путей
+using Fixups = vector<pair<OpCode, uint16_t>>;
+
+// Использование локальной переменной, которой присваиваются экземпляры классов
+struct InstanceUses {
+    // Значение переменной используется не только для обращения к полям
+    bool escapes = false;
+    // Поля, к которым обращается метод и которые присваивает __init__
+    set<string> fields;
+};
+
+// Поле экземпляра, заменённого регистрами полей, может отсутствовать там, где его читают.
+// Метод переводится заново, и экземпляр в переменной variable создаётся как обычно
+struct EscapingInstance {
+    string variable;
+};
+
+// Назначение операнда инструкции
+enum class Operand {
+    None,
+    // Регистр, который инструкция читает
+    Input,
+    // Регистр, в который инструкция записывает результат
+    Output,
+    Constant,
+    Name,
+    // Адрес перехода
+    Target,
+    CallSite,
+    // Число, хранимое в самой инструкции
+    Immediate,
+};
+
+struct OperandRoles {
+    Operand a = Operand::None;
+    Operand b = Operand::None;
+    Operand c = Operand::None;
+};
+
+OperandRoles GetOperandRoles(OpCode op) {
+    using O = Operand;
+    switch (op) {
+        case OpCode::Nop:
+        case OpCode::PrintNewline:
+        case OpCode::ReturnNone:
+            return {};
+        case OpCode::LoadConst:
+        case OpCode::LoadConstReturn:
+        case OpCode::LoadConstAdd:
+        case OpCode::LoadConstSub:
+            return {O::Output, O::Constant};
+        case OpCode::LoadNone:
+            return {O::Output};
+        case OpCode::LoadInt:
+            return {O::Output, O::Immediate, O::Immediate};
+        case OpCode::Move:
+        case OpCode::Box:
+        case OpCode::Unbox:
+        case OpCode::MoveInt:
+        case OpCode::Not:
+        case OpCode::Stringify:
+            return {O::Output, O::Input};
+        case OpCode::GetField:
+            return {O::Output, O::Input, O::Name};
+        case OpCode::GetSelfField:
+        case OpCode::GetSelfFieldCall:
+        case OpCode::GetSelfFieldGetField:
+            return {O::Output, O::None, O::Name};
+        case OpCode::SetField:
+            return {O::Input, O::Input, O::Name};
+        case OpCode::SetSelfField:
+            return {O::None, O::Input, O::Name};
+        case OpCode::CheckFieldOwner:
+        case OpCode::Return:
+            return {O::Input};
+        case OpCode::Jump:
+            return {O::Target};
+        case OpCode::JumpIfFalse:
+            return {O::Input, O::Target};
+        case OpCode::JumpIfLogical:
+            return {O::Input, O::Target, O::Immediate};
+        case OpCode::Print:
+            return {O::Input, O::Immediate};
+        case OpCode::Call:
+            return {O::Output, O::Input, O::CallSite};
+        case OpCode::CallSelf:
+        case OpCode::CallSelfReturn:
+        case OpCode::CallNative:
+        case OpCode::NewInstance:
+            return {O::Output, O::None, O::CallSite};
+        case OpCode::CheckNativeArg:
+            return {O::Input, O::Immediate, O::CallSite};
+        case OpCode::GuardClass:
+            return {O::Input, O::Target, O::CallSite};
+        case OpCode::GuardSelfClass:
+            return {O::None, O::Target, O::CallSite};
+        default:
+            // Арифметические операции и сравнения, в том числе в суперинструкциях
+            return {O::Output, O::Input, O::Input};
+    }
+}
+
+class MethodCompiler {
+public:
+    MethodCompiler(const runtime::Class& cls, const runtime::Method& method,
+                   const InlinePlan& plan, bool scalar_replacement,
+                   const unordered_set<string>& escaping)
+        : method_(method)
+        , plan_(plan)
+        , scalar_replacement_(scalar_replacement)
+        , escaping_(escaping) {
+        function_.name = cls.GetName() + "."s + method.name;
+    }
+
+    Function Compile() {
+        const runtime::Executable* method_body = nullptr;
+        try {
+            method_body = &ast::GetMethodBody(method_);
+        } catch (const runtime_error& e) {
+            // Ошибку разбора отложенного тела выбросит обход дерева при вызове метода
+            throw UnsupportedMethod("Method body does not parse: "s + e.what());
+        }
+        const auto* body = dynamic_cast<const ast::MethodBody*>(method_body);
+        if (body == nullptr) {
+            throw UnsupportedMethod("Unsupported method body"s);
+        }
+        DeclareVariables(*body->GetBody());
+
+        AddNode();
+        CompileStatement(*body->GetBody());
+        Emit(OpCode::ReturnNone);
+        if (function_.code.size() > MAX_OPERAND) {
+            throw UnsupportedMethod("Method is too long"s);
+        }
+        function_.register_count = static_cast<uint16_t>(max_register_);
+        function_.first_temp = static_cast<uint16_t>(first_temp_);
+        return std::move(function_);
+    }
+
+private:
+    // Регистры: 0 - self, затем параметры и локальные переменные, затем временные значения
+    void DeclareVariables(const Statement& body) {
+        if (method_.formal_params.size() + 1 > MAX_OPERAND) {
+            throw UnsupportedMethod("Too many parameters"s);
+        }
+        function_.param_count = static_cast<uint16_t>(method_.formal_params.size());
+        for (size_t i = 0; i < method_.formal_params.size(); ++i) {
+            const string& name = method_.formal_params[i];
+            if (name == SELF) {
+                throw UnsupportedMethod("Parameter hides self"s);
+            }
+            // Повторяющийся параметр получает значение последнего аргумента, как в Closure
+            variables_[name] = static_cast<uint16_t>(i + 1);
+        }
+        next_register_ = method_.formal_params.size() + 1;
+        CollectLocals(body);
+        if (scalar_replacement_) {
+            DeclareInstanceFields(body);
+        }
+        first_temp_ = next_register_;
+        max_register_ = next_register_;
+        state_.locals.assign(first_temp_, Local{});
+        for (size_t i = 0; i <= method_.formal_params.size(); ++i) {
+            state_.locals[i] = Local{true, Type::Unknown, true, false};
+        }
+    }
+
+    void CollectLocals(const Statement& statement) {
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            for (const auto& child : compound->GetStatements()) {
+                CollectLocals(*child);
+            }
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            CollectLocals(*if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                CollectLocals(*if_else->GetElseBody());
+            }
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            const string& name = assignment->GetVar();
+            if (name == SELF) {
+                throw UnsupportedMethod("Assignment to self"s);
+            }
+            if (variables_.count(name) == 0) {
+                variables_[name] = NewRegister();
+            }
+        }
+    }
+
+    /*
+     * Замена экземпляров регистрами полей. Экземпляр, который метод создаёт и использует
+     * только для чтения и записи полей, не покидает кадр метода, поэтому его можно
+     * не создавать. Каждое поле такого экземпляра хранится в регистре, как локальная
+     * переменная с именем <переменная>.<поле>, а код __init__ переносится в метод и
+     * записывает поля self в эти регистры. Так не создаются ни объект, ни словарь его полей,
+     * и не меняются счётчики ссылок
+     */
+    void DeclareInstanceFields(const Statement& body) {
+        map<string, InstanceUses> uses;
+        FindInstanceUses(body, uses);
+        for (const auto& [name, instance] : uses) {
+            const auto it = variables_.find(name);
+            // Значение параметра создано вне метода
+            if (instance.escapes || it == variables_.end() || it->second <= function_.param_count
+                || escaping_.count(name) > 0) {
+                continue;
+            }
+            scalar_instances_.insert(name);
+            for (const string& field : instance.fields) {
+                const string local = name + '.' + field;
+                variables_[local] = NewRegister();
+                field_owners_[local] = name;
+            }
+        }
+    }
+
+    void FindInstanceUses(const Statement& node, map<string, InstanceUses>& uses) {
+        const auto visit = [&](const auto& children) {
+            for (const auto& child : children) {
+                FindInstanceUses(*child, uses);
+            }
+        };
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&node)) {
+            visit(compound->GetStatements());
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&node)) {
+            FindInstanceUses(*if_else->GetCondition(), uses);
+            FindInstanceUses(*if_else->GetIfBody(), uses);
+            if (if_else->GetElseBody()) {
+                FindInstanceUses(*if_else->GetElseBody(), uses);
+            }
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&node)) {
+            InstanceUses& variable = uses[assignment->GetVar()];
+            const auto* instance = dynamic_cast<const ast::NewInstance*>(assignment->GetValue().get());
+            const Function* init = instance != nullptr ? FindInit(*instance) : nullptr;
+            if (instance == nullptr || (init == nullptr && HasInit(*instance))) {
+                variable.escapes = true;
+            } else if (init != nullptr) {
+                for (const Instruction& instruction : init->code) {
+                    if (instruction.op == OpCode::SetSelfField) {
+                        variable.fields.insert(init->names[instruction.c]);
+                    }
+                }
+            }
+            FindInstanceUses(*assignment->GetValue(), uses);
+        } else if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&node)) {
+            const auto& ids = field->GetObject().GetDottedIds();
+            if (ids.size() == 1) {
+                uses[ids.front()].fields.insert(field->GetFieldName());
+            } else {
+                FindInstanceUses(field->GetObject(), uses);
+            }
+            FindInstanceUses(*field->GetValue(), uses);
+        } else if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&node)) {
+            const auto& ids = variable->GetDottedIds();
+            if (ids.size() == 1) {
+                uses[ids.front()].escapes = true;
+            } else {
+                uses[ids.front()].fields.insert(ids[1]);
+            }
+        } else if (const auto* print = dynamic_cast<const ast::Print*>(&node)) {
+            visit(print->GetArgs());
+        } else if (const auto* ret = dynamic_cast<const ast::Return*>(&node)) {
+            FindInstanceUses(*ret->GetStatement(), uses);
+        } else if (const auto* call = dynamic_cast<const ast::MethodCall*>(&node)) {
+            FindInstanceUses(*call->GetObject(), uses);
+            visit(call->GetArgs());
+        } else if (const auto* native = dynamic_cast<const ast::NativeCall*>(&node)) {
+            visit(native->GetArgs());
+        } else if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&node)) {
+            visit(instance->GetArgs());
+        } else if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&node)) {
+            FindInstanceUses(*stringify->GetArg(), uses);
+        } else if (const auto* negation = dynamic_cast<const ast::Not*>(&node)) {
+            FindInstanceUses(*negation->GetArg(), uses);
+        } else if (const auto* operation = dynamic_cast<const ast::BinaryOperation*>(&node)) {
+            if (operation->GetLhs() && operation->GetRhs()) {
+                FindInstanceUses(*operation->GetLhs(), uses);
+                FindInstanceUses(*operation->GetRhs(), uses);
+            }
+        }
+    }
+
+    // Проверяет, что при создании экземпляра вызывается __init__
+    static bool HasInit(const ast::NewInstance& instance) {
+        const runtime::Method* init = instance.GetClass().GetMethod(INIT_METHOD);
+        return init != nullptr && init->formal_params.size() == instance.GetArgs().size();
+    }
+
+    // Возвращает байт-код __init__, вызываемого при создании экземпляра, если его можно
+    // перенести в метод, создающий экземпляр: код без ветвлений и вызовов, который
+    // использует self только для записи полей и чтения уже записанных полей
+    const Function* FindInit(const ast::NewInstance& instance) {
+        if (!HasInit(instance)) {
+            return nullptr;
+        }
+        const runtime::Method& init = *instance.GetClass().GetMethod(INIT_METHOD);
+        const auto [it, inserted] = inits_.try_emplace(&init);
+        if (!inserted) {
+            return it->second.get();
+        }
+        try {
+            static const InlinePlan no_plan;
+            static const unordered_set<string> no_escaping;
+            auto function = make_unique<Function>(
+                MethodCompiler(instance.GetClass(), init, no_plan, false, no_escaping).Compile());
+            if (CanReplaceInit(*function)) {
+                it->second = std::move(function);
+            }
+        } catch (const UnsupportedMethod&) {
+        }
+        return it->second.get();
+    }
+
+    static bool CanReplaceInit(const Function& init) {
+        if (init.uses_self_value) {
+            return false;
+        }
+        set<string> assigned;
+        for (const Instruction& instruction : init.code) {
+            if (instruction.op == OpCode::Return || instruction.op == OpCode::ReturnNone) {
+                return true;
+            }
+            const OperandRoles roles = GetOperandRoles(instruction.op);
+            if (roles.a == Operand::Target || roles.b == Operand::Target
+                || roles.c == Operand::CallSite) {
+                return false;
+            }
+            if (instruction.op == OpCode::GetSelfField
+                && assigned.count(init.names[instruction.c]) == 0) {
+                return false;
+            }
+            if (instruction.op == OpCode::SetSelfField) {
+                assigned.insert(init.names[instruction.c]);
+            }
+        }
+        return true;
+    }
+
+    // Тип выражения в текущей точке метода. Метод не содержит циклов, поэтому типы
+    // переменных уточняются по ходу компиляции: присваивание задаёт тип переменной,
+    // а в точке слияния ветвей if типы объединяются (см. MergeStates)
+    Type TypeOf(const Statement& expression) const {
+        if (dynamic_cast<const ast::NumericConst*>(&expression)) {
+            return Type::Int;
+        }
+        if (dynamic_cast<const ast::StringConst*>(&expression)
+            || dynamic_cast<const ast::Stringify*>(&expression)) {
+            return Type::Str;
+        }
+        if (dynamic_cast<const ast::BoolConst*>(&expression)
+            || dynamic_cast<const ast::Comparison*>(&expression)
+            || dynamic_cast<const ast::Not*>(&expression)) {
+            return Type::Bool;
+        }
+        if (dynamic_cast<const ast::VariableValue*>(&expression)) {
+            const optional<uint16_t> reg = FindLocal(expression);
+            return reg ? state_.locals[*reg].type : Type::Unknown;
+        }
+        const auto* operation = dynamic_cast<const ast::BinaryOperation*>(&expression);
+        if (operation == nullptr) {
+            return Type::Unknown;
+        }
+        const Type lhs = TypeOf(*operation->GetLhs());
+        const Type rhs = TypeOf(*operation->GetRhs());
+        if (dynamic_cast<const ast::And*>(&expression) || dynamic_cast<const ast::Or*>(&expression)) {
+            return Join(lhs, rhs);
+        }
+        if (lhs == Type::Bottom || rhs == Type::Bottom) {
+            return Type::Bottom;
+        }
+        // Вычитание, умножение и деление принимают только числа
+        if (dynamic_cast<const ast::Sub*>(&expression) || dynamic_cast<const ast::Mult*>(&expression)
+            || dynamic_cast<const ast::Div*>(&expression)) {
+            return Type::Int;
+        }
+        if (lhs == Type::Int && rhs == Type::Int) {
+            return Type::Int;
+        }
+        if (lhs == Type::Str && rhs == Type::Str && dynamic_cast<const ast::Add*>(&expression)) {
+            return Type::Str;
+        }
+        return Type::Unknown;
+    }
+
+    // Возвращает true, если вычисление выражения может выполнить код программы:
+    // метод, нативную функцию, __init__, __add__, __str__ либо методы сравнения
+    bool MayCallOut(const Statement& expression) const {
+        if (dynamic_cast<const ast::MethodCall*>(&expression)
+            || dynamic_cast<const ast::NativeCall*>(&expression)
+            || dynamic_cast<const ast::NewInstance*>(&expression)) {
+            return true;
+        }
+        if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&expression)) {
+            return !IsPrimitive(TypeOf(*stringify->GetArg())) || MayCallOut(*stringify->GetArg());
+        }
+        if (const auto* negation = dynamic_cast<const ast::Not*>(&expression)) {
+            return MayCallOut(*negation->GetArg());
+        }
+        const auto* operation = dynamic_cast<const ast::BinaryOperation*>(&expression);
+        if (operation == nullptr) {
+            return false;
+        }
+        if (MayCallOut(*operation->GetLhs()) || MayCallOut(*operation->GetRhs())) {
+            return true;
+        }
+        if (dynamic_cast<const ast::Add*>(&expression)
+            || dynamic_cast<const ast::Comparison*>(&expression)) {
+            return !IsPrimitive(TypeOf(*operation->GetLhs()));
+        }
+        return false;
+    }
+
+    static bool IsPrimitive(Type type) {
+        return type == Type::Int || type == Type::Str || type == Type::Bool;
+    }
+
+    // Возвращает имя локальной переменной, значение которой - значение variable: самой
+    // переменной либо поля экземпляра, заменённого регистрами полей
+    optional<string> FindLocalName(const ast::VariableValue& variable) const {
+        const auto& ids = variable.GetDottedIds();
+        if (ids.size() == 1) {
+            return ids.front();
+        }
+        if (ids.size() == 2 && scalar_instances_.count(ids.front()) > 0) {
+            return ids.front() + '.' + ids[1];
+        }
+        return nullopt;
+    }
+
+    // Возвращает регистр переменной метода, если выражение - чтение этой переменной
+    optional<uint16_t> FindLocal(const Statement& expression) const {
+        const auto* variable = dynamic_cast<const ast::VariableValue*>(&expression);
+        if (variable == nullptr) {
+            return nullopt;
+        }
+        const optional<string> name = FindLocalName(*variable);
+        if (!name) {
+            return nullopt;
+        }
+        const auto it = variables_.find(*name);
+        if (it == variables_.end()) {
+            return nullopt;
+        }
+        return it->second;
+    }
+
+    // Возвращает арифметическую операцию над числами, если выражение - такая операция
+    const ast::BinaryOperation* FindIntArithmetic(const Statement& expression) const {
+        const auto* operation = dynamic_cast<const ast::BinaryOperation*>(&expression);
+        if (operation == nullptr
+            || !(dynamic_cast<const ast::Add*>(&expression) || dynamic_cast<const ast::Sub*>(&expression)
+                 || dynamic_cast<const ast::Mult*>(&expression)
+                 || dynamic_cast<const ast::Div*>(&expression))) {
+            return nullptr;
+        }
+        if (TypeOf(*operation->GetLhs()) != Type::Int || TypeOf(*operation->GetRhs()) != Type::Int) {
+            return nullptr;
+        }
+        return operation;
+    }
+
+    // Проверяет, что число - значение выражения - можно получить в регистре n, не
+    // распаковывая объект: выражение - операция над числами либо переменная, число
+    // которой уже находится в регистре n
+    bool IsUnboxed(const Statement& expression) const {
+        if (FindIntArithmetic(expression) != nullptr) {
+            return true;
+        }
+        const optional<uint16_t> reg = FindLocal(expression);
+        return reg && state_.locals[*reg].type == Type::Int && state_.locals[*reg].unboxed;
+    }
+
+    // Операция над числами выполняется без упаковки, если хотя бы один операнд уже
+    // получен без упаковки. Иначе одна инструкция над объектами дешевле распаковки
+    // операндов и упаковки результата
+    bool ShouldUnbox(const ast::BinaryOperation& operation) const {
+        if (TypeOf(*operation.GetLhs()) != Type::Int || TypeOf(*operation.GetRhs()) != Type::Int) {
+            return false;
+        }
+        return IsUnboxed(*operation.GetLhs()) || IsUnboxed(*operation.GetRhs());
+    }
+
+    // После успешного вычитания, умножения либо деления операнды-переменные - числа
+    void RefineToInt(const Statement& operand) {
+        if (const optional<uint16_t> reg = FindLocal(operand)) {
+            Local& local = state_.locals[*reg];
+            if (local.assigned) {
+                local.type = Type::Int;
+            }
+        }
+    }
+
+    // Запись инструкций
+
+    // Учитывает узел дерева, вычисление которого начнёт следующая инструкция
+    void AddNode() {
+        ++pending_nodes_;
+    }
+
+    size_t Emit(OpCode op, size_t a = 0, size_t b = 0, size_t c = 0) {
+        while (pending_nodes_ > numeric_limits<uint8_t>::max()) {
+            Instruction nop;
+            nop.nodes = numeric_limits<uint8_t>::max();
+            function_.code.push_back(nop);
+            pending_nodes_ -= nop.nodes;
+        }
+        Instruction instruction;
+        instruction.op = op;
+        instruction.nodes = static_cast<uint8_t>(pending_nodes_);
+        instruction.a = static_cast<uint16_t>(a);
+        instruction.b = static_cast<uint16_t>(b);
+        instruction.c = static_cast<uint16_t>(c);
+        pending_nodes_ = 0;
+        function_.code.push_back(instruction);
+        return function_.code.size() - 1;
+    }
+
+    // Записывает в переход jump адрес следующей инструкции
+    void PatchJump(size_t jump) {
+        Instruction& instruction = function_.code[jump];
+        const auto target = static_cast<uint16_t>(function_.code.size());
+        if (instruction.op == OpCode::Jump) {
+            instruction.a = target;
+        } else {
+            instruction.b = target;
+        }
+    }
+
+    uint16_t NewRegister() {
+        if (next_register_ >= MAX_OPERAND) {
+            throw UnsupportedMethod("Too many registers"s);
+        }
+        max_register_ = max(max_register_, next_register_ + 1);
+        return static_cast<uint16_t>(next_register_++);
+    }
+
+    size_t AddConstant(ObjectHolder value) {
+        function_.constants.push_back(std::move(value));
+        return CheckIndex(function_.constants.size() - 1);
+    }
+
+    size_t AddName(const string& name) {
+        const auto it = find(function_.names.begin(), function_.names.end(), name);
+        if (it != function_.names.end()) {
+            return it - function_.names.begin();
+        }
+        function_.names.push_back(name);
+        return CheckIndex(function_.names.size() - 1);
+    }
+
+    size_t AddCallSite(CallSite site) {
+        function_.call_sites.push_back(std::move(site));
+        return CheckIndex(function_.call_sites.size() - 1);
+    }
+
+    static size_t CheckIndex(size_t index) {
+        if (index >= MAX_OPERAND) {
+            throw UnsupportedMethod("Method is too large"s);
+        }
+        return index;
+    }
+
+    // Инструкции Mython
+
+    void CompileStatement(const Statement& statement) {
+        const size_t temps = next_register_;
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            AddNode();
+            for (const auto& child : compound->GetStatements()) {
+                CompileStatement(*child);
+            }
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            AddNode();
+            const string& name = assignment->GetVar();
+            if (scalar_instances_.count(name) > 0) {
+                CompileScalarInstance(static_cast<const ast::NewInstance&>(*assignment->GetValue()),
+                                      name);
+            } else {
+                CompileAssignment(variables_.at(name), *assignment->GetValue());
+            }
+        } else if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&statement)) {
+            CompileFieldAssignment(*field);
+        } else if (const auto* print = dynamic_cast<const ast::Print*>(&statement)) {
+            AddNode();
+            const auto& args = print->GetArgs();
+            for (size_t i = 0; i < args.size(); ++i) {
+                const uint16_t value = CompileExpression(*args[i]);
+                Emit(OpCode::Print, value, i > 0 ? 1 : 0);
+                next_register_ = temps;
+            }
+            Emit(OpCode::PrintNewline);
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            CompileIfElse(*if_else);
+        } else if (const auto* ret = dynamic_cast<const ast::Return*>(&statement)) {
+            AddNode();
+            if (dynamic_cast<const ast::None*>(ret->GetStatement().get())) {
+                AddNode();
+                Emit(OpCode::ReturnNone);
+            } else {
+                Emit(OpCode::Return, CompileExpression(*ret->GetStatement()));
+            }
+            // Код после return не выполняется, и любая переменная в нём считается присвоенной
+            state_.reachable = false;
+        } else {
+            // Значение выражения-инструкции не используется, но вычисляется ради его действий
+            // и исключений
+            CompileExpression(statement);
+        }
+        next_register_ = temps;
+    }
+
+    void CompileAssignment(uint16_t reg, const Statement& value) {
+        // Результат операции над числами остаётся в регистре n и упаковывается,
+        // только когда значение переменной покидает вычисления
+        if (IsUnboxed(value)) {
+            CompileInt(value, reg);
+            state_.locals[reg] = Local{true, Type::Int, false, true};
+        } else {
+            const Type type = TypeOf(value);
+            CompileExpression(value, reg);
+            state_.locals[reg] = Local{true, type, true, false};
+        }
+    }
+
+    void CompileFieldAssignment(const ast::FieldAssignment& field) {
+        AddNode();
+        const auto& ids = field.GetObject().GetDottedIds();
+        if (ids.size() == 1 && scalar_instances_.count(ids.front()) > 0) {
+            AddNode();
+            if (state_.reachable && !state_.locals[variables_.at(ids.front())].assigned) {
+                throw EscapingInstance{ids.front()};
+            }
+            CompileAssignment(variables_.at(ids.front() + '.' + field.GetFieldName()),
+                              *field.GetValue());
+            return;
+        }
+        const size_t name = AddName(field.GetFieldName());
+        if (IsSelf(field.GetObject())) {
+            AddNode();
+            Emit(OpCode::SetSelfField, 0, CompileExpression(*field.GetValue()), name);
+            return;
+        }
+        const uint16_t object = CompileExpression(field.GetObject());
+        // Обход дерева проверяет объект до вычисления значения
+        if (MayCallOut(*field.GetValue())) {
+            Emit(OpCode::CheckFieldOwner, object);
+        }
+        Emit(OpCode::SetField, object, CompileExpression(*field.GetValue()), name);
+    }
+
+    /*
+     * Если переменная хранится в конце ветвей по-разному, в конец ветви добавляются
+     * инструкции, согласующие хранение (см. MergeStates). Для ветви if они записываются
+     * после ветви else, когда известно её состояние:
+     *
+     *     jump_if_false cond, else
+     *     <ветвь if>
+     *     jump if_fixups
+     * else:
+     *     <ветвь else>
+     *     <согласование ветви else>
+     *     jump end
+     * if_fixups:
+     *     <согласование ветви if>
+     * end:
+     */
+    void CompileIfElse(const ast::IfElse& if_else) {
+        AddNode();
+        const size_t temps = next_register_;
+        const size_t to_else = Emit(OpCode::JumpIfFalse, CompileExpression(*if_else.GetCondition()));
+        next_register_ = temps;
+        const FlowState before = state_;
+        CompileStatement(*if_else.GetIfBody());
+        Fixups if_fixups;
+        Fixups else_fixups;
+        if (!if_else.GetElseBody()) {
+            state_ = MergeStates(state_, before, if_fixups, else_fixups);
+            EmitFixups(if_fixups);
+            if (else_fixups.empty()) {
+                PatchJump(to_else);
+                return;
+            }
+            const size_t to_end = Emit(OpCode::Jump);
+            PatchJump(to_else);
+            EmitFixups(else_fixups);
+            PatchJump(to_end);
+            return;
+        }
+        const size_t to_if_end = Emit(OpCode::Jump);
+        PatchJump(to_else);
+        FlowState after_if = std::move(state_);
+        state_ = before;
+        CompileStatement(*if_else.GetElseBody());
+        state_ = MergeStates(after_if, state_, if_fixups, else_fixups);
+        EmitFixups(else_fixups);
+        if (if_fixups.empty()) {
+            PatchJump(to_if_end);
+            return;
+        }
+        const size_t to_end = Emit(OpCode::Jump);
+        PatchJump(to_if_end);
+        EmitFixups(if_fixups);
+        PatchJump(to_end);
+    }
+
+    // Возвращает состояние переменных в точке слияния путей first и second. Если путь
+    // хранит переменную иначе, чем другой, в его fixups добавляется инструкция, после
+    // которой переменная хранится одинаково: число переносится в регистр n без создания
+    // объекта, значение другого типа упаковывается
+    static FlowState MergeStates(const FlowState& first, const FlowState& second,
+                                 Fixups& first_fixups, Fixups& second_fixups) {
+        if (!first.reachable) {
+            return second;
+        }
+        if (!second.reachable) {
+            return first;
+        }
+        FlowState result = first;
+        for (size_t reg = 0; reg < result.locals.size(); ++reg) {
+            const Local& lhs = first.locals[reg];
+            const Local& rhs = second.locals[reg];
+            Local& merged = result.locals[reg];
+            merged.assigned = lhs.assigned && rhs.assigned;
+            merged.type = Join(lhs.type, rhs.type);
+            merged.boxed = lhs.boxed && rhs.boxed;
+            merged.unboxed = lhs.unboxed && rhs.unboxed;
+            if (!merged.assigned || merged.boxed || merged.unboxed) {
+                continue;
+            }
+            const auto index = static_cast<uint16_t>(reg);
+            if (merged.type == Type::Int) {
+                merged.unboxed = true;
+                (lhs.unboxed ? second_fixups : first_fixups).emplace_back(OpCode::Unbox, index);
+            } else {
+                merged.boxed = true;
+                (lhs.boxed ? second_fixups : first_fixups).emplace_back(OpCode::Box, index);
+            }
+        }
+        return result;
+    }
+
+    void EmitFixups(const Fixups& fixups) {
+        for (const auto& [op, reg] : fixups) {
+            Emit(op, reg, reg);
+        }
+    }
+
+    // Выражения
+
+    // Проверяет, что переменная - сам self, а не цепочка полей self
+    static bool IsSelf(const ast::VariableValue& variable) {
+        return variable.GetDottedIds().size() == 1 && variable.GetDottedIds().front() == SELF;
+    }
+
+    // Возвращает регистр назначения: dst либо новый временный регистр
+    uint16_t Target(optional<uint16_t> dst) {
+        return dst ? *dst : NewRegister();
+    }
+
+    // Вычисляет выражение и возвращает регистр-объект с его значением. Если задан dst,
+    // значение записывается в dst последней инструкцией, так что выражение может читать dst
+    uint16_t CompileExpression(const Statement& expression, optional<uint16_t> dst = nullopt) {
+        AddNode();
+        return CompileValue(expression, dst);
+    }
+
+    // Вычисляет выражение типа Int и возвращает регистр-число с его значением.
+    // Как и в CompileExpression, значение записывается в dst последней инструкцией
+    uint16_t CompileInt(const Statement& expression, optional<uint16_t> dst = nullopt) {
+        AddNode();
+        return CompileIntValue(expression, dst);
+    }
+
+    uint16_t CompileValue(const Statement& expression, optional<uint16_t> dst) {
+        const size_t temps = next_register_;
+        const auto done = [&](OpCode op, size_t b = 0, size_t c = 0) {
+            next_register_ = temps;
+            const uint16_t target = Target(dst);
+            Emit(op, target, b, c);
+            return target;
+        };
+
+        if (const auto* number = dynamic_cast<const ast::NumericConst*>(&expression)) {
+            return done(OpCode::LoadConst, AddConstant(ObjectHolder::Own(runtime::Number(number->GetValue()))));
+        }
+        if (const auto* str = dynamic_cast<const ast::StringConst*>(&expression)) {
+            return done(OpCode::LoadConst, AddConstant(ObjectHolder::Own(runtime::String(str->GetValue()))));
+        }
+        if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&expression)) {
+            return done(OpCode::LoadConst, AddConstant(ObjectHolder::Own(runtime::Bool(boolean->GetValue()))));
+        }
+        if (dynamic_cast<const ast::None*>(&expression)) {
+            return done(OpCode::LoadNone);
+        }
+        if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&expression)) {
+            return CompileVariable(*variable, dst);
+        }
+        if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&expression)) {
+            return done(OpCode::Stringify, CompileExpression(*stringify->GetArg()));
+        }
+        if (const auto* negation = dynamic_cast<const ast::Not*>(&expression)) {
+            return done(OpCode::Not, CompileExpression(*negation->GetArg()));
+        }
+        if (const auto* call = dynamic_cast<const ast::MethodCall*>(&expression)) {
+            CallSite site;
+            site.name = static_cast<uint16_t>(AddName(call->GetMethod()));
+            site.args = CompileArgs(call->GetArgs());
+            const auto* object = dynamic_cast<const ast::VariableValue*>(call->GetObject().get());
+            if (object != nullptr && IsSelf(*object)) {
+                AddNode();
+                const size_t index = AddCallSite(std::move(site));
+                if (const auto it = plan_.find(index); it != plan_.end()) {
+                    return CompileInlinedCall(index, it->second, nullopt, dst, temps);
+                }
+                return done(OpCode::CallSelf, 0, index);
+            }
+            const uint16_t receiver = CompileExpression(*call->GetObject());
+            const size_t index = AddCallSite(std::move(site));
+            if (const auto it = plan_.find(index); it != plan_.end()) {
+                return CompileInlinedCall(index, it->second, receiver, dst, temps);
+            }
+            return done(OpCode::Call, receiver, index);
+        }
+        if (const auto* native = dynamic_cast<const ast::NativeCall*>(&expression)) {
+            return CompileNativeCall(*native, done);
+        }
+        if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&expression)) {
+            CallSite site;
+            site.cls = &instance->GetClass();
+            const runtime::Method* init = site.cls->GetMethod(INIT_METHOD);
+            // Без подходящего __init__ параметры конструктора не вычисляются
+            site.has_init = init != nullptr
+                            && init->formal_params.size() == instance->GetArgs().size();
+            if (site.has_init) {
+                site.args = CompileArgs(instance->GetArgs());
+            }
+            return done(OpCode::NewInstance, 0, AddCallSite(std::move(site)));
+        }
+        if (dynamic_cast<const ast::And*>(&expression) || dynamic_cast<const ast::Or*>(&expression)) {
+            return CompileLogical(static_cast<const ast::BinaryOperation&>(expression), dst);
+        }
+        if (const auto* operation = dynamic_cast<const ast::BinaryOperation*>(&expression)) {
+            if (!operation->GetLhs() || !operation->GetRhs()) {
+                throw UnsupportedMethod("Null operands"s);
+            }
+            const OpCode op = SelectOperation(*operation);
+            if (ShouldUnbox(*operation)) {
+                if (const auto* comparison = dynamic_cast<const ast::Comparison*>(operation)) {
+                    const uint16_t lhs = CompileInt(*operation->GetLhs());
+                    const uint16_t rhs = CompileInt(*operation->GetRhs());
+                    return done(FindCompareOps(*comparison)->unboxed, lhs, rhs);
+                }
+                return done(OpCode::Box, CompileIntValue(expression, nullopt));
+            }
+            const uint16_t lhs = CompileExpression(*operation->GetLhs());
+            const uint16_t rhs = CompileExpression(*operation->GetRhs());
+            const uint16_t target = done(op, lhs, rhs);
+            if (op == OpCode::Sub || op == OpCode::Mult || op == OpCode::Div) {
+                RefineToInt(*operation->GetLhs());
+                RefineToInt(*operation->GetRhs());
+            }
+            return target;
+        }
+        throw UnsupportedMethod("Unsupported statement in "s + function_.name);
+    }
+
+    uint16_t CompileIntValue(const Statement& expression, optional<uint16_t> dst) {
+        const size_t temps = next_register_;
+        if (const auto* operation = FindIntArithmetic(expression)) {
+            const uint16_t lhs = CompileInt(*operation->GetLhs());
+            const uint16_t rhs = CompileInt(*operation->GetRhs());
+            next_register_ = temps;
+            const uint16_t target = Target(dst);
+            Emit(SelectUnboxedOperation(*operation), target, lhs, rhs);
+            return target;
+        }
+        if (const auto* number = dynamic_cast<const ast::NumericConst*>(&expression)) {
+            const auto value = static_cast<uint32_t>(number->GetValue().GetValue());
+            const uint16_t target = Target(dst);
+            Emit(OpCode::LoadInt, target, value & 0xFFFF, value >> 16);
+            return target;
+        }
+        if (FindLocal(expression)) {
+            const auto& variable = static_cast<const ast::VariableValue&>(expression);
+            const uint16_t reg = Unboxed(ReadVariable(*FindLocalName(variable)));
+            if (dst && *dst != reg) {
+                Emit(OpCode::MoveInt, *dst, reg);
+                return *dst;
+            }
+            return reg;
+        }
+        // Остальные выражения типа Int, например разность значений, тип которых проверяется
+        // при выполнении, вычисляются в объект и распаковываются
+        const uint16_t value = CompileValue(expression, nullopt);
+        next_register_ = temps;
+        const uint16_t target = Target(dst);
+        Emit(OpCode::Unbox, target, value);
+        return target;
+    }
+
+    // Записывает в регистр-объект переменной её значение, если оно есть только в регистре-числе
+    uint16_t Boxed(uint16_t reg) {
+        Local& local = state_.locals[reg];
+        if (!local.boxed) {
+            Emit(OpCode::Box, reg, reg);
+            local.boxed = true;
+        }
+        return reg;
+    }
+
+    // Записывает в регистр-число переменной типа Int её значение, если оно есть только
+    // в регистре-объекте
+    uint16_t Unboxed(uint16_t reg) {
+        Local& local = state_.locals[reg];
+        if (!local.unboxed) {
+            Emit(OpCode::Unbox, reg, reg);
+            local.unboxed = true;
+        }
+        return reg;
+    }
+
+    /*
+     * Встраивает метод target в место вызова site_index. receiver - регистр получателя,
+     * nullopt для вызова метода self. Встроенный код выполняется, если класс получателя
+     * совпадает с target.cls, иначе проверка переходит к обычному вызову:
+     *
+     *     guard_class receiver, slow
+     *     <тело метода, return заменены записью результата и переходом на end>
+     * slow:
+     *     call result, receiver
+     * end:
+     */
+    uint16_t CompileInlinedCall(size_t site_index, const InlineTarget& target,
+                                optional<uint16_t> receiver, optional<uint16_t> dst,
+                                size_t temps) {
+        const Function& callee = *target.function;
+        function_.call_sites[site_index].cls = target.cls;
+        const vector<uint16_t> args = function_.call_sites[site_index].args;
+        const size_t guard = receiver ? Emit(OpCode::GuardClass, *receiver, 0, site_index)
+                                      : Emit(OpCode::GuardSelfClass, 0, 0, site_index);
+
+        // Регистры вызываемого метода: self - получатель, параметры - регистры аргументов,
+        // если метод их не меняет, остальные - новые временные регистры
+        vector<uint16_t> registers(callee.register_count);
+        registers[0] = receiver.value_or(0);
+        if (!receiver && callee.uses_self_value) {
+            function_.uses_self_value = true;
+        }
+        for (size_t i = 1; i < callee.register_count; ++i) {
+            const bool is_param = i <= callee.param_count;
+            if (is_param && !WritesRegister(callee, i)) {
+                registers[i] = args[i - 1];
+                continue;
+            }
+            registers[i] = NewRegister();
+            if (is_param) {
+                Emit(OpCode::Move, registers[i], args[i - 1]);
+            }
+        }
+        // Результат записывается последним, поэтому он может занимать регистр получателя
+        // либо аргумента
+        const auto result = static_cast<uint16_t>(dst ? *dst : temps);
+
+        vector<bool> targets(callee.code.size(), false);
+        for (const Instruction& instruction : callee.code) {
+            const OperandRoles roles = GetOperandRoles(instruction.op);
+            if (roles.a == Operand::Target) {
+                targets[instruction.a] = true;
+            }
+            if (roles.b == Operand::Target) {
+                targets[instruction.b] = true;
+            }
+        }
+
+        vector<size_t> positions(callee.code.size());
+        vector<size_t> exits;
+        for (size_t i = 0; i < callee.code.size(); ++i) {
+            positions[i] = function_.code.size();
+            Instruction instruction = callee.code[i];
+            pending_nodes_ += instruction.nodes;
+            // Завершающий return None после return недостижим
+            if (i > 0 && !targets[i] && IsExit(callee.code[i - 1].op)) {
+                continue;
+            }
+            if (instruction.op == OpCode::Return) {
+                if (registers[instruction.a] != result) {
+                    Emit(OpCode::Move, result, registers[instruction.a]);
+                }
+                exits.push_back(Emit(OpCode::Jump));
+                continue;
+            }
+            if (instruction.op == OpCode::ReturnNone) {
+                Emit(OpCode::LoadNone, result);
+                exits.push_back(Emit(OpCode::Jump));
+                continue;
+            }
+            // Поля self вызываемого метода - поля получателя, который находится в регистре 0
+            if (receiver && instruction.op == OpCode::GetSelfField) {
+                instruction = {OpCode::GetField, 0, instruction.a, 0, instruction.c};
+            } else if (receiver && instruction.op == OpCode::SetSelfField) {
+                instruction = {OpCode::SetField, 0, 0, instruction.b, instruction.c};
+            }
+            const OperandRoles roles = GetOperandRoles(instruction.op);
+            instruction.a = Relocate(roles.a, instruction.a, callee, registers);
+            instruction.b = Relocate(roles.b, instruction.b, callee, registers);
+            instruction.c = Relocate(roles.c, instruction.c, callee, registers);
+            Emit(instruction.op, instruction.a, instruction.b, instruction.c);
+        }
+        // Адреса переходов внутри метода
+        for (size_t i = 0; i < callee.code.size(); ++i) {
+            const OperandRoles roles = GetOperandRoles(callee.code[i].op);
+            Instruction& instruction = function_.code[positions[i]];
+            if (roles.a == Operand::Target) {
+                instruction.a = static_cast<uint16_t>(positions[callee.code[i].a]);
+            }
+            if (roles.b == Operand::Target) {
+                instruction.b = static_cast<uint16_t>(positions[callee.code[i].b]);
+            }
+        }
+
+        function_.code[guard].b = static_cast<uint16_t>(function_.code.size());
+        if (receiver) {
+            Emit(OpCode::Call, result, *receiver, site_index);
+        } else {
+            Emit(OpCode::CallSelf, result, 0, site_index);
+        }
+        for (const size_t exit : exits) {
+            PatchJump(exit);
+        }
+        ++function_.inlined_calls;
+        next_register_ = temps;
+        return Target(dst);
+    }
+
+    /*
+     * Создаёт экземпляр, заменённый регистрами полей (см. DeclareInstanceFields), и
+     * присваивает его переменной name. Код __init__ переносится в метод так же, как код
+     * встраиваемого метода, но без проверки класса: класс создаваемого экземпляра известен.
+     * Запись и чтение полей self заменяются пересылками между регистрами полей и регистрами
+     * __init__
+     */
+    void CompileScalarInstance(const ast::NewInstance& instance, const string& name) {
+        AddNode();
+        const Function* init = FindInit(instance);
+        vector<Type> types;
+        vector<uint16_t> args;
+        if (init != nullptr) {
+            for (const auto& arg : instance.GetArgs()) {
+                types.push_back(TypeOf(*arg));
+            }
+            args = CompileArgs(instance.GetArgs());
+        }
+        // У созданного экземпляра нет полей, пока их не присвоит __init__
+        for (const auto& [local, owner] : field_owners_) {
+            if (owner == name) {
+                state_.locals[variables_.at(local)] = Local{};
+            }
+        }
+        state_.locals[variables_.at(name)] = Local{true, Type::Unknown, true, false};
+        ++function_.replaced_instances;
+        if (init == nullptr) {
+            return;
+        }
+
+        vector<uint16_t> registers(init->register_count);
+        for (size_t i = 1; i < init->register_count; ++i) {
+            const bool is_param = i <= init->param_count;
+            if (is_param && !WritesRegister(*init, i)) {
+                registers[i] = args[i - 1];
+                continue;
+            }
+            registers[i] = NewRegister();
+            if (is_param) {
+                Emit(OpCode::Move, registers[i], args[i - 1]);
+            }
+        }
+        for (Instruction instruction : init->code) {
+            pending_nodes_ += instruction.nodes;
+            // Код __init__ не содержит переходов, и его выполнение заканчивает первый return
+            if (instruction.op == OpCode::Return || instruction.op == OpCode::ReturnNone) {
+                break;
+            }
+            if (instruction.op == OpCode::SetSelfField) {
+                const uint16_t field = variables_.at(name + '.' + init->names[instruction.c]);
+                Emit(OpCode::Move, field, registers[instruction.b]);
+                // Поле, которому присвоен неизменённый параметр, получает тип аргумента
+                const bool is_arg = instruction.b >= 1 && instruction.b <= init->param_count
+                                    && registers[instruction.b] == args[instruction.b - 1];
+                state_.locals[field] =
+                    Local{true, is_arg ? types[instruction.b - 1] : Type::Unknown, true, false};
+                continue;
+            }
+            if (instruction.op == OpCode::GetSelfField) {
+                const uint16_t field = variables_.at(name + '.' + init->names[instruction.c]);
+                Emit(OpCode::Move, registers[instruction.a], field);
+                continue;
+            }
+            const OperandRoles roles = GetOperandRoles(instruction.op);
+            instruction.a = Relocate(roles.a, instruction.a, *init, registers);
+            instruction.b = Relocate(roles.b, instruction.b, *init, registers);
+            instruction.c = Relocate(roles.c, instruction.c, *init, registers);
+            Emit(instruction.op, instruction.a, instruction.b, instruction.c);
+        }
+    }
+
+    // Переносит операнд инструкции встраиваемого метода в код вызывающего метода.
+    // Адреса переходов переносятся после записи всех инструкций
+    uint16_t Relocate(Operand role, uint16_t operand, const Function& callee,
+                      const vector<uint16_t>& registers) {
+        switch (role) {
+            case Operand::Input:
+            case Operand::Output:
+                return registers[operand];
+            case Operand::Constant:
+                return static_cast<uint16_t>(AddConstant(callee.constants[operand]));
+            case Operand::Name:
+                return static_cast<uint16_t>(AddName(callee.names[operand]));
+            default:
+                return operand;
+        }
+    }
+
+    static bool IsExit(OpCode op) {
+        return op == OpCode::Return || op == OpCode::ReturnNone || op == OpCode::Jump;
+    }
+
+    static bool WritesRegister(const Function& function, size_t reg) {
+        return any_of(function.code.begin(), function.code.end(), [reg](const Instruction& in) {
+            return GetOperandRoles(in.op).a == Operand::Output && in.a == reg;
+        });
+    }
+
+    static OpCode SelectUnboxedOperation(const ast::BinaryOperation& operation) {
+        if (dynamic_cast<const ast::Add*>(&operation)) {
+            return OpCode::AddUnboxed;
+        }
+        if (dynamic_cast<const ast::Sub*>(&operation)) {
+            return OpCode::SubUnboxed;
+        }
+        if (dynamic_cast<const ast::Mult*>(&operation)) {
+            return OpCode::MultUnboxed;
+        }
+        return OpCode::DivUnboxed;
+    }
+
+    OpCode SelectOperation(const ast::BinaryOperation& operation) const {
+        const Type lhs = TypeOf(*operation.GetLhs());
+        const Type rhs = TypeOf(*operation.GetRhs());
+        const bool ints = lhs == Type::Int && rhs == Type::Int;
+        const bool strings = lhs == Type::Str && rhs == Type::Str;
+        if (dynamic_cast<const ast::Add*>(&operation)) {
+            return ints ? OpCode::AddInt : strings ? OpCode::AddStr : OpCode::Add;
+        }
+        if (dynamic_cast<const ast::Sub*>(&operation)) {
+            return ints ? OpCode::SubInt : OpCode::Sub;
+        }
+        if (dynamic_cast<const ast::Mult*>(&operation)) {
+            return ints ? OpCode::MultInt : OpCode::Mult;
+        }
+        if (dynamic_cast<const ast::Div*>(&operation)) {
+            return ints ? OpCode::DivInt : OpCode::Div;
+        }
+        if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&operation)) {
+            const CompareOps* ops = FindCompareOps(*comparison);
+            if (ops == nullptr) {
+                throw UnsupportedMethod("Unknown comparison"s);
+            }
+            return ints ? ops->ints : strings ? ops->strings : ops->generic;
+        }
+        throw UnsupportedMethod("Unsupported operation in "s + function_.name);
+    }
+
+    uint16_t CompileVariable(const ast::VariableValue& variable, optional<uint16_t> dst) {
+        const auto& ids = variable.GetDottedIds();
+        const size_t temps = next_register_;
+        size_t first_field = 1;
+        uint16_t object = 0;
+        if (ids.front() == SELF) {
+            if (ids.size() == 1) {
+                function_.uses_self_value = true;
+            } else {
+                // self.x читается из полей экземпляра без обращения к регистру self
+                next_register_ = temps;
+                object = ids.size() == 2 ? Target(dst) : NewRegister();
+                Emit(OpCode::GetSelfField, object, 0, AddName(ids[1]));
+                first_field = 2;
+            }
+        } else if (scalar_instances_.count(ids.front()) > 0) {
+            // Чтение поля экземпляра, заменённого регистрами полей
+            object = Boxed(ReadVariable(ids.front() + '.' + ids[1]));
+            first_field = 2;
+        } else {
+            object = Boxed(ReadVariable(ids.front()));
+        }
+        if (first_field >= ids.size()) {
+            if (dst && *dst != object) {
+                Emit(OpCode::Move, *dst, object);
+                return *dst;
+            }
+            return object;
+        }
+        for (size_t i = first_field; i < ids.size(); ++i) {
+            const bool last = i + 1 == ids.size();
+            next_register_ = temps;
+            const uint16_t target = last ? Target(dst) : NewRegister();
+            Emit(OpCode::GetField, target, object, AddName(ids[i]));
+            object = target;
+        }
+        return object;
+    }
+
+    uint16_t ReadVariable(const string& name) {
+        const auto it = variables_.find(name);
+        if (it == variables_.end()) {
+            throw UnsupportedMethod("Unknown name "s + name);
+        }
+        if (state_.reachable && !state_.locals[it->second].assigned) {
+            if (const auto owner = field_owners_.find(name); owner != field_owners_.end()) {
+                throw EscapingInstance{owner->second};
+            }
+            throw UnsupportedMethod("Variable "s + name + " may be read before assignment"s);
+        }
+        return it->second;
+    }
+
+    vector<uint16_t> CompileArgs(const vector<unique_ptr<Statement>>& args) {
+        vector<uint16_t> registers;
+        registers.reserve(args.size());
+        for (const auto& arg : args) {
+            registers.push_back(CompileExpression(*arg));
+        }
+        return registers;
+    }
+
+    template <typename Done>
+    uint16_t CompileNativeCall(const ast::NativeCall& native, const Done& done) {
+        const auto& args = native.GetArgs();
+        CallSite site;
+        site.function = &native.GetFunction();
+        const size_t index = function_.call_sites.size();
+        bool check_each = false;
+        for (size_t i = 1; i < args.size(); ++i) {
+            check_each = check_each || MayCallOut(*args[i]);
+        }
+        // Обход дерева проверяет каждый параметр сразу после вычисления, поэтому
+        // проверки нужны, если следующие параметры могут выполнить код программы
+        for (size_t i = 0; i < args.size(); ++i) {
+            site.args.push_back(CompileExpression(*args[i]));
+            if (check_each && site.function->param_types[i] != runtime::TypeHint::Any) {
+                Emit(OpCode::CheckNativeArg, site.args.back(), i, index);
+            }
+        }
+        AddCallSite(std::move(site));
+        return done(OpCode::CallNative, 0, index);
+    }
+
+    // and и or возвращают значение одного из операндов. Как и при обходе дерева,
+    // выбранный левый операнд вычисляется повторно
+    uint16_t CompileLogical(const ast::BinaryOperation& operation, optional<uint16_t> dst) {
+        const bool is_and = dynamic_cast<const ast::And*>(&operation) != nullptr;
+        const size_t temps = next_register_;
+        const uint16_t lhs = CompileExpression(*operation.GetLhs());
+        const size_t to_rhs = Emit(OpCode::JumpIfLogical, lhs, 0, is_and ? 1 : 0);
+        // Упаковка и уточнение типов переменных в операндах, вычисляемых не на каждом
+        // пути, не действуют после выражения
+        const FlowState after_lhs = state_;
+        next_register_ = temps;
+        const uint16_t target = Target(dst);
+        CompileExpression(*operation.GetLhs(), target);
+        const size_t to_end = Emit(OpCode::Jump);
+        PatchJump(to_rhs);
+        CompileExpression(*operation.GetRhs(), target);
+        PatchJump(to_end);
+        state_ = after_lhs;
+        return target;
+    }
+
+    const runtime::Method& method_;
+    const InlinePlan& plan_;
+    const bool scalar_replacement_;
+    // Переменные, экземпляры в которых создаются как обычно после неудачной замены
+    const unordered_set<string>& escaping_;
+    Function function_;
+    // Регистры переменных метода
+    unordered_map<string, uint16_t> variables_;
+    size_t next_register_ = 0;
+    size_t first_temp_ = 0;
+    size_t max_register_ = 0;
+    size_t pending_nodes_ = 0;
+    // Сведения о переменных в точке метода, для которой записывается код
+    FlowState state_;
+    // Переменные, экземпляры в которых заменены регистрами полей, и владельцы регистров
+    // полей по их именам
+    unordered_set<string> scalar_instances_;
+    unordered_map<string, string> field_owners_;
+    // Код __init__, переносимый в метод, либо nullptr, если его нельзя перенести
+    unordered_map<const runtime::Method*, unique_ptr<Function>> inits_;
+};
+
+struct Superinstruction {
+    OpCode first;
+    OpCode second;
+    OpCode fused;
+};
+
+// Пары выбраны по профилю bench/opcode_profile на программах bench/corpus и перечислены
+// в порядке выбора: инструкция входит не больше чем в одну суперинструкцию. Сравнение с
+// переходом выбирается первым, так как избавляет ещё и от создания объекта Bool
+const Superinstruction SUPERINSTRUCTIONS[] = {
+    {OpCode::Equal, OpCode::JumpIfFalse, OpCode::EqualJumpIfFalse},
+    {OpCode::Less, OpCode::JumpIfFalse, OpCode::LessJumpIfFalse},
+    {OpCode::LessOrEqual, OpCode::JumpIfFalse, OpCode::LessOrEqualJumpIfFalse},
+    {OpCode::EqualUnboxed, OpCode::JumpIfFalse, OpCode::EqualUnboxedJumpIfFalse},
+    {OpCode::LessUnboxed, OpCode::JumpIfFalse, OpCode::LessUnboxedJumpIfFalse},
+    {OpCode::LessOrEqualUnboxed, OpCode::JumpIfFalse, OpCode::LessOrEqualUnboxedJumpIfFalse},
+    {OpCode::GetSelfField, OpCode::Call, OpCode::GetSelfFieldCall},
+    {OpCode::GetSelfField, OpCode::GetField, OpCode::GetSelfFieldGetField},
+    {OpCode::LoadConst, OpCode::Return, OpCode::LoadConstReturn},
+    {OpCode::LoadConst, OpCode::Add, OpCode::LoadConstAdd},
+    {OpCode::LoadConst, OpCode::Sub, OpCode::LoadConstSub},
+    {OpCode::CallSelf, OpCode::Return, OpCode::CallSelfReturn},
+    {OpCode::Add, OpCode::Return, OpCode::AddReturn},
+};
+
+}  // namespace
+
+string_view OpCodeName(OpCode op) {
+    switch (op) {
+        case OpCode::Nop: return "nop"sv;
+        case OpCode::LoadConst: return "load_const"sv;
+        case OpCode::LoadNone: return "load_none"sv;
+        case OpCode::Move: return "move"sv;
+        case OpCode::GetField: return "get_field"sv;
+        case OpCode::GetSelfField: return "get_self_field"sv;
+        case OpCode::SetField: return "set_field"sv;
+        case OpCode::SetSelfField: return "set_self_field"sv;
+        case OpCode::CheckFieldOwner: return "check_field_owner"sv;
+        case OpCode::Add: return "add"sv;
+        case OpCode::Sub: return "sub"sv;
+        case OpCode::Mult: return "mult"sv;
+        case OpCode::Div: return "div"sv;
+        case OpCode::AddInt: return "add_int"sv;
+        case OpCode::SubInt: return "sub_int"sv;
+        case OpCode::MultInt: return "mult_int"sv;
+        case OpCode::DivInt: return "div_int"sv;
+        case OpCode::AddStr: return "add_str"sv;
+        case OpCode::Equal: return "eq"sv;
+        case OpCode::NotEqual: return "ne"sv;
+        case OpCode::Less: return "lt"sv;
+        case OpCode::Greater: return "gt"sv;
+        case OpCode::LessOrEqual: return "le"sv;
+        case OpCode::GreaterOrEqual: return "ge"sv;
+        case OpCode::EqualInt: return "eq_int"sv;
+        case OpCode::NotEqualInt: return "ne_int"sv;
+        case OpCode::LessInt: return "lt_int"sv;
+        case OpCode::GreaterInt: return "gt_int"sv;
+        case OpCode::LessOrEqualInt: return "le_int"sv;
+        case OpCode::GreaterOrEqualInt: return "ge_int"sv;
+        case OpCode::EqualStr: return "eq_str"sv;
+        case OpCode::NotEqualStr: return "ne_str"sv;
+        case OpCode::LessStr: return "lt_str"sv;
+        case OpCode::GreaterStr: return "gt_str"sv;
+        case OpCode::LessOrEqualStr: return "le_str"sv;
+        case OpCode::GreaterOrEqualStr: return "ge_str"sv;
+        case OpCode::LoadInt: return "load_int"sv;
+        case OpCode::Box: return "box"sv;
+        case OpCode::Unbox: return "unbox"sv;
+        case OpCode::MoveInt: return "move_int"sv;
+        case OpCode::AddUnboxed: return "add_unboxed"sv;
+        case OpCode::SubUnboxed: return "sub_unboxed"sv;
+        case OpCode::MultUnboxed: return "mult_unboxed"sv;
+        case OpCode::DivUnboxed: return "div_unboxed"sv;
+        case OpCode::EqualUnboxed: return "eq_unboxed"sv;
+        case OpCode::NotEqualUnboxed: return "ne_unboxed"sv;
+        case OpCode::LessUnboxed: return "lt_unboxed"sv;
+        case OpCode::GreaterUnboxed: return "gt_unboxed"sv;
+        case OpCode::LessOrEqualUnboxed: return "le_unboxed"sv;
+        case OpCode::GreaterOrEqualUnboxed: return "ge_unboxed"sv;
+        case OpCode::Not: return "not"sv;
+        case OpCode::Stringify: return "str"sv;
+        case OpCode::Jump: return "jump"sv;
+        case OpCode::JumpIfFalse: return "jump_if_false"sv;
+        case OpCode::JumpIfLogical: return "jump_if_logical"sv;
+        case OpCode::Print: return "print"sv;
+        case OpCode::PrintNewline: return "print_newline"sv;
+        case OpCode::Call: return "call"sv;
+        case OpCode::CallSelf: return "call_self"sv;
+        case OpCode::CallNative: return "call_native"sv;
+        case OpCode::CheckNativeArg: return "check_native_arg"sv;
+        case OpCode::NewInstance: return "new"sv;
+        case OpCode::GuardClass: return "guard_class"sv;
+        case OpCode::GuardSelfClass: return "guard_self_class"sv;
+        case OpCode::Return: return "return"sv;
+        case OpCode::ReturnNone: return "return_none"sv;
+        case OpCode::EqualJumpIfFalse: return "eq_jump_if_false"sv;
+        case OpCode::LessJumpIfFalse: return "lt_jump_if_false"sv;
+        case OpCode::LessOrEqualJumpIfFalse: return "le_jump_if_false"sv;
+        case OpCode::EqualUnboxedJumpIfFalse: return "eq_unboxed_jump_if_false"sv;
+        case OpCode::LessUnboxedJumpIfFalse: return "lt_unboxed_jump_if_false"sv;
+        case OpCode::LessOrEqualUnboxedJumpIfFalse: return "le_unboxed_jump_if_false"sv;
+        case OpCode::GetSelfFieldCall: return "get_self_field_call"sv;
+        case OpCode::GetSelfFieldGetField: return "get_self_field_get_field"sv;
+        case OpCode::LoadConstReturn: return "load_const_return"sv;
+        case OpCode::LoadConstAdd: return "load_const_add"sv;
+        case OpCode::LoadConstSub: return "load_const_sub"sv;
+        case OpCode::CallSelfReturn: return "call_self_return"sv;
+        case OpCode::AddReturn: return "add_return"sv;
+    }
+    return "unknown"sv;
+}
+
+Function CompileMethod(const runtime::Class& cls, const runtime::Method& method,
+                       const InlinePlan& plan, bool scalar_replacement) {
+    unordered_set<string> escaping;
+    while (true) {
+        try {
+            return MethodCompiler(cls, method, plan, scalar_replacement, escaping).Compile();
+        } catch (const EscapingInstance& e) {
+            escaping.insert(e.variable);
+        }
+    }
+}
+
+bool CanInline(const Function& callee, size_t max_size) {
+    if (callee.code.size() > max_size) {
+        return false;
+    }
+    return none_of(callee.code.begin(), callee.code.end(), [](const Instruction& instruction) {
+        const OperandRoles roles = GetOperandRoles(instruction.op);
+        // Суперинструкции не переносятся, так как их вторая инструкция
+        // может оказаться не следующей
+        return roles.c == Operand::CallSite || instruction.op >= OpCode::EqualJumpIfFalse;
+    });
+}
+
+void FuseInstructions(Function& function) {
+    auto& code = function.code;
+    vector<bool> fused(code.size(), false);
+    for (const Superinstruction& super : SUPERINSTRUCTIONS) {
+        for (size_t i = 0; i + 1 < code.size(); ++i) {
+            Instruction& first = code[i];
+            const Instruction& second = code[i + 1];
+            if (fused[i] || fused[i + 1] || first.op != super.first || second.op != super.second) {
+                continue;
+            }
+            // Результат сравнения не сохраняется, поэтому он должен быть временным значением,
+            // которое читает только переход
+            if (second.op == OpCode::JumpIfFalse
+                && (second.a != first.a || first.a < function.first_temp)) {
+                continue;
+            }
+            first.op = super.fused;
+            fused[i] = fused[i + 1] = true;
+        }
+    }
+}
+
+void Disassemble(const Function& function, ostream& out) {
+    out << function.name << ": "sv << function.param_count << " params, "sv
+        << function.register_count << " registers\n"sv;
+    for (size_t i = 0; i < function.code.size(); ++i) {
+        const Instruction& instruction = function.code[i];
+        out << setw(4) << i << "  "sv << OpCodeName(instruction.op) << ' ' << instruction.a
+            << ' ' << instruction.b << ' ' << instruction.c;
+        const OperandRoles roles = GetOperandRoles(instruction.op);
+        if (instruction.op == OpCode::LoadInt) {
+            out << "  ; "sv << static_cast<int>(instruction.b | uint32_t{instruction.c} << 16);
+        } else if (roles.c == Operand::Name) {
+            out << "  ; "sv << function.names[instruction.c];
+        } else if (roles.c == Operand::CallSite) {
+            const CallSite& site = function.call_sites[instruction.c];
+            if (site.function != nullptr) {
+                out << "  ; "sv << site.function->name;
+            } else if (instruction.op == OpCode::NewInstance) {
+                out << "  ; "sv << site.cls->GetName();
+            } else {
+                out << "  ; "sv << function.names[site.name];
+            }
+        }
+        out << '\n';
+    }
+}
+
+}  // namespace vm
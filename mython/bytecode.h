@@ -0,0 +1,269 @@
+#pragma once
+
+#include "native.h"
+#include "runtime.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vm {
+
+    /*
+     * Коды инструкций виртуальной машины. Инструкция читает операнды из регистров кадра
+     * и записывает результат в регистр, поэтому промежуточные значения не перекладываются
+     * через стек. Суффиксы Int и Str обозначают варианты, применяемые, когда компилятор
+     * доказал, что операнды - числа либо строки: такие инструкции не проверяют типы.
+     *
+     * Кроме регистров-объектов r у кадра есть регистры-числа n с теми же номерами.
+     * Инструкции с суффиксом Unboxed работают с числами в n и не создают объектов Number.
+     * Число упаковывается в объект инструкцией Box, только когда значение покидает
+     * вычисление: передаётся в метод, записывается в поле, выводится либо возвращается
+     */
+    enum class OpCode : std::uint8_t {
+        // Ничего не делает. Хранит число узлов дерева, не поместившееся в другую инструкцию
+        Nop,
+        // r[a] = constants[b]
+        LoadConst,
+        // r[a] = None
+        LoadNone,
+        // r[a] = r[b]
+        Move,
+        // r[a] = r[b].names[c]
+        GetField,
+        // r[a] = self.names[c]
+        GetSelfField,
+        // r[a].names[c] = r[b]
+        SetField,
+        // self.names[c] = r[b]
+        SetSelfField,
+        // Проверяет, что полям r[a] можно присваивать значения
+        CheckFieldOwner,
+        // r[a] = r[b] <операция> r[c]
+        Add,
+        Sub,
+        Mult,
+        Div,
+        AddInt,
+        SubInt,
+        MultInt,
+        DivInt,
+        AddStr,
+        Equal,
+        NotEqual,
+        Less,
+        Greater,
+        LessOrEqual,
+        GreaterOrEqual,
+        EqualInt,
+        NotEqualInt,
+        LessInt,
+        GreaterInt,
+        LessOrEqualInt,
+        GreaterOrEqualInt,
+        EqualStr,
+        NotEqualStr,
+        LessStr,
+        GreaterStr,
+        LessOrEqualStr,
+        GreaterOrEqualStr,
+        // n[a] = число, составленное из b (младшие 16 бит) и c (старшие 16 бит)
+        LoadInt,
+        // r[a] = Number(n[b])
+        Box,
+        // n[a] = r[b], где r[b] - объект Number
+        Unbox,
+        // n[a] = n[b]
+        MoveInt,
+        // n[a] = n[b] <операция> n[c]
+        AddUnboxed,
+        SubUnboxed,
+        MultUnboxed,
+        DivUnboxed,
+        // r[a] = n[b] <сравнение> n[c]
+        EqualUnboxed,
+        NotEqualUnboxed,
+        LessUnboxed,
+        GreaterUnboxed,
+        LessOrEqualUnboxed,
+        GreaterOrEqualUnboxed,
+        // r[a] = not r[b]
+        Not,
+        // r[a] = str(r[b])
+        Stringify,
+        // Переход на инструкцию a
+        Jump,
+        // Переход на инструкцию b, если r[a] приводится к False
+        JumpIfFalse,
+        // Переход на инструкцию b, если логическое значение операнда and/or r[a] равно c
+        JumpIfLogical,
+        // Выводит r[a], предваряя его пробелом, если b != 0
+        Print,
+        // Завершает строку вывода команды print
+        PrintNewline,
+        // r[a] = r[b].method(args) для места вызова c
+        Call,
+        // r[a] = self.method(args) для места вызова c
+        CallSelf,
+        // r[a] = function(args) для места вызова c
+        CallNative,
+        // Проверяет, что r[a] подходит параметру b нативной функции места вызова c
+        CheckNativeArg,
+        // r[a] = новый экземпляр класса места вызова c
+        NewInstance,
+        // Переход на инструкцию b, если r[a] (self) - не экземпляр класса места вызова c.
+        // Защищает код метода, встроенного в место вызова c
+        GuardClass,
+        GuardSelfClass,
+        // Возвращает r[a] (None) из метода
+        Return,
+        ReturnNone,
+
+        // Суперинструкции (см. FuseInstructions) выполняют свою инструкцию и следующую за ней
+        // за одну диспетчеризацию. Следующая инструкция остаётся в коде, чтобы на неё
+        // можно было перейти
+
+        // Сравнение и переход по его результату. Результат не записывается в регистр
+        EqualJumpIfFalse,
+        LessJumpIfFalse,
+        LessOrEqualJumpIfFalse,
+        EqualUnboxedJumpIfFalse,
+        LessUnboxedJumpIfFalse,
+        LessOrEqualUnboxedJumpIfFalse,
+        // Чтение поля self и вызов его метода либо чтение его поля
+        GetSelfFieldCall,
+        GetSelfFieldGetField,
+        // Загрузка константы и операция над ней
+        LoadConstReturn,
+        LoadConstAdd,
+        LoadConstSub,
+        // Операция и возврат её результата
+        CallSelfReturn,
+        AddReturn,
+    };
+
+    // Число кодов инструкций
+    inline constexpr std::size_t OPCODE_COUNT = static_cast<std::size_t>(OpCode::AddReturn) + 1;
+
+    // Возвращает имя инструкции для дизассемблера
+    std::string_view OpCodeName(OpCode op);
+
+    // Инструкция в формате с тремя операндами. Каждая инструкция хранит число узлов дерева,
+    // вычисление которых она начинает, что позволяет сравнить число диспетчеризаций
+    // виртуальной машины с числом вызовов Execute при обходе дерева
+    struct Instruction {
+        OpCode op = OpCode::Nop;
+        std::uint8_t nodes = 0;
+        std::uint16_t a = 0;
+        std::uint16_t b = 0;
+        std::uint16_t c = 0;
+    };
+
+    // Место вызова метода, нативной функции либо конструктора
+    struct CallSite {
+        // Индекс имени метода в Function::names
+        std::uint16_t name = 0;
+        // Регистры со значениями параметров
+        std::vector<std::uint16_t> args;
+        // Нативная функция для CallNative
+        const runtime::NativeFunction* function = nullptr;
+        // Класс и наличие подходящего __init__ для NewInstance либо класс получателя,
+        // для которого метод встроен в место вызова
+        const runtime::Class* cls = nullptr;
+        bool has_init = false;
+    };
+
+    // Классы получателей, наблюдавшиеся в месте вызова метода
+    struct SiteProfile {
+        // Класс первого получателя
+        std::atomic<const runtime::Class*> receiver = nullptr;
+        // true, если встречались получатели другого класса или не экземпляры классов
+        std::atomic<bool> polymorphic = false;
+    };
+
+    // Профиль вызовов метода, собираемый до встраивания вызываемых методов
+    struct FunctionProfile {
+        explicit FunctionProfile(std::size_t sites)
+            : sites(sites) {
+        }
+
+        // По одному на место вызова Function::call_sites
+        std::vector<SiteProfile> sites;
+        // true, когда профиль уже использован для встраивания
+        std::atomic<bool> used = false;
+    };
+
+    /*
+     * Метод, переведённый в байт-код. Регистр 0 содержит self, следующие - параметры,
+     * затем локальные переменные и временные значения. Число регистров кадра известно
+     * после компиляции и не меняется во время выполнения. Номер регистра обозначает
+     * и регистр-объект r, и регистр-число n
+     */
+    struct Function : runtime::MethodCode {
+        std::string name;
+        std::vector<Instruction> code;
+        std::vector<runtime::ObjectHolder> constants;
+        std::vector<std::string> names;
+        std::vector<CallSite> call_sites;
+        std::uint16_t param_count = 0;
+        std::uint16_t register_count = 0;
+        // Первый регистр временных значений, следующий за регистрами локальных переменных
+        std::uint16_t first_temp = 0;
+        // true, если значение self используется целиком, а не только для обращения к полям
+        // и методам. Тогда регистр 0 заполняется при входе в метод
+        bool uses_self_value = false;
+        // Причина, по которой метод не переведён в байт-код. Функция с непустой причиной
+        // отмечает метод, который выполняется обходом дерева
+        std::string rejection;
+        // Профиль мест вызова. Отсутствует, если профиль не собирается
+        std::unique_ptr<FunctionProfile> profile;
+        // Число мест вызова, в которые встроены вызываемые методы
+        std::size_t inlined_calls = 0;
+        // Число созданий экземпляров, заменённых регистрами полей
+        std::size_t replaced_instances = 0;
+    };
+
+    // Метод, встраиваемый в место вызова
+    struct InlineTarget {
+        // Класс получателя, на котором проверяется встроенный код
+        const runtime::Class* cls = nullptr;
+        // Байт-код метода без суперинструкций
+        const Function* function = nullptr;
+    };
+
+    // Встраиваемые методы по индексам мест вызова Function::call_sites
+    using InlinePlan = std::unordered_map<std::size_t, InlineTarget>;
+
+    // Метод нельзя перевести в байт-код
+    class UnsupportedMethod : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Переводит тело метода method класса cls в байт-код, встраивая методы согласно plan.
+    // При scalar_replacement экземпляры, которые не покидают метод, заменяются регистрами
+    // полей. Места вызова нумеруются одинаково при любом plan. Если метод нельзя перевести,
+    // выбрасывает UnsupportedMethod
+    [[nodiscard]] Function CompileMethod(const runtime::Class& cls, const runtime::Method& method,
+                                         const InlinePlan& plan = {},
+                                         bool scalar_replacement = true);
+
+    // Проверяет, что метод можно встроить в место вызова: он не длиннее max_size
+    // инструкций и не вызывает методы, нативные функции и конструкторы, так что
+    // встраивание не бывает рекурсивным
+    [[nodiscard]] bool CanInline(const Function& callee, std::size_t max_size);
+
+    // Заменяет частые пары инструкций суперинструкциями
+    void FuseInstructions(Function& function);
+
+    // Выводит инструкции функции в текстовом виде
+    void Disassemble(const Function& function, std::ostream& out);
+
+}  // namespace vm
@@ -0,0 +1,251 @@
+#include "census.h"
+
+#include "profiler.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <typeindex>
+#include <unordered_map>
+
+using namespace std;
+
+namespace profile {
+
+class HeapCensus::Observer : public runtime::AllocationObserver {
+public:
+    size_t OnAllocate(const runtime::Object& object, size_t bytes) override {
+        const auto* instance = dynamic_cast<const runtime::ClassInstance*>(&object);
+        const SiteKey key{current_line, type_index(typeid(object)),
+                          instance != nullptr ? &instance->GetClass() : nullptr};
+
+        lock_guard guard(mutex_);
+        auto [it, inserted] = site_ids_.emplace(key, sites_.size());
+        if (inserted) {
+            AllocationSite site;
+            site.line = key.line;
+            site.type = TypeName(object);
+            if (instance != nullptr) {
+                site.class_name = instance->GetClass().GetName();
+            }
+            sites_.push_back(std::move(site));
+        }
+        AllocationSite& site = sites_[it->second];
+        ++site.allocations;
+        site.bytes += bytes;
+        ++site.live;
+        site.live_bytes += bytes;
+        return it->second;
+    }
+
+    void OnFree(size_t site_id, size_t bytes) noexcept override {
+        lock_guard guard(mutex_);
+        AllocationSite& site = sites_[site_id];
+        --site.live;
+        site.live_bytes -= bytes;
+    }
+
+    HeapSnapshot TakeSnapshot() const {
+        lock_guard guard(mutex_);
+        return HeapSnapshot{sites_};
+    }
+
+private:
+    struct SiteKey {
+        int line;
+        type_index type;
+        const runtime::Class* cls;
+
+        bool operator==(const SiteKey& other) const {
+            return line == other.line && type == other.type && cls == other.cls;
+        }
+    };
+
+    struct SiteKeyHasher {
+        size_t operator()(const SiteKey& key) const {
+            return hash<int>{}(key.line) * 37 + key.type.hash_code() * 17
+                   + hash<const void*>{}(key.cls);
+        }
+    };
+
+    static string TypeName(const runtime::Object& object) {
+        if (dynamic_cast<const runtime::ClassInstance*>(&object) != nullptr) {
+            return "ClassInstance"s;
+        }
+        if (dynamic_cast<const runtime::Class*>(&object) != nullptr) {
+            return "Class"s;
+        }
+        if (dynamic_cast<const runtime::Bool*>(&object) != nullptr) {
+            return "Bool"s;
+        }
+        if (dynamic_cast<const runtime::Number*>(&object) != nullptr) {
+            return "Number"s;
+        }
+        if (dynamic_cast<const runtime::String*>(&object) != nullptr) {
+            return "String"s;
+        }
+        return typeid(object).name();
+    }
+
+    mutable mutex mutex_;
+    unordered_map<SiteKey, size_t, SiteKeyHasher> site_ids_;
+    vector<AllocationSite> sites_;
+};
+
+namespace {
+
+string SiteLabel(const AllocationSite& site) {
+    string label = site.line != 0 ? "line "s + to_string(site.line) : "<unknown>"s;
+    label += ' ';
+    label += site.type;
+    if (!site.class_name.empty()) {
+        label += ' ';
+        label += site.class_name;
+    }
+    return label;
+}
+
+void PrintTopSites(vector<const AllocationSite*> sites, ostream& out, size_t top,
+                   const function<uint64_t(const AllocationSite&)>& key) {
+    sort(sites.begin(), sites.end(), [&key](const AllocationSite* lhs, const AllocationSite* rhs) {
+        return key(*lhs) > key(*rhs);
+    });
+    sites.resize(min(sites.size(), top));
+    out << setw(12) << "count"sv << setw(14) << "bytes"sv << setw(10) << "live"sv
+        << setw(14) << "live bytes"sv << "  site\n"sv;
+    for (const auto* site : sites) {
+        out << setw(12) << site->allocations << setw(14) << site->bytes << setw(10) << site->live
+            << setw(14) << site->live_bytes << "  "sv << SiteLabel(*site) << '\n';
+    }
+}
+
+// Суммарные показатели для группы мест размещения
+struct Totals {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t live = 0;
+    uint64_t live_bytes = 0;
+
+    void Add(const AllocationSite& site) {
+        allocations += site.allocations;
+        bytes += site.bytes;
+        live += site.live;
+        live_bytes += site.live_bytes;
+    }
+};
+
+void PrintTotals(const map<string, Totals>& groups, ostream& out) {
+    for (const auto& [name, totals] : groups) {
+        out << setw(12) << totals.allocations << setw(14) << totals.bytes << setw(10)
+            << totals.live << setw(14) << totals.live_bytes << "  "sv << name << '\n';
+    }
+}
+
+}  // namespace
+
+void PrintHeapReport(const HeapSnapshot& snapshot, std::ostream& out, size_t top) {
+    Totals total;
+    map<string, Totals> by_type;
+    map<string, Totals> by_class;
+    vector<const AllocationSite*> sites;
+    for (const auto& site : snapshot.sites) {
+        total.Add(site);
+        by_type[site.type].Add(site);
+        if (!site.class_name.empty()) {
+            by_class[site.class_name].Add(site);
+        }
+        sites.push_back(&site);
+    }
+
+    out << "Heap census: "sv << total.allocations << " allocations, "sv << total.bytes
+        << " bytes, "sv << total.live << " live objects, "sv << total.live_bytes
+        << " live bytes\n"sv;
+    out << "\nTop allocation sites by count:\n"sv;
+    PrintTopSites(sites, out, top, [](const AllocationSite& site) {
+        return site.allocations;
+    });
+    out << "\nTop allocation sites by bytes:\n"sv;
+    PrintTopSites(sites, out, top, [](const AllocationSite& site) {
+        return site.bytes;
+    });
+    out << "\nBy type:\n"sv;
+    PrintTotals(by_type, out);
+    out << "\nBy class:\n"sv;
+    PrintTotals(by_class, out);
+}
+
+void PrintHeapDiff(const HeapSnapshot& before, const HeapSnapshot& after, std::ostream& out,
+                   size_t top) {
+    map<string, const AllocationSite*> old_sites;
+    for (const auto& site : before.sites) {
+        old_sites[SiteLabel(site)] = &site;
+    }
+
+    struct Growth {
+        int64_t live = 0;
+        int64_t live_bytes = 0;
+        uint64_t allocations = 0;
+        string label;
+    };
+    vector<Growth> growth;
+    for (const auto& site : after.sites) {
+        Growth g{static_cast<int64_t>(site.live), static_cast<int64_t>(site.live_bytes),
+                 site.allocations, SiteLabel(site)};
+        if (const auto it = old_sites.find(g.label); it != old_sites.end()) {
+            g.live -= static_cast<int64_t>(it->second->live);
+            g.live_bytes -= static_cast<int64_t>(it->second->live_bytes);
+            g.allocations -= it->second->allocations;
+        }
+        if (g.live > 0) {
+            growth.push_back(std::move(g));
+        }
+    }
+    sort(growth.begin(), growth.end(), [](const Growth& lhs, const Growth& rhs) {
+        return lhs.live_bytes > rhs.live_bytes;
+    });
+    growth.resize(min(growth.size(), top));
+
+    out << setw(10) << "+live"sv << setw(14) << "+live bytes"sv << setw(12) << "+allocs"sv
+        << "  site\n"sv;
+    for (const auto& g : growth) {
+        out << setw(10) << g.live << setw(14) << g.live_bytes << setw(12) << g.allocations << "  "sv
+            << g.label << '\n';
+    }
+}
+
+HeapCensus::HeapCensus()
+    : observer_(make_shared<Observer>()) {
+}
+
+HeapCensus::~HeapCensus() {
+    Stop();
+}
+
+void HeapCensus::Start() {
+    if (running_) {
+        return;
+    }
+    if (!runtime::AllocationObserver::Activate(observer_.get())) {
+        throw std::logic_error("Another heap census is already running"s);
+    }
+    running_ = true;
+}
+
+void HeapCensus::Stop() {
+    if (!running_) {
+        return;
+    }
+    runtime::AllocationObserver::Deactivate(observer_.get());
+    running_ = false;
+}
+
+HeapSnapshot HeapCensus::TakeSnapshot() const {
+    return observer_->TakeSnapshot();
+}
+
+}  // namespace profile
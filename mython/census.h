@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace profile {
+
+    // Статистика размещений объектов одного типа в одной строке программы
+    struct AllocationSite {
+        // Строка программы либо 0, если строка неизвестна
+        int line = 0;
+        // Тип объекта: Number, String, Bool, Class, ClassInstance либо имя C++ типа
+        std::string type;
+        // Для экземпляров классов - имя класса Mython
+        std::string class_name;
+        // Размещено объектов и байт за всё время учёта
+        std::uint64_t allocations = 0;
+        std::uint64_t bytes = 0;
+        // Объектов и байт, не освобождённых на момент снимка
+        std::uint64_t live = 0;
+        std::uint64_t live_bytes = 0;
+    };
+
+    // Снимок учёта размещений
+    struct HeapSnapshot {
+        std::vector<AllocationSite> sites;
+    };
+
+    // Выводит итоги, top мест размещения по числу объектов и по объёму,
+    // а также распределение объектов по типам и классам
+    void PrintHeapReport(const HeapSnapshot& snapshot, std::ostream& out, size_t top = 10);
+
+    // Выводит top мест размещения, в которых число живых объектов между снимками before и after
+    // выросло сильнее всего. Помогает найти утечки в долго работающих интерпретаторах
+    void PrintHeapDiff(const HeapSnapshot& before, const HeapSnapshot& after, std::ostream& out,
+                       size_t top = 10);
+
+    /*
+     * Учёт размещений объектов Mython.
+     * Пока учёт запущен, каждый ObjectHolder::Own сообщает о размещённом объекте, а объект
+     * относится к строке программы из profile::current_line. Чтобы строки были известны,
+     * программу нужно разобрать с ParseOptions::track_lines.
+     * Одновременно может работать только один учёт размещений
+     */
+    class HeapCensus {
+    public:
+        HeapCensus();
+
+        HeapCensus(const HeapCensus&) = delete;
+        HeapCensus& operator=(const HeapCensus&) = delete;
+
+        ~HeapCensus();
+
+        // Запускает учёт. Если уже запущен другой учёт, выбрасывает исключение std::logic_error
+        void Start();
+        // Останавливает учёт новых размещений. Освобождение объектов, размещённых
+        // во время учёта, продолжает учитываться
+        void Stop();
+
+        // Возвращает снимок текущего состояния учёта
+        [[nodiscard]] HeapSnapshot TakeSnapshot() const;
+
+    private:
+        class Observer;
+
+        std::shared_ptr<Observer> observer_;
+        bool running_ = false;
+    };
+
+}  // namespace profile
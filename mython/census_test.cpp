@@ -0,0 +1,108 @@
+#include "census.h"
+#include "program.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace profile {
+
+namespace {
+
+const string PROGRAM = R"(class Node:
+  def __init__(v):
+    self.value = v
+
+a = Node(1)
+b = Node(2)
+s = 'x' + 'y'
+)"s;
+
+CompiledProgram CompileTracked(const string& program) {
+    istringstream input(program);
+    ParseOptions options;
+    options.track_lines = true;
+    return CompiledProgram::Compile(input, options);
+}
+
+const AllocationSite* FindSite(const HeapSnapshot& snapshot, int line, const string& type) {
+    for (const auto& site : snapshot.sites) {
+        if (site.line == line && site.type == type) {
+            return &site;
+        }
+    }
+    return nullptr;
+}
+
+void TestSitesAreAttributedToLines() {
+    const auto program = CompileTracked(PROGRAM);
+
+    HeapCensus census;
+    census.Start();
+    runtime::Closure closure;
+    runtime::DummyContext context;
+    program.Run(closure, context);
+    census.Stop();
+
+    const HeapSnapshot snapshot = census.TakeSnapshot();
+    const auto* node = FindSite(snapshot, 5, "ClassInstance"s);
+    ASSERT(node != nullptr);
+    ASSERT_EQUAL(node->class_name, "Node"s);
+    ASSERT_EQUAL(node->allocations, 1U);
+    ASSERT_EQUAL(node->live, 1U);
+
+    const auto* strings = FindSite(snapshot, 7, "String"s);
+    ASSERT(strings != nullptr);
+    // две константы и результат сложения, живым остаётся только результат
+    ASSERT_EQUAL(strings->allocations, 3U);
+    ASSERT_EQUAL(strings->live, 1U);
+
+    closure.clear();
+    ASSERT_EQUAL(FindSite(census.TakeSnapshot(), 5, "ClassInstance"s)->live, 0U);
+}
+
+void TestDiffShowsGrowth() {
+    const auto program = CompileTracked(PROGRAM);
+
+    HeapCensus census;
+    census.Start();
+    vector<runtime::Closure> retained(1);
+    runtime::DummyContext context;
+    program.Run(retained.back(), context);
+    const HeapSnapshot before = census.TakeSnapshot();
+
+    retained.resize(4);
+    for (size_t i = 1; i < retained.size(); ++i) {
+        program.Run(retained[i], context);
+    }
+    const HeapSnapshot after = census.TakeSnapshot();
+    census.Stop();
+
+    ostringstream diff;
+    PrintHeapDiff(before, after, diff);
+    ASSERT(diff.str().find("line 5 ClassInstance Node"s) != string::npos);
+    ASSERT(diff.str().find("line 7 String"s) != string::npos);
+
+    ostringstream report;
+    PrintHeapReport(after, report);
+    ASSERT(report.str().find("By class:\n"s) != string::npos);
+    ASSERT(report.str().find("  Node\n"s) != string::npos);
+}
+
+void TestOnlyOneCensusAtATime() {
+    HeapCensus first;
+    first.Start();
+    HeapCensus second;
+    ASSERT_THROWS(second.Start(), std::logic_error);
+    first.Stop();
+    ASSERT_DOESNT_THROW(second.Start());
+}
+
+}  // namespace
+
+void RunCensusTests(TestRunner& tr) {
+    RUN_SERIAL_TEST(tr, profile::TestSitesAreAttributedToLines);
+    RUN_SERIAL_TEST(tr, profile::TestDiffShowsGrowth);
+    RUN_SERIAL_TEST(tr, profile::TestOnlyOneCensusAtATime);
+}
+
+}  // namespace profile
@@ -0,0 +1,424 @@
+#include "flat_ast.h"
+
+#include "operations.h"
+
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace flat {
+
+namespace {
+
+using runtime::ObjectHolder;
+using Statement = runtime::Executable;
+
+const string INIT_METHOD = "__init__"s;
+
+class Flattener {
+public:
+    Tree Build(const Statement& statement) {
+        tree_.root = Add(statement);
+        return std::move(tree_);
+    }
+
+private:
+    // Добавляет узлы statement и возвращает индекс его корня
+    uint32_t Add(const Statement& statement) {
+        if (const auto* number = dynamic_cast<const ast::NumericConst*>(&statement)) {
+            return Emit(NodeKind::NumericConst,
+                        static_cast<uint32_t>(number->GetValue().GetValue()));
+        }
+        if (const auto* str = dynamic_cast<const ast::StringConst*>(&statement)) {
+            tree_.strings.push_back(str->GetValue().GetValue());
+            return Emit(NodeKind::StringConst, Index(tree_.strings.size() - 1));
+        }
+        if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&statement)) {
+            return Emit(NodeKind::BoolConst, boolean->GetValue().GetValue() ? 1 : 0);
+        }
+        if (dynamic_cast<const ast::None*>(&statement)) {
+            return Emit(NodeKind::None);
+        }
+        if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&statement)) {
+            return AddVariable(*variable);
+        }
+        if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            const uint32_t value = Add(*assignment->GetValue());
+            return Emit(NodeKind::Assignment, Name(assignment->GetVar()), value);
+        }
+        if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&statement)) {
+            const uint32_t object = AddVariable(field->GetObject());
+            const uint32_t value = Add(*field->GetValue());
+            return Emit(NodeKind::FieldAssignment, object, Name(field->GetFieldName()), value);
+        }
+        if (const auto* print = dynamic_cast<const ast::Print*>(&statement)) {
+            return Emit(NodeKind::Print, AddList(print->GetArgs()));
+        }
+        if (const auto* call = dynamic_cast<const ast::MethodCall*>(&statement)) {
+            const uint32_t object = Add(*call->GetObject());
+            const uint32_t args = AddList(call->GetArgs());
+            return Emit(NodeKind::MethodCall, object, Name(call->GetMethod()), args);
+        }
+        if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&statement)) {
+            const uint32_t args = AddList(instance->GetArgs());
+            tree_.classes.push_back(&instance->GetClass());
+            return Emit(NodeKind::NewInstance, Index(tree_.classes.size() - 1), args);
+        }
+        if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&statement)) {
+            return Emit(NodeKind::Stringify, Add(*stringify->GetArg()));
+        }
+        if (const auto* negation = dynamic_cast<const ast::Not*>(&statement)) {
+            return Emit(NodeKind::Not, Add(*negation->GetArg()));
+        }
+        if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&statement)) {
+            const uint32_t lhs = Add(*comparison->GetLhs());
+            const uint32_t rhs = Add(*comparison->GetRhs());
+            tree_.comparators.push_back(comparison->GetComparator());
+            return Emit(NodeKind::Comparison, lhs, rhs, Index(tree_.comparators.size() - 1));
+        }
+        if (const auto* operation = dynamic_cast<const ast::BinaryOperation*>(&statement)) {
+            if (const auto kind = BinaryKind(*operation)) {
+                const uint32_t lhs = Add(*operation->GetLhs());
+                const uint32_t rhs = Add(*operation->GetRhs());
+                return Emit(*kind, lhs, rhs);
+            }
+        }
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            return Emit(NodeKind::Compound, AddList(compound->GetStatements()));
+        }
+        if (const auto* body = dynamic_cast<const ast::MethodBody*>(&statement)) {
+            return Emit(NodeKind::MethodBody, Add(*body->GetBody()));
+        }
+        if (const auto* ret = dynamic_cast<const ast::Return*>(&statement)) {
+            return Emit(NodeKind::Return, Add(*ret->GetStatement()));
+        }
+        if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&statement)) {
+            tree_.class_objects.push_back(definition->GetClassObject());
+            return Emit(NodeKind::ClassDefinition, Index(tree_.class_objects.size() - 1));
+        }
+        if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            const uint32_t condition = Add(*if_else->GetCondition());
+            const uint32_t if_body = Add(*if_else->GetIfBody());
+            const uint32_t else_body =
+                if_else->GetElseBody() ? Add(*if_else->GetElseBody()) : NO_NODE;
+            return Emit(NodeKind::IfElse, condition, if_body, else_body);
+        }
+        // Нативные вызовы и узлы режима профилирования выполняются обходом исходного дерева
+        tree_.statements.push_back(const_cast<Statement*>(&statement));
+        return Emit(NodeKind::Tree, Index(tree_.statements.size() - 1));
+    }
+
+    static optional<NodeKind> BinaryKind(const ast::BinaryOperation& operation) {
+        if (dynamic_cast<const ast::Add*>(&operation)) {
+            return NodeKind::Add;
+        }
+        if (dynamic_cast<const ast::Sub*>(&operation)) {
+            return NodeKind::Sub;
+        }
+        if (dynamic_cast<const ast::Mult*>(&operation)) {
+            return NodeKind::Mult;
+        }
+        if (dynamic_cast<const ast::Div*>(&operation)) {
+            return NodeKind::Div;
+        }
+        if (dynamic_cast<const ast::Or*>(&operation)) {
+            return NodeKind::Or;
+        }
+        if (dynamic_cast<const ast::And*>(&operation)) {
+            return NodeKind::And;
+        }
+        return nullopt;
+    }
+
+    uint32_t AddVariable(const ast::VariableValue& variable) {
+        const auto& ids = variable.GetDottedIds();
+        if (ids.size() == 1) {
+            return Emit(NodeKind::Variable, Name(ids[0]));
+        }
+        const uint32_t list = Index(tree_.lists.size());
+        tree_.lists.push_back(Index(ids.size()));
+        for (const auto& id : ids) {
+            tree_.lists.push_back(Name(id));
+        }
+        return Emit(NodeKind::DottedVariable, list);
+    }
+
+    // Добавляет узлы элементов и возвращает начало их списка в lists
+    uint32_t AddList(const vector<unique_ptr<Statement>>& items) {
+        vector<uint32_t> indices;
+        indices.reserve(items.size());
+        for (const auto& item : items) {
+            indices.push_back(Add(*item));
+        }
+        const uint32_t list = Index(tree_.lists.size());
+        tree_.lists.push_back(Index(indices.size()));
+        tree_.lists.insert(tree_.lists.end(), indices.begin(), indices.end());
+        return list;
+    }
+
+    uint32_t Name(const string& name) {
+        const auto [it, inserted] = names_.emplace(name, Index(tree_.names.size()));
+        if (inserted) {
+            tree_.names.push_back(name);
+        }
+        return it->second;
+    }
+
+    uint32_t Emit(NodeKind kind, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        tree_.nodes.push_back(Node{kind, a, b, c});
+        return Index(tree_.nodes.size() - 1);
+    }
+
+    static uint32_t Index(size_t index) {
+        if (index >= NO_NODE) {
+            throw length_error("Statement is too large"s);
+        }
+        return static_cast<uint32_t>(index);
+    }
+
+    Tree tree_;
+    unordered_map<string, uint32_t> names_;
+};
+
+// Обход плоского дерева. Каждый вид узла выполняется так же, как соответствующий
+// узел ast в statement.cpp, кроме Return: вместо исключения он устанавливает признак
+// возврата. Раскрутка стека проходила бы через кадры Eval, а у этой функции большая
+// таблица обработчиков, которую раскрутка просматривает в каждом кадре
+class Evaluator {
+public:
+    Evaluator(const Tree& tree, runtime::Closure& closure, runtime::Context& context)
+        : tree_(tree)
+        , closure_(closure)
+        , context_(context) {
+    }
+
+    ObjectHolder Eval(uint32_t index) {
+        const Node& node = tree_.nodes[index];
+        switch (node.kind) {
+            case NodeKind::NumericConst:
+                return ObjectHolder::Own(runtime::Number{static_cast<int>(node.a)});
+            case NodeKind::StringConst:
+                return ObjectHolder::Own(runtime::String{tree_.strings[node.a]});
+            case NodeKind::BoolConst:
+                return ObjectHolder::Own(runtime::Bool{node.a != 0});
+            case NodeKind::None:
+                return {};
+            case NodeKind::Variable:
+                return ReadVariable(tree_.names[node.a]);
+            case NodeKind::DottedVariable: {
+                const uint32_t* ids = &tree_.lists[node.a + 1];
+                ObjectHolder object = ReadVariable(tree_.names[ids[0]]);
+                for (uint32_t i = 1; i < tree_.lists[node.a]; ++i) {
+                    object = runtime::GetField(object, tree_.names[ids[i]]);
+                }
+                return object;
+            }
+            case NodeKind::Assignment: {
+                const string& name = tree_.names[node.a];
+                closure_[name] = Eval(node.b);
+                return closure_.at(name);
+            }
+            case NodeKind::FieldAssignment: {
+                const ObjectHolder object = Eval(node.a);
+                runtime::CheckFieldOwner(object);
+                return runtime::SetField(object, tree_.names[node.b], Eval(node.c));
+            }
+            case NodeKind::Print:
+                return Print(node.a);
+            case NodeKind::MethodCall: {
+                const vector<ObjectHolder> args = EvalList(node.c);
+                return runtime::CallMethod(Eval(node.a), tree_.names[node.b], args, context_);
+            }
+            case NodeKind::NewInstance:
+                return NewInstance(*tree_.classes[node.a], node.b);
+            case NodeKind::Stringify:
+                return runtime::Stringify(Eval(node.a), context_);
+            case NodeKind::Add: {
+                const ObjectHolder lhs = Eval(node.a);
+                return runtime::Add(lhs, Eval(node.b), context_);
+            }
+            case NodeKind::Sub: {
+                const ObjectHolder lhs = Eval(node.a);
+                return runtime::Sub(lhs, Eval(node.b));
+            }
+            case NodeKind::Mult: {
+                const ObjectHolder lhs = Eval(node.a);
+                return runtime::Mult(lhs, Eval(node.b));
+            }
+            case NodeKind::Div: {
+                const ObjectHolder lhs = Eval(node.a);
+                return runtime::Div(lhs, Eval(node.b));
+            }
+            case NodeKind::Or:
+                // Результат - значение lhs либо rhs, поэтому lhs вычисляется повторно
+                if (runtime::LogicalValue(Eval(node.a))) {
+                    return Eval(node.a);
+                }
+                return Eval(node.b);
+            case NodeKind::And:
+                if (!runtime::LogicalValue(Eval(node.a))) {
+                    return Eval(node.a);
+                }
+                return Eval(node.b);
+            case NodeKind::Not:
+                return ObjectHolder::Own(runtime::Bool{!runtime::LogicalValue(Eval(node.a))});
+            case NodeKind::Comparison: {
+                const ObjectHolder lhs = Eval(node.a);
+                const ObjectHolder rhs = Eval(node.b);
+                return ObjectHolder::Own(
+                    runtime::Bool{tree_.comparators[node.c](lhs, rhs, context_)});
+            }
+            case NodeKind::Compound: {
+                const uint32_t count = tree_.lists[node.a];
+                for (uint32_t i = 1; i <= count; ++i) {
+                    context_.ChargeStep();
+                    ObjectHolder result = Eval(tree_.lists[node.a + i]);
+                    if (returning_) {
+                        return result;
+                    }
+                }
+                return {};
+            }
+            case NodeKind::MethodBody:
+                return EvalMethodBody(node.a);
+            case NodeKind::Return: {
+                ObjectHolder result = Eval(node.a);
+                returning_ = true;
+                return result;
+            }
+            case NodeKind::ClassDefinition: {
+                const ObjectHolder& cls = tree_.class_objects[node.a];
+                closure_[static_cast<const runtime::Class&>(*cls).GetName()] = cls;
+                return cls;
+            }
+            case NodeKind::IfElse:
+                if (runtime::IsTrue(Eval(node.a))) {
+                    return Eval(node.b);
+                }
+                if (node.c != NO_NODE) {
+                    return Eval(node.c);
+                }
+                return {};
+            case NodeKind::Tree:
+                return tree_.statements[node.a]->Execute(closure_, context_);
+        }
+        throw logic_error("Unknown flat node"s);
+    }
+
+private:
+    ObjectHolder EvalMethodBody(uint32_t body) {
+        try {
+            ObjectHolder result = Eval(body);
+            returning_ = false;
+            return result;
+        } catch (ObjectHolder& result) {
+            // return внутри узла, выполняемого обходом исходного дерева
+            return std::move(result);
+        }
+    }
+
+    ObjectHolder ReadVariable(const string& name) const {
+        const auto it = closure_.find(name);
+        if (it == closure_.end()) {
+            throw runtime_error("Unknown name"s);
+        }
+        return it->second;
+    }
+
+    vector<ObjectHolder> EvalList(uint32_t list) {
+        const uint32_t count = tree_.lists[list];
+        vector<ObjectHolder> values;
+        values.reserve(count);
+        for (uint32_t i = 1; i <= count; ++i) {
+            values.push_back(Eval(tree_.lists[list + i]));
+        }
+        return values;
+    }
+
+    ObjectHolder Print(uint32_t list) {
+        const uint32_t count = tree_.lists[list];
+        for (uint32_t i = 1; i <= count; ++i) {
+            const ObjectHolder value = Eval(tree_.lists[list + i]);
+            if (i > 1) {
+                context_.GetOutputStream() << ' ';
+            }
+            runtime::PrintValue(value, context_);
+        }
+        context_.GetOutputStream() << "\n";
+        return ObjectHolder::None();
+    }
+
+    ObjectHolder NewInstance(const runtime::Class& cls, uint32_t args) {
+        ObjectHolder object = ObjectHolder::Own(runtime::ClassInstance(cls));
+        auto* instance = object.TryAs<runtime::ClassInstance>();
+        if (instance->HasMethod(INIT_METHOD, tree_.lists[args])) {
+            instance->Call(INIT_METHOD, EvalList(args), context_);
+        }
+        return object;
+    }
+
+    const Tree& tree_;
+    runtime::Closure& closure_;
+    runtime::Context& context_;
+    // Выполнен узел Return: инструкции до ближайшего MethodBody пропускаются
+    bool returning_ = false;
+};
+
+// Плоское дерево тела метода
+class FlatMethod : public runtime::MethodCode {
+public:
+    explicit FlatMethod(Tree tree)
+        : tree_(std::move(tree)) {
+    }
+
+    const Tree& GetTree() const {
+        return tree_;
+    }
+
+private:
+    Tree tree_;
+};
+
+}  // namespace
+
+Tree Flatten(const runtime::Executable& statement) {
+    return Flattener().Build(statement);
+}
+
+ObjectHolder Execute(const Tree& tree, runtime::Closure& closure, runtime::Context& context) {
+    return Evaluator(tree, closure, context).Eval(tree.root);
+}
+
+optional<ObjectHolder> FlatTreeWalker::TryCall(runtime::ClassInstance& self,
+                                               const runtime::Method& method,
+                                               const vector<ObjectHolder>& args,
+                                               runtime::Context& context) {
+    const runtime::MethodCode* code = method.runtime_data.GetCode(runtime::CodeKind::FlatTree);
+    if (code == nullptr) {
+        auto flat_method = make_unique<FlatMethod>(Flatten(ast::GetMethodBody(method)));
+        const FlatMethod* created = flat_method.get();
+        // Дерево могло быть построено одновременно в другом потоке, тогда используется оно
+        code = method.runtime_data.SetCode(runtime::CodeKind::FlatTree, std::move(flat_method));
+        if (code == created) {
+            flattened_methods_.fetch_add(1, memory_order_relaxed);
+            nodes_.fetch_add(created->GetTree().nodes.size(), memory_order_relaxed);
+        }
+    }
+    runtime::Closure closure;
+    closure["self"s] = ObjectHolder::Share(self);
+    for (size_t i = 0; i < args.size(); ++i) {
+        closure[method.formal_params[i]] = args[i];
+    }
+    return Execute(static_cast<const FlatMethod&>(*code).GetTree(), closure, context);
+}
+
+FlatStats FlatTreeWalker::GetStats() const {
+    FlatStats stats;
+    stats.flattened_methods = flattened_methods_.load(memory_order_relaxed);
+    stats.nodes = nodes_.load(memory_order_relaxed);
+    return stats;
+}
+
+}  // namespace flat
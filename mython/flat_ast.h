@@ -0,0 +1,109 @@
+#pragma once
+
+#include "runtime.h"
+#include "statement.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace flat {
+
+    // Вид узла плоского дерева. Смысл операндов a, b и c узла указан для каждого вида.
+    // Списки (параметры, инструкции) хранятся в Tree::lists: число элементов, затем элементы
+    enum class NodeKind : std::uint8_t {
+        NumericConst,     // a - значение
+        StringConst,      // a - строка в strings
+        BoolConst,        // a - значение
+        None,
+        Variable,         // a - имя в names
+        DottedVariable,   // a - список имён
+        Assignment,       // a - имя переменной, b - значение
+        FieldAssignment,  // a - объект, b - имя поля, c - значение
+        Print,            // a - список аргументов
+        MethodCall,       // a - объект, b - имя метода, c - список аргументов
+        NewInstance,      // a - класс в classes, b - список аргументов
+        Stringify,        // a - аргумент
+        Add,              // a, b - операнды
+        Sub,
+        Mult,
+        Div,
+        Or,
+        And,
+        Not,              // a - аргумент
+        Comparison,       // a, b - операнды, c - функция сравнения в comparators
+        Compound,         // a - список инструкций
+        MethodBody,       // a - тело
+        Return,           // a - значение
+        ClassDefinition,  // a - объект класса в class_objects
+        IfElse,           // a - условие, b - ветка if, c - ветка else либо NO_NODE
+        Tree,             // a - узел исходного дерева в statements, выполняется его обходом
+    };
+
+    // Узел плоского дерева: вид и до трёх 32-битных операндов - индексов дочерних узлов,
+    // списков, имён либо значений
+    struct Node {
+        NodeKind kind = NodeKind::None;
+        std::uint32_t a = 0;
+        std::uint32_t b = 0;
+        std::uint32_t c = 0;
+    };
+
+    inline constexpr std::uint32_t NO_NODE = UINT32_MAX;
+
+    /*
+     * Плоское дерево инструкции: узлы в одном векторе в обратном порядке обхода
+     * (дочерние узлы раньше родителя, корень - последний), поэтому обход читает память
+     * подряд. Узлы, для которых нет плоского вида (нативные вызовы, узлы режима
+     * профилирования), выполняются обходом исходного дерева, поэтому исходное дерево
+     * должно существовать, пока используется плоское
+     */
+    struct Tree {
+        std::vector<Node> nodes;
+        std::vector<std::uint32_t> lists;
+        std::vector<std::string> names;
+        std::vector<std::string> strings;
+        std::vector<const runtime::Class*> classes;
+        std::vector<runtime::ObjectHolder> class_objects;
+        std::vector<ast::Comparison::Comparator> comparators;
+        std::vector<runtime::Executable*> statements;
+        std::uint32_t root = NO_NODE;
+    };
+
+    // Строит плоское дерево инструкции statement, полученной от парсера
+    Tree Flatten(const runtime::Executable& statement);
+
+    // Выполняет плоское дерево так же, как обход исходного дерева выполнил бы statement:
+    // с теми же результатами, исключениями и расходом бюджета выполнения
+    runtime::ObjectHolder Execute(const Tree& tree, runtime::Closure& closure,
+                                  runtime::Context& context);
+
+    // Статистика обхода плоских деревьев
+    struct FlatStats {
+        // Методов, для которых построено плоское дерево
+        std::uint64_t flattened_methods = 0;
+        // Узлов во всех построенных деревьях
+        std::uint64_t nodes = 0;
+    };
+
+    /*
+     * Ускоритель вызовов, выполняющий методы обходом плоских деревьев.
+     * Плоское дерево метода строится при первом вызове и хранится в сведениях
+     * о выполнении метода. Может использоваться одновременно из нескольких потоков
+     */
+    class FlatTreeWalker : public runtime::CallAccelerator {
+    public:
+        std::optional<runtime::ObjectHolder> TryCall(runtime::ClassInstance& self,
+            const runtime::Method& method, const std::vector<runtime::ObjectHolder>& args,
+            runtime::Context& context) override;
+
+        [[nodiscard]] FlatStats GetStats() const;
+
+    private:
+        std::atomic<std::uint64_t> flattened_methods_ = 0;
+        std::atomic<std::uint64_t> nodes_ = 0;
+    };
+
+}  // namespace flat
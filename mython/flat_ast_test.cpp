@@ -0,0 +1,196 @@
+#include "flat_ast.h"
+#include "program.h"
+#include "test_runner_p.h"
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace flat {
+
+namespace {
+
+const string FEATURES_PROGRAM = R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __add__(other):
+    return self.x + other.x + self.y + other.y
+
+  def __eq__(other):
+    return self.x == other.x and self.y == other.y
+
+  def __str__():
+    return '(' + str(self.x) + ', ' + str(self.y) + ')'
+
+  def norm1():
+    total = self.x
+    if self.y < 0:
+      total = total - self.y
+    else:
+      total = total + self.y
+    return total
+
+class Box:
+  def __init__(p):
+    self.p = p
+
+  def moved(dx):
+    self.p.x = self.p.x + dx
+    return self.p.x
+
+  def describe(name, n):
+    print 'box', name, n, self.p
+    return name + ':' + str(n)
+
+  def pick(a, b):
+    return a or b
+
+  def both(a, b):
+    return a and b
+
+  def negate(v):
+    return not v
+
+  def make(x):
+    return Point(x, x * 2)
+
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+  def nothing():
+    x = None
+
+p = Point(1, -2)
+q = Point(3, 4)
+b = Box(p)
+print p + q, p == q, p.norm1(), q.norm1()
+print b.moved(5), p.x, b.p.x
+print b.describe('n', 7)
+print b.pick(0, 5), b.pick(3, 5), b.both(0, 5), b.both(2, 5), b.negate(0), b.negate(True)
+print b.make(4), b.fib(12), b.nothing(), 7 / 2 - 1
+)"s;
+
+struct RunResult {
+    string output;
+    string error;
+};
+
+RunResult Run(const string& source, runtime::CallAccelerator* accelerator,
+              runtime::ExecutionBudget* budget = nullptr) {
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    runtime::DummyContext context;
+    context.SetCallAccelerator(accelerator);
+    context.SetBudget(budget);
+    RunResult result;
+    try {
+        program.Run(context);
+    } catch (const runtime_error& e) {
+        result.error = e.what();
+    }
+    result.output = context.output.str();
+    return result;
+}
+
+void TestNodesArePostOrder() {
+    // x = 1 + 2 * 3; print x
+    auto body = make_unique<ast::Compound>();
+    body->AddStatement(make_unique<ast::Assignment>(
+        "x"s, make_unique<ast::Add>(
+                  make_unique<ast::NumericConst>(1),
+                  make_unique<ast::Mult>(make_unique<ast::NumericConst>(2),
+                                         make_unique<ast::NumericConst>(3)))));
+    body->AddStatement(ast::Print::Variable("x"s));
+
+    const Tree tree = Flatten(*body);
+    ASSERT_EQUAL(tree.nodes.size(), 9U);
+    ASSERT_EQUAL(tree.root, 8U);
+    // Дочерние узлы расположены раньше родителя
+    for (uint32_t i = 0; i < tree.nodes.size(); ++i) {
+        const Node& node = tree.nodes[i];
+        if (node.kind == NodeKind::Add || node.kind == NodeKind::Mult) {
+            ASSERT(node.a < i && node.b < i);
+        } else if (node.kind == NodeKind::Assignment) {
+            ASSERT(node.b < i);
+        }
+    }
+    ASSERT(tree.nodes[4].kind == NodeKind::Add);
+    ASSERT_EQUAL(tree.nodes[4].a, 0U);
+    ASSERT_EQUAL(tree.nodes[4].b, 3U);
+    ASSERT(tree.nodes[8].kind == NodeKind::Compound);
+    ASSERT_EQUAL(tree.names, (vector<string>{"x"s}));
+
+    runtime::Closure closure;
+    runtime::DummyContext context;
+    Execute(tree, closure, context);
+    ASSERT_EQUAL(context.output.str(), "7\n"s);
+    ASSERT_EQUAL(closure.at("x"s).TryAs<runtime::Number>()->GetValue(), 7);
+}
+
+void TestMatchesTreeWalker() {
+    const RunResult expected = Run(FEATURES_PROGRAM, nullptr);
+    ASSERT_EQUAL(expected.error, ""s);
+    ASSERT_EQUAL(expected.output,
+                 "6 False 3 7\n6 6 6\nbox n 7 (6, -2)\nn:7\n5 3 0 5 True False\n"
+                 "(4, 8) 144 None 2\n"s);
+
+    FlatTreeWalker walker;
+    const RunResult actual = Run(FEATURES_PROGRAM, &walker);
+    ASSERT_EQUAL(actual.output, expected.output);
+    ASSERT_EQUAL(actual.error, ""s);
+    // Дерево строится один раз на метод, а не на вызов
+    ASSERT_EQUAL(walker.GetStats().flattened_methods, 14U);
+    ASSERT(walker.GetStats().nodes > 100);
+}
+
+void TestErrorsMatchTreeWalker() {
+    const vector<string> sources = {
+        "class A:\n  def f(a, b):\n    print 'before'\n    return a / b\n\na = A()\nprint a.f(1, 0)\n"s,
+        "class A:\n  def f():\n    return self.missing\n\na = A()\nprint a.f()\n"s,
+        "class A:\n  def f(x):\n    return x.g()\n\na = A()\nprint a.f(1)\n"s,
+        "class A:\n  def f(x):\n    x.y = 1\n\na = A()\nprint a.f(1)\n"s,
+        "class A:\n  def f(flag):\n    if flag:\n      x = 1\n    return x\n\na = A()\nprint a.f(False)\n"s,
+    };
+    for (const string& source : sources) {
+        const RunResult expected = Run(source, nullptr);
+        ASSERT(!expected.error.empty());
+        FlatTreeWalker walker;
+        const RunResult actual = Run(source, &walker);
+        ASSERT_EQUAL(actual.output, expected.output);
+        ASSERT_EQUAL(actual.error, expected.error);
+    }
+}
+
+void TestChargesSameSteps() {
+    // Бюджет исчерпывается посреди вызовов fib: вывод до этого места должен совпасть
+    const string source = FEATURES_PROGRAM + "print b.fib(15)\n"s;
+    for (const uint64_t max_steps : {50U, 500U, 5000U}) {
+        runtime::ExecutionBudget expected_budget(max_steps);
+        const RunResult expected = Run(source, nullptr, &expected_budget);
+        ASSERT(!expected.error.empty());
+
+        FlatTreeWalker walker;
+        runtime::ExecutionBudget actual_budget(max_steps);
+        const RunResult actual = Run(source, &walker, &actual_budget);
+        ASSERT_EQUAL(actual.output, expected.output);
+        ASSERT_EQUAL(actual.error, expected.error);
+    }
+}
+
+}  // namespace
+
+void RunFlatAstTests(TestRunner& tr) {
+    RUN_TEST(tr, TestNodesArePostOrder);
+    RUN_TEST(tr, TestMatchesTreeWalker);
+    RUN_TEST(tr, TestErrorsMatchTreeWalker);
+    RUN_TEST(tr, TestChargesSameSteps);
+}
+
+}  // namespace flat
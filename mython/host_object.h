@@ -0,0 +1,205 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace runtime {
+
+    // Базовый класс для объектов хост-программы, поля которых доступны из Mython
+    class HostObjectBase : public Object {
+    public:
+        // Возвращает true, если у объекта есть поле name
+        [[nodiscard]] virtual bool HasField(std::string_view name) const = 0;
+
+        // Возвращает значение поля name. Если поля нет, выбрасывает исключение runtime_error
+        [[nodiscard]] virtual ObjectHolder GetField(std::string_view name) const = 0;
+
+        // Записывает value в поле name. Если поля нет либо тип value не подходит полю,
+        // выбрасывает исключение runtime_error
+        virtual void SetField(std::string_view name, const ObjectHolder& value) = 0;
+    };
+
+    /*
+     * Описание структуры T, доступной из Mython. Специализация должна содержать
+     * имя класса и таблицу полей, например:
+     *
+     * template <>
+     * struct HostBinding<Point> {
+     *     static constexpr std::string_view name = "Point";
+     *     static constexpr std::array fields = {
+     *         MakeHostField<&Point::x>("x"),
+     *         MakeHostField<&Point::y>("y"),
+     *     };
+     * };
+     */
+    template <typename T>
+    struct HostBinding;
+
+    template <typename T, typename = void>
+    struct HasHostBinding : std::false_type {};
+
+    template <typename T>
+    struct HasHostBinding<T, std::void_t<decltype(HostBinding<T>::fields)>> : std::true_type {};
+
+    template <typename T>
+    class HostObject;
+
+    // Преобразование значений полей C++ в объекты Mython и обратно
+    template <typename V, typename = void>
+    struct HostValue;
+
+    template <>
+    struct HostValue<int> {
+        static ObjectHolder Get(int& value) {
+            return ObjectHolder::Own(Number{value});
+        }
+        static void Set(int& value, const ObjectHolder& object) {
+            if (const auto* ptr = object.TryAs<Number>()) {
+                value = ptr->GetValue();
+                return;
+            }
+            throw std::runtime_error("Number expected");
+        }
+    };
+
+    template <>
+    struct HostValue<bool> {
+        static ObjectHolder Get(bool& value) {
+            return ObjectHolder::Own(Bool{value});
+        }
+        static void Set(bool& value, const ObjectHolder& object) {
+            if (const auto* ptr = object.TryAs<Bool>()) {
+                value = ptr->GetValue();
+                return;
+            }
+            throw std::runtime_error("Bool expected");
+        }
+    };
+
+    template <>
+    struct HostValue<std::string> {
+        static ObjectHolder Get(std::string& value) {
+            return ObjectHolder::Own(String{value});
+        }
+        static void Set(std::string& value, const ObjectHolder& object) {
+            if (const auto* ptr = object.TryAs<String>()) {
+                value = ptr->GetValue();
+                return;
+            }
+            throw std::runtime_error("String expected");
+        }
+    };
+
+    // Вложенная структура с собственным описанием HostBinding доступна по ссылке, без копирования
+    template <typename V>
+    struct HostValue<V, std::enable_if_t<HasHostBinding<V>::value>> {
+        static ObjectHolder Get(V& value) {
+            return ObjectHolder::Own(HostObject<V>(value));
+        }
+        static void Set(V& /*value*/, const ObjectHolder& /*object*/) {
+            throw std::runtime_error("Nested host objects can't be reassigned");
+        }
+    };
+
+    // Поле структуры T: имя и функции доступа к нему
+    template <typename T>
+    struct HostField {
+        std::string_view name;
+        ObjectHolder (*get)(T& object);
+        void (*set)(T& object, const ObjectHolder& value);
+    };
+
+    template <auto Member>
+    struct MemberPointerTraits;
+
+    template <typename T, typename V, V T::*Member>
+    struct MemberPointerTraits<Member> {
+        using Class = T;
+        using Value = V;
+    };
+
+    // Создаёт описание поля по указателю на член класса.
+    // Функции доступа генерируются на этапе компиляции для каждого поля
+    template <auto Member>
+    constexpr auto MakeHostField(std::string_view name) {
+        using Class = typename MemberPointerTraits<Member>::Class;
+        using Value = typename MemberPointerTraits<Member>::Value;
+        return HostField<Class>{
+            name,
+            [](Class& object) {
+                return HostValue<Value>::Get(object.*Member);
+            },
+            [](Class& object, const ObjectHolder& value) {
+                HostValue<Value>::Set(object.*Member, value);
+            },
+        };
+    }
+
+    /*
+     * Объект Mython, представляющий структуру хост-программы типа T.
+     * Хранит ссылку на структуру, поэтому чтение и запись полей из программы
+     * происходят непосредственно в памяти хоста. Структура должна существовать,
+     * пока программа обращается к объекту
+     */
+    template <typename T>
+    class HostObject : public HostObjectBase {
+    public:
+        explicit HostObject(T& object)
+            : object_(object) {
+        }
+
+        [[nodiscard]] bool HasField(std::string_view name) const override {
+            return FindField(name) != nullptr;
+        }
+
+        [[nodiscard]] ObjectHolder GetField(std::string_view name) const override {
+            return GetFieldOrThrow(name).get(object_);
+        }
+
+        void SetField(std::string_view name, const ObjectHolder& value) override {
+            GetFieldOrThrow(name).set(object_, value);
+        }
+
+        // Выводит в os имя класса, например "Point"
+        void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+            os << HostBinding<T>::name;
+        }
+
+        [[nodiscard]] T& GetObject() const {
+            return object_;
+        }
+
+    private:
+        static const HostField<T>* FindField(std::string_view name) {
+            for (const auto& field : HostBinding<T>::fields) {
+                if (field.name == name) {
+                    return &field;
+                }
+            }
+            return nullptr;
+        }
+
+        static const HostField<T>& GetFieldOrThrow(std::string_view name) {
+            if (const auto* field = FindField(name)) {
+                return *field;
+            }
+            throw std::runtime_error(std::string("Host object ").append(HostBinding<T>::name)
+                                         .append(" has no field ")
+                                         .append(name));
+        }
+
+        T& object_;
+    };
+
+    // Возвращает ObjectHolder, представляющий структуру object в программе на Mython
+    template <typename T>
+    [[nodiscard]] ObjectHolder MakeHostObject(T& object) {
+        return ObjectHolder::Own(HostObject<T>(object));
+    }
+
+}  // namespace runtime
@@ -0,0 +1,104 @@
+#include "host_object.h"
+#include "program.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace {
+
+struct Customer {
+    string name;
+    bool vip = false;
+};
+
+struct Order {
+    int id = 0;
+    int total = 0;
+    Customer customer;
+};
+
+}  // namespace
+
+namespace runtime {
+
+template <>
+struct HostBinding<Customer> {
+    static constexpr std::string_view name = "Customer";
+    static constexpr std::array fields = {
+        MakeHostField<&Customer::name>("name"),
+        MakeHostField<&Customer::vip>("vip"),
+    };
+};
+
+template <>
+struct HostBinding<Order> {
+    static constexpr std::string_view name = "Order";
+    static constexpr std::array fields = {
+        MakeHostField<&Order::id>("id"),
+        MakeHostField<&Order::total>("total"),
+        MakeHostField<&Order::customer>("customer"),
+    };
+};
+
+namespace {
+
+string RunWithOrder(const string& program, Order& order) {
+    istringstream input(program);
+    const auto compiled = CompiledProgram::Compile(input);
+
+    DummyContext context;
+    Closure closure{{"order"s, MakeHostObject(order)}};
+    compiled.Run(closure, context);
+    return context.output.str();
+}
+
+void TestReadHostFields() {
+    Order order{7, 120, {"Ann"s, true}};
+
+    const string output = RunWithOrder(R"(
+print order.id, order.total, order.customer.name, order.customer.vip
+print order, order.customer
+)"s, order);
+
+    ASSERT_EQUAL(output, "7 120 Ann True\nOrder Customer\n"s);
+}
+
+void TestWriteHostFieldsInPlace() {
+    Order order{7, 120, {"Ann"s, false}};
+
+    RunWithOrder(R"(
+class Discount:
+  def apply(o, amount):
+    o.total = o.total - amount
+
+d = Discount()
+d.apply(order, 20)
+order.customer.name = 'Bob'
+order.customer.vip = True
+c = order.customer
+c.name = c.name + '!'
+)"s, order);
+
+    ASSERT_EQUAL(order.total, 100);
+    ASSERT_EQUAL(order.customer.name, "Bob!"s);
+    ASSERT(order.customer.vip);
+}
+
+void TestHostFieldErrors() {
+    Order order;
+
+    ASSERT_THROWS(RunWithOrder("print order.missing\n"s, order), std::runtime_error);
+    ASSERT_THROWS(RunWithOrder("order.id = 'text'\n"s, order), std::runtime_error);
+    ASSERT_THROWS(RunWithOrder("order.customer = 1\n"s, order), std::runtime_error);
+    ASSERT_EQUAL(order.id, 0);
+}
+
+}  // namespace
+
+void RunHostObjectTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestReadHostFields);
+    RUN_TEST(tr, runtime::TestWriteHostFieldsInPlace);
+    RUN_TEST(tr, runtime::TestHostFieldErrors);
+}
+
+}  // namespace runtime
@@ -0,0 +1,113 @@
+#include "interpreter_stack.h"
+
+#include <cerrno>
+#include <exception>
+#include <system_error>
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+// Запас стека над границей, при которой вызовы методов прекращаются.
+// Нужен для вычисления выражений внутри метода, вывода и раскрутки стека при исключении
+constexpr size_t STACK_RESERVE = 256 * 1024;
+
+size_t RoundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Область памяти, выделенная mmap и освобождаемая при разрушении
+class MappedMemory {
+public:
+    explicit MappedMemory(size_t size)
+        : size_(size)
+        , data_(mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0)) {
+        if (data_ == MAP_FAILED) {
+            throw system_error(errno, generic_category(), "Can't allocate interpreter stack"s);
+        }
+    }
+
+    MappedMemory(const MappedMemory&) = delete;
+    MappedMemory& operator=(const MappedMemory&) = delete;
+
+    ~MappedMemory() {
+        munmap(data_, size_);
+    }
+
+    [[nodiscard]] char* Data() const {
+        return static_cast<char*>(data_);
+    }
+
+private:
+    size_t size_;
+    void* data_;
+};
+
+struct StackTask {
+    Context& context;
+    const function<void()>& func;
+    const char* stack_limit;
+    size_t max_call_depth;
+    exception_ptr error;
+};
+
+void* RunStackTask(void* arg) {
+    auto& task = *static_cast<StackTask*>(arg);
+    task.context.SetStackLimit(task.stack_limit);
+    task.context.SetMaxCallDepth(task.max_call_depth);
+    try {
+        task.func();
+    } catch (...) {
+        task.error = current_exception();
+    }
+    task.context.SetStackLimit(nullptr);
+    task.context.SetMaxCallDepth(0);
+    return nullptr;
+}
+
+void CheckPthread(int code, const char* what) {
+    if (code != 0) {
+        throw system_error(code, generic_category(), what);
+    }
+}
+
+}  // namespace
+
+void RunOnInterpreterStack(Context& context, const InterpreterStackOptions& options,
+                           const std::function<void()>& func) {
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t stack_size
+        = RoundUp(options.max_call_depth * options.bytes_per_call + 2 * STACK_RESERVE, page_size)
+          + page_size;
+
+    MappedMemory stack(stack_size);
+    // Нижняя страница защищена, чтобы переполнение не затронуло соседнюю память
+    mprotect(stack.Data(), page_size, PROT_NONE);
+
+    StackTask task{context, func, stack.Data() + page_size + STACK_RESERVE,
+                   options.max_call_depth, nullptr};
+
+    pthread_attr_t attr;
+    CheckPthread(pthread_attr_init(&attr), "pthread_attr_init");
+    pthread_t thread;
+    int code = pthread_attr_setstack(&attr, stack.Data(), stack_size);
+    if (code == 0) {
+        code = pthread_create(&thread, &attr, &RunStackTask, &task);
+    }
+    pthread_attr_destroy(&attr);
+    CheckPthread(code, "Can't start interpreter thread");
+    CheckPthread(pthread_join(thread, nullptr), "pthread_join");
+
+    if (task.error) {
+        rethrow_exception(task.error);
+    }
+}
+
+}  // namespace runtime
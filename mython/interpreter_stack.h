@@ -0,0 +1,28 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <functional>
+
+namespace runtime {
+
+    // Параметры стека интерпретатора
+    struct InterpreterStackOptions {
+        // Максимальная глубина вложенных вызовов методов
+        size_t max_call_depth = 100000;
+        // Размер стека, отводимый на один уровень вложенности вызовов
+        size_t bytes_per_call = 2048;
+    };
+
+    /*
+     * Выполняет func на отдельном потоке, стек которого выделен через mmap и рассчитан
+     * на options.max_call_depth вложенных вызовов методов. Страницы стека выделяются системой
+     * по мере использования, поэтому неиспользованная глубина почти не занимает памяти.
+     * На время выполнения context ограничивает глубину вызовов и следит за границей стека:
+     * вместо переполнения стека программа получает исключение RecursionDepthExceeded.
+     * Исключения, выброшенные func, передаются вызывающему потоку
+     */
+    void RunOnInterpreterStack(Context& context, const InterpreterStackOptions& options,
+                               const std::function<void()>& func);
+
+}  // namespace runtime
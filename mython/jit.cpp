@@ -0,0 +1,885 @@
+#include "jit.h"
+
+#include "statement.h"
+
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace jit {
+
+namespace {
+
+using runtime::Class;
+using runtime::CodeKind;
+using runtime::Method;
+using runtime::ObjectHolder;
+
+// Состояние вызова машинного кода. Машинный код обращается к полям по смещениям *_OFFSET
+struct NativeState {
+    // Глубина вложенных вызовов машинного кода
+    uint32_t depth = 0;
+    uint32_t max_depth = 0;
+    // Наименьший допустимый адрес стека либо 0
+    uintptr_t stack_limit = 0;
+    // Не равно 0, если вызов нужно выполнить обходом дерева
+    uint8_t bailout = 0;
+};
+
+constexpr uint8_t DEPTH_OFFSET = 0;
+constexpr uint8_t MAX_DEPTH_OFFSET = 4;
+constexpr uint8_t STACK_LIMIT_OFFSET = 8;
+constexpr uint8_t BAILOUT_OFFSET = 16;
+static_assert(offsetof(NativeState, depth) == DEPTH_OFFSET);
+static_assert(offsetof(NativeState, max_depth) == MAX_DEPTH_OFFSET);
+static_assert(offsetof(NativeState, stack_limit) == STACK_LIMIT_OFFSET);
+static_assert(offsetof(NativeState, bailout) == BAILOUT_OFFSET);
+
+// Параметры передаются машинному коду в регистрах по соглашению System V:
+// указатель на NativeState в rdi, числа - в esi, edx, ecx, r8d и r9d
+enum Register : uint8_t {
+    EAX = 0,
+    ECX = 1,
+    EDX = 2,
+    ESI = 6,
+    R8D = 8,
+    R9D = 9,
+};
+
+constexpr Register PARAM_REGISTERS[] = {ESI, EDX, ECX, R8D, R9D};
+constexpr size_t MAX_NATIVE_PARAMS = size(PARAM_REGISTERS);
+
+using Entry0 = int32_t (*)(NativeState*);
+using Entry1 = int32_t (*)(NativeState*, int32_t);
+using Entry2 = int32_t (*)(NativeState*, int32_t, int32_t);
+using Entry3 = int32_t (*)(NativeState*, int32_t, int32_t, int32_t);
+using Entry4 = int32_t (*)(NativeState*, int32_t, int32_t, int32_t, int32_t);
+using Entry5 = int32_t (*)(NativeState*, int32_t, int32_t, int32_t, int32_t, int32_t);
+
+// Условия переходов и инструкций setcc
+enum Condition : uint8_t {
+    BELOW = 0x2,
+    EQUAL = 0x4,
+    NOT_EQUAL = 0x5,
+    ABOVE = 0x7,
+    LESS = 0xC,
+    GREATER_EQUAL = 0xD,
+    LESS_EQUAL = 0xE,
+    GREATER = 0xF,
+};
+
+// Метод не может быть скомпилирован
+class UnsupportedMethod : public runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+// Машинный код в страницах, доступных только для чтения и выполнения
+class ExecutableMemory {
+public:
+    explicit ExecutableMemory(const vector<uint8_t>& code)
+        : size_(RoundToPages(code.size())) {
+        data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data_ == MAP_FAILED) {
+            throw runtime_error("Can't allocate memory for native code"s);
+        }
+        memcpy(data_, code.data(), code.size());
+        if (mprotect(data_, size_, PROT_READ | PROT_EXEC) != 0) {
+            munmap(data_, size_);
+            throw runtime_error("Can't make native code executable"s);
+        }
+    }
+
+    ExecutableMemory(const ExecutableMemory&) = delete;
+    ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+
+    ~ExecutableMemory() {
+        munmap(data_, size_);
+    }
+
+    [[nodiscard]] const uint8_t* GetData() const {
+        return static_cast<const uint8_t*>(data_);
+    }
+
+private:
+    static size_t RoundToPages(size_t size) {
+        const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return max<size_t>((size + page - 1) / page, 1) * page;
+    }
+
+    size_t size_;
+    void* data_ = nullptr;
+};
+
+enum class ValueType {
+    Unknown,
+    Int,
+    Bool,
+};
+
+// Код метода, созданный JIT-компилятором. Если entry равен nullptr, метод не компилируется
+struct NativeMethod : runtime::MethodCode {
+    // Память с кодом разделяют все методы, скомпилированные вместе
+    shared_ptr<const ExecutableMemory> memory;
+    const uint8_t* entry = nullptr;
+    // Класс экземпляров, для которых создан код: вызовы методов self в нём уже разрешены
+    const Class* receiver = nullptr;
+    ValueType result = ValueType::Unknown;
+    // Причина, по которой метод не компилируется
+    string rejection;
+
+    template <typename Entry>
+    [[nodiscard]] Entry As() const {
+        return reinterpret_cast<Entry>(reinterpret_cast<uintptr_t>(entry));
+    }
+};
+
+// Формирует машинный код x86-64. Переходы на метки, которые ещё не привязаны,
+// исправляются при привязке
+class Assembler {
+public:
+    size_t NewLabel() {
+        labels_.emplace_back();
+        return labels_.size() - 1;
+    }
+
+    void Bind(size_t label) {
+        Label& l = labels_[label];
+        l.position = code_.size();
+        for (const size_t fixup : l.fixups) {
+            Patch32(fixup, static_cast<int32_t>(code_.size() - (fixup + 4)));
+        }
+        l.fixups.clear();
+    }
+
+    void Bytes(initializer_list<uint8_t> bytes) {
+        code_.insert(code_.end(), bytes);
+    }
+
+    void Imm32(int32_t value) {
+        const auto u = static_cast<uint32_t>(value);
+        Bytes({static_cast<uint8_t>(u), static_cast<uint8_t>(u >> 8),
+               static_cast<uint8_t>(u >> 16), static_cast<uint8_t>(u >> 24)});
+    }
+
+    void Patch32(size_t position, int32_t value) {
+        const auto u = static_cast<uint32_t>(value);
+        for (int i = 0; i < 4; ++i) {
+            code_[position + i] = static_cast<uint8_t>(u >> (8 * i));
+        }
+    }
+
+    // jmp label
+    void Jump(size_t label) {
+        Bytes({0xE9});
+        Target(label);
+    }
+
+    // jcc label
+    void JumpIf(Condition condition, size_t label) {
+        Bytes({0x0F, static_cast<uint8_t>(0x80 | condition)});
+        Target(label);
+    }
+
+    // call label
+    void Call(size_t label) {
+        Bytes({0xE8});
+        Target(label);
+    }
+
+    // mov eax, value
+    void MovEax(int32_t value) {
+        Bytes({0xB8});
+        Imm32(value);
+    }
+
+    // mov eax, [rbp + offset]
+    void LoadEax(int32_t offset) {
+        Bytes({0x8B, 0x85});
+        Imm32(offset);
+    }
+
+    // mov [rbp + offset], reg
+    void Store(int32_t offset, Register reg) {
+        if (reg >= R8D) {
+            Bytes({0x44});
+        }
+        Bytes({0x89, static_cast<uint8_t>(0x85 | ((reg & 7) << 3))});
+        Imm32(offset);
+    }
+
+    // pop reg (64-битный регистр, соответствующий reg)
+    void Pop(Register reg) {
+        if (reg >= R8D) {
+            Bytes({0x41});
+        }
+        Bytes({static_cast<uint8_t>(0x58 | (reg & 7))});
+    }
+
+    // setcc al; movzx eax, al
+    void SetEax(Condition condition) {
+        Bytes({0x0F, static_cast<uint8_t>(0x90 | condition), 0xC0, 0x0F, 0xB6, 0xC0});
+    }
+
+    [[nodiscard]] size_t GetSize() const {
+        return code_.size();
+    }
+
+    [[nodiscard]] const vector<uint8_t>& GetCode() const {
+        return code_;
+    }
+
+private:
+    struct Label {
+        optional<size_t> position;
+        vector<size_t> fixups;
+    };
+
+    void Target(size_t label) {
+        Label& l = labels_[label];
+        if (l.position) {
+            Imm32(static_cast<int32_t>(*l.position - (code_.size() + 4)));
+        } else {
+            l.fixups.push_back(code_.size());
+            Imm32(0);
+        }
+    }
+
+    vector<uint8_t> code_;
+    vector<Label> labels_;
+};
+
+// Метод, компилируемый в составе единицы компиляции
+struct Function {
+    const Method* method = nullptr;
+    ValueType result = ValueType::Unknown;
+    // Типы параметров и локальных переменных
+    unordered_map<string, ValueType> variable_types;
+    // Метка начала кода функции
+    size_t label = 0;
+    size_t offset = 0;
+};
+
+class UnitCompiler;
+
+/*
+ * Переводит тело одного метода в машинный код. Значение выражения вычисляется в eax,
+ * промежуточные значения сохраняются в стеке. Параметры и локальные переменные
+ * хранятся в ячейках кадра [rbp - 16 - 8 * i], в rbx - указатель на NativeState.
+ * В режиме вывода типов код формируется во временном буфере, а неизвестные
+ * типы значений допускаются
+ */
+class FunctionCompiler {
+public:
+    FunctionCompiler(UnitCompiler& unit, Function& function, Assembler& assembler, bool emit)
+        : unit_(unit)
+        , function_(function)
+        , as_(assembler)
+        , emit_(emit)
+        , bail_(as_.NewLabel())
+        , exit_(as_.NewLabel()) {
+    }
+
+    void Compile();
+
+private:
+    using Names = unordered_set<string>;
+
+    void CompileStatement(const runtime::Executable& statement, Names& assigned);
+    ValueType CompileExpression(const runtime::Executable& expression, const Names& assigned);
+    ValueType CompileCall(const ast::MethodCall& call, const Names& assigned);
+    // Вычисляет lhs в eax и rhs в ecx
+    void CompileOperands(const ast::BinaryOperation& operation, const Names& assigned,
+                         ValueType lhs_type, ValueType rhs_type);
+    void ExpectType(ValueType actual, ValueType expected) const;
+    void SetVariableType(const string& name, ValueType type);
+    int32_t GetSlot(const string& name);
+
+    UnitCompiler& unit_;
+    Function& function_;
+    Assembler& as_;
+    bool emit_;
+    size_t bail_;
+    size_t exit_;
+    unordered_map<string, size_t> slots_;
+};
+
+// Компилирует метод вместе с методами, которые он вызывает у self, в общий буфер
+class UnitCompiler {
+public:
+    explicit UnitCompiler(const Class& cls)
+        : cls_(cls) {
+    }
+
+    // Если какой-либо из методов не поддерживается, выбрасывает UnsupportedMethod
+    void Compile(const Method& root) {
+        GetFunction(root);
+        // Типы результатов методов уточняются, пока не перестанут меняться.
+        // Каждый проход только уточняет неизвестные типы либо добавляет методы, поэтому
+        // число проходов ограничено
+        do {
+            changed_ = false;
+            for (size_t i = 0; i < functions_.size(); ++i) {
+                Assembler scratch;
+                FunctionCompiler(*this, functions_[i], scratch, false).Compile();
+            }
+        } while (changed_);
+
+        for (auto& function : functions_) {
+            function.label = assembler_.NewLabel();
+        }
+        for (auto& function : functions_) {
+            function.offset = assembler_.GetSize();
+            FunctionCompiler(*this, function, assembler_, true).Compile();
+        }
+    }
+
+    // Возвращает функцию для метода, добавляя её при первом обращении
+    Function& GetFunction(const Method& method) {
+        if (const auto it = index_.find(&method); it != index_.end()) {
+            return functions_[it->second];
+        }
+        if (method.formal_params.size() > MAX_NATIVE_PARAMS) {
+            throw UnsupportedMethod("Too many parameters in "s + method.name);
+        }
+        index_[&method] = functions_.size();
+        Function& function = functions_.emplace_back();
+        function.method = &method;
+        for (const auto& param : method.formal_params) {
+            function.variable_types[param] = ValueType::Int;
+        }
+        changed_ = true;
+        return function;
+    }
+
+    void MarkChanged() {
+        changed_ = true;
+    }
+
+    [[nodiscard]] const Class& GetClass() const {
+        return cls_;
+    }
+
+    [[nodiscard]] const deque<Function>& GetFunctions() const {
+        return functions_;
+    }
+
+    [[nodiscard]] const vector<uint8_t>& GetCode() const {
+        return assembler_.GetCode();
+    }
+
+private:
+    const Class& cls_;
+    deque<Function> functions_;
+    unordered_map<const Method*, size_t> index_;
+    Assembler assembler_;
+    bool changed_ = false;
+};
+
+void FunctionCompiler::Compile() {
+    const Method& method = *function_.method;
+    if (emit_) {
+        as_.Bind(function_.label);
+    }
+    // push rbp; mov rbp, rsp; push rbx; sub rsp, <размер кадра>
+    as_.Bytes({0x55, 0x48, 0x89, 0xE5, 0x53, 0x48, 0x81, 0xEC});
+    const size_t frame_size_position = as_.GetSize();
+    as_.Imm32(0);
+    // mov rbx, rdi; inc dword [rbx + depth]; mov eax, [rbx + depth]; cmp eax, [rbx + max_depth]
+    as_.Bytes({0x48, 0x89, 0xFB, 0xFF, 0x43, DEPTH_OFFSET, 0x8B, 0x43, DEPTH_OFFSET, 0x3B, 0x43,
+               MAX_DEPTH_OFFSET});
+    as_.JumpIf(ABOVE, bail_);
+    // cmp rsp, [rbx + stack_limit]
+    as_.Bytes({0x48, 0x3B, 0x63, STACK_LIMIT_OFFSET});
+    as_.JumpIf(BELOW, bail_);
+
+    Names assigned;
+    for (size_t i = 0; i < method.formal_params.size(); ++i) {
+        as_.Store(GetSlot(method.formal_params[i]), PARAM_REGISTERS[i]);
+        assigned.insert(method.formal_params[i]);
+    }
+    CompileStatement(ast::GetMethodBody(method), assigned);
+    // Выход из метода без return возвращает None
+    as_.Jump(bail_);
+
+    as_.Bind(bail_);
+    // mov byte [rbx + bailout], 1; xor eax, eax
+    as_.Bytes({0xC6, 0x43, BAILOUT_OFFSET, 0x01, 0x31, 0xC0});
+    as_.Bind(exit_);
+    // dec dword [rbx + depth]; mov rbx, [rbp - 8]; leave; ret
+    as_.Bytes({0xFF, 0x4B, DEPTH_OFFSET, 0x48, 0x8B, 0x5D, 0xF8, 0xC9, 0xC3});
+
+    as_.Patch32(frame_size_position, static_cast<int32_t>((slots_.size() * 8 + 15) / 16 * 16));
+
+    if (emit_ && function_.result == ValueType::Unknown) {
+        throw UnsupportedMethod("Can't infer result type of "s + method.name);
+    }
+}
+
+void FunctionCompiler::CompileStatement(const runtime::Executable& statement, Names& assigned) {
+    if (const auto* body = dynamic_cast<const ast::MethodBody*>(&statement)) {
+        CompileStatement(*body->GetBody(), assigned);
+    } else if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+        for (const auto& s : compound->GetStatements()) {
+            CompileStatement(*s, assigned);
+        }
+    } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+        const ValueType type = CompileExpression(*assignment->GetValue(), assigned);
+        SetVariableType(assignment->GetVar(), type);
+        as_.Store(GetSlot(assignment->GetVar()), EAX);
+        assigned.insert(assignment->GetVar());
+    } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+        CompileExpression(*if_else->GetCondition(), assigned);
+        const size_t else_label = as_.NewLabel();
+        const size_t end_label = as_.NewLabel();
+        // test eax, eax
+        as_.Bytes({0x85, 0xC0});
+        as_.JumpIf(EQUAL, else_label);
+        Names if_assigned = assigned;
+        CompileStatement(*if_else->GetIfBody(), if_assigned);
+        as_.Jump(end_label);
+        as_.Bind(else_label);
+        if (if_else->GetElseBody()) {
+            Names else_assigned = assigned;
+            CompileStatement(*if_else->GetElseBody(), else_assigned);
+            // После if/else определены переменные, присвоенные в обеих ветках
+            for (const auto& name : if_assigned) {
+                if (else_assigned.count(name) > 0) {
+                    assigned.insert(name);
+                }
+            }
+        }
+        as_.Bind(end_label);
+    } else if (const auto* ret = dynamic_cast<const ast::Return*>(&statement)) {
+        const ValueType type = CompileExpression(*ret->GetStatement(), assigned);
+        if (type != ValueType::Unknown && function_.result != type) {
+            if (function_.result != ValueType::Unknown) {
+                throw UnsupportedMethod("Different result types in "s + function_.method->name);
+            }
+            function_.result = type;
+            unit_.MarkChanged();
+        }
+        as_.Jump(exit_);
+    } else {
+        CompileExpression(statement, assigned);
+    }
+}
+
+ValueType FunctionCompiler::CompileExpression(const runtime::Executable& expression,
+                                              const Names& assigned) {
+    using CompareFunction = bool (*)(const ObjectHolder&, const ObjectHolder&, runtime::Context&);
+
+    if (const auto* number = dynamic_cast<const ast::NumericConst*>(&expression)) {
+        as_.MovEax(number->GetValue().GetValue());
+        return ValueType::Int;
+    }
+    if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&expression)) {
+        as_.MovEax(boolean->GetValue().GetValue() ? 1 : 0);
+        return ValueType::Bool;
+    }
+    if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&expression)) {
+        const auto& ids = variable->GetDottedIds();
+        if (ids.size() != 1 || assigned.count(ids.front()) == 0) {
+            throw UnsupportedMethod("Unsupported variable "s + ids.front());
+        }
+        as_.LoadEax(GetSlot(ids.front()));
+        const ValueType type = function_.variable_types[ids.front()];
+        if (emit_ && type == ValueType::Unknown) {
+            throw UnsupportedMethod("Can't infer type of "s + ids.front());
+        }
+        return type;
+    }
+    if (const auto* add = dynamic_cast<const ast::Add*>(&expression)) {
+        CompileOperands(*add, assigned, ValueType::Int, ValueType::Int);
+        // add eax, ecx
+        as_.Bytes({0x01, 0xC8});
+        return ValueType::Int;
+    }
+    if (const auto* sub = dynamic_cast<const ast::Sub*>(&expression)) {
+        CompileOperands(*sub, assigned, ValueType::Int, ValueType::Int);
+        // sub eax, ecx
+        as_.Bytes({0x29, 0xC8});
+        return ValueType::Int;
+    }
+    if (const auto* mult = dynamic_cast<const ast::Mult*>(&expression)) {
+        CompileOperands(*mult, assigned, ValueType::Int, ValueType::Int);
+        // imul eax, ecx
+        as_.Bytes({0x0F, 0xAF, 0xC1});
+        return ValueType::Int;
+    }
+    if (const auto* div = dynamic_cast<const ast::Div*>(&expression)) {
+        CompileOperands(*div, assigned, ValueType::Int, ValueType::Int);
+        const size_t divide = as_.NewLabel();
+        const size_t done = as_.NewLabel();
+        // Деление на ноль обрабатывает обход дерева.
+        // test ecx, ecx; cmp ecx, -1
+        as_.Bytes({0x85, 0xC9});
+        as_.JumpIf(EQUAL, bail_);
+        as_.Bytes({0x83, 0xF9, 0xFF});
+        as_.JumpIf(NOT_EQUAL, divide);
+        // Деление на -1 заменяется сменой знака, чтобы INT_MIN / -1 не вызывало исключение
+        // процессора. neg eax
+        as_.Bytes({0xF7, 0xD8});
+        as_.Jump(done);
+        as_.Bind(divide);
+        // cdq; idiv ecx
+        as_.Bytes({0x99, 0xF7, 0xF9});
+        as_.Bind(done);
+        return ValueType::Int;
+    }
+    if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&expression)) {
+        const auto* compare = comparison->GetComparator().target<CompareFunction>();
+        if (compare == nullptr) {
+            throw UnsupportedMethod("Unknown comparison"s);
+        }
+        Condition condition = EQUAL;
+        if (*compare == &runtime::Less) {
+            condition = LESS;
+        } else if (*compare == &runtime::Greater) {
+            condition = GREATER;
+        } else if (*compare == &runtime::Equal) {
+            condition = EQUAL;
+        } else if (*compare == &runtime::NotEqual) {
+            condition = NOT_EQUAL;
+        } else if (*compare == &runtime::LessOrEqual) {
+            condition = LESS_EQUAL;
+        } else if (*compare == &runtime::GreaterOrEqual) {
+            condition = GREATER_EQUAL;
+        } else {
+            throw UnsupportedMethod("Unknown comparison"s);
+        }
+        CompileOperands(*comparison, assigned, ValueType::Unknown, ValueType::Unknown);
+        // cmp eax, ecx
+        as_.Bytes({0x39, 0xC8});
+        as_.SetEax(condition);
+        return ValueType::Bool;
+    }
+    if (const auto* negation = dynamic_cast<const ast::Not*>(&expression)) {
+        CompileExpression(*negation->GetArg(), assigned);
+        // test eax, eax
+        as_.Bytes({0x85, 0xC0});
+        as_.SetEax(EQUAL);
+        return ValueType::Bool;
+    }
+    const bool is_and = dynamic_cast<const ast::And*>(&expression) != nullptr;
+    if (is_and || dynamic_cast<const ast::Or*>(&expression) != nullptr) {
+        // Результат and и or - значение одного из аргументов, поэтому их типы должны совпадать
+        const auto& operation = static_cast<const ast::BinaryOperation&>(expression);
+        const ValueType lhs = CompileExpression(*operation.GetLhs(), assigned);
+        const size_t done = as_.NewLabel();
+        // test eax, eax
+        as_.Bytes({0x85, 0xC0});
+        as_.JumpIf(is_and ? EQUAL : NOT_EQUAL, done);
+        const ValueType rhs = CompileExpression(*operation.GetRhs(), assigned);
+        as_.Bind(done);
+        if (lhs == ValueType::Unknown || rhs == ValueType::Unknown) {
+            return ValueType::Unknown;
+        }
+        ExpectType(rhs, lhs);
+        return lhs;
+    }
+    if (const auto* call = dynamic_cast<const ast::MethodCall*>(&expression)) {
+        return CompileCall(*call, assigned);
+    }
+    throw UnsupportedMethod("Unsupported statement in "s + function_.method->name);
+}
+
+ValueType FunctionCompiler::CompileCall(const ast::MethodCall& call, const Names& assigned) {
+    const auto* object = dynamic_cast<const ast::VariableValue*>(call.GetObject().get());
+    if (object == nullptr || object->GetDottedIds() != vector{"self"s}) {
+        throw UnsupportedMethod("Only methods of self can be called"s);
+    }
+    const Method* callee = unit_.GetClass().GetMethod(call.GetMethod());
+    if (callee == nullptr || callee->formal_params.size() != call.GetArgs().size()) {
+        throw UnsupportedMethod("Unknown method "s + call.GetMethod());
+    }
+    const Function& function = unit_.GetFunction(*callee);
+
+    for (const auto& arg : call.GetArgs()) {
+        ExpectType(CompileExpression(*arg, assigned), ValueType::Int);
+        // push rax
+        as_.Bytes({0x50});
+    }
+    for (size_t i = call.GetArgs().size(); i > 0; --i) {
+        as_.Pop(PARAM_REGISTERS[i - 1]);
+    }
+    if (emit_) {
+        // mov rdi, rbx
+        as_.Bytes({0x48, 0x89, 0xDF});
+        as_.Call(function.label);
+        // Если вызванный метод прекратил работу, текущий тоже прекращает её.
+        // cmp byte [rbx + bailout], 0
+        as_.Bytes({0x80, 0x7B, BAILOUT_OFFSET, 0x00});
+        as_.JumpIf(NOT_EQUAL, exit_);
+    }
+    if (emit_ && function.result == ValueType::Unknown) {
+        throw UnsupportedMethod("Can't infer result type of "s + callee->name);
+    }
+    return function.result;
+}
+
+void FunctionCompiler::CompileOperands(const ast::BinaryOperation& operation,
+                                       const Names& assigned, ValueType lhs_type,
+                                       ValueType rhs_type) {
+    const ValueType lhs = CompileExpression(*operation.GetLhs(), assigned);
+    ExpectType(lhs, lhs_type);
+    // push rax
+    as_.Bytes({0x50});
+    const ValueType rhs = CompileExpression(*operation.GetRhs(), assigned);
+    ExpectType(rhs, rhs_type == ValueType::Unknown ? lhs : rhs_type);
+    // mov ecx, eax; pop rax
+    as_.Bytes({0x89, 0xC1, 0x58});
+}
+
+void FunctionCompiler::ExpectType(ValueType actual, ValueType expected) const {
+    if (actual != ValueType::Unknown && expected != ValueType::Unknown && actual != expected) {
+        throw UnsupportedMethod("Type mismatch in "s + function_.method->name);
+    }
+}
+
+void FunctionCompiler::SetVariableType(const string& name, ValueType type) {
+    if (name == "self"sv) {
+        throw UnsupportedMethod("Assignment to self"s);
+    }
+    ValueType& current = function_.variable_types[name];
+    if (type == ValueType::Unknown || current == type) {
+        return;
+    }
+    if (current != ValueType::Unknown) {
+        throw UnsupportedMethod("Variable "s + name + " changes its type"s);
+    }
+    current = type;
+    unit_.MarkChanged();
+}
+
+int32_t FunctionCompiler::GetSlot(const string& name) {
+    const auto [it, inserted] = slots_.emplace(name, slots_.size());
+    return -16 - static_cast<int32_t>(it->second * 8);
+}
+
+// Отключает ускоритель вызовов контекста на время своего существования
+class AcceleratorPause {
+public:
+    explicit AcceleratorPause(runtime::Context& context)
+        : context_(context)
+        , accelerator_(context.GetCallAccelerator()) {
+        context_.SetCallAccelerator(nullptr);
+    }
+
+    AcceleratorPause(const AcceleratorPause&) = delete;
+    AcceleratorPause& operator=(const AcceleratorPause&) = delete;
+
+    ~AcceleratorPause() {
+        context_.SetCallAccelerator(accelerator_);
+    }
+
+private:
+    runtime::Context& context_;
+    runtime::CallAccelerator* accelerator_;
+};
+
+bool SameValue(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+    if (const auto* l = lhs.TryAs<runtime::Number>()) {
+        const auto* r = rhs.TryAs<runtime::Number>();
+        return r != nullptr && l->GetValue() == r->GetValue();
+    }
+    if (const auto* l = lhs.TryAs<runtime::Bool>()) {
+        const auto* r = rhs.TryAs<runtime::Bool>();
+        return r != nullptr && l->GetValue() == r->GetValue();
+    }
+    return false;
+}
+
+string Describe(const ObjectHolder& value) {
+    if (!value) {
+        return "None"s;
+    }
+    runtime::DummyContext context;
+    ostringstream out;
+    value->Print(out, context);
+    return out.str();
+}
+
+}  // namespace
+
+bool IsSupported() noexcept {
+#if defined(__x86_64__) && defined(__linux__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IsCompiled(const runtime::Method& method) noexcept {
+    const auto* native =
+        dynamic_cast<const NativeMethod*>(method.runtime_data.GetCode(CodeKind::Native));
+    return native != nullptr && native->entry != nullptr;
+}
+
+MethodJit::MethodJit(JitOptions options)
+    : options_(options) {
+}
+
+optional<ObjectHolder> MethodJit::TryCall(runtime::ClassInstance& self, const Method& method,
+                                          const vector<ObjectHolder>& args,
+                                          runtime::Context& context) {
+    // Машинный код не расходует шаги бюджета
+    if (context.GetBudget() != nullptr) {
+        return nullopt;
+    }
+    const runtime::MethodCode* code = method.runtime_data.GetCode(CodeKind::Native);
+    if (code == nullptr) {
+        if (method.runtime_data.GetCallCount() < options_.threshold) {
+            return nullopt;
+        }
+        Compile(self.GetClass(), method);
+        code = method.runtime_data.GetCode(CodeKind::Native);
+    }
+    const auto* native = dynamic_cast<const NativeMethod*>(code);
+    if (native == nullptr || native->entry == nullptr || native->receiver != &self.GetClass()) {
+        return nullopt;
+    }
+
+    int32_t values[MAX_NATIVE_PARAMS] = {};
+    for (size_t i = 0; i < args.size(); ++i) {
+        const auto* number = args[i].TryAs<runtime::Number>();
+        if (number == nullptr) {
+            return nullopt;
+        }
+        values[i] = number->GetValue();
+    }
+
+    NativeState state;
+    state.max_depth = options_.max_native_depth;
+    if (const size_t max_depth = context.GetMaxCallDepth(); max_depth != 0) {
+        // Текущий вызов уже учтён в глубине вызовов контекста и соответствует глубине 1
+        const size_t left = max_depth - min(max_depth, context.GetCallDepth()) + 1;
+        state.max_depth = static_cast<uint32_t>(min<size_t>(state.max_depth, left));
+    }
+    state.stack_limit = context.GetStackLimit();
+
+    int32_t value = 0;
+    switch (args.size()) {
+        case 0:
+            value = native->As<Entry0>()(&state);
+            break;
+        case 1:
+            value = native->As<Entry1>()(&state, values[0]);
+            break;
+        case 2:
+            value = native->As<Entry2>()(&state, values[0], values[1]);
+            break;
+        case 3:
+            value = native->As<Entry3>()(&state, values[0], values[1], values[2]);
+            break;
+        case 4:
+            value = native->As<Entry4>()(&state, values[0], values[1], values[2], values[3]);
+            break;
+        default:
+            value = native->As<Entry5>()(&state, values[0], values[1], values[2], values[3],
+                                         values[4]);
+            break;
+    }
+    if (state.bailout != 0) {
+        bailouts_.fetch_add(1, memory_order_relaxed);
+        return nullopt;
+    }
+    native_calls_.fetch_add(1, memory_order_relaxed);
+
+    ObjectHolder result = native->result == ValueType::Bool
+                              ? ObjectHolder::Own(runtime::Bool{value != 0})
+                              : ObjectHolder::Own(runtime::Number{value});
+    if (options_.cross_check) {
+        CrossCheck(self, method, args, context, result);
+    }
+    return result;
+}
+
+JitStats MethodJit::GetStats() const {
+    JitStats stats;
+    stats.compiled_methods = compiled_methods_.load(memory_order_relaxed);
+    stats.rejected_methods = rejected_methods_.load(memory_order_relaxed);
+    stats.code_bytes = code_bytes_.load(memory_order_relaxed);
+    stats.native_calls = native_calls_.load(memory_order_relaxed);
+    stats.bailouts = bailouts_.load(memory_order_relaxed);
+    return stats;
+}
+
+CompileResult MethodJit::Compile(const Class& cls, const Method& method) {
+    // Код принадлежит методам, а не компилятору, поэтому компиляция общая для всех
+    // экземпляров MethodJit
+    static mutex compile_mutex;
+    lock_guard lock(compile_mutex);
+    CompileResult result;
+    if (method.runtime_data.GetCode(CodeKind::Native) != nullptr) {
+        return result;
+    }
+
+    try {
+        if (!IsSupported()) {
+            throw UnsupportedMethod("Platform is not supported"s);
+        }
+        UnitCompiler unit(cls);
+        unit.Compile(method);
+        auto memory = make_shared<const ExecutableMemory>(unit.GetCode());
+        code_bytes_.fetch_add(unit.GetCode().size(), memory_order_relaxed);
+        for (const Function& function : unit.GetFunctions()) {
+            // Метод, уже скомпилированный для другого класса, сохраняет свой код
+            if (function.method->runtime_data.GetCode(CodeKind::Native) != nullptr) {
+                continue;
+            }
+            auto native = make_unique<NativeMethod>();
+            native->memory = memory;
+            native->entry = memory->GetData() + function.offset;
+            native->receiver = &cls;
+            native->result = function.result;
+            function.method->runtime_data.SetCode(CodeKind::Native, std::move(native));
+            compiled_methods_.fetch_add(1, memory_order_relaxed);
+            result.compiled.push_back(function.method);
+        }
+    } catch (const runtime_error& e) {
+        rejected_methods_.fetch_add(1, memory_order_relaxed);
+        auto rejected = make_unique<NativeMethod>();
+        rejected->receiver = &cls;
+        rejected->rejection = e.what();
+        method.runtime_data.SetCode(CodeKind::Native, std::move(rejected));
+        result.rejection = e.what();
+    }
+    return result;
+}
+
+void MethodJit::CrossCheck(runtime::ClassInstance& self, const Method& method,
+                           const vector<ObjectHolder>& args, runtime::Context& context,
+                           const ObjectHolder& native_result) const {
+    runtime::Closure closure;
+    closure["self"s] = ObjectHolder::Share(self);
+    for (size_t i = 0; i < args.size(); ++i) {
+        closure[method.formal_params[i]] = args[i];
+    }
+    ObjectHolder expected;
+    {
+        // Вложенные вызовы тоже выполняются обходом дерева
+        AcceleratorPause pause(context);
+        expected = method.body->Execute(closure, context);
+    }
+    if (!SameValue(native_result, expected)) {
+        throw JitMismatch(self.GetClass().GetName() + "."s + method.name + " returned "s
+                          + Describe(native_result) + " in native code and "s
+                          + Describe(expected) + " in tree-walker"s);
+    }
+}
+
+}  // namespace jit
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace jit {
+
+    // Параметры JIT-компилятора
+    struct JitOptions {
+        // Число вызовов метода, после которого метод компилируется
+        std::uint64_t threshold = 1000;
+        // Режим проверки: каждый вызов скомпилированного метода повторяется обходом дерева,
+        // и при расхождении результатов выбрасывается JitMismatch
+        bool cross_check = false;
+        // Наибольшая глубина вложенных вызовов внутри машинного кода. Более глубокие вызовы
+        // выполняются обходом дерева
+        std::uint32_t max_native_depth = 10000;
+    };
+
+    // Результат машинного кода разошёлся с результатом обхода дерева
+    class JitMismatch : public std::logic_error {
+    public:
+        using std::logic_error::logic_error;
+    };
+
+    // Статистика JIT-компилятора
+    struct JitStats {
+        // Методов, для которых создан машинный код
+        std::uint64_t compiled_methods = 0;
+        // Методов, которые не удалось скомпилировать
+        std::uint64_t rejected_methods = 0;
+        // Объём созданного машинного кода, байт
+        std::uint64_t code_bytes = 0;
+        // Вызовов, выполненных машинным кодом
+        std::uint64_t native_calls = 0;
+        // Вызовов, которые машинный код вернул для выполнения обходом дерева
+        std::uint64_t bailouts = 0;
+    };
+
+    // Результат компиляции метода
+    struct CompileResult {
+        // Методы, для которых создан машинный код: сам метод и вызываемые им методы self
+        std::vector<const runtime::Method*> compiled;
+        // Причина, по которой метод не скомпилирован, либо пустая строка
+        std::string rejection;
+    };
+
+    // Возвращает true, если JIT-компилятор поддерживает текущую платформу (Linux x86-64)
+    [[nodiscard]] bool IsSupported() noexcept;
+
+    // Возвращает true, если для метода method создан машинный код
+    [[nodiscard]] bool IsCompiled(const runtime::Method& method) noexcept;
+
+    /*
+     * Шаблонный JIT-компилятор методов Mython для x86-64.
+     *
+     * Когда число вызовов метода достигает JitOptions::threshold, тело метода вместе со всеми
+     * методами, которые оно вызывает у self, переводится в машинный код: каждый узел дерева
+     * заменяется фиксированной последовательностью инструкций. Код размещается в страницах,
+     * выделенных mmap и доступных только для чтения и выполнения, и принадлежит методу.
+     *
+     * Компилируются методы, которые работают только с целыми числами и логическими значениями:
+     * параметры-числа, локальные переменные, арифметика, сравнения, and, or, not, if/else,
+     * return и вызовы методов self. Значения в машинном коде не упаковываются в объекты.
+     * Остальные методы, а также вызовы с параметрами других типов, вызовы у экземпляров
+     * других классов и запуски с бюджетом выполнения обрабатываются обходом дерева.
+     *
+     * Такие методы не имеют видимых действий, поэтому при делении на ноль, превышении глубины
+     * вызовов либо выходе из метода без return машинный код прекращает работу, и метод
+     * целиком выполняется заново обходом дерева, который сообщит об ошибке обычным образом.
+     *
+     * Машинный код не обновляет теневой стек вызовов, поэтому семплирующий профилировщик
+     * видит только внешний вызов скомпилированного метода.
+     * Один компилятор может использоваться одновременно из нескольких потоков
+     */
+    class MethodJit : public runtime::CallAccelerator {
+    public:
+        explicit MethodJit(JitOptions options = {});
+
+        std::optional<runtime::ObjectHolder> TryCall(runtime::ClassInstance& self,
+            const runtime::Method& method, const std::vector<runtime::ObjectHolder>& args,
+            runtime::Context& context) override;
+
+        // Компилирует метод method для экземпляров класса cls независимо от числа вызовов.
+        // Если код метода уже создан либо метод уже отклонён, ничего не делает
+        CompileResult Compile(const runtime::Class& cls, const runtime::Method& method);
+
+        [[nodiscard]] JitStats GetStats() const;
+
+    private:
+        void CrossCheck(runtime::ClassInstance& self, const runtime::Method& method,
+            const std::vector<runtime::ObjectHolder>& args, runtime::Context& context,
+            const runtime::ObjectHolder& native_result) const;
+
+        JitOptions options_;
+        std::atomic<std::uint64_t> compiled_methods_ = 0;
+        std::atomic<std::uint64_t> rejected_methods_ = 0;
+        std::atomic<std::uint64_t> code_bytes_ = 0;
+        std::atomic<std::uint64_t> native_calls_ = 0;
+        std::atomic<std::uint64_t> bailouts_ = 0;
+    };
+
+}  // namespace jit
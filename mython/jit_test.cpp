@@ -0,0 +1,275 @@
+#include "jit.h"
+#include "program.h"
+#include "test_runner_p.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace jit {
+
+namespace {
+
+const string MATH_PROGRAM = R"(
+class Math:
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+  def gcd(a, b):
+    if b == 0:
+      return a
+    return self.gcd(b, a - a / b * b)
+
+  def is_even(n):
+    if n == 0:
+      return True
+    return self.is_odd(n - 1)
+
+  def is_odd(n):
+    if n == 0:
+      return False
+    return self.is_even(n - 1)
+
+  def clamp(x, lo, hi):
+    result = x
+    if x < lo:
+      result = lo
+    if x > hi:
+      result = hi
+    return result
+
+  def logic(a, b):
+    return not (a > b and b > 0) or a == b
+
+m = Math()
+print m.fib(15), m.gcd(1071, 462), m.is_even(10), m.is_odd(7)
+print m.clamp(5, 0, 3), m.clamp(-5, 0, 3), m.clamp(2, 0, 3)
+print m.logic(3, 1), m.logic(1, 3), m.logic(2, 2), m.logic(5, -1)
+)"s;
+
+const string MATH_OUTPUT = "610 21 True True\n3 0 2\nFalse True True True\n"s;
+
+string Run(const string& source, MethodJit* method_jit) {
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    runtime::DummyContext context;
+    context.SetCallAccelerator(method_jit);
+    program.Run(context);
+    return context.output.str();
+}
+
+JitOptions EagerOptions() {
+    JitOptions options;
+    options.threshold = 1;
+    options.cross_check = true;
+    return options;
+}
+
+void TestCompiledMethodsMatchTreeWalker() {
+    ASSERT_EQUAL(Run(MATH_PROGRAM, nullptr), MATH_OUTPUT);
+
+    MethodJit method_jit(EagerOptions());
+    ASSERT_EQUAL(Run(MATH_PROGRAM, &method_jit), MATH_OUTPUT);
+    if (IsSupported()) {
+        const JitStats stats = method_jit.GetStats();
+        ASSERT_EQUAL(stats.compiled_methods, 6U);
+        ASSERT_EQUAL(stats.rejected_methods, 0U);
+        ASSERT(stats.native_calls >= 11);
+        ASSERT(stats.code_bytes > 0);
+    }
+}
+
+void TestCompilesAfterThreshold() {
+    const string source = R"(
+class Counter:
+  def twice(n):
+    return n * 2
+
+c = Counter()
+print c.twice(1), c.twice(2), c.twice(3), c.twice(4)
+)"s;
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+
+    JitOptions options;
+    options.threshold = 3;
+    MethodJit method_jit(options);
+    runtime::DummyContext context;
+    context.SetCallAccelerator(&method_jit);
+    program.Run(context);
+
+    ASSERT_EQUAL(context.output.str(), "2 4 6 8\n"s);
+    if (IsSupported()) {
+        ASSERT_EQUAL(method_jit.GetStats().compiled_methods, 1U);
+        ASSERT_EQUAL(method_jit.GetStats().native_calls, 2U);
+    }
+}
+
+void TestUnsupportedMethodsUseTreeWalker() {
+    const string source = R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+  def shifted(dx):
+    return self.x + dx
+
+  def describe(n):
+    print 'n =', n
+    return str(n)
+
+  def concat(a, b):
+    return a + b
+
+p = Point(10)
+print p.shifted(5), p.describe(3), p.concat('a', 'b')
+)"s;
+    MethodJit method_jit(EagerOptions());
+    ASSERT_EQUAL(Run(source, &method_jit), "15n = 3\n 3 ab\n"s);
+    // concat компилируется в расчёте на числа, но со строками выполняется обходом дерева
+    if (IsSupported()) {
+        ASSERT_EQUAL(method_jit.GetStats().compiled_methods, 1U);
+        ASSERT_EQUAL(method_jit.GetStats().rejected_methods, 3U);
+    }
+    ASSERT_EQUAL(method_jit.GetStats().native_calls, 0U);
+}
+
+void TestBailoutReportsErrorsLikeTreeWalker() {
+    const string source = R"(
+class Calc:
+  def div(a, b):
+    return a / b
+
+  def sign(n):
+    if n > 0:
+      return 1
+    if n < 0:
+      return 0 - 1
+
+c = Calc()
+print c.div(7, -1), c.sign(5)
+print c.sign(0)
+print c.div(1, 0)
+)"s;
+    MethodJit method_jit(EagerOptions());
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    runtime::DummyContext context;
+    context.SetCallAccelerator(&method_jit);
+    ASSERT_THROWS(program.Run(context), runtime_error);
+    ASSERT_EQUAL(context.output.str(), "-7 1\nNone\n"s);
+    if (IsSupported()) {
+        ASSERT_EQUAL(method_jit.GetStats().bailouts, 2U);
+    }
+}
+
+void TestDeepRecursionFallsBackToTreeWalker() {
+    const string source = R"(
+class Sum:
+  def to(n):
+    if n == 0:
+      return 0
+    return n + self.to(n - 1)
+
+s = Sum()
+print s.to(100), s.to(300)
+)"s;
+    JitOptions options = EagerOptions();
+    options.max_native_depth = 200;
+    MethodJit method_jit(options);
+    ASSERT_EQUAL(Run(source, &method_jit), "5050 45150\n"s);
+    if (IsSupported()) {
+        ASSERT(method_jit.GetStats().bailouts > 0);
+    }
+}
+
+void TestOverriddenCalleeUsesTreeWalker() {
+    const string source = R"(
+class Base:
+  def value():
+    return 1
+
+  def twice():
+    return self.value() * 2
+
+class Derived(Base):
+  def value():
+    return 10
+
+b = Base()
+d = Derived()
+print b.twice(), d.twice(), b.twice(), d.twice()
+)"s;
+    MethodJit method_jit(EagerOptions());
+    ASSERT_EQUAL(Run(source, &method_jit), "2 20 2 20\n"s);
+}
+
+void TestBudgetDisablesNativeCode() {
+    istringstream input(MATH_PROGRAM);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    MethodJit method_jit(EagerOptions());
+    runtime::DummyContext context;
+    context.SetCallAccelerator(&method_jit);
+    runtime::ExecutionBudget budget(1000);
+    context.SetBudget(&budget);
+    ASSERT_THROWS(program.Run(context), runtime::StepLimitExceeded);
+    ASSERT_EQUAL(method_jit.GetStats().native_calls, 0U);
+}
+
+void TestNativeCallsRespectContextDepth() {
+    const string source = R"(
+class Down:
+  def go(n):
+    if n == 0:
+      return 0
+    return self.go(n - 1)
+
+d = Down()
+print d.go(10)
+print d.go(100)
+)"s;
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    MethodJit method_jit(EagerOptions());
+    runtime::DummyContext context;
+    context.SetCallAccelerator(&method_jit);
+    context.SetMaxCallDepth(50);
+    ASSERT_THROWS(program.Run(context), runtime::RecursionDepthExceeded);
+    ASSERT_EQUAL(context.output.str(), "0\n"s);
+}
+
+void BenchNativeFib() {
+    const string source = R"(
+class Math:
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+m = Math()
+print m.fib(20)
+)"s;
+    JitOptions options;
+    options.threshold = 1;
+    MethodJit method_jit(options);
+    ASSERT_EQUAL(Run(source, &method_jit), "6765\n"s);
+}
+
+}  // namespace
+
+void RunJitTests(TestRunner& tr) {
+    RUN_TEST(tr, TestCompiledMethodsMatchTreeWalker);
+    RUN_TEST(tr, TestCompilesAfterThreshold);
+    RUN_TEST(tr, TestUnsupportedMethodsUseTreeWalker);
+    RUN_TEST(tr, TestBailoutReportsErrorsLikeTreeWalker);
+    RUN_TEST(tr, TestDeepRecursionFallsBackToTreeWalker);
+    RUN_TEST(tr, TestOverriddenCalleeUsesTreeWalker);
+    RUN_TEST(tr, TestBudgetDisablesNativeCode);
+    RUN_TEST(tr, TestNativeCallsRespectContextDepth);
+    RUN_BENCH(tr, BenchNativeFib);
+}
+
+}  // namespace jit
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <charconv>
+#include <limits>
 #include <unordered_map>
 
 using namespace std;
@@ -26,6 +27,10 @@ namespace parse {
         if (lhs.Is<Id>()) {
             return lhs.As<Id>().value == rhs.As<Id>().value;
         }
+        if (lhs.Is<DeferredBody>()) {
+            return *lhs.As<DeferredBody>().value == *rhs.As<DeferredBody>().value
+                   && lhs.As<DeferredBody>().first_line == rhs.As<DeferredBody>().first_line;
+        }
         return true;
     }
 
@@ -68,6 +73,7 @@ namespace parse {
         UNVALUED_OUTPUT(None);
         UNVALUED_OUTPUT(True);
         UNVALUED_OUTPUT(False);
+        UNVALUED_OUTPUT(DeferredBody);
         UNVALUED_OUTPUT(Eof);
 
 #undef UNVALUED_OUTPUT
@@ -75,25 +81,97 @@ namespace parse {
         return os << "Unknown token :("sv;
     }
 
-    Lexer::Lexer(std::istream& in) {
+    Lexer::Lexer(std::istream& in, const LexerOptions& options) {
         using namespace parse;
         using namespace token_type;
 
         std::string inp_line;
-        while (getline(in, inp_line)) {
+        int line_number = options.first_line - 1;
+        bool has_line = static_cast<bool>(getline(in, inp_line));
+        while (has_line) {
+            ++line_number;
+            const size_t first_token = tokens_.size();
+            AddLine(std::move(inp_line), line_number);
+            has_line = static_cast<bool>(getline(in, inp_line));
+            if (!options.defer_method_bodies || !IsMethodHeader(first_token)) {
+                continue;
+            }
 
-            if (IsEmptyLine(inp_line)) {
+            // Строки тела: пустые и строки с отступом больше, чем у заголовка
+            std::vector<std::string> body;
+            bool declares_class = false;
+            for (; has_line; has_line = static_cast<bool>(getline(in, inp_line))) {
+                if (!IsEmptyLine(inp_line)) {
+                    if (static_cast<size_t>(CountSpace(inp_line)) <= number_spaces) {
+                        break;
+                    }
+                    declares_class = declares_class || DeclaresClass(inp_line);
+                }
+                body.push_back(std::move(inp_line));
+            }
+            if (body.empty() || declares_class) {
+                // Классы, объявленные в теле, должны быть видны в остальной программе
+                for (std::string& line : body) {
+                    AddLine(std::move(line), ++line_number);
+                }
                 continue;
             }
 
-            SetIndent(TrimLine(inp_line));
-            std::istringstream istring(inp_line);
-            ReadLine(istring);
+            // Заголовок заканчивается лексемой Newline, её заменяет лексема тела
+            tokens_.pop_back();
+            lines_.pop_back();
+            const size_t indent = number_spaces * 2;
+            auto text = std::make_shared<std::string>();
+            for (const std::string& line : body) {
+                if (!IsEmptyLine(line)) {
+                    text->append(line, indent);
+                }
+                text->push_back('\n');
+            }
+            tokens_.push_back(DeferredBody{std::move(text), line_number + 1});
+            lines_.push_back(line_number + 1);
+            line_number += static_cast<int>(body.size());
         }
 
         SetIndent(0);
 
         tokens_.push_back(Eof{});
+        lines_.resize(tokens_.size(), line_number + 1);
+    }
+
+    void Lexer::AddLine(std::string line, int line_number) {
+        if (IsEmptyLine(line)) {
+            return;
+        }
+        SetIndent(TrimLine(line));
+        std::istringstream istring(line);
+        ReadLine(istring);
+        lines_.resize(tokens_.size(), line_number);
+    }
+
+    // Заголовок метода - строка "def ... :", лексемы которой начинаются с first_token
+    bool Lexer::IsMethodHeader(size_t first_token) const {
+        using namespace token_type;
+        // Перед def могут быть лексемы Indent и Dedent
+        while (first_token < tokens_.size()
+               && (tokens_[first_token].Is<Indent>() || tokens_[first_token].Is<Dedent>())) {
+            ++first_token;
+        }
+        const size_t size = tokens_.size();
+        return first_token < size && tokens_[first_token].Is<Def>() && size - first_token >= 2
+               && tokens_[size - 1].Is<Newline>() && tokens_[size - 2].Is<Char>()
+               && tokens_[size - 2].As<Char>().value == ':';
+    }
+
+    bool Lexer::DeclaresClass(const std::string_view line) const {
+        constexpr std::string_view CLASS = "class"sv;
+        const size_t start = line.find_first_not_of(' ');
+        if (line.compare(start, CLASS.size(), CLASS) != 0) {
+            return false;
+        }
+        const size_t end = start + CLASS.size();
+        return end == line.size()
+               || !(isalnum(static_cast<unsigned char>(line[end])) || line[end] == '_');
     }
 
     const Token& Lexer::CurrentToken() const {
@@ -103,6 +181,10 @@ namespace parse {
         throw std::logic_error("Not implemented"s);
     }
 
+    int Lexer::CurrentLine() const {
+        return lines_[std::min(index_, lines_.size() - 1)];
+    }
+
     Token Lexer::NextToken() {
         if ((index_ + 1) < tokens_.size()) {
             index_++;
@@ -213,9 +295,9 @@ namespace parse {
         }
     }
 
-    void Lexer::ReadSign(std::istringstream& istring, char ch)
-    {
-        using namespace parse::token_type;
+    void Lexer::ReadSign(std::istringstream& istring, char ch)
+    {
+        using namespace parse::token_type;
         switch (ch) {
         case '=': case '!': case '<': case'>': {
             if (istring.peek() == '=') {
@@ -251,7 +333,7 @@ namespace parse {
             istring.unget();
             ReadId(istring);
         }
-        }
+        }
     }
 
     void Lexer::ReadString(std::istringstream& in, const char d) {
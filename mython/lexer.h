@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iosfwd>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
@@ -49,6 +50,13 @@ namespace parse {
         struct None {};         // Лексема «None»
         struct True {};         // Лексема «True»
         struct False {};        // Лексема «False»
+
+        // Лексема «тело метода, разбор которого отложен» (см. LexerOptions::defer_method_bodies).
+        // Заменяет лексемы Newline, Indent, ..., Dedent тела
+        struct DeferredBody {
+            std::shared_ptr<const std::string> value;  // Строки тела без отступа заголовка метода
+            int first_line;                            // Номер первой строки тела
+        };
         
     }  // namespace token_type
 
@@ -58,7 +66,8 @@ namespace parse {
         token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
         token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
         token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
-        token_type::None, token_type::True, token_type::False, token_type::Eof>;
+        token_type::None, token_type::True, token_type::False, token_type::DeferredBody,
+        token_type::Eof>;
 
     struct Token : TokenBase {
         using TokenBase::TokenBase;
@@ -89,9 +98,19 @@ namespace parse {
         using std::runtime_error::runtime_error;
     };
 
+    // Параметры лексического разбора
+    struct LexerOptions {
+        // Заменять тело каждого метода одной лексемой DeferredBody, не выполняя его лексический
+        // разбор. В теле проверяется только отступ строк: тело - строки после заголовка def,
+        // отступ которых больше отступа заголовка. Тела, объявляющие классы, разбираются сразу
+        bool defer_method_bodies = false;
+        // Номер первой строки текста
+        int first_line = 1;
+    };
+
     class Lexer {
     public:
-        explicit Lexer(std::istream& input);
+        explicit Lexer(std::istream& input, const LexerOptions& options = {});
 
         // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
         const Token& CurrentToken() const;
@@ -99,6 +118,9 @@ namespace parse {
         // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
         Token NextToken();
 
+        // Возвращает номер строки исходного текста (начиная с 1), в которой находится текущий токен
+        [[nodiscard]] int CurrentLine() const;
+
         // Если текущий токен имеет тип T, метод возвращает ссылку на него.
         // В противном случае метод выбрасывает исключение LexerError
         template <typename T>
@@ -141,12 +163,17 @@ namespace parse {
 
     private:
         std::vector<Token> tokens_;
+        // Номера строк исходного текста для каждого токена из tokens_
+        std::vector<int> lines_;
         size_t index_ = 0;
         size_t number_spaces = 0;
 
         size_t TrimLine(std::string& str) const;
         int CountSpace(const std::string_view str)const;
         void ReadLine(std::istringstream& input);
+        void AddLine(std::string line, int line_number);
+        [[nodiscard]] bool IsMethodHeader(size_t first_token) const;
+        [[nodiscard]] bool DeclaresClass(std::string_view line) const;
         void SetIndent(const size_t);
         void ReadId(std::istringstream& input);
         void ReadSign(std::istringstream& input, char ch);
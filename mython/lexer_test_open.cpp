@@ -1,6 +1,7 @@
 #include "lexer.h"
 #include "test_runner_p.h"
 
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -351,6 +352,87 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+void TestLineNumbers() {
+    istringstream input(R"(x = 1
+
+# comment
+class A:
+  def f():
+    return 2
+y = 3
+)"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentLine(), 1);
+    lexer.NextToken();
+    lexer.NextToken();
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 1);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Class{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 4);
+    while (!lexer.CurrentToken().Is<token_type::Return>()) {
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(lexer.CurrentLine(), 6);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 6);
+    lexer.NextToken();
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 7);
+    while (!lexer.CurrentToken().Is<token_type::Eof>()) {
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(lexer.CurrentLine(), 8);
+}
+
+void TestDeferredMethodBodies() {
+    istringstream input(R"(class A:
+  def f(x):
+    if x:
+
+      return 1
+    return 2
+  def g():
+    class B:
+      def h():
+        return 3
+    return 4
+y = 5
+)"s);
+    LexerOptions options;
+    options.defer_method_bodies = true;
+    Lexer lexer(input, options);
+
+    while (!lexer.CurrentToken().Is<token_type::Def>()) {
+        lexer.NextToken();
+    }
+    for (int i = 0; i < 5; ++i) {
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Char{':'}));
+    // Тело f без отступа заголовка заменено одной лексемой
+    const auto body = make_shared<const string>("  if x:\n\n    return 1\n  return 2\n"s);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::DeferredBody{body, 3}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 3);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 7);
+
+    // Тело g объявляет класс и разбирается сразу
+    lexer.NextToken();
+    lexer.NextToken();
+    lexer.NextToken();
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Class{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 8);
+    while (!lexer.CurrentToken().Is<token_type::Id>()
+           || lexer.CurrentToken().As<token_type::Id>().value != "y"s) {
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(lexer.CurrentLine(), 12);
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
@@ -364,9 +446,11 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestEmptyLinesAreIgnored);
     RUN_TEST(tr, parse::TestExpect);
     RUN_TEST(tr, parse::TestExpectNext);
-    RUN_TEST(tr, parse::TestMythonProgram);
+    RUN_BENCH(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestLineNumbers);
+    RUN_TEST(tr, parse::TestDeferredMethodBodies);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -1,10 +1,31 @@
+#include "aot.h"
+#include "batch.h"
+#include "census.h"
+#include "flat_ast.h"
+#include "jit.h"
 #include "lexer.h"
 #include "parse.h"
+#include "profiler.h"
+#include "program.h"
 #include "runtime.h"
+#include "sampler.h"
+#include "server.h"
 #include "statement.h"
 #include "test_runner_p.h"
+#include "tiering.h"
 
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -16,22 +37,374 @@ namespace ast {
 void RunUnitTests(TestRunner& tr);
 } // namespace ast
 
+namespace aot {
+void RunAotTests(TestRunner& tr);
+}  // namespace aot
+
 namespace runtime {
 void RunObjectHolderTests(TestRunner& tr);
 void RunObjectsTests(TestRunner& tr);
+void RunNativeTests(TestRunner& tr);
+void RunHostObjectTests(TestRunner& tr);
 }  // namespace runtime
 
 void TestParseProgram(TestRunner& tr);
+void RunCompiledProgramTests(TestRunner& tr);
+void RunBatchTests(TestRunner& tr);
+void RunServerTests(TestRunner& tr);
+
+namespace flat {
+void RunFlatAstTests(TestRunner& tr);
+}  // namespace flat
+
+namespace jit {
+void RunJitTests(TestRunner& tr);
+void RunTieringTests(TestRunner& tr);
+}  // namespace jit
+
+namespace vm {
+void RunVmTests(TestRunner& tr);
+}  // namespace vm
+
+namespace profile {
+void RunProfilerTests(TestRunner& tr);
+void RunSamplerTests(TestRunner& tr);
+void RunCensusTests(TestRunner& tr);
+}  // namespace profile
 
 namespace {
 
-void RunMythonProgram(istream& input, ostream& output) {
-    parse::Lexer lexer(input);
-    auto program = ParseProgram(lexer);
+// Параметры командной строки интерпретатора
+struct CommandLine {
+    // Файл для текстового отчёта профилировщика
+    string profile_report;
+    // Файл для стеков вызовов в свёрнутом формате (для построения флеймграфов)
+    string profile_stacks;
+    // Файл для стеков, собранных семплирующим профилировщиком
+    string sample_stacks;
+    // Частота семплирования, Гц
+    int sample_hz = 99;
+    // Файл для отчёта об учёте размещений объектов
+    string heap_census;
+    // Максимальное число шагов выполнения программы
+    optional<uint64_t> max_steps;
+    // Ограничение времени выполнения программы
+    optional<chrono::milliseconds> timeout;
+    // Максимальная глубина вызовов методов. Если задана, программа выполняется
+    // на собственном стеке интерпретатора
+    optional<size_t> max_depth;
+    // Порог, после которого юнит-тест считается медленным
+    optional<chrono::milliseconds> slow_test;
+    // Выполнять замеры в бенчмарках, зарегистрированных через RUN_BENCH
+    bool bench_tests = false;
+    // Число потоков для юнит-тестов, 0 - по числу процессоров
+    size_t test_jobs = 1;
+    // Файл со списком программ для пакетного выполнения, по одному пути в строке
+    string batch;
+    // Число потоков пакетного выполнения, 0 - по числу процессоров
+    size_t jobs = 0;
+    // Записывать вывод каждой программы пакета в файл <путь программы>.out
+    // вместо общего потока с кадрами
+    bool batch_output_files = false;
+    // Сокет, на котором интерпретатор работает как сервер
+    string serve;
+    // Сокет сервера, которому передаётся программа из стандартного ввода
+    string connect;
+    // Число скомпилированных программ в кэше сервера
+    size_t cache_size = 1024;
+    // Переводить часто вызываемые методы в байт-код
+    bool vm = true;
+    // Компилировать часто вызываемые методы в машинный код
+    bool jit = true;
+    // Число вызовов метода, после которого он компилируется
+    uint64_t jit_threshold = jit::TierPolicy{}.invocation_threshold;
+    // Число рекурсивных вызовов метода из самого себя, после которого он компилируется
+    uint64_t jit_backedge_threshold = jit::TierPolicy{}.backedge_threshold;
+    // Файл для отчёта о переходах методов на уровень машинного кода
+    string tier_stats;
+    // Сверять результаты машинного кода с результатами обхода дерева
+    bool jit_check = false;
+    // Выполнять методы обходом плоских деревьев (см. flat_ast.h) вместо перевода
+    // в байт-код и машинный код
+    bool flat_ast = false;
+    // Откладывать разбор тел методов до первого вызова (см. ParseOptions::lazy_methods)
+    bool lazy_methods = false;
+    // Файл, в который записывается программа, переведённая в C++ (см. aot.h),
+    // вместо её выполнения
+    string emit_cpp;
+};
+
+// Возвращает значение параметра вида "--name=value" либо nullopt, если arg - другой параметр
+optional<string> GetOptionValue(string_view arg, string_view name) {
+    if (arg.size() > name.size() && arg.substr(0, name.size()) == name
+        && arg[name.size()] == '=') {
+        return string(arg.substr(name.size() + 1));
+    }
+    return nullopt;
+}
+
+CommandLine ParseCommandLine(int argc, char* argv[]) {
+    CommandLine result;
+    for (int i = 1; i < argc; ++i) {
+        const string_view arg = argv[i];
+        if (auto value = GetOptionValue(arg, "--profile"sv)) {
+            result.profile_report = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--profile-stacks"sv)) {
+            result.profile_stacks = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--sample"sv)) {
+            result.sample_stacks = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--sample-hz"sv)) {
+            result.sample_hz = stoi(*value);
+        } else if (auto value = GetOptionValue(arg, "--heap-census"sv)) {
+            result.heap_census = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--max-steps"sv)) {
+            result.max_steps = stoull(*value);
+        } else if (auto value = GetOptionValue(arg, "--timeout-ms"sv)) {
+            result.timeout = chrono::milliseconds(stoll(*value));
+        } else if (auto value = GetOptionValue(arg, "--max-depth"sv)) {
+            result.max_depth = stoull(*value);
+        } else if (auto value = GetOptionValue(arg, "--slow-test-ms"sv)) {
+            result.slow_test = chrono::milliseconds(stoll(*value));
+        } else if (auto value = GetOptionValue(arg, "--batch"sv)) {
+            result.batch = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--jobs"sv)) {
+            result.jobs = stoull(*value);
+        } else if (auto value = GetOptionValue(arg, "--batch-output"sv)) {
+            if (*value != "framed"sv && *value != "files"sv) {
+                throw invalid_argument("--batch-output must be framed or files"s);
+            }
+            result.batch_output_files = *value == "files"sv;
+        } else if (auto value = GetOptionValue(arg, "--serve"sv)) {
+            result.serve = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--connect"sv)) {
+            result.connect = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--cache-size"sv)) {
+            result.cache_size = stoull(*value);
+        } else if (auto value = GetOptionValue(arg, "--test-jobs"sv)) {
+            result.test_jobs = stoull(*value);
+        } else if (auto value = GetOptionValue(arg, "--jit-threshold"sv)) {
+            result.jit_threshold = stoull(*value);
+        } else if (auto value = GetOptionValue(arg, "--jit-backedge-threshold"sv)) {
+            result.jit_backedge_threshold = stoull(*value);
+        } else if (auto value = GetOptionValue(arg, "--tier-stats"sv)) {
+            result.tier_stats = std::move(*value);
+        } else if (auto value = GetOptionValue(arg, "--emit-cpp"sv)) {
+            result.emit_cpp = std::move(*value);
+        } else if (arg == "--no-jit"sv) {
+            result.jit = false;
+        } else if (arg == "--no-vm"sv) {
+            result.vm = false;
+        } else if (arg == "--jit-check"sv) {
+            result.jit_check = true;
+        } else if (arg == "--flat-ast"sv) {
+            result.flat_ast = true;
+        } else if (arg == "--lazy-methods"sv) {
+            result.lazy_methods = true;
+        } else if (arg == "--bench-tests"sv) {
+            result.bench_tests = true;
+        } else {
+            throw invalid_argument("Unknown option "s + string(arg));
+        }
+    }
+    return result;
+}
+
+void WriteFile(const string& path, const function<void(ostream&)>& write) {
+    ofstream out(path);
+    if (!out) {
+        throw runtime_error("Can't open "s + path);
+    }
+    write(out);
+}
+
+void RunMythonProgram(istream& input, ostream& output, const CommandLine& command_line) {
+    profile::Profiler profiler;
+    ParseOptions options;
+    if (!command_line.profile_report.empty() || !command_line.profile_stacks.empty()) {
+        options.profiler = &profiler;
+    }
+    options.track_lines = !command_line.heap_census.empty();
+    options.lazy_methods = command_line.lazy_methods;
+    const auto program = CompiledProgram::Compile(input, options);
+
+    profile::HeapCensus census;
+    if (!command_line.heap_census.empty()) {
+        census.Start();
+    }
 
     runtime::SimpleContext context{output};
-    runtime::Closure closure;
-    program->Execute(closure, context);
+    optional<runtime::ExecutionBudget::Clock::time_point> deadline;
+    if (command_line.timeout) {
+        deadline = runtime::ExecutionBudget::Clock::now() + *command_line.timeout;
+    }
+    runtime::ExecutionBudget budget(command_line.max_steps, deadline);
+    if (command_line.max_steps || deadline) {
+        context.SetBudget(&budget);
+    }
+
+    jit::TierPolicy tier_policy;
+    tier_policy.invocation_threshold = command_line.jit_threshold;
+    tier_policy.backedge_threshold = command_line.jit_backedge_threshold;
+    // Машинный код не обновляет теневой стек, поэтому при семплировании методы
+    // не компилируются в машинный код
+    const bool native =
+        command_line.jit && jit::IsSupported() && command_line.sample_stacks.empty();
+    if (!native) {
+        tier_policy.invocation_threshold = jit::TierPolicy::NEVER;
+        tier_policy.backedge_threshold = jit::TierPolicy::NEVER;
+    }
+    if (!command_line.vm) {
+        tier_policy.bytecode_threshold = jit::TierPolicy::NEVER;
+    }
+    jit::JitOptions jit_options;
+    jit_options.cross_check = command_line.jit_check;
+    jit::TieredExecution tiered_execution(tier_policy, jit_options);
+    flat::FlatTreeWalker flat_tree_walker;
+    if (command_line.flat_ast) {
+        context.SetCallAccelerator(&flat_tree_walker);
+    } else if (native || command_line.vm) {
+        context.SetCallAccelerator(&tiered_execution);
+    }
+
+    const auto run = [&program, &context, &command_line] {
+        runtime::Closure closure;
+        if (command_line.max_depth) {
+            runtime::InterpreterStackOptions stack_options;
+            stack_options.max_call_depth = *command_line.max_depth;
+            program.Run(closure, context, stack_options);
+        } else {
+            program.Run(closure, context);
+        }
+    };
+
+    if (command_line.sample_stacks.empty()) {
+        run();
+    } else {
+        profile::SamplingProfiler sampler(command_line.sample_hz);
+        sampler.Start();
+        run();
+        sampler.Stop();
+        WriteFile(command_line.sample_stacks, [&sampler](ostream& out) {
+            sampler.PrintCollapsedStacks(out);
+        });
+    }
+
+    if (!command_line.heap_census.empty()) {
+        census.Stop();
+        WriteFile(command_line.heap_census, [&census](ostream& out) {
+            profile::PrintHeapReport(census.TakeSnapshot(), out);
+        });
+    }
+    if (!command_line.tier_stats.empty()) {
+        WriteFile(command_line.tier_stats, [&tiered_execution](ostream& out) {
+            tiered_execution.PrintReport(out);
+        });
+    }
+    if (!command_line.profile_report.empty()) {
+        WriteFile(command_line.profile_report, [&profiler](ostream& out) {
+            profiler.PrintReport(out);
+        });
+    }
+    if (!command_line.profile_stacks.empty()) {
+        WriteFile(command_line.profile_stacks, [&profiler](ostream& out) {
+            profiler.PrintCollapsedStacks(out);
+        });
+    }
+}
+
+// Переводит программу, читаемую из потока input, в C++ и записывает в файл path
+void EmitMythonProgram(istream& input, const string& path) {
+    parse::Lexer lexer(input);
+    const auto program = ParseProgram(lexer);
+    WriteFile(path, [&program](ostream& out) {
+        aot::EmitCpp(*program, out);
+    });
+}
+
+// Выполняет программы из списка command_line.batch. Возвращает число программ,
+// завершившихся с ошибкой
+size_t RunMythonBatch(ostream& output, const CommandLine& command_line) {
+    ifstream list(command_line.batch);
+    if (!list) {
+        throw runtime_error("Can't open "s + command_line.batch);
+    }
+    vector<string> paths;
+    for (string line; getline(list, line);) {
+        if (!line.empty()) {
+            paths.push_back(std::move(line));
+        }
+    }
+
+    BatchOptions options;
+    options.jobs = command_line.jobs;
+    options.max_steps = command_line.max_steps;
+    options.timeout = command_line.timeout;
+
+    size_t failed = 0;
+    RunBatch(paths, options, [&](size_t index, const ScriptResult& result) {
+        failed += !result.ok;
+        if (!command_line.batch_output_files) {
+            WriteFramedResult(output, index, result);
+            return;
+        }
+        WriteFile(result.path + ".out"s, [&result](ostream& out) {
+            out << result.output;
+        });
+        if (!result.ok) {
+            cerr << result.path << ": "sv << result.error << endl;
+        }
+    });
+    return failed;
+}
+
+// Обслуживает запросы на сокете command_line.serve до получения SIGINT или SIGTERM
+void ServeMython(const CommandLine& command_line) {
+    ServerOptions options;
+    options.socket_path = command_line.serve;
+    options.jobs = command_line.jobs;
+    options.cache_capacity = command_line.cache_size;
+    options.limits.max_steps = command_line.max_steps;
+    options.limits.timeout = command_line.timeout;
+    if (command_line.max_depth) {
+        options.max_call_depth = *command_line.max_depth;
+    }
+
+    // Сигналы блокируются до создания потоков сервера и принимаются отдельным потоком,
+    // который может безопасно остановить сервер
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    MythonServer server(options);
+    thread signal_waiter([&server, &signals] {
+        int signal = 0;
+        sigwait(&signals, &signal);
+        server.Stop();
+    });
+    server.Serve();
+    // Если сервер остановлен не сигналом, поток ожидания нужно разбудить
+    pthread_kill(signal_waiter.native_handle(), SIGTERM);
+    signal_waiter.join();
+    unlink(command_line.serve.c_str());
+}
+
+// Выполняет программу из input на сервере command_line.connect.
+// Возвращает false, если программа завершилась с ошибкой
+bool RunOnServer(istream& input, ostream& output, const CommandLine& command_line) {
+    const string source{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+    MythonClient client(command_line.connect);
+    const RunReply reply = client.Run(source, {}, {command_line.max_steps, command_line.timeout},
+                                      &output);
+    if (!reply.ok) {
+        cerr << reply.error << endl;
+    }
+    return reply.ok;
+}
+
+void RunMythonProgram(istream& input, ostream& output) {
+    RunMythonProgram(input, output, CommandLine{});
 }
 
 void TestSimplePrints() {
@@ -112,27 +485,62 @@ print y.value
     ASSERT_EQUAL(output.str(), "2\n3\n");
 }
 
-void TestAll() {
+void TestAll(const CommandLine& command_line) {
     TestRunner tr;
+    if (command_line.slow_test) {
+        tr.SetSlowTestThreshold(*command_line.slow_test);
+    }
+    tr.SetBenchmarksEnabled(command_line.bench_tests);
+    tr.SetJobs(command_line.test_jobs > 0 ? command_line.test_jobs
+                                          : max(thread::hardware_concurrency(), 1U));
     parse::RunOpenLexerTests(tr);
     runtime::RunObjectHolderTests(tr);
     runtime::RunObjectsTests(tr);
+    runtime::RunNativeTests(tr);
+    runtime::RunHostObjectTests(tr);
     ast::RunUnitTests(tr);
     TestParseProgram(tr);
+    RunCompiledProgramTests(tr);
+    RunBatchTests(tr);
+    RunServerTests(tr);
+    profile::RunProfilerTests(tr);
+    profile::RunSamplerTests(tr);
+    profile::RunCensusTests(tr);
+    jit::RunJitTests(tr);
+    jit::RunTieringTests(tr);
+    vm::RunVmTests(tr);
+    aot::RunAotTests(tr);
+    flat::RunFlatAstTests(tr);
 
     RUN_TEST(tr, TestSimplePrints);
     RUN_TEST(tr, TestAssignments);
-    RUN_TEST(tr, TestArithmetics);
-    RUN_TEST(tr, TestVariablesArePointers);
+    RUN_BENCH(tr, TestArithmetics);
+    RUN_BENCH(tr, TestVariablesArePointers);
 }
 
 }  // namespace
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
-        TestAll();
-
-        RunMythonProgram(cin, cout);
+        const CommandLine command_line = ParseCommandLine(argc, argv);
+
+        TestAll(command_line);
+
+        if (!command_line.serve.empty()) {
+            ServeMython(command_line);
+            return 0;
+        }
+        if (!command_line.connect.empty()) {
+            return RunOnServer(cin, cout, command_line) ? 0 : 1;
+        }
+        if (!command_line.batch.empty()) {
+            return RunMythonBatch(cout, command_line) == 0 ? 0 : 1;
+        }
+        if (!command_line.emit_cpp.empty()) {
+            EmitMythonProgram(cin, command_line.emit_cpp);
+            return 0;
+        }
+        RunMythonProgram(cin, cout, command_line);
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
 		return 1;
@@ -0,0 +1,64 @@
+#include "native.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace runtime {
+
+bool MatchesHint(const ObjectHolder& object, TypeHint hint) {
+    switch (hint) {
+    case TypeHint::Any:
+        return true;
+    case TypeHint::Number:
+        return object.TryAs<Number>() != nullptr;
+    case TypeHint::String:
+        return object.TryAs<String>() != nullptr;
+    case TypeHint::Bool:
+        return object.TryAs<Bool>() != nullptr;
+    case TypeHint::Instance:
+        return object.TryAs<ClassInstance>() != nullptr;
+    }
+    return false;
+}
+
+std::string_view HintName(TypeHint hint) {
+    switch (hint) {
+    case TypeHint::Any:
+        return "Any"sv;
+    case TypeHint::Number:
+        return "Number"sv;
+    case TypeHint::String:
+        return "String"sv;
+    case TypeHint::Bool:
+        return "Bool"sv;
+    case TypeHint::Instance:
+        return "Instance"sv;
+    }
+    return "Unknown"sv;
+}
+
+void NativeRegistry::Register(NativeFunction function) {
+    if (!function.body) {
+        throw std::invalid_argument("Native function "s + function.name + " has no body"s);
+    }
+    if (functions_.count(function.name) != 0) {
+        throw std::invalid_argument("Native function "s + function.name + " already exists"s);
+    }
+    auto name = function.name;
+    functions_.emplace(std::move(name), std::make_shared<const NativeFunction>(std::move(function)));
+}
+
+void NativeRegistry::Register(std::string name, std::vector<TypeHint> param_types,
+                              TypeHint result_type, NativeFunction::Body body) {
+    Register(NativeFunction{std::move(name), std::move(param_types), result_type, std::move(body)});
+}
+
+std::shared_ptr<const NativeFunction> NativeRegistry::Find(const std::string& name) const {
+    if (const auto it = functions_.find(name); it != functions_.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+}  // namespace runtime
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace runtime {
+
+    // Подсказка о типе значения, принимаемого нативной функцией
+    enum class TypeHint {
+        Any,       // любое значение, включая None
+        Number,
+        String,
+        Bool,
+        Instance,  // экземпляр пользовательского класса
+    };
+
+    // Возвращает true, если значение object соответствует подсказке hint
+    bool MatchesHint(const ObjectHolder& object, TypeHint hint);
+
+    // Возвращает имя типа для сообщений об ошибках
+    std::string_view HintName(TypeHint hint);
+
+    // Функция, реализованная на C++ и доступная из программы на Mython
+    struct NativeFunction {
+        using Body = std::function<ObjectHolder(const std::vector<ObjectHolder>& args,
+                                                Context& context)>;
+
+        // Имя, под которым функция видна в программе
+        std::string name;
+        // Типы параметров. Количество параметров фиксировано и равно param_types.size()
+        std::vector<TypeHint> param_types;
+        // Тип возвращаемого значения
+        TypeHint result_type = TypeHint::Any;
+        // Реализация функции
+        Body body;
+    };
+
+    /*
+     * Реестр нативных функций хост-программы.
+     * Вызовы функций разрешаются при разборе программы, поэтому реестр нужен только
+     * на время компиляции: узлы дерева разделяют владение зарегистрированными функциями.
+     */
+    class NativeRegistry {
+    public:
+        // Регистрирует функцию. Если функция с таким именем уже есть, выбрасывает
+        // исключение std::invalid_argument
+        void Register(NativeFunction function);
+
+        void Register(std::string name, std::vector<TypeHint> param_types, TypeHint result_type,
+                      NativeFunction::Body body);
+
+        // Возвращает функцию name либо nullptr, если такой функции нет
+        [[nodiscard]] std::shared_ptr<const NativeFunction> Find(const std::string& name) const;
+
+    private:
+        std::unordered_map<std::string, std::shared_ptr<const NativeFunction>> functions_;
+    };
+
+}  // namespace runtime
@@ -0,0 +1,92 @@
+#include "native.h"
+#include "program.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+NativeRegistry MakeRegistry() {
+    NativeRegistry registry;
+    registry.Register("square"s, {TypeHint::Number}, TypeHint::Number,
+                      [](const vector<ObjectHolder>& args, Context& /*context*/) {
+                          const int value = args[0].TryAs<Number>()->GetValue();
+                          return ObjectHolder::Own(Number{value * value});
+                      });
+    registry.Register("greet"s, {TypeHint::String}, TypeHint::Any,
+                      [](const vector<ObjectHolder>& args, Context& context) {
+                          context.GetOutputStream() << "hi, "sv
+                                                    << args[0].TryAs<String>()->GetValue()
+                                                    << '\n';
+                          return ObjectHolder::None();
+                      });
+    return registry;
+}
+
+string RunWithNatives(const string& program, const NativeRegistry& registry) {
+    istringstream input(program);
+    ParseOptions options;
+    options.natives = &registry;
+    const auto compiled = CompiledProgram::Compile(input, options);
+
+    DummyContext context;
+    compiled.Run(context);
+    return context.output.str();
+}
+
+void TestRegistry() {
+    NativeRegistry registry = MakeRegistry();
+
+    ASSERT(registry.Find("square"s));
+    ASSERT(!registry.Find("cube"s));
+    ASSERT_EQUAL(registry.Find("square"s)->param_types.size(), 1U);
+    ASSERT_THROWS(registry.Register("square"s, {}, TypeHint::Any,
+                                    [](const vector<ObjectHolder>&, Context&) {
+                                        return ObjectHolder::None();
+                                    }),
+                  std::invalid_argument);
+}
+
+void TestMatchesHint() {
+    ASSERT(MatchesHint(ObjectHolder::Own(Number{1}), TypeHint::Number));
+    ASSERT(!MatchesHint(ObjectHolder::Own(Number{1}), TypeHint::String));
+    ASSERT(MatchesHint(ObjectHolder::Own(String{"s"s}), TypeHint::String));
+    ASSERT(MatchesHint(ObjectHolder::Own(Bool{true}), TypeHint::Bool));
+    ASSERT(MatchesHint(ObjectHolder::None(), TypeHint::Any));
+    ASSERT(!MatchesHint(ObjectHolder::None(), TypeHint::Instance));
+}
+
+void TestNativeCalls() {
+    const string program = R"(
+class Calc:
+  def twice_square(x):
+    return square(x) * 2
+
+x = square(7)
+c = Calc()
+print x, c.twice_square(3)
+greet('Mython')
+)"s;
+    ASSERT_EQUAL(RunWithNatives(program, MakeRegistry()), "49 18\nhi, Mython\n"s);
+}
+
+void TestNativeCallErrors() {
+    const NativeRegistry registry = MakeRegistry();
+
+    ASSERT_THROWS(RunWithNatives("x = square(1, 2)\n"s, registry), ParseError);
+    ASSERT_THROWS(RunWithNatives("x = cube(2)\n"s, registry), ParseError);
+    ASSERT_THROWS(RunWithNatives("x = square('2')\n"s, registry), std::runtime_error);
+}
+
+}  // namespace
+
+void RunNativeTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestRegistry);
+    RUN_TEST(tr, runtime::TestMatchesHint);
+    RUN_TEST(tr, runtime::TestNativeCalls);
+    RUN_TEST(tr, runtime::TestNativeCallErrors);
+}
+
+}  // namespace runtime
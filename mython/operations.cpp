@@ -0,0 +1,135 @@
+#include "operations.h"
+
+#include "host_object.h"
+
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+const string ADD_METHOD = "__add__"s;
+
+}  // namespace
+
+ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    const auto* lhs_number = lhs.TryAs<Number>();
+    const auto* rhs_number = rhs.TryAs<Number>();
+    if (lhs_number && rhs_number) {
+        return ObjectHolder::Own(Number{lhs_number->GetValue() + rhs_number->GetValue()});
+    }
+    const auto* lhs_string = lhs.TryAs<String>();
+    const auto* rhs_string = rhs.TryAs<String>();
+    if (lhs_string && rhs_string) {
+        return ObjectHolder::Own(String{lhs_string->GetValue() + rhs_string->GetValue()});
+    }
+    if (auto* instance = lhs.TryAs<ClassInstance>()) {
+        if (instance->HasMethod(ADD_METHOD, 1)) {
+            return instance->Call(ADD_METHOD, {rhs}, context);
+        }
+    }
+    throw runtime_error("Add operands are illegal"s);
+}
+
+ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+    const auto* lhs_number = lhs.TryAs<Number>();
+    const auto* rhs_number = rhs.TryAs<Number>();
+    if (lhs_number && rhs_number) {
+        return ObjectHolder::Own(Number{lhs_number->GetValue() - rhs_number->GetValue()});
+    }
+    throw runtime_error("Substrict operands are illegal"s);
+}
+
+ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+    const auto* lhs_number = lhs.TryAs<Number>();
+    const auto* rhs_number = rhs.TryAs<Number>();
+    if (lhs_number && rhs_number) {
+        return ObjectHolder::Own(Number{lhs_number->GetValue() * rhs_number->GetValue()});
+    }
+    throw runtime_error("Multiply operands are illegal"s);
+}
+
+ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+    const auto* lhs_number = lhs.TryAs<Number>();
+    const auto* rhs_number = rhs.TryAs<Number>();
+    if (lhs_number && rhs_number) {
+        if (rhs_number->GetValue() == 0) {
+            throw runtime_error("Division by zero"s);
+        }
+        return ObjectHolder::Own(Number{lhs_number->GetValue() / rhs_number->GetValue()});
+    }
+    throw runtime_error("Division operands are illegal"s);
+}
+
+ObjectHolder Stringify(const ObjectHolder& value, Context& context) {
+    if (value.TryAs<Number>() || value.TryAs<String>() || value.TryAs<Bool>()
+        || value.TryAs<ClassInstance>()) {
+        ostringstream out;
+        value->Print(out, context);
+        return ObjectHolder::Own(String(out.str()));
+    }
+    return ObjectHolder::Own(String("None"s));
+}
+
+bool LogicalValue(const ObjectHolder& value) {
+    if (const auto* ptr = value.TryAs<Bool>()) {
+        return ptr->GetValue();
+    }
+    if (const auto* ptr = value.TryAs<Number>()) {
+        return ptr->GetValue() != 0;
+    }
+    throw runtime_error("Value does not bool value"s);
+}
+
+ObjectHolder GetField(const ObjectHolder& object, const string& name) {
+    if (auto* instance = object.TryAs<ClassInstance>()) {
+        const auto it = instance->Fields().find(name);
+        if (it == instance->Fields().end()) {
+            throw runtime_error("Accessing a non-existent field"s);
+        }
+        return it->second;
+    }
+    if (auto* host = object.TryAs<HostObjectBase>()) {
+        return host->GetField(name);
+    }
+    throw runtime_error("Accessing a non-existent field"s);
+}
+
+void CheckFieldOwner(const ObjectHolder& object) {
+    if (!object.TryAs<ClassInstance>() && !object.TryAs<HostObjectBase>()) {
+        throw runtime_error("Attempting to access a non-instance class field"s);
+    }
+}
+
+ObjectHolder SetField(const ObjectHolder& object, const string& name, ObjectHolder value) {
+    if (auto* instance = object.TryAs<ClassInstance>()) {
+        return instance->Fields()[name] = std::move(value);
+    }
+    if (auto* host = object.TryAs<HostObjectBase>()) {
+        host->SetField(name, value);
+        return value;
+    }
+    throw runtime_error("Attempting to access a non-instance class field"s);
+}
+
+ObjectHolder CallMethod(const ObjectHolder& object, const string& method,
+                        const vector<ObjectHolder>& args, Context& context) {
+    if (auto* instance = object.TryAs<ClassInstance>()) {
+        return instance->Call(method, args, context);
+    }
+    throw runtime_error("Accessing a non-existent field"s);
+}
+
+void PrintValue(const ObjectHolder& value, Context& context) {
+    if (value) {
+        value->Print(context.GetOutputStream(), context);
+    } else {
+        context.GetOutputStream() << "None"sv;
+    }
+}
+
+}  // namespace runtime
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <string>
+#include <vector>
+
+namespace runtime {
+
+    /*
+     * Операции над значениями Mython. Их выполняют как узлы дерева программы (statement.h),
+     * так и виртуальная машина (vm.h), поэтому оба способа выполнения одинаково вычисляют
+     * результаты и выбрасывают одинаковые исключения
+     */
+
+    // Возвращает сумму чисел, конкатенацию строк либо результат вызова lhs.__add__(rhs).
+    // Для других операндов выбрасывает runtime_error
+    ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    // Возвращают разность, произведение и частное чисел lhs и rhs.
+    // Для других операндов, а также при делении на 0 выбрасывают runtime_error
+    ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs);
+    ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs);
+    ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs);
+
+    // Возвращает строку - результат операции str над value
+    ObjectHolder Stringify(const ObjectHolder& value, Context& context);
+
+    // Возвращает логическое значение операнда and, or либо not. Операндом может быть
+    // число или значение Bool, для остальных значений выбрасывается runtime_error
+    bool LogicalValue(const ObjectHolder& value);
+
+    // Возвращает поле name экземпляра класса либо объекта хост-программы object.
+    // Если поля нет, выбрасывает runtime_error
+    ObjectHolder GetField(const ObjectHolder& object, const std::string& name);
+
+    // Проверяет, что полям object можно присваивать значения, иначе выбрасывает runtime_error
+    void CheckFieldOwner(const ObjectHolder& object);
+
+    // Присваивает полю name объекта object значение value и возвращает его
+    ObjectHolder SetField(const ObjectHolder& object, const std::string& name, ObjectHolder value);
+
+    // Вызывает метод method экземпляра класса object. Если object не является
+    // экземпляром класса, выбрасывает runtime_error
+    ObjectHolder CallMethod(const ObjectHolder& object, const std::string& method,
+        const std::vector<ObjectHolder>& args, Context& context);
+
+    // Выводит value в поток вывода контекста, а пустое значение - как None
+    void PrintValue(const ObjectHolder& value, Context& context);
+
+}  // namespace runtime
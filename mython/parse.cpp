@@ -3,6 +3,11 @@
 #include "lexer.h"
 #include "statement.h"
 
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+
 using namespace std;
 
 namespace TokenType = parse::token_type;
@@ -18,28 +23,116 @@ bool operator!=(const parse::Token& token, char c) {
     return !(token == c);
 }
 
+// Объявленный класс программы и его порядковый номер
+struct DeclaredClass {
+    size_t index = 0;
+    const runtime::Class* cls = nullptr;
+};
+
+// Общие сведения разбора программы. Тела методов, разбор которых отложен,
+// ссылаются на них, поэтому сведения живут, пока живы тела
+struct ProgramState {
+    // Объявленные классы. Классами владеют узлы ClassDefinition, а классы владеют телами
+    // методов, поэтому здесь хранятся указатели
+    unordered_map<string, DeclaredClass> classes;
+    // Копия реестра нативных функций для отложенного разбора: реестр, переданный
+    // в ParseOptions, может быть уничтожен раньше программы
+    optional<runtime::NativeRegistry> natives;
+    // Параметры отложенного разбора. Задаются при первом отложенном теле
+    optional<ParseOptions> lazy_options;
+};
+
 class Parser {
 public:
-    explicit Parser(parse::Lexer& lexer)
-        : lexer_(lexer) {
+    Parser(parse::Lexer& lexer, const ParseOptions& options)
+        : Parser(lexer, options, make_shared<ProgramState>(), SIZE_MAX) {
+    }
+
+    // В разбираемом тексте видны только первые visible_classes объявленных классов
+    Parser(parse::Lexer& lexer, const ParseOptions& options, shared_ptr<ProgramState> state,
+           size_t visible_classes)
+        : lexer_(lexer)
+        , options_(options)
+        , state_(std::move(state))
+        , visible_classes_(visible_classes) {
     }
 
     // Program -> eps
     //          | Statement \n Program
     unique_ptr<ast::Statement> ParseProgram() {
+        const int line = lexer_.CurrentLine();
         auto result = make_unique<ast::Compound>();
         while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
             result->AddStatement(ParseStatement());
         }
+        if (options_.profiler != nullptr) {
+            return ProfileFrame(profile::Profiler::MODULE_FRAME, line, std::move(result));
+        }
         return result;
     }
 
 private:
-    // Suite -> NEWLINE INDENT (Statement) + DEDENT
+    // Возвращает класс name, видимый в разбираемом тексте, либо nullptr
+    [[nodiscard]] const runtime::Class* FindClass(const string& name) const {
+        const auto it = state_->classes.find(name);
+        if (it == state_->classes.end() || it->second.index >= visible_classes_) {
+            return nullptr;
+        }
+        return it->second.cls;
+    }
+
+    // Разбирает тело метода, лексический разбор которого был отложен
+    static unique_ptr<ast::Statement> ParseDeferredBody(const TokenType::DeferredBody& body,
+                                                        const ParseOptions& options,
+                                                        shared_ptr<ProgramState> state,
+                                                        size_t visible_classes) {
+        istringstream input(*body.value);
+        parse::LexerOptions lexer_options;
+        lexer_options.first_line = body.first_line;
+        parse::Lexer lexer(input, lexer_options);
+        Parser parser(lexer, options, std::move(state), visible_classes);
+        auto result = make_unique<ast::MethodBody>(parser.ParseBlock());
+        lexer.Expect<TokenType::Eof>();
+        return result;
+    }
+
+    // Тело метода, лексический разбор которого отложен, разбирается при первом вызове метода
+    unique_ptr<ast::Statement> MakeLazyBody(const TokenType::DeferredBody& body) {
+        if (options_.profiler != nullptr) {
+            // Профилировщику нужны все строки и тела методов до выполнения программы
+            return ParseDeferredBody(body, options_, state_, visible_classes_);
+        }
+        if (!state_->lazy_options) {
+            ParseOptions lazy_options = options_;
+            if (options_.natives != nullptr) {
+                state_->natives = *options_.natives;
+                lazy_options.natives = &*state_->natives;
+            }
+            state_->lazy_options = lazy_options;
+        }
+        // Тело видит только классы, объявленные до него, как и при разборе без отложенных тел
+        return make_unique<ast::LazyMethodBody>(
+            [state = state_, visible = state_->classes.size(), body] {
+                return ParseDeferredBody(body, *state->lazy_options, state, visible);
+            });
+    }
+
+    unique_ptr<ast::Statement> ProfileFrame(string name, int line,
+                                            unique_ptr<ast::Statement> body) {
+        const size_t frame_id = options_.profiler->RegisterFrame(std::move(name), line);
+        return make_unique<ast::ProfiledFrame>(*options_.profiler, frame_id, std::move(body));
+    }
+
+    // Suite -> NEWLINE Block
     unique_ptr<ast::Statement> ParseSuite() { // NOLINT
         lexer_.Expect<TokenType::Newline>();
-        lexer_.ExpectNext<TokenType::Indent>();
+        lexer_.NextToken();
+        return ParseBlock();
+    }
 
+    // Block -> INDENT (Statement) + DEDENT
+    unique_ptr<ast::Statement> ParseBlock() { // NOLINT
+        lexer_.Expect<TokenType::Indent>();
         lexer_.NextToken();
 
         auto result = make_unique<ast::Compound>();
@@ -54,11 +147,12 @@ private:
     }
 
     // Methods -> [def id(Params) : Suite]*
-    vector<runtime::Method> ParseMethods() { // NOLINT
+    vector<runtime::Method> ParseMethods(const string& class_name) { // NOLINT
         vector<runtime::Method> result;
 
         while (lexer_.CurrentToken().Is<TokenType::Def>()) {
             runtime::Method m;
+            const int line = lexer_.CurrentLine();
 
             m.name = lexer_.ExpectNext<TokenType::Id>().value;
             lexer_.ExpectNext<TokenType::Char>('(');
@@ -74,7 +168,15 @@ private:
             lexer_.ExpectNext<TokenType::Char>(':');
             lexer_.NextToken();
 
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            if (const auto* body = lexer_.CurrentToken().TryAs<TokenType::DeferredBody>()) {
+                m.body = MakeLazyBody(*body);
+                lexer_.NextToken();
+            } else {
+                m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            }
+            if (options_.profiler != nullptr) {
+                m.body = ProfileFrame(class_name + "."s + m.name, line, std::move(m.body));
+            }
 
             result.push_back(std::move(m));
         }
@@ -93,32 +195,30 @@ private:
             lexer_.ExpectNext<TokenType::Char>(')');
             lexer_.NextToken();
 
-            auto it = declared_classes_.find(name);
-            if (it == declared_classes_.end()) {
+            base_class = FindClass(name);
+            if (base_class == nullptr) {
                 throw ParseError("Base class "s + name + " not found for class "s + class_name);
             }
-            base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
         }
 
         lexer_.Expect<TokenType::Char>(':');
         lexer_.ExpectNext<TokenType::Newline>();
         lexer_.ExpectNext<TokenType::Indent>();
         lexer_.ExpectNext<TokenType::Def>();
-        vector<runtime::Method> methods = ParseMethods();  // NOLINT
+        vector<runtime::Method> methods = ParseMethods(class_name);  // NOLINT
 
         lexer_.Expect<TokenType::Dedent>();
         lexer_.NextToken();
 
-        auto [it, inserted] = declared_classes_.insert({
-            class_name,
-            runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class)),
-        });
-
-        if (!inserted) {
+        if (state_->classes.count(class_name) > 0) {
             throw ParseError("Class "s + class_name + " already exists"s);
         }
+        auto cls =
+            runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class));
+        const size_t index = state_->classes.size();
+        state_->classes[class_name] = {index, cls.TryAs<runtime::Class>()};
 
-        return make_unique<ast::ClassDefinition>(it->second);
+        return make_unique<ast::ClassDefinition>(std::move(cls));
     }
 
     vector<string> ParseDottedIds() {
@@ -152,10 +252,6 @@ private:
         lexer_.Expect<TokenType::Char>('(');
         lexer_.NextToken();
 
-        if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
-        }
-
         vector<unique_ptr<ast::Statement>> args;
         if (lexer_.CurrentToken() != ')') {
             args = ParseTestList();
@@ -163,6 +259,13 @@ private:
         lexer_.Expect<TokenType::Char>(')');
         lexer_.NextToken();
 
+        if (id_list.empty()) {
+            if (auto call = TryParseNativeCall(last_name, args)) {
+                return call;
+            }
+            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+        }
+
         return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
                                             std::move(last_name), std::move(args));
     }
@@ -266,9 +369,11 @@ private:
                     make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
                     std::move(args));
             }
-            if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
-                return make_unique<ast::NewInstance>(
-                    static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
+            if (const runtime::Class* cls = FindClass(method_name)) {
+                return make_unique<ast::NewInstance>(*cls, std::move(args));
+            }
+            if (auto call = TryParseNativeCall(method_name, args)) {
+                return call;
             }
             if (method_name == "str"sv) {
                 if (args.size() != 1) {
@@ -281,6 +386,23 @@ private:
         return make_unique<ast::VariableValue>(std::move(names));
     }
 
+    // Возвращает вызов нативной функции name либо nullptr, если такая функция не зарегистрирована
+    unique_ptr<ast::Statement> TryParseNativeCall(const string& name,
+                                                  vector<unique_ptr<ast::Statement>>& args) {
+        if (options_.natives == nullptr) {
+            return nullptr;
+        }
+        auto function = options_.natives->Find(name);
+        if (!function) {
+            return nullptr;
+        }
+        if (function->param_types.size() != args.size()) {
+            throw ParseError("Function "s + name + " takes exactly "s
+                             + to_string(function->param_types.size()) + " argument(s)"s);
+        }
+        return make_unique<ast::NativeCall>(std::move(function), std::move(args));
+    }
+
     vector<unique_ptr<ast::Statement>> ParseTestList() { // NOLINT
         vector<unique_ptr<ast::Statement>> result;
         result.push_back(ParseTest());
@@ -388,6 +510,18 @@ private:
     //           | class ClassDefinition
     //           | if Condition
     unique_ptr<ast::Statement> ParseStatement() { // NOLINT
+        const int line = lexer_.CurrentLine();
+        auto result = ParseStatementBody();  // NOLINT
+        if (options_.profiler != nullptr) {
+            options_.profiler->RegisterLine(line);
+        }
+        if (options_.profiler != nullptr || options_.track_lines) {
+            result = make_unique<ast::ProfiledStatement>(options_.profiler, line, std::move(result));
+        }
+        return result;
+    }
+
+    unique_ptr<ast::Statement> ParseStatementBody() { // NOLINT
         const auto& tok = lexer_.CurrentToken();
 
         if (tok.Is<TokenType::Class>()) {
@@ -425,11 +559,17 @@ private:
     }
 
     parse::Lexer& lexer_;
-    runtime::Closure declared_classes_;
+    const ParseOptions& options_;
+    shared_ptr<ProgramState> state_;
+    size_t visible_classes_ = SIZE_MAX;
 };
 
 }  // namespace
 
 unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
+    return ParseProgram(lexer, ParseOptions{});
+}
+
+unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer, const ParseOptions& options) {
+    return Parser{lexer, options}.ParseProgram();
 }
\ No newline at end of file
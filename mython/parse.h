@@ -9,10 +9,32 @@ class Lexer;
 
 namespace runtime {
 class Executable;
+class NativeRegistry;
+}
+
+namespace profile {
+class Profiler;
 }
 
 struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+// Параметры разбора программы
+struct ParseOptions {
+    // Нативные функции, вызовы которых разрешаются при разборе. Может быть nullptr
+    const runtime::NativeRegistry* natives = nullptr;
+    // Профилировщик, учитывающий выполнение инструкций и методов программы. Может быть nullptr
+    profile::Profiler* profiler = nullptr;
+    // Отслеживать номер выполняемой строки в profile::current_line (нужно для учёта размещений)
+    bool track_lines = false;
+    // Откладывать лексический и синтаксический разбор тел методов до первого вызова
+    // (см. parse::LexerOptions::defer_method_bodies и ast::LazyMethodBody). Ошибки в теле
+    // метода обнаруживаются при его первом вызове. Учитывается CompiledProgram::Compile.
+    // ParseProgram откладывает разбор тел, если так создан лексер. В режиме профилирования
+    // тела разбираются сразу
+    bool lazy_methods = false;
+};
+
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer, const ParseOptions& options);
\ No newline at end of file
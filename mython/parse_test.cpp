@@ -7,10 +7,30 @@ using namespace std;
 
 namespace parse {
 
-unique_ptr<ast::Statement> ParseProgramFromString(const string& program) {
+unique_ptr<ast::Statement> ParseProgramFromString(const string& program,
+                                                  const ParseOptions& options = {}) {
     istringstream is(program);
-    parse::Lexer lexer(is);
-    return ParseProgram(lexer);
+    parse::LexerOptions lexer_options;
+    lexer_options.defer_method_bodies = options.lazy_methods;
+    parse::Lexer lexer(is, lexer_options);
+    return ParseProgram(lexer, options);
+}
+
+ParseOptions LazyOptions() {
+    ParseOptions options;
+    options.lazy_methods = true;
+    return options;
+}
+
+// Возвращает текст ошибки, с которой завершился вызов func, либо пустую строку
+template <typename Func>
+string ErrorOf(Func func) {
+    try {
+        func();
+    } catch (const runtime_error& e) {
+        return e.what();
+    }
+    return {};
 }
 
 void TestSimpleProgram() {
@@ -244,6 +264,122 @@ print r, c, t1, t2
                  "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
 }
 
+void TestLazyMethodsParsedOnFirstCall() {
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add(n):
+    if n > 0:
+      self.value = self.value + n
+    return self.value
+
+  def unused():
+    return self.value * 2
+
+c = Counter()
+c.add(5)
+print c.add(2)
+)"s;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program, LazyOptions());
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "7\n"s);
+
+    const auto& cls = *closure.at("Counter"s).TryAs<runtime::Class>();
+    const auto* add = dynamic_cast<const ast::LazyMethodBody*>(cls.GetMethod("add"s)->body.get());
+    const auto* unused =
+        dynamic_cast<const ast::LazyMethodBody*>(cls.GetMethod("unused"s)->body.get());
+    ASSERT(add != nullptr && unused != nullptr);
+    ASSERT(add->IsResolved());
+    ASSERT(!unused->IsResolved());
+}
+
+void TestLazyMethodErrorsReportedOnCall() {
+    const string program = R"(
+class A:
+  def ok():
+    return 1
+
+  def broken():
+    x = = 1
+
+  def early():
+    return B()
+
+class B:
+  def f():
+    return 2
+
+a = A()
+print a.ok()
+)"s;
+    const string eager_error = ErrorOf([&program] {
+        ParseProgramFromString(program);
+    });
+    ASSERT(!eager_error.empty());
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program, LazyOptions());
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "1\n"s);
+
+    auto& a = *closure.at("a"s).TryAs<runtime::ClassInstance>();
+    ASSERT_EQUAL(ErrorOf([&] {
+                     a.Call("broken"s, {}, context);
+                 }),
+                 eager_error);
+    // Ошибка повторяется при каждом вызове
+    ASSERT_EQUAL(ErrorOf([&] {
+                     a.Call("broken"s, {}, context);
+                 }),
+                 eager_error);
+    // Как и при разборе без отложенных тел, класс B объявлен позже метода и в нём не виден
+    ASSERT_EQUAL(ErrorOf([&] {
+                     a.Call("early"s, {}, context);
+                 }),
+                 "Unknown call to B()"s);
+}
+
+void TestLazyMethodsDeclaringClasses() {
+    const string program = R"(
+class A:
+  def f():
+    class Inner:
+      def g(x):
+        return x + 1
+    return 1
+
+class B:
+  def h(x):
+    return twice(x)
+
+i = Inner()
+b = B()
+print i.g(4), b.h(4)
+)"s;
+    ParseOptions options = LazyOptions();
+    unique_ptr<ast::Statement> tree;
+    {
+        // Тела разбираются после уничтожения реестра нативных функций
+        runtime::NativeRegistry natives;
+        natives.Register("twice"s, {runtime::TypeHint::Number}, runtime::TypeHint::Number,
+                         [](const vector<runtime::ObjectHolder>& args, runtime::Context&) {
+                             const int value = args[0].TryAs<runtime::Number>()->GetValue();
+                             return runtime::ObjectHolder::Own(runtime::Number{value * 2});
+                         });
+        options.natives = &natives;
+        tree = ParseProgramFromString(program, options);
+    }
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "5 8\n"s);
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -254,5 +390,8 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestRecursion);
     RUN_TEST(tr, parse::TestRecursion2);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
-    RUN_TEST(tr, parse::TestClassicalPolymorphism);
+    RUN_BENCH(tr, parse::TestClassicalPolymorphism);
+    RUN_TEST(tr, parse::TestLazyMethodsParsedOnFirstCall);
+    RUN_TEST(tr, parse::TestLazyMethodErrorsReportedOnCall);
+    RUN_TEST(tr, parse::TestLazyMethodsDeclaringClasses);
 }
\ No newline at end of file
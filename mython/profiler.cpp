@@ -0,0 +1,100 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+namespace profile {
+
+namespace {
+
+double ToMilliseconds(Clock::duration d) {
+    return chrono::duration<double, milli>(d).count();
+}
+
+}  // namespace
+
+size_t Profiler::RegisterFrame(std::string name, int line) {
+    frames_.push_back({std::move(name), line});
+    return frames_.size() - 1;
+}
+
+void Profiler::RegisterLine(int line) {
+    if (static_cast<size_t>(line) >= line_hits_.size()) {
+        line_hits_.resize(line + 1);
+    }
+}
+
+void Profiler::EnterFrame(size_t frame_id) {
+    auto& frame = frames_[frame_id];
+    ++frame.calls;
+    ++frame.active;
+    path_.push_back(frame_id);
+    stack_.push_back({Clock::now()});
+}
+
+void Profiler::ExitFrame() {
+    const auto elapsed = Clock::now() - stack_.back().start;
+    const auto self_time = elapsed - stack_.back().children;
+
+    auto& frame = frames_[path_.back()];
+    if (--frame.active == 0) {
+        frame.inclusive += elapsed;
+    }
+    frame.exclusive += self_time;
+    stacks_[path_] += self_time;
+
+    stack_.pop_back();
+    path_.pop_back();
+    if (!stack_.empty()) {
+        stack_.back().children += elapsed;
+    }
+}
+
+void Profiler::PrintReport(std::ostream& out) const {
+    out << "Line hits:\n"sv;
+    out << setw(8) << "line"sv << setw(12) << "hits"sv << '\n';
+    for (size_t line = 0; line < line_hits_.size(); ++line) {
+        if (line_hits_[line] != 0) {
+            out << setw(8) << line << setw(12) << line_hits_[line] << '\n';
+        }
+    }
+
+    vector<const FrameInfo*> frames;
+    for (const auto& frame : frames_) {
+        if (frame.calls != 0) {
+            frames.push_back(&frame);
+        }
+    }
+    sort(frames.begin(), frames.end(), [](const FrameInfo* lhs, const FrameInfo* rhs) {
+        return lhs->exclusive > rhs->exclusive;
+    });
+
+    out << "\nMethods:\n"sv;
+    out << setw(10) << "calls"sv << setw(14) << "inclusive ms"sv << setw(14) << "exclusive ms"sv
+        << "  method (line)\n"sv;
+    out << fixed << setprecision(3);
+    for (const auto* frame : frames) {
+        out << setw(10) << frame->calls << setw(14) << ToMilliseconds(frame->inclusive)
+            << setw(14) << ToMilliseconds(frame->exclusive) << "  "sv << frame->name << " ("sv
+            << frame->line << ")\n"sv;
+    }
+}
+
+void Profiler::PrintCollapsedStacks(std::ostream& out) const {
+    for (const auto& [path, self_time] : stacks_) {
+        bool first = true;
+        for (const size_t frame_id : path) {
+            if (!first) {
+                out << ';';
+            }
+            first = false;
+            out << frames_[frame_id].name;
+        }
+        out << ' ' << chrono::duration_cast<chrono::microseconds>(self_time).count() << '\n';
+    }
+}
+
+}  // namespace profile
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace profile {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Номер строки инструкции, выполняемой текущим потоком, либо 0, если строки не отслеживаются.
+    // Обновляется только в программах, разобранных с профилировщиком или с ParseOptions::track_lines
+    inline thread_local int current_line = 0;
+
+    // Устанавливает current_line на время своего существования
+    class LineScope {
+    public:
+        explicit LineScope(int line) noexcept
+            : saved_line_(current_line) {
+            current_line = line;
+        }
+
+        LineScope(const LineScope&) = delete;
+        LineScope& operator=(const LineScope&) = delete;
+
+        ~LineScope() {
+            current_line = saved_line_;
+        }
+
+    private:
+        int saved_line_;
+    };
+
+    /*
+     * Инструментирующий профилировщик программ Mython.
+     * Парсер регистрирует в нём строки с инструкциями и кадры (методы классов и тело программы),
+     * а узлы дерева, созданные в режиме профилирования, сообщают о выполнении инструкций,
+     * входе в кадр и выходе из него. Без профилировщика парсер не добавляет таких узлов,
+     * поэтому обычное выполнение не несёт накладных расходов.
+     * Профилировщик не потокобезопасен: одновременно с ним может выполняться одна программа
+     */
+    class Profiler {
+    public:
+        // Имя кадра, соответствующего телу программы
+        static constexpr char MODULE_FRAME[] = "<module>";
+
+        // Регистрирует кадр name, объявленный в строке line, и возвращает его идентификатор
+        size_t RegisterFrame(std::string name, int line);
+
+        // Регистрирует инструкцию, расположенную в строке line
+        void RegisterLine(int line);
+
+        // Учитывает выполнение инструкции в строке line
+        void CountLine(int line) {
+            ++line_hits_[line];
+        }
+
+        // Учитывает вход в кадр frame_id
+        void EnterFrame(size_t frame_id);
+        // Учитывает выход из последнего кадра, в который был выполнен вход
+        void ExitFrame();
+
+        // Выводит текстовый отчёт о числе выполнений строк и времени работы методов
+        void PrintReport(std::ostream& out) const;
+
+        // Выводит стеки вызовов в свёрнутом формате (collapsed stacks) для построения
+        // флеймграфов: "<module>;Class.method;Class.other <время в микросекундах>"
+        void PrintCollapsedStacks(std::ostream& out) const;
+
+    private:
+        struct FrameInfo {
+            std::string name;
+            int line = 0;
+            std::uint64_t calls = 0;
+            Clock::duration inclusive{};
+            Clock::duration exclusive{};
+            // Количество активаций кадра в текущем стеке. Время рекурсивных вызовов
+            // включается во inclusive только для самой внешней активации
+            int active = 0;
+        };
+
+        struct ActiveFrame {
+            Clock::time_point start;
+            Clock::duration children{};
+        };
+
+        std::vector<FrameInfo> frames_;
+        std::vector<std::uint64_t> line_hits_;
+        std::vector<ActiveFrame> stack_;
+        // Идентификаторы кадров текущего стека вызовов
+        std::vector<size_t> path_;
+        std::map<std::vector<size_t>, Clock::duration> stacks_;
+    };
+
+    // Учитывает вход в кадр при создании и выход из него при разрушении
+    class FrameGuard {
+    public:
+        FrameGuard(Profiler& profiler, size_t frame_id)
+            : profiler_(profiler) {
+            profiler_.EnterFrame(frame_id);
+        }
+
+        FrameGuard(const FrameGuard&) = delete;
+        FrameGuard& operator=(const FrameGuard&) = delete;
+
+        ~FrameGuard() {
+            profiler_.ExitFrame();
+        }
+
+    private:
+        Profiler& profiler_;
+    };
+
+}  // namespace profile
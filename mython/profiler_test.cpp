@@ -0,0 +1,89 @@
+#include "profiler.h"
+#include "program.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace profile {
+
+namespace {
+
+const string PROGRAM = R"(class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+f = Fib()
+print f.calc(4)
+)"s;
+
+void RunProfiled(const string& program, Profiler& profiler, ostream& output) {
+    istringstream input(program);
+    ParseOptions options;
+    options.profiler = &profiler;
+    const auto compiled = CompiledProgram::Compile(input, options);
+
+    runtime::SimpleContext context{output};
+    compiled.Run(context);
+}
+
+void TestProgramOutputIsUnchanged() {
+    Profiler profiler;
+    ostringstream output;
+    RunProfiled(PROGRAM, profiler, output);
+
+    ASSERT_EQUAL(output.str(), "3\n"s);
+}
+
+void TestReport() {
+    Profiler profiler;
+    ostringstream output;
+    RunProfiled(PROGRAM, profiler, output);
+
+    ostringstream report;
+    profiler.PrintReport(report);
+    const string text = report.str();
+
+    // fib(4) вызывает calc 9 раз, из них 5 раз с n < 2
+    ASSERT(text.find("       3           9\n"s) != string::npos);
+    ASSERT(text.find("       4           5\n"s) != string::npos);
+    ASSERT(text.find("       5           4\n"s) != string::npos);
+    ASSERT(text.find("       8           1\n"s) != string::npos);
+    ASSERT(text.find("  Fib.calc (2)\n"s) != string::npos);
+    ASSERT(text.find("  <module> (1)\n"s) != string::npos);
+}
+
+void TestCollapsedStacks() {
+    Profiler profiler;
+    ostringstream output;
+    RunProfiled(PROGRAM, profiler, output);
+
+    ostringstream stacks;
+    profiler.PrintCollapsedStacks(stacks);
+
+    vector<string> paths;
+    istringstream lines(stacks.str());
+    for (string path, time; lines >> path >> time;) {
+        ASSERT(time.find_first_not_of("0123456789"s) == string::npos);
+        paths.push_back(path);
+    }
+    const vector<string> expected = {
+        "<module>"s,
+        "<module>;Fib.calc"s,
+        "<module>;Fib.calc;Fib.calc"s,
+        "<module>;Fib.calc;Fib.calc;Fib.calc"s,
+        "<module>;Fib.calc;Fib.calc;Fib.calc;Fib.calc"s,
+    };
+    ASSERT_EQUAL(paths, expected);
+}
+
+}  // namespace
+
+void RunProfilerTests(TestRunner& tr) {
+    RUN_TEST(tr, profile::TestProgramOutputIsUnchanged);
+    RUN_TEST(tr, profile::TestReport);
+    RUN_TEST(tr, profile::TestCollapsedStacks);
+}
+
+}  // namespace profile
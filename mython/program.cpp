@@ -0,0 +1,39 @@
+#include "program.h"
+
+#include "lexer.h"
+
+using namespace std;
+
+CompiledProgram::CompiledProgram(std::shared_ptr<const runtime::Executable> tree)
+    : tree_(std::move(tree)) {
+}
+
+CompiledProgram CompiledProgram::Compile(std::istream& input, const ParseOptions& options) {
+    parse::LexerOptions lexer_options;
+    lexer_options.defer_method_bodies = options.lazy_methods && options.profiler == nullptr;
+    parse::Lexer lexer(input, lexer_options);
+    return CompiledProgram(ParseProgram(lexer, options));
+}
+
+runtime::ObjectHolder CompiledProgram::Run(runtime::Closure& closure,
+                                           runtime::Context& context) const {
+    // Узлы дерева не изменяют своего состояния во время выполнения (отложенные тела методов
+    // разбираются один раз и потокобезопасно), а интерфейс Executable не помечает Execute
+    // как const лишь по историческим причинам
+    return const_cast<runtime::Executable&>(*tree_).Execute(closure, context);
+}
+
+runtime::ObjectHolder CompiledProgram::Run(runtime::Context& context) const {
+    runtime::Closure closure;
+    return Run(closure, context);
+}
+
+runtime::ObjectHolder CompiledProgram::Run(
+    runtime::Closure& closure, runtime::Context& context,
+    const runtime::InterpreterStackOptions& stack_options) const {
+    runtime::ObjectHolder result;
+    runtime::RunOnInterpreterStack(context, stack_options, [&] {
+        result = Run(closure, context);
+    });
+    return result;
+}
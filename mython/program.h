@@ -0,0 +1,42 @@
+#pragma once
+
+#include "interpreter_stack.h"
+#include "parse.h"
+#include "runtime.h"
+
+#include <iosfwd>
+#include <memory>
+
+/*
+ * Скомпилированная программа Mython.
+ * После компиляции дерево программы не изменяется, поэтому одну и ту же программу можно
+ * выполнять многократно, в том числе одновременно из нескольких потоков. Тела методов,
+ * разбор которых отложен (ParseOptions::lazy_methods), разбираются при первом вызове
+ * в любом из запусков.
+ * Каждому запуску нужны собственные runtime::Context и runtime::Closure.
+ * Копии CompiledProgram разделяют одно и то же дерево программы.
+ */
+class CompiledProgram {
+public:
+    // Выполняет лексический и синтаксический разбор программы, читаемой из потока input.
+    // При ошибке разбора выбрасывает parse::LexerError либо ParseError
+    [[nodiscard]] static CompiledProgram Compile(std::istream& input,
+                                                 const ParseOptions& options = {});
+
+    // Выполняет программу, используя closure в качестве глобальной области видимости
+    runtime::ObjectHolder Run(runtime::Closure& closure, runtime::Context& context) const;
+
+    // Выполняет программу в новой пустой глобальной области видимости
+    runtime::ObjectHolder Run(runtime::Context& context) const;
+
+    // Выполняет программу на собственном стеке интерпретатора (см. runtime::RunOnInterpreterStack).
+    // Если глубина вызовов методов превысит stack_options.max_call_depth,
+    // выбрасывается runtime::RecursionDepthExceeded
+    runtime::ObjectHolder Run(runtime::Closure& closure, runtime::Context& context,
+                              const runtime::InterpreterStackOptions& stack_options) const;
+
+private:
+    explicit CompiledProgram(std::shared_ptr<const runtime::Executable> tree);
+
+    std::shared_ptr<const runtime::Executable> tree_;
+};
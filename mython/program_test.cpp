@@ -0,0 +1,205 @@
+#include "program.h"
+#include "test_runner_p.h"
+
+#include <optional>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const string COUNTER_PROGRAM = R"(
+class Counter:
+  def __init__(start):
+    self.value = start
+
+  def add(n):
+    self.value = self.value + n
+    return self
+
+c = Counter(10)
+c.add(5)
+print c.value, 'done'
+)"s;
+
+CompiledProgram CompileString(const string& program) {
+    istringstream input(program);
+    return CompiledProgram::Compile(input);
+}
+
+void TestRunTwice() {
+    const CompiledProgram program = CompileString(COUNTER_PROGRAM);
+
+    runtime::DummyContext first;
+    program.Run(first);
+    runtime::DummyContext second;
+    program.Run(second);
+
+    ASSERT_EQUAL(first.output.str(), "15 done\n"s);
+    ASSERT_EQUAL(second.output.str(), "15 done\n"s);
+}
+
+void TestClosureOutlivesProgram() {
+    runtime::Closure closure;
+    {
+        optional<CompiledProgram> program = CompileString("x = 57\ny = 'hello'\n"s);
+        runtime::DummyContext context;
+        program->Run(closure, context);
+    }
+
+    runtime::DummyContext context;
+    ostringstream out;
+    closure.at("x"s)->Print(out, context);
+    out << ' ';
+    closure.at("y"s)->Print(out, context);
+    ASSERT_EQUAL(out.str(), "57 hello"s);
+}
+
+void TestConcurrentRuns() {
+    const CompiledProgram program = CompileString(COUNTER_PROGRAM);
+
+    constexpr int THREAD_COUNT = 8;
+    constexpr int RUNS_PER_THREAD = 50;
+    vector<string> outputs(THREAD_COUNT);
+    vector<thread> threads;
+    for (int i = 0; i < THREAD_COUNT; ++i) {
+        threads.emplace_back([&program, &out = outputs[i]] {
+            for (int run = 0; run < RUNS_PER_THREAD; ++run) {
+                runtime::DummyContext context;
+                program.Run(context);
+                out += context.output.str();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    string expected;
+    for (int run = 0; run < RUNS_PER_THREAD; ++run) {
+        expected += "15 done\n"s;
+    }
+    for (const auto& out : outputs) {
+        ASSERT_EQUAL(out, expected);
+    }
+}
+
+void TestStepLimit() {
+    const CompiledProgram program = CompileString("x = 1\ny = 2\nprint x + y\n"s);
+
+    {
+        runtime::ExecutionBudget budget(3);
+        runtime::DummyContext context;
+        context.SetBudget(&budget);
+        program.Run(context);
+        ASSERT_EQUAL(context.output.str(), "3\n"s);
+        ASSERT_EQUAL(budget.UsedSteps(), 3U);
+    }
+    {
+        runtime::ExecutionBudget budget(2);
+        runtime::DummyContext context;
+        context.SetBudget(&budget);
+        ASSERT_THROWS(program.Run(context), runtime::StepLimitExceeded);
+        ASSERT(context.output.str().empty());
+    }
+}
+
+void TestRunawayRecursionIsAborted() {
+    const CompiledProgram program = CompileString(R"(
+class Loop:
+  def run(n):
+    return self.run(n + 1)
+
+l = Loop()
+l.run(0)
+)"s);
+
+    runtime::ExecutionBudget budget(2000);
+    runtime::DummyContext context;
+    context.SetBudget(&budget);
+    ASSERT_THROWS(program.Run(context), runtime::StepLimitExceeded);
+}
+
+void TestDeadline() {
+    const CompiledProgram program = CompileString(R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+f = Fib()
+print f.calc(30)
+)"s);
+
+    runtime::ExecutionBudget budget(nullopt, runtime::ExecutionBudget::Clock::now()
+                                                 + chrono::milliseconds(5));
+    runtime::DummyContext context;
+    context.SetBudget(&budget);
+    ASSERT_THROWS(program.Run(context), runtime::DeadlineExceeded);
+}
+
+const string COUNTDOWN_PROGRAM = R"(
+class Countdown:
+  def run(n):
+    if n > 0:
+      return self.run(n - 1)
+    return 'done'
+
+c = Countdown()
+print c.run(depth)
+)"s;
+
+string RunCountdown(int depth, const runtime::InterpreterStackOptions& stack_options) {
+    const CompiledProgram program = CompileString(COUNTDOWN_PROGRAM);
+    runtime::Closure closure{{"depth"s, runtime::ObjectHolder::Own(runtime::Number{depth})}};
+    runtime::DummyContext context;
+    program.Run(closure, context, stack_options);
+    ASSERT_EQUAL(context.GetCallDepth(), 0U);
+    return context.output.str();
+}
+
+void TestMaxCallDepth() {
+    const CompiledProgram program = CompileString(COUNTDOWN_PROGRAM);
+    runtime::Closure closure{{"depth"s, runtime::ObjectHolder::Own(runtime::Number{100})}};
+    runtime::DummyContext context;
+
+    context.SetMaxCallDepth(101);
+    program.Run(closure, context);
+    ASSERT_EQUAL(context.output.str(), "done\n"s);
+
+    context.SetMaxCallDepth(100);
+    ASSERT_THROWS(program.Run(closure, context), runtime::RecursionDepthExceeded);
+    ASSERT_EQUAL(context.GetCallDepth(), 0U);
+}
+
+void TestDeepRecursionOnInterpreterStack() {
+    runtime::InterpreterStackOptions stack_options;
+    stack_options.max_call_depth = 100000;
+    ASSERT_EQUAL(RunCountdown(50000, stack_options), "done\n"s);
+
+    stack_options.max_call_depth = 1000;
+    ASSERT_THROWS(RunCountdown(5000, stack_options), runtime::RecursionDepthExceeded);
+}
+
+void TestStackLimitPreventsOverflow() {
+    // Стека заведомо не хватает на заданную глубину: граница стека останавливает рекурсию
+    runtime::InterpreterStackOptions stack_options;
+    stack_options.max_call_depth = 200000;
+    stack_options.bytes_per_call = 16;
+    ASSERT_THROWS(RunCountdown(200000, stack_options), runtime::RecursionDepthExceeded);
+}
+
+}  // namespace
+
+void RunCompiledProgramTests(TestRunner& tr) {
+    RUN_TEST(tr, TestRunTwice);
+    RUN_TEST(tr, TestClosureOutlivesProgram);
+    RUN_TEST(tr, TestConcurrentRuns);
+    RUN_TEST(tr, TestStepLimit);
+    RUN_TEST(tr, TestRunawayRecursionIsAborted);
+    RUN_TEST(tr, TestDeadline);
+    RUN_TEST(tr, TestMaxCallDepth);
+    RUN_TEST(tr, TestDeepRecursionOnInterpreterStack);
+    RUN_TEST(tr, TestStackLimitPreventsOverflow);
+}
@@ -1,5 +1,8 @@
 #include "runtime.h"
 
+#include "sampler.h"
+
+#include <algorithm>
 #include <cassert>
 #include <optional>
 #include <sstream>
@@ -43,6 +46,38 @@ ObjectHolder::operator bool() const {
     return Get() != nullptr;
 }
 
+ExecutionBudget::ExecutionBudget(std::optional<std::uint64_t> max_steps,
+                                 std::optional<Clock::time_point> deadline)
+    : max_steps_(max_steps)
+    , deadline_(deadline) {
+}
+
+void Context::ThrowRecursionDepthExceeded() const {
+    throw RecursionDepthExceeded("Maximum call depth exceeded at depth "s
+                                 + to_string(call_depth_));
+}
+
+std::uint64_t ExecutionBudget::UsedSteps() const {
+    return granted_ + slice_size_ - slice_left_;
+}
+
+void ExecutionBudget::Refill() {
+    // Порция исчерпана: все её шаги выполнены
+    granted_ += slice_size_;
+    slice_size_ = 0;
+    if (max_steps_ && granted_ >= *max_steps_) {
+        throw StepLimitExceeded("Step limit of "s + to_string(*max_steps_) + " exceeded"s);
+    }
+    if (deadline_ && Clock::now() >= *deadline_) {
+        throw DeadlineExceeded("Execution deadline exceeded"s);
+    }
+    slice_size_ = CHECK_INTERVAL;
+    if (max_steps_) {
+        slice_size_ = std::min(slice_size_, *max_steps_ - granted_);
+    }
+    slice_left_ = slice_size_;
+}
+
 bool IsTrue(const ObjectHolder& object) {
     if (const auto* ptr = object.TryAs<Number>()) {
         return ptr->GetValue() != 0;
@@ -76,6 +111,10 @@ bool ClassInstance::HasMethod(const std::string& method, size_t argument_count)
     return false;
 }
 
+const Class& ClassInstance::GetClass() const {
+    return cls_;
+}
+
 Closure& ClassInstance::Fields() {
         
     return fields_;
@@ -88,18 +127,60 @@ const Closure& ClassInstance::Fields() const {
 
 ClassInstance::ClassInstance(const Class& cls) :cls_(cls) {}
 
+namespace {
+
+// Учитывает выход из метода при разрушении
+class CallDepthGuard {
+public:
+    explicit CallDepthGuard(Context& context)
+        : context_(context) {
+    }
+
+    CallDepthGuard(const CallDepthGuard&) = delete;
+    CallDepthGuard& operator=(const CallDepthGuard&) = delete;
+
+    ~CallDepthGuard() {
+        context_.ExitCall();
+    }
+
+private:
+    Context& context_;
+};
+
+}  // namespace
+
 ObjectHolder ClassInstance::Call(const std::string& method,
                                  const std::vector<ObjectHolder>& actual_args,
                                  Context& context) {
+    context.ChargeStep();
     // verify  is ptr = nullptr
     if (!HasMethod(method, actual_args.size())) {
         throw std::runtime_error("Not implemented"s);
     }
 
-    Closure symb_table;
-    symb_table["self"s] = ObjectHolder::Share(*this);
+    context.EnterCall();
+    CallDepthGuard depth_guard(context);
+
     // getting ptr to method
     const auto ptrMethod = cls_.GetMethod(method);
+    ptrMethod->runtime_data.CountCall();
+    // Вызывающий метод - на вершине теневого стека. Кадры глубже ShadowStack::MAX_DEPTH
+    // не сохраняются, и обратные дуги на такой глубине не учитываются
+    const profile::ShadowStack& shadow_stack = profile::CurrentShadowStack();
+    if (const size_t depth = shadow_stack.Depth();
+        depth > 0 && depth <= profile::ShadowStack::MAX_DEPTH
+        && shadow_stack.Frame(depth - 1).method == ptrMethod) {
+        ptrMethod->runtime_data.CountBackedge();
+    }
+    profile::ShadowFrameGuard shadow_frame(&cls_, ptrMethod);
+    if (CallAccelerator* accelerator = context.GetCallAccelerator()) {
+        if (auto result = accelerator->TryCall(*this, *ptrMethod, actual_args, context)) {
+            return std::move(*result);
+        }
+    }
+    // Таблица символов нужна только обходу дерева, поэтому создаётся после ускорителя
+    Closure symb_table;
+    symb_table["self"s] = ObjectHolder::Share(*this);
     // send params and call methods of object
     for (size_t i = 0; i < actual_args.size(); ++i) {
         symb_table[ptrMethod->formal_params[i]] = actual_args[i]; 
@@ -107,15 +188,62 @@ ObjectHolder ClassInstance::Call(const std::string& method,
     return ptrMethod->body->Execute(symb_table, context);
 }
 
+MethodRuntimeData::MethodRuntimeData(MethodRuntimeData&& other) noexcept
+    : calls_(other.calls_.load(std::memory_order_relaxed))
+    , backedges_(other.backedges_.load(std::memory_order_relaxed)) {
+    for (size_t i = 0; i < CODE_KINDS; ++i) {
+        code_[i].store(other.code_[i].exchange(nullptr, std::memory_order_acq_rel),
+                       std::memory_order_release);
+    }
+}
+
+MethodRuntimeData& MethodRuntimeData::operator=(MethodRuntimeData&& other) noexcept {
+    if (this != &other) {
+        calls_.store(other.calls_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        backedges_.store(other.backedges_.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+        for (size_t i = 0; i < CODE_KINDS; ++i) {
+            delete code_[i].exchange(other.code_[i].exchange(nullptr, std::memory_order_acq_rel),
+                                     std::memory_order_acq_rel);
+        }
+    }
+    return *this;
+}
+
+MethodRuntimeData::~MethodRuntimeData() {
+    for (auto& code : code_) {
+        delete code.load(std::memory_order_acquire);
+    }
+}
+
+const MethodCode* MethodRuntimeData::SetCode(CodeKind kind,
+                                             std::unique_ptr<MethodCode> code) noexcept {
+    const MethodCode* expected = nullptr;
+    if (code_[static_cast<size_t>(kind)].compare_exchange_strong(expected, code.get(),
+                                                                  std::memory_order_acq_rel)) {
+        return code.release();
+    }
+    return expected;
+}
+
+bool MethodRuntimeData::ReplaceCode(CodeKind kind, const MethodCode* expected,
+                                    std::unique_ptr<MethodCode> code) noexcept {
+    if (!code_[static_cast<size_t>(kind)].compare_exchange_strong(expected, code.get(),
+                                                                   std::memory_order_acq_rel)) {
+        return false;
+    }
+    code->replaced_.reset(expected);
+    code.release();
+    return true;
+}
+
 Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
     : name_(std::move(name))
     , methods_(std::move(methods))
     , parent_(parent)
 {
     if (parent_ != nullptr) {
-        for (const auto& method : parent_->methods_) {
-            name_to_method_[method.name] = &method;
-        }
+        name_to_method_ = parent_->name_to_method_;
     }
 
     for (const auto& method : methods_) {
@@ -131,10 +259,18 @@ const Method* Class::GetMethod(const std::string& name) const {
     return nullptr;
 }
 
-[[nodiscard]] inline const std::string& Class::GetName() const {
+const std::string& Class::GetName() const {
     return name_;
 }
 
+const std::vector<Method>& Class::GetMethods() const {
+    return methods_;
+}
+
+const Class* Class::GetParent() const {
+    return parent_;
+}
+
 void Class::Print(ostream& os, Context& /*context*/) {
     os << "Class " << GetName();
 }
@@ -1,21 +1,170 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace runtime {
 
+    // Исключение, прерывающее программу, которая исчерпала лимит выполнения
+    class ExecutionLimitExceeded : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Программа выполнила больше шагов, чем разрешено бюджетом
+    class StepLimitExceeded : public ExecutionLimitExceeded {
+    public:
+        using ExecutionLimitExceeded::ExecutionLimitExceeded;
+    };
+
+    // Программа не завершилась до крайнего срока
+    class DeadlineExceeded : public ExecutionLimitExceeded {
+    public:
+        using ExecutionLimitExceeded::ExecutionLimitExceeded;
+    };
+
+    // Глубина вложенных вызовов методов превысила допустимую
+    class RecursionDepthExceeded : public ExecutionLimitExceeded {
+    public:
+        using ExecutionLimitExceeded::ExecutionLimitExceeded;
+    };
+
+    /*
+     * Бюджет выполнения программы: максимальное число шагов (вызовов методов и инструкций
+     * составных инструкций) и крайний срок по монотонным часам.
+     * Шаги расходуются порциями, поэтому проверка на каждом шаге - это уменьшение счётчика,
+     * а часы и общий остаток проверяются лишь при исчерпании порции
+     */
+    class ExecutionBudget {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // Количество шагов между проверками крайнего срока
+        static constexpr std::uint64_t CHECK_INTERVAL = 1024;
+
+        // max_steps - разрешённое число шагов, nullopt - без ограничения.
+        // deadline - крайний срок, nullopt - без ограничения
+        explicit ExecutionBudget(std::optional<std::uint64_t> max_steps,
+            std::optional<Clock::time_point> deadline = std::nullopt);
+
+        // Учитывает один шаг выполнения. При исчерпании бюджета выбрасывает StepLimitExceeded,
+        // при наступлении крайнего срока - DeadlineExceeded
+        void Charge() {
+            if (slice_left_ == 0) {
+                Refill();
+            }
+            --slice_left_;
+        }
+
+        // Возвращает число выполненных шагов
+        [[nodiscard]] std::uint64_t UsedSteps() const;
+
+    private:
+        void Refill();
+
+        std::optional<std::uint64_t> max_steps_;
+        std::optional<Clock::time_point> deadline_;
+        // Шагов, выданных предыдущими порциями
+        std::uint64_t granted_ = 0;
+        std::uint64_t slice_size_ = 0;
+        std::uint64_t slice_left_ = 0;
+    };
+
+    class CallAccelerator;
+
     // Контекст исполнения инструкций Mython
     class Context {
     public:
         // Возвращает поток вывода для команд print
         virtual std::ostream& GetOutputStream() = 0;
 
+        // Устанавливает бюджет выполнения. Значение nullptr снимает ограничения
+        void SetBudget(ExecutionBudget* budget) {
+            budget_ = budget;
+        }
+
+        [[nodiscard]] ExecutionBudget* GetBudget() const {
+            return budget_;
+        }
+
+        // Учитывает шаг выполнения, если задан бюджет.
+        // Вызывается при входе в метод и перед каждой инструкцией составной инструкции
+        void ChargeStep() {
+            if (budget_ != nullptr) {
+                budget_->Charge();
+            }
+        }
+
+        // Ограничивает глубину вложенных вызовов методов. Значение 0 снимает ограничение
+        void SetMaxCallDepth(size_t max_depth) {
+            max_call_depth_ = max_depth;
+        }
+
+        // Задаёт наименьший адрес стека потока, при достижении которого новые вызовы методов
+        // не начинаются. Значение nullptr снимает ограничение
+        void SetStackLimit(const void* limit) {
+            stack_limit_ = reinterpret_cast<std::uintptr_t>(limit);
+        }
+
+        [[nodiscard]] size_t GetCallDepth() const {
+            return call_depth_;
+        }
+
+        // Возвращает наибольшую допустимую глубину вызовов либо 0, если она не ограничена
+        [[nodiscard]] size_t GetMaxCallDepth() const {
+            return max_call_depth_;
+        }
+
+        // Возвращает наименьший допустимый адрес стека потока либо 0, если он не ограничен
+        [[nodiscard]] std::uintptr_t GetStackLimit() const {
+            return stack_limit_;
+        }
+
+        // Учитывает вход в метод. Если глубина вызовов превысит допустимую либо стек потока
+        // подошёл к границе, выбрасывает RecursionDepthExceeded
+        void EnterCall() {
+            const char stack_marker = 0;
+            if ((max_call_depth_ != 0 && call_depth_ >= max_call_depth_)
+                || reinterpret_cast<std::uintptr_t>(&stack_marker) < stack_limit_) {
+                ThrowRecursionDepthExceeded();
+            }
+            ++call_depth_;
+        }
+
+        // Учитывает выход из метода
+        void ExitCall() noexcept {
+            --call_depth_;
+        }
+
+        // Устанавливает ускоритель вызовов методов. Значение nullptr отключает ускорение,
+        // и все методы выполняются обходом дерева
+        void SetCallAccelerator(CallAccelerator* accelerator) {
+            accelerator_ = accelerator;
+        }
+
+        [[nodiscard]] CallAccelerator* GetCallAccelerator() const {
+            return accelerator_;
+        }
+
     protected:
         ~Context() = default;
+
+    private:
+        [[noreturn]] void ThrowRecursionDepthExceeded() const;
+
+        ExecutionBudget* budget_ = nullptr;
+        size_t call_depth_ = 0;
+        size_t max_call_depth_ = 0;
+        std::uintptr_t stack_limit_ = 0;
+        CallAccelerator* accelerator_ = nullptr;
     };
 
     // Базовый класс для всех объектов языка Mython
@@ -26,6 +175,39 @@ namespace runtime {
         virtual void Print(std::ostream& os, Context& context) = 0;
     };
 
+    // Наблюдатель за размещением объектов в куче, используется для учёта размещений (см. census.h).
+    // Пока наблюдатель не установлен, ObjectHolder::Own размещает объекты без дополнительных затрат
+    class AllocationObserver : public std::enable_shared_from_this<AllocationObserver> {
+    public:
+        virtual ~AllocationObserver() = default;
+
+        // Вызывается после размещения объекта object размером bytes байт.
+        // Возвращает идентификатор места размещения, который будет передан в OnFree
+        virtual size_t OnAllocate(const Object& object, size_t bytes) = 0;
+        // Вызывается перед освобождением объекта, размещённого в месте site
+        virtual void OnFree(size_t site, size_t bytes) noexcept = 0;
+
+        // Возвращает текущего наблюдателя либо nullptr
+        [[nodiscard]] static AllocationObserver* Active() noexcept {
+            return active_.load(std::memory_order_relaxed);
+        }
+
+        // Делает observer текущим наблюдателем, если другого наблюдателя нет, и возвращает true.
+        // Наблюдатель должен принадлежать std::shared_ptr
+        static bool Activate(AllocationObserver* observer) noexcept {
+            AllocationObserver* expected = nullptr;
+            return active_.compare_exchange_strong(expected, observer);
+        }
+
+        // Отключает наблюдатель observer, если он текущий
+        static void Deactivate(AllocationObserver* observer) noexcept {
+            active_.compare_exchange_strong(observer, nullptr);
+        }
+
+    private:
+        static inline std::atomic<AllocationObserver*> active_ = nullptr;
+    };
+
     // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
     class ObjectHolder {
     public:
@@ -37,6 +219,9 @@ namespace runtime {
         // object копируется или перемещается в кучу
         template <typename T>
         [[nodiscard]] static ObjectHolder Own(T&& object) {
+            if (AllocationObserver* observer = AllocationObserver::Active()) {
+                return OwnObserved(std::forward<T>(object), *observer);
+            }
             return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
         }
 
@@ -67,6 +252,19 @@ namespace runtime {
         explicit ObjectHolder(std::shared_ptr<Object> data);
         void AssertIsValid() const;
 
+        // Размещает объект, сообщая наблюдателю о его размещении и освобождении
+        template <typename T>
+        static ObjectHolder OwnObserved(T&& object, AllocationObserver& observer) {
+            auto owner = observer.shared_from_this();
+            auto ptr = std::make_unique<T>(std::forward<T>(object));
+            const size_t site = observer.OnAllocate(*ptr, sizeof(T));
+            auto deleter = [owner = std::move(owner), site](T* p) {
+                owner->OnFree(site, sizeof(T));
+                delete p;
+            };
+            return ObjectHolder(std::shared_ptr<T>(ptr.release(), std::move(deleter)));
+        }
+
         std::shared_ptr<Object> data_;
     };
 
@@ -119,6 +317,83 @@ namespace runtime {
         void Print(std::ostream& os, Context& context) override;
     };
 
+    // Представление метода, созданное ускорителем вызовов (например, машинный код).
+    // Принадлежит методу и удаляется вместе с ним
+    class MethodCode {
+    public:
+        MethodCode() = default;
+        MethodCode(MethodCode&&) = default;
+        MethodCode& operator=(MethodCode&&) = default;
+        virtual ~MethodCode() = default;
+
+    private:
+        friend class MethodRuntimeData;
+
+        // Код, заменённый этим кодом (см. MethodRuntimeData::ReplaceCode)
+        std::unique_ptr<const MethodCode> replaced_;
+    };
+
+    // Вид представления метода. Метод хранит по одному представлению каждого вида
+    enum class CodeKind {
+        // Машинный код (см. jit.h)
+        Native,
+        // Байт-код виртуальной машины (см. vm.h)
+        Bytecode,
+        // Плоское дерево (см. flat_ast.h)
+        FlatTree,
+    };
+
+    // Сведения о выполнении метода, накапливаемые во время работы программы.
+    // Могут изменяться одновременно из нескольких потоков
+    class MethodRuntimeData {
+    public:
+        MethodRuntimeData() = default;
+        MethodRuntimeData(MethodRuntimeData&& other) noexcept;
+        MethodRuntimeData& operator=(MethodRuntimeData&& other) noexcept;
+        ~MethodRuntimeData();
+
+        // Учитывает вызов метода
+        void CountCall() noexcept {
+            calls_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint64_t GetCallCount() const noexcept {
+            return calls_.load(std::memory_order_relaxed);
+        }
+
+        // Учитывает вызов метода из него самого. В Mython нет циклов, и повторение
+        // выражается рекурсией, поэтому такой вызов - аналог обратной дуги цикла
+        void CountBackedge() noexcept {
+            backedges_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint64_t GetBackedgeCount() const noexcept {
+            return backedges_.load(std::memory_order_relaxed);
+        }
+
+        // Возвращает код метода вида kind, созданный ускорителем вызовов, либо nullptr
+        [[nodiscard]] const MethodCode* GetCode(CodeKind kind) const noexcept {
+            return code_[static_cast<size_t>(kind)].load(std::memory_order_acquire);
+        }
+
+        // Сохраняет code, если код метода вида kind ещё не задан, и возвращает код метода.
+        // Если код уже был задан другим потоком, code удаляется
+        const MethodCode* SetCode(CodeKind kind, std::unique_ptr<MethodCode> code) noexcept;
+
+        // Заменяет код метода вида kind, если он равен expected, и возвращает true.
+        // Прежний код может ещё выполняться в других потоках, поэтому он удаляется
+        // вместе с новым кодом
+        bool ReplaceCode(CodeKind kind, const MethodCode* expected,
+                         std::unique_ptr<MethodCode> code) noexcept;
+
+    private:
+        static constexpr size_t CODE_KINDS = 3;
+
+        std::atomic<std::uint64_t> calls_ = 0;
+        std::atomic<std::uint64_t> backedges_ = 0;
+        std::atomic<const MethodCode*> code_[CODE_KINDS] = {};
+    };
+
     // Метод класса
     struct Method {
         // Имя метода
@@ -127,6 +402,8 @@ namespace runtime {
         std::vector<std::string> formal_params;
         // Тело метода
         std::unique_ptr<Executable> body;
+        // Сведения о выполнении метода
+        mutable MethodRuntimeData runtime_data;
     };
 
     // Класс
@@ -142,6 +419,12 @@ namespace runtime {
         // Возвращает имя класса
         [[nodiscard]] const std::string& GetName() const;
 
+        // Возвращает методы, объявленные в самом классе (без унаследованных)
+        [[nodiscard]] const std::vector<Method>& GetMethods() const;
+
+        // Возвращает родительский класс либо nullptr для базового класса
+        [[nodiscard]] const Class* GetParent() const;
+
         // Выводит в os строку "Class <имя класса>", например "Class cat"
         void Print(std::ostream& os, Context& context) override;
 
@@ -175,6 +458,9 @@ namespace runtime {
         // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
         [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
 
+        // Возвращает класс объекта
+        [[nodiscard]] const Class& GetClass() const;
+
         // Возвращает ссылку на Closure, содержащий поля объекта
         [[nodiscard]] Closure& Fields();
         // Возвращает константную ссылку на Closure, содержащую поля объекта
@@ -184,6 +470,22 @@ namespace runtime {
         Closure fields_;
     };
 
+    /*
+     * Ускоритель вызовов методов, например JIT-компилятор (см. jit.h).
+     * ClassInstance::Call предлагает ему каждый вызов, прежде чем выполнить тело метода
+     * обходом дерева
+     */
+    class CallAccelerator {
+    public:
+        virtual ~CallAccelerator() = default;
+
+        // Выполняет метод method объекта self с параметрами args и возвращает результат либо
+        // возвращает nullopt, если метод нужно выполнить обходом дерева. Вызов, для которого
+        // возвращён nullopt, не должен оказывать видимых действий
+        virtual std::optional<ObjectHolder> TryCall(ClassInstance& self, const Method& method,
+            const std::vector<ObjectHolder>& args, Context& context) = 0;
+    };
+
     /*
      * Возвращает true, если lhs и rhs содержат одинаковые числа, строки или значения типа Bool.
      * Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs),
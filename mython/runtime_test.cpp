@@ -179,6 +179,13 @@ void TestMethodInvocation() {
 
     ASSERT(!child_inst.HasMethod("test"s, 1U));
     ASSERT_THROWS(child_inst.Call("test"s, {ObjectHolder::None()}, context), runtime_error);
+
+    Class grandchild_class{"Grandchild"s, {}, &child_class};
+    ClassInstance grandchild_inst{grandchild_class};
+    ASSERT(grandchild_inst.HasMethod("test"s, 2U));
+    ASSERT(grandchild_inst.HasMethod("test_2"s, 1U));
+    res = grandchild_inst.Call("test_2"s, {ObjectHolder::Own(Number{1})}, context);
+    ASSERT(Equal(res, ObjectHolder::Own(Number{456}), context));
 }
 
 void TestNonowning() {
@@ -544,9 +551,9 @@ void RunObjectsTests(TestRunner& tr) {
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
-    RUN_TEST(tr, runtime::TestNonowning);
-    RUN_TEST(tr, runtime::TestOwning);
-    RUN_TEST(tr, runtime::TestMove);
+    RUN_SERIAL_TEST(tr, runtime::TestNonowning);
+    RUN_SERIAL_TEST(tr, runtime::TestOwning);
+    RUN_SERIAL_TEST(tr, runtime::TestMove);
     RUN_TEST(tr, runtime::TestNullptr);
 }
 
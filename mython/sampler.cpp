@@ -0,0 +1,145 @@
+#include "sampler.h"
+
+#include "runtime.h"
+
+#include <algorithm>
+#include <csignal>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include <sys/time.h>
+
+using namespace std;
+
+namespace profile {
+
+namespace {
+
+// Профилировщик, получающий сигналы SIGPROF
+atomic<SamplingProfiler*> active_profiler = nullptr;
+
+// Среднее число кадров на семпл, под которое резервируется буфер кадров
+constexpr size_t FRAMES_PER_SAMPLE = 16;
+
+void SetTimer(int frequency_hz) {
+    itimerval timer{};
+    if (frequency_hz > 0) {
+        const long interval_us = max(1L, 1000000L / frequency_hz);
+        timer.it_interval.tv_sec = interval_us / 1000000L;
+        timer.it_interval.tv_usec = interval_us % 1000000L;
+        timer.it_value = timer.it_interval;
+    }
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+}  // namespace
+
+ShadowStack& CurrentShadowStack() noexcept {
+    thread_local ShadowStack stack;
+    return stack;
+}
+
+SamplingProfiler::SamplingProfiler(int frequency_hz, size_t max_samples)
+    : frequency_hz_(frequency_hz)
+    , samples_(max_samples)
+    , frames_(max_samples * FRAMES_PER_SAMPLE) {
+    if (frequency_hz <= 0) {
+        throw std::invalid_argument("Sampling frequency must be positive"s);
+    }
+}
+
+SamplingProfiler::~SamplingProfiler() {
+    Stop();
+}
+
+void SamplingProfiler::Start() {
+    if (running_) {
+        return;
+    }
+    SamplingProfiler* expected = nullptr;
+    if (!active_profiler.compare_exchange_strong(expected, this)) {
+        throw std::logic_error("Another sampling profiler is already running"s);
+    }
+
+    struct sigaction action {};
+    action.sa_handler = &SamplingProfiler::HandleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &action, nullptr);
+
+    running_ = true;
+    SetTimer(frequency_hz_);
+}
+
+void SamplingProfiler::Stop() {
+    if (!running_) {
+        return;
+    }
+    SetTimer(0);
+    signal(SIGPROF, SIG_IGN);
+    active_profiler = nullptr;
+    running_ = false;
+}
+
+size_t SamplingProfiler::SampleCount() const {
+    return taken_count_;
+}
+
+size_t SamplingProfiler::DroppedCount() const {
+    return dropped_count_;
+}
+
+void SamplingProfiler::HandleSignal(int /*signal*/) {
+    if (auto* profiler = active_profiler.load(memory_order_relaxed)) {
+        profiler->TakeSample();
+    }
+}
+
+void SamplingProfiler::TakeSample() noexcept {
+    const ShadowStack& stack = CurrentShadowStack();
+    atomic_signal_fence(memory_order_acquire);
+    const size_t depth = min(stack.Depth(), ShadowStack::MAX_DEPTH);
+
+    const size_t index = next_sample_.fetch_add(1, memory_order_relaxed);
+    if (index >= samples_.size()) {
+        dropped_count_.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    const size_t offset = next_frame_.fetch_add(depth, memory_order_relaxed);
+    if (offset + depth > frames_.size()) {
+        dropped_count_.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    for (size_t i = 0; i < depth; ++i) {
+        frames_[offset + i] = stack.Frame(i);
+    }
+    samples_[index] = {offset, depth, true};
+    taken_count_.fetch_add(1, memory_order_relaxed);
+}
+
+void SamplingProfiler::PrintCollapsedStacks(std::ostream& out) const {
+    map<string, size_t> stacks;
+    const size_t count = min(next_sample_.load(), samples_.size());
+    for (size_t i = 0; i < count; ++i) {
+        const Sample& sample = samples_[i];
+        if (!sample.valid) {
+            continue;
+        }
+        string path = "<module>"s;
+        for (size_t frame = 0; frame < sample.depth; ++frame) {
+            const ShadowFrame& shadow = frames_[sample.offset + frame];
+            path += ';';
+            path += shadow.cls->GetName();
+            path += '.';
+            path += shadow.method->name;
+        }
+        ++stacks[path];
+    }
+    for (const auto& [path, samples] : stacks) {
+        out << path << ' ' << samples << '\n';
+    }
+}
+
+}  // namespace profile
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+namespace runtime {
+class Class;
+struct Method;
+}  // namespace runtime
+
+namespace profile {
+
+    // Кадр теневого стека вызовов Mython: класс объекта и вызванный метод
+    struct ShadowFrame {
+        const runtime::Class* cls = nullptr;
+        const runtime::Method* method = nullptr;
+    };
+
+    /*
+     * Теневой стек вызовов методов Mython текущего потока.
+     * Поддерживается ClassInstance::Call и читается обработчиком сигнала SIGPROF,
+     * поэтому хранится в массиве фиксированного размера и не выделяет память.
+     * Кадры глубже MAX_DEPTH не сохраняются, но учитываются в глубине стека
+     */
+    class ShadowStack {
+    public:
+        static constexpr size_t MAX_DEPTH = 128;
+
+        void Push(const runtime::Class* cls, const runtime::Method* method) noexcept {
+            if (depth_ < MAX_DEPTH) {
+                frames_[depth_] = {cls, method};
+            }
+            // Кадр должен быть записан до того, как его увидит обработчик сигнала
+            std::atomic_signal_fence(std::memory_order_release);
+            ++depth_;
+        }
+
+        void Pop() noexcept {
+            --depth_;
+            std::atomic_signal_fence(std::memory_order_release);
+        }
+
+        [[nodiscard]] size_t Depth() const noexcept {
+            return depth_;
+        }
+
+        [[nodiscard]] const ShadowFrame& Frame(size_t index) const noexcept {
+            return frames_[index];
+        }
+
+    private:
+        ShadowFrame frames_[MAX_DEPTH];
+        volatile size_t depth_ = 0;
+    };
+
+    // Возвращает теневой стек текущего потока
+    ShadowStack& CurrentShadowStack() noexcept;
+
+    // Добавляет кадр в теневой стек текущего потока при создании и удаляет при разрушении
+    class ShadowFrameGuard {
+    public:
+        ShadowFrameGuard(const runtime::Class* cls, const runtime::Method* method) noexcept
+            : stack_(CurrentShadowStack()) {
+            stack_.Push(cls, method);
+        }
+
+        ShadowFrameGuard(const ShadowFrameGuard&) = delete;
+        ShadowFrameGuard& operator=(const ShadowFrameGuard&) = delete;
+
+        ~ShadowFrameGuard() {
+            stack_.Pop();
+        }
+
+    private:
+        ShadowStack& stack_;
+    };
+
+    /*
+     * Семплирующий профилировщик. По таймеру setitimer(ITIMER_PROF) процесс получает сигнал
+     * SIGPROF, обработчик которого копирует теневой стек прерванного потока в заранее
+     * выделенный буфер. Одновременно может работать только один профилировщик.
+     * Классы и методы из собранных семплов должны существовать до вывода результатов
+     */
+    class SamplingProfiler {
+    public:
+        // frequency_hz - частота семплирования (по процессорному времени процесса),
+        // max_samples - вместимость буфера семплов
+        explicit SamplingProfiler(int frequency_hz = 99, size_t max_samples = 1 << 16);
+
+        SamplingProfiler(const SamplingProfiler&) = delete;
+        SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+        ~SamplingProfiler();
+
+        // Запускает сбор семплов. Если уже работает другой профилировщик,
+        // выбрасывает исключение std::logic_error
+        void Start();
+        // Останавливает сбор семплов
+        void Stop();
+
+        // Возвращает количество собранных семплов
+        [[nodiscard]] size_t SampleCount() const;
+        // Возвращает количество семплов, не поместившихся в буфер
+        [[nodiscard]] size_t DroppedCount() const;
+
+        // Выводит семплы в свёрнутом формате, который принимают flamegraph.pl,
+        // speedscope и аналогичные инструменты: "<module>;Class.method;... <число семплов>"
+        void PrintCollapsedStacks(std::ostream& out) const;
+
+    private:
+        // Семпл занимает depth подряд идущих кадров буфера frames_, начиная с offset
+        struct Sample {
+            size_t offset = 0;
+            size_t depth = 0;
+            bool valid = false;
+        };
+
+        static void HandleSignal(int signal);
+        void TakeSample() noexcept;
+
+        int frequency_hz_;
+        std::vector<Sample> samples_;
+        std::vector<ShadowFrame> frames_;
+        std::atomic<size_t> next_sample_ = 0;
+        std::atomic<size_t> next_frame_ = 0;
+        std::atomic<size_t> taken_count_ = 0;
+        std::atomic<size_t> dropped_count_ = 0;
+        bool running_ = false;
+    };
+
+}  // namespace profile
@@ -0,0 +1,82 @@
+#include "program.h"
+#include "sampler.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace profile {
+
+namespace {
+
+void TestShadowStackFollowsCalls() {
+    const string program = R"(
+class Probe:
+  def outer():
+    return self.inner()
+
+  def inner():
+    return 1
+
+p = Probe()
+print p.outer()
+)"s;
+    istringstream input(program);
+    const auto compiled = CompiledProgram::Compile(input);
+
+    const size_t depth_before = CurrentShadowStack().Depth();
+    runtime::DummyContext context;
+    compiled.Run(context);
+
+    ASSERT_EQUAL(context.output.str(), "1\n"s);
+    ASSERT_EQUAL(CurrentShadowStack().Depth(), depth_before);
+}
+
+void TestShadowFrameGuard() {
+    ShadowStack& stack = CurrentShadowStack();
+    const size_t depth = stack.Depth();
+    {
+        ShadowFrameGuard guard(nullptr, nullptr);
+        ASSERT_EQUAL(stack.Depth(), depth + 1);
+        ASSERT(stack.Frame(depth).method == nullptr);
+    }
+    ASSERT_EQUAL(stack.Depth(), depth);
+}
+
+void TestSamplingCollectsMythonStacks() {
+    const string program = R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+f = Fib()
+print f.calc(20)
+)"s;
+    istringstream input(program);
+    const auto compiled = CompiledProgram::Compile(input);
+
+    SamplingProfiler profiler(1000);
+    profiler.Start();
+    ASSERT_THROWS(SamplingProfiler(1000).Start(), std::logic_error);
+    runtime::DummyContext context;
+    compiled.Run(context);
+    profiler.Stop();
+
+    ASSERT_EQUAL(context.output.str(), "6765\n"s);
+    ASSERT(profiler.SampleCount() > 0);
+
+    ostringstream stacks;
+    profiler.PrintCollapsedStacks(stacks);
+    ASSERT(stacks.str().find("<module>;Fib.calc;Fib.calc"s) != string::npos);
+}
+
+}  // namespace
+
+void RunSamplerTests(TestRunner& tr) {
+    RUN_TEST(tr, profile::TestShadowStackFollowsCalls);
+    RUN_TEST(tr, profile::TestShadowFrameGuard);
+    RUN_SERIAL_TEST(tr, profile::TestSamplingCollectsMythonStacks);
+}
+
+}  // namespace profile
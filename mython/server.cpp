@@ -0,0 +1,409 @@
+#include "server.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t OUTPUT_FRAME_SIZE = 4096;
+
+// Буфер потока вывода программы, отправляющий данные клиенту кадрами OUT
+class FrameBuffer : public streambuf {
+public:
+    explicit FrameBuffer(UnixSocket& connection)
+        : connection_(connection)
+        , data_(OUTPUT_FRAME_SIZE) {
+        setp(data_.data(), data_.data() + data_.size());
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        SendFrame();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        SendFrame();
+        return 0;
+    }
+
+private:
+    void SendFrame() {
+        const size_t size = pptr() - pbase();
+        if (size > 0) {
+            connection_.WriteAll("OUT "s + to_string(size) + '\n');
+            connection_.WriteAll({pbase(), size});
+            setp(data_.data(), data_.data() + data_.size());
+        }
+    }
+
+    UnixSocket& connection_;
+    vector<char> data_;
+};
+
+vector<string> SplitWords(const string& line) {
+    vector<string> words;
+    istringstream in(line);
+    for (string word; in >> word;) {
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+size_t ParseSize(const string& word) {
+    size_t pos = 0;
+    const unsigned long long value = stoull(word, &pos);
+    if (pos != word.size()) {
+        throw invalid_argument("Bad number "s + word);
+    }
+    return value;
+}
+
+template <typename T>
+optional<T> ParseLimit(const string& word) {
+    if (word == "-"s) {
+        return nullopt;
+    }
+    return T(ParseSize(word));
+}
+
+// Возвращает более строгое из двух ограничений
+template <typename T>
+optional<T> Stricter(const optional<T>& lhs, const optional<T>& rhs) {
+    if (lhs && rhs) {
+        return min(*lhs, *rhs);
+    }
+    return lhs ? lhs : rhs;
+}
+
+template <typename T>
+string FormatLimit(const optional<T>& limit) {
+    if (!limit) {
+        return "-"s;
+    }
+    if constexpr (is_same_v<T, chrono::milliseconds>) {
+        return to_string(limit->count());
+    } else {
+        return to_string(*limit);
+    }
+}
+
+string ProgramId(const string& source) {
+    ostringstream out;
+    out << hex << setw(16) << setfill('0') << hash<string>{}(source);
+    return out.str();
+}
+
+void SendError(UnixSocket& connection, const string& message) {
+    connection.WriteAll("END error "s + to_string(message.size()) + '\n' + message);
+}
+
+}  // namespace
+
+ProgramCache::ProgramCache(size_t capacity)
+    : capacity_(max<size_t>(capacity, 1)) {
+}
+
+const ProgramCache::Entry& ProgramCache::Touch(list<Entry>::iterator it) {
+    entries_.splice(entries_.begin(), entries_, it);
+    return entries_.front();
+}
+
+pair<string, CompiledProgram> ProgramCache::GetOrCompile(const string& source) {
+    string id = ProgramId(source);
+    {
+        lock_guard lock(mutex_);
+        if (const auto it = by_id_.find(id); it != by_id_.end() && it->second->source == source) {
+            ++hits_;
+            return {std::move(id), Touch(it->second).program};
+        }
+        ++misses_;
+    }
+
+    // Компиляция выполняется без блокировки, чтобы не задерживать другие запросы
+    istringstream input(source);
+    CompiledProgram program = CompiledProgram::Compile(input);
+
+    lock_guard lock(mutex_);
+    if (const auto it = by_id_.find(id); it != by_id_.end()) {
+        entries_.erase(it->second);
+        by_id_.erase(it);
+    }
+    entries_.push_front({id, source, program});
+    by_id_[id] = entries_.begin();
+    if (entries_.size() > capacity_) {
+        by_id_.erase(entries_.back().id);
+        entries_.pop_back();
+    }
+    return {std::move(id), std::move(program)};
+}
+
+optional<CompiledProgram> ProgramCache::Find(const string& id) {
+    lock_guard lock(mutex_);
+    const auto it = by_id_.find(id);
+    if (it == by_id_.end()) {
+        ++misses_;
+        return nullopt;
+    }
+    ++hits_;
+    return Touch(it->second).program;
+}
+
+uint64_t ProgramCache::GetHits() const {
+    lock_guard lock(mutex_);
+    return hits_;
+}
+
+uint64_t ProgramCache::GetMisses() const {
+    lock_guard lock(mutex_);
+    return misses_;
+}
+
+MythonServer::MythonServer(ServerOptions options)
+    : options_(std::move(options))
+    , listener_(UnixSocket::Listen(options_.socket_path))
+    , cache_(options_.cache_capacity)
+    , free_slots_(options_.jobs > 0 ? options_.jobs : max(thread::hardware_concurrency(), 1U)) {
+}
+
+void MythonServer::Serve() {
+    while (!stopping_) {
+        UnixSocket connection = listener_.Accept();
+        if (!connection.IsValid()) {
+            break;
+        }
+        {
+            lock_guard lock(connections_mutex_);
+            ++handlers_;
+        }
+        thread([this, connection = std::move(connection)]() mutable {
+            HandleConnection(connection);
+        }).detach();
+    }
+    unique_lock lock(connections_mutex_);
+    connections_closed_.wait(lock, [this] {
+        return handlers_ == 0;
+    });
+}
+
+void MythonServer::Stop() {
+    stopping_ = true;
+    listener_.Shutdown();
+    lock_guard lock(connections_mutex_);
+    for (auto* connection : connections_) {
+        connection->Shutdown();
+    }
+}
+
+MythonServer::Stats MythonServer::GetStats() const {
+    return {requests_, errors_, cache_.GetHits(), cache_.GetMisses()};
+}
+
+void MythonServer::AcquireSlot() {
+    unique_lock lock(slots_mutex_);
+    slot_released_.wait(lock, [this] {
+        return free_slots_ > 0;
+    });
+    --free_slots_;
+}
+
+void MythonServer::ReleaseSlot() {
+    {
+        lock_guard lock(slots_mutex_);
+        ++free_slots_;
+    }
+    slot_released_.notify_one();
+}
+
+void MythonServer::HandleConnection(UnixSocket& connection) {
+    {
+        lock_guard lock(connections_mutex_);
+        connections_.insert(&connection);
+        if (stopping_) {
+            connection.Shutdown();
+        }
+    }
+    try {
+        for (string header; connection.ReadLine(header);) {
+            if (!HandleRequest(connection, header)) {
+                break;
+            }
+        }
+    } catch (const exception&) {
+        // Клиент закрыл соединение во время ответа
+    }
+    lock_guard lock(connections_mutex_);
+    connections_.erase(&connection);
+    --handlers_;
+    // Уведомление под мьютексом: после его освобождения Serve может вернуть управление
+    // и объект сервера может быть разрушен
+    connections_closed_.notify_all();
+}
+
+bool MythonServer::HandleRequest(UnixSocket& connection, const string& header) {
+    ++requests_;
+    const vector<string> words = SplitWords(header);
+    string source;
+    string input;
+    RunLimits limits;
+    optional<CompiledProgram> program;
+    try {
+        const auto check_size = [this](size_t size) {
+            if (size > options_.max_request_size) {
+                throw length_error("Request is too large"s);
+            }
+            return size;
+        };
+        if (words.size() == 2 && words[0] == "COMPILE"s) {
+            source = connection.ReadExactly(check_size(ParseSize(words[1])));
+        } else if (words.size() == 5 && (words[0] == "RUN"s || words[0] == "EXEC"s)) {
+            if (words[0] == "RUN"s) {
+                source = connection.ReadExactly(check_size(ParseSize(words[1])));
+            }
+            input = connection.ReadExactly(check_size(ParseSize(words[2])));
+            limits.max_steps = ParseLimit<uint64_t>(words[3]);
+            limits.timeout = ParseLimit<chrono::milliseconds>(words[4]);
+        } else {
+            throw invalid_argument("Bad request: "s + header);
+        }
+    } catch (const exception& e) {
+        // Границы следующего запроса неизвестны, поэтому соединение закрывается
+        ++errors_;
+        SendError(connection, e.what());
+        return false;
+    }
+
+    try {
+        if (words[0] == "COMPILE"s) {
+            connection.WriteAll("ID "s + cache_.GetOrCompile(source).first + '\n');
+            return true;
+        }
+        if (words[0] == "RUN"s) {
+            program = cache_.GetOrCompile(source).second;
+        } else {
+            program = cache_.Find(words[1]);
+            if (!program) {
+                throw invalid_argument("Unknown program id "s + words[1]);
+            }
+        }
+    } catch (const exception& e) {
+        ++errors_;
+        SendError(connection, e.what());
+        return true;
+    }
+    Execute(connection, *program, input, limits);
+    return true;
+}
+
+void MythonServer::Execute(UnixSocket& connection, const CompiledProgram& program,
+                           const string& input, const RunLimits& limits) {
+    FrameBuffer buffer(connection);
+    ostream output(&buffer);
+    // Ошибка отправки вывода прерывает выполнение программы
+    output.exceptions(ios::badbit);
+    runtime::SimpleContext context{output};
+
+    const auto max_steps = Stricter(options_.limits.max_steps, limits.max_steps);
+    const auto timeout = Stricter(options_.limits.timeout, limits.timeout);
+    optional<runtime::ExecutionBudget::Clock::time_point> deadline;
+    if (timeout) {
+        deadline = runtime::ExecutionBudget::Clock::now() + *timeout;
+    }
+    runtime::ExecutionBudget budget(max_steps, deadline);
+    if (max_steps || deadline) {
+        context.SetBudget(&budget);
+    }
+
+    runtime::Closure closure;
+    closure["input"s] = runtime::ObjectHolder::Own(runtime::String{input});
+    runtime::InterpreterStackOptions stack_options;
+    stack_options.max_call_depth = options_.max_call_depth;
+    string error;
+    AcquireSlot();
+    try {
+        program.Run(closure, context, stack_options);
+    } catch (const exception& e) {
+        error = e.what();
+    }
+    ReleaseSlot();
+    output.flush();
+    if (error.empty()) {
+        connection.WriteAll("END ok\n"sv);
+    } else {
+        ++errors_;
+        SendError(connection, error);
+    }
+}
+
+MythonClient::MythonClient(const string& socket_path)
+    : socket_(UnixSocket::Connect(socket_path)) {
+}
+
+string MythonClient::Compile(const string& source) {
+    socket_.WriteAll("COMPILE "s + to_string(source.size()) + '\n' + source);
+    string line;
+    if (!socket_.ReadLine(line)) {
+        throw runtime_error("Connection closed"s);
+    }
+    const vector<string> words = SplitWords(line);
+    if (words.size() == 2 && words[0] == "ID"s) {
+        return words[1];
+    }
+    if (words.size() == 3 && words[0] == "END"s && words[1] == "error"s) {
+        throw runtime_error(socket_.ReadExactly(ParseSize(words[2])));
+    }
+    throw runtime_error("Bad reply: "s + line);
+}
+
+RunReply MythonClient::Run(const string& source, const string& input, const RunLimits& limits,
+                           ostream* stream) {
+    socket_.WriteAll("RUN "s + to_string(source.size()) + ' ' + to_string(input.size()) + ' '
+                     + FormatLimit(limits.max_steps) + ' ' + FormatLimit(limits.timeout) + '\n'
+                     + source + input);
+    return ReadRunReply(stream);
+}
+
+RunReply MythonClient::Exec(const string& program_id, const string& input,
+                            const RunLimits& limits, ostream* stream) {
+    socket_.WriteAll("EXEC "s + program_id + ' ' + to_string(input.size()) + ' '
+                     + FormatLimit(limits.max_steps) + ' ' + FormatLimit(limits.timeout) + '\n'
+                     + input);
+    return ReadRunReply(stream);
+}
+
+RunReply MythonClient::ReadRunReply(ostream* stream) {
+    RunReply reply;
+    for (string line; socket_.ReadLine(line);) {
+        const vector<string> words = SplitWords(line);
+        if (words.size() == 2 && words[0] == "OUT"s) {
+            const string data = socket_.ReadExactly(ParseSize(words[1]));
+            if (stream) {
+                stream->write(data.data(), data.size());
+            } else {
+                reply.output += data;
+            }
+        } else if (words.size() == 2 && words[0] == "END"s && words[1] == "ok"s) {
+            return reply;
+        } else if (words.size() == 3 && words[0] == "END"s && words[1] == "error"s) {
+            reply.ok = false;
+            reply.error = socket_.ReadExactly(ParseSize(words[2]));
+            return reply;
+        } else {
+            throw runtime_error("Bad reply: "s + line);
+        }
+    }
+    throw runtime_error("Connection closed"s);
+}
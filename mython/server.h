@@ -0,0 +1,165 @@
+#pragma once
+
+#include "program.h"
+#include "unix_socket.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * Сервер Mython принимает запросы через сокет домена Unix.
+ * Запрос - строка заголовка, за которой следуют указанные в ней данные:
+ *   COMPILE <source_size>\n<source>
+ *       компилирует программу и отвечает "ID <program_id>\n"
+ *   RUN <source_size> <input_size> <max_steps|-> <timeout_ms|->\n<source><input>
+ *   EXEC <program_id> <input_size> <max_steps|-> <timeout_ms|->\n<input>
+ *       выполняют программу, переданную текстом либо идентификатором
+ * Строка input доступна программе как глобальная переменная input.
+ * Вывод программы передаётся по мере выполнения кадрами "OUT <size>\n<data>".
+ * Ответ на любой запрос завершается строкой "END ok\n" либо "END error <size>\n<message>";
+ * после успешного COMPILE строка END не передаётся.
+ * По одному соединению можно передать любое число запросов
+ */
+
+// Ограничения выполнения одного запроса
+struct RunLimits {
+    std::optional<std::uint64_t> max_steps;
+    std::optional<std::chrono::milliseconds> timeout;
+};
+
+struct ServerOptions {
+    std::string socket_path;
+    // Число программ, выполняемых одновременно. 0 - по числу процессоров
+    size_t jobs = 0;
+    // Число скомпилированных программ в кэше
+    size_t cache_capacity = 1024;
+    // Ограничения, действующие на каждый запрос. Запрос может только ужесточить их
+    RunLimits limits;
+    // Максимальная глубина вызовов методов
+    size_t max_call_depth = 10000;
+    // Максимальный объём текста программы и входных данных в одном запросе
+    size_t max_request_size = 16 * 1024 * 1024;
+};
+
+/*
+ * Кэш скомпилированных программ с вытеснением давно не использовавшихся.
+ * Идентификатор программы вычисляется по её тексту, поэтому одинаковые программы
+ * компилируются один раз. Методы можно вызывать из нескольких потоков
+ */
+class ProgramCache {
+public:
+    explicit ProgramCache(size_t capacity);
+
+    // Возвращает идентификатор и программу, компилируя её, если её нет в кэше.
+    // Ошибки разбора передаются вызывающему
+    std::pair<std::string, CompiledProgram> GetOrCompile(const std::string& source);
+
+    // Возвращает программу по идентификатору либо nullopt, если она вытеснена из кэша
+    std::optional<CompiledProgram> Find(const std::string& id);
+
+    [[nodiscard]] std::uint64_t GetHits() const;
+    [[nodiscard]] std::uint64_t GetMisses() const;
+
+private:
+    struct Entry {
+        std::string id;
+        std::string source;
+        CompiledProgram program;
+    };
+
+    // Переносит запись в начало списка. Вызывается под mutex_
+    const Entry& Touch(std::list<Entry>::iterator it);
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> by_id_;
+    std::uint64_t hits_ = 0;
+    std::uint64_t misses_ = 0;
+};
+
+class MythonServer {
+public:
+    struct Stats {
+        std::uint64_t requests = 0;
+        std::uint64_t errors = 0;
+        std::uint64_t cache_hits = 0;
+        std::uint64_t cache_misses = 0;
+    };
+
+    // Создаёт слушающий сокет. Соединения принимаются после вызова Serve
+    explicit MythonServer(ServerOptions options);
+
+    // Обслуживает соединения, пока не будет вызван Stop. Каждое соединение читается
+    // своим потоком, а одновременно выполняется не больше options.jobs программ
+    void Serve();
+
+    // Прекращает приём соединений и закрывает открытые. Можно вызывать из любого потока
+    void Stop();
+
+    [[nodiscard]] Stats GetStats() const;
+
+private:
+    void HandleConnection(UnixSocket& connection);
+    // Захватывает один из options_.jobs слотов выполнения программ
+    void AcquireSlot();
+    void ReleaseSlot();
+    // Обрабатывает один запрос. Возвращает false, если соединение нужно закрыть
+    bool HandleRequest(UnixSocket& connection, const std::string& header);
+    void Execute(UnixSocket& connection, const CompiledProgram& program, const std::string& input,
+                 const RunLimits& limits);
+
+    ServerOptions options_;
+    UnixSocket listener_;
+    ProgramCache cache_;
+    std::atomic<bool> stopping_{false};
+    std::mutex connections_mutex_;
+    std::condition_variable connections_closed_;
+    std::set<UnixSocket*> connections_;
+    size_t handlers_ = 0;
+    std::mutex slots_mutex_;
+    std::condition_variable slot_released_;
+    size_t free_slots_ = 0;
+    std::atomic<std::uint64_t> requests_{0};
+    std::atomic<std::uint64_t> errors_{0};
+};
+
+// Ответ сервера на запрос выполнения программы
+struct RunReply {
+    bool ok = true;
+    // Вывод программы, если он не передавался в поток по мере получения
+    std::string output;
+    std::string error;
+};
+
+// Клиент сервера Mython. Один клиент держит одно соединение
+class MythonClient {
+public:
+    explicit MythonClient(const std::string& socket_path);
+
+    // Компилирует программу на сервере и возвращает её идентификатор.
+    // При ошибке разбора выбрасывает std::runtime_error
+    std::string Compile(const std::string& source);
+
+    // Выполняет программу. Если stream не равен nullptr, вывод программы записывается в него
+    // по мере получения, иначе возвращается в RunReply::output
+    RunReply Run(const std::string& source, const std::string& input = {},
+                 const RunLimits& limits = {}, std::ostream* stream = nullptr);
+    RunReply Exec(const std::string& program_id, const std::string& input = {},
+                  const RunLimits& limits = {}, std::ostream* stream = nullptr);
+
+private:
+    RunReply ReadRunReply(std::ostream* stream);
+
+    UnixSocket socket_;
+};
@@ -0,0 +1,138 @@
+#include "server.h"
+#include "test_runner_p.h"
+
+#include <filesystem>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Сервер, работающий в отдельном потоке на время теста
+class TestServer {
+public:
+    explicit TestServer(ServerOptions options = {})
+        : server_(WithSocketPath(std::move(options)))
+        , thread_([this] {
+            server_.Serve();
+        }) {
+    }
+
+    TestServer(const TestServer&) = delete;
+    TestServer& operator=(const TestServer&) = delete;
+
+    ~TestServer() {
+        server_.Stop();
+        thread_.join();
+        filesystem::remove(path_);
+    }
+
+    MythonServer& Get() {
+        return server_;
+    }
+
+    const string& GetPath() const {
+        return path_;
+    }
+
+private:
+    ServerOptions WithSocketPath(ServerOptions options) {
+        static atomic<int> counter{0};
+        path_ = (filesystem::temp_directory_path()
+                 / ("mython_server_test_"s + to_string(getpid()) + "_"s + to_string(counter++)))
+                    .string();
+        options.socket_path = path_;
+        options.jobs = 2;
+        return options;
+    }
+
+    string path_;
+    MythonServer server_;
+    thread thread_;
+};
+
+const string GREETER = R"(class Greeter:
+  def greet(name):
+    return 'Hello, ' + name
+
+g = Greeter()
+print g.greet(input)
+)"s;
+
+void TestRunSource() {
+    TestServer server;
+    MythonClient client(server.GetPath());
+    const RunReply reply = client.Run(GREETER, "world"s);
+    ASSERT(reply.ok);
+    ASSERT_EQUAL(reply.output, "Hello, world\n"s);
+
+    // Повторный запрос с тем же текстом берёт программу из кэша
+    ASSERT_EQUAL(client.Run(GREETER, "again"s).output, "Hello, again\n"s);
+    ASSERT_EQUAL(server.Get().GetStats().cache_hits, 1U);
+    ASSERT_EQUAL(server.Get().GetStats().cache_misses, 1U);
+}
+
+void TestCompileAndExec() {
+    TestServer server;
+    MythonClient client(server.GetPath());
+    const string id = client.Compile(GREETER);
+    ASSERT_EQUAL(client.Exec(id, "Mython"s).output, "Hello, Mython\n"s);
+
+    // Идентификатор действителен и для других соединений
+    MythonClient other(server.GetPath());
+    ASSERT_EQUAL(other.Exec(id, "again"s).output, "Hello, again\n"s);
+
+    const RunReply unknown = other.Exec("0123"s);
+    ASSERT(!unknown.ok);
+    ASSERT_THROWS(client.Compile("x = = 1\n"s), runtime_error);
+    // После ошибки соединение продолжает работать
+    ASSERT_EQUAL(client.Run("print 1\n"s).output, "1\n"s);
+}
+
+void TestLimitsPerRequest() {
+    ServerOptions options;
+    options.limits.max_steps = 100000;
+    TestServer server(std::move(options));
+    MythonClient client(server.GetPath());
+
+    const string endless = "class Loop:\n  def run():\n    return self.run()\n\nl = Loop()\nl.run()\n"s;
+    RunReply reply = client.Run(endless);
+    ASSERT(!reply.ok);
+
+    reply = client.Run("print 1\nprint 2\nprint 3\n"s, {}, RunLimits{2, nullopt});
+    ASSERT(!reply.ok);
+    ASSERT_EQUAL(reply.output, "1\n2\n"s);
+
+    ASSERT(client.Run("print 1\n"s).ok);
+}
+
+void TestLargeOutputIsStreamed() {
+    TestServer server;
+    MythonClient client(server.GetPath());
+    const string program = R"(class Printer:
+  def run(n):
+    if n > 0:
+      print 'line', n
+      self.run(n - 1)
+
+p = Printer()
+p.run(2000)
+)"s;
+    ostringstream stream;
+    const RunReply reply = client.Run(program, {}, {}, &stream);
+    ASSERT(reply.ok);
+    ASSERT(reply.output.empty());
+    ASSERT(stream.str().size() > 10000U);
+    ASSERT_EQUAL(stream.str().substr(0, 10), "line 2000\n"s);
+}
+
+}  // namespace
+
+void RunServerTests(TestRunner& tr) {
+    RUN_TEST(tr, TestRunSource);
+    RUN_TEST(tr, TestCompileAndExec);
+    RUN_TEST(tr, TestLimitsPerRequest);
+    RUN_TEST(tr, TestLargeOutputIsStreamed);
+}
@@ -1,7 +1,8 @@
 #include "statement.h"
 
+#include "operations.h"
+
 #include <iostream>
-#include <sstream>
 #include <stdexcept>
 
 using namespace std;
@@ -13,7 +14,6 @@ namespace ast {
     using runtime::ObjectHolder;
 
     namespace {
-        const string ADD_METHOD = "__add__"s;
         const string INIT_METHOD = "__init__"s;
     }  // namespace
 
@@ -38,34 +38,16 @@ namespace ast {
     }
 
     ObjectHolder VariableValue::Execute(Closure& closure, Context& /*context*/) {
-        if (dotted_ids_.size() == 1) {
-            const auto it = closure.find(dotted_ids_[0]);
-            if (it != closure.end()) {
-                return  it->second;
-            }
-            else {
-                throw std::runtime_error("Unknown name"s);
-            }
-        }
-
-        ObjectHolder obj = closure.at(dotted_ids_[0]);
-        auto* class_ptr = obj.TryAs<runtime::ClassInstance>();
-        if (!class_ptr) {
-            throw std::runtime_error("Accessing a non-existent field"s);
+        const auto it = closure.find(dotted_ids_[0]);
+        if (it == closure.end()) {
+            throw std::runtime_error("Unknown name"s);
         }
-        for (size_t i = 1; i + 1 < dotted_ids_.size(); ++i) {
 
-            const auto item = class_ptr->Fields().find(dotted_ids_[i]);
-            if (item == class_ptr->Fields().end())
-                throw std::runtime_error("Accessing a non-existent field"s);
-            obj = item->second;
-
-        }
-        const auto& fields = obj.TryAs<runtime::ClassInstance>()->Fields();
-        if (const auto it = fields.find(dotted_ids_.back()); it != fields.end()) {
-            return it->second;
+        ObjectHolder obj = it->second;
+        for (size_t i = 1; i < dotted_ids_.size(); ++i) {
+            obj = runtime::GetField(obj, dotted_ids_[i]);
         }
-        throw std::runtime_error("Unknown name"s);
+        return obj;
     }
 
     unique_ptr<Print> Print::Variable(const std::string& name) {
@@ -87,14 +69,7 @@ namespace ast {
             if (!first) {
                 context.GetOutputStream() << ' ';
             }
-            if (value) {
-                value->Print(context.GetOutputStream(), context);
-            }
-            else {
-                context.GetOutputStream() << "None";
-            }
-            if (args_.size() == 1)
-                break;
+            runtime::PrintValue(value, context);
             first = false;
         }
         context.GetOutputStream() << "\n";
@@ -114,144 +89,68 @@ namespace ast {
             object_args.push_back(arg->Execute(closure, context));
         }
 
-        auto* cls = object_->Execute(closure, context).TryAs<runtime::ClassInstance>();
-        if (cls) {
-           return cls->Call(method_, object_args, context);
-        }
-        throw std::runtime_error("Accessing a non-existent field");        
+        return runtime::CallMethod(object_->Execute(closure, context), method_, object_args,
+            context);
     }
 
-    ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
-        const auto arg = GetArg()->Execute(closure, context);
-        std::ostringstream out;
-        if (const auto ptr = arg.TryAs<runtime::Number>()) {
-            ptr->Print(out, context);
-            return ObjectHolder::Own(runtime::String(out.str()));
-        }
-        else if (const auto ptr = arg.TryAs<runtime::String>()) {
-            ptr->Print(out, context);
-            return ObjectHolder::Own(runtime::String(out.str()));
-        }
-        else if (const auto ptr = arg.TryAs<runtime::Bool>()) {
-            ptr->Print(out, context);
-            return ObjectHolder::Own(runtime::String(out.str()));
-        }
-        else if (const auto ptr = arg.TryAs<runtime::ClassInstance>()) {
+    NativeCall::NativeCall(std::shared_ptr<const runtime::NativeFunction> function,
+        std::vector<std::unique_ptr<Statement>> args)
+        :function_(std::move(function))
+        , args_(std::move(args)) {
+    }
 
-            ptr->Print(out, context);
-            return ObjectHolder::Own(runtime::String(out.str()));
-        }
-        else {
-            return ObjectHolder::Own(runtime::String("None"));
+    ObjectHolder NativeCall::Execute(Closure& closure, Context& context) {
+        std::vector<runtime::ObjectHolder> actual_args;
+        actual_args.reserve(args_.size());
+        for (size_t i = 0; i < args_.size(); ++i) {
+            actual_args.push_back(args_[i]->Execute(closure, context));
+            const auto hint = function_->param_types[i];
+            if (!runtime::MatchesHint(actual_args.back(), hint)) {
+                throw std::runtime_error("Argument "s + std::to_string(i + 1) + " of "s
+                    + function_->name + "() must be "s + std::string(runtime::HintName(hint)));
+            }
         }
+        return function_->body(actual_args, context);
+    }
+
+    ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
+        return runtime::Stringify(GetArg()->Execute(closure, context), context);
     }
 
     ObjectHolder Add::Execute(Closure& closure, Context& context) {
         if (!GetRhs() || !GetLhs()) {
             throw std::runtime_error("Null operands are not supported"s);
         }
-        // getting objects
         auto obj_lhs = GetLhs()->Execute(closure, context);
         auto obj_rhs = GetRhs()->Execute(closure, context);
-        // getting pointers to Number objects
-        auto ptr_lhs_n = obj_lhs.TryAs<runtime::Number>();
-        auto ptr_rhs_n = obj_rhs.TryAs<runtime::Number>();
-        // verify pointers on nullptr
-        if (ptr_lhs_n && ptr_rhs_n) {
-            auto l_val = ptr_lhs_n->GetValue();
-            auto r_val = ptr_rhs_n->GetValue();
-
-            return ObjectHolder::Own(runtime::Number{ l_val + r_val });
-        }
-        // gettting pointers to String objects
-        auto ptr_lhs_s = obj_lhs.TryAs<runtime::String>();
-        auto ptr_rhs_s = obj_rhs.TryAs<runtime::String>();
-        // verify pointers on nullptr
-        if (ptr_lhs_s && ptr_rhs_s) {
-            auto l_val = ptr_lhs_s->GetValue();
-            auto r_val = ptr_rhs_s->GetValue();
-
-            return ObjectHolder::Own(runtime::String{ l_val + r_val });
-        }
-        // getting pointers to ClassInstance objects
-        auto ptr_lhs_class_inst = obj_lhs.TryAs<runtime::ClassInstance>();
-        // verify pointers on nullptr
-        if (ptr_lhs_class_inst) {
-            constexpr int counter_args = 1;
-
-            if (ptr_lhs_class_inst->HasMethod(ADD_METHOD, counter_args)) {
-                return ptr_lhs_class_inst->Call(ADD_METHOD, { obj_rhs }, context);
-            }
-        }
-
-        throw std::runtime_error("Add operands are illegal"s);
+        return runtime::Add(obj_lhs, obj_rhs, context);
     }
 
     ObjectHolder Sub::Execute(Closure& closure, Context& context) {
         if (!GetRhs() || !GetLhs()) {
             throw std::runtime_error("Null operands are not supported"s);
         }
-        // getting objects
         auto obj_lhs = GetLhs()->Execute(closure, context);
         auto obj_rhs = GetRhs()->Execute(closure, context);
-        // getting pointers to Number objects
-        auto ptr_lhs_n = obj_lhs.TryAs<runtime::Number>();
-        auto ptr_rhs_n = obj_rhs.TryAs<runtime::Number>();
-        // verify pointers on nullptr
-        if (ptr_lhs_n && ptr_rhs_n) {
-            auto l_num = ptr_lhs_n->GetValue();
-            auto r_num = ptr_rhs_n->GetValue();
-
-            return ObjectHolder::Own(runtime::Number{ l_num - r_num });
-        }
-
-        throw std::runtime_error("Substrict operands are illegal"s);
+        return runtime::Sub(obj_lhs, obj_rhs);
     }
 
     ObjectHolder Mult::Execute(Closure& closure, Context& context) {
         if (!GetRhs() || !GetLhs()) {
             throw std::runtime_error("Null operands are not supported"s);
         }
-        // getting objects
         auto obj_lhs = GetLhs()->Execute(closure, context);
         auto obj_rhs = GetRhs()->Execute(closure, context);
-        // getting pointers to Number objects
-        auto ptr_lhs_n = obj_lhs.TryAs<runtime::Number>();
-        auto ptr_rhs_n = obj_rhs.TryAs<runtime::Number>();
-        // verify pointers on nullptr
-        if (ptr_lhs_n && ptr_rhs_n) {
-            auto l_num = ptr_lhs_n->GetValue();
-            auto r_num = ptr_rhs_n->GetValue();
-
-            return ObjectHolder::Own(runtime::Number{ l_num * r_num });
-        }
-
-        throw std::runtime_error("Multiply operands are illegal"s);
+        return runtime::Mult(obj_lhs, obj_rhs);
     }
 
     ObjectHolder Div::Execute(Closure& closure, Context& context) {
         if (!GetRhs() || !GetLhs()) {
             throw std::runtime_error("Null operands are not supported"s);
         }
-        // getting objects
         auto obj_lhs = GetLhs()->Execute(closure, context);
         auto obj_rhs = GetRhs()->Execute(closure, context);
-        // getting pointers to Number objects
-        auto ptr_lhs_n = obj_lhs.TryAs<runtime::Number>();
-        auto ptr_rhs_n = obj_rhs.TryAs<runtime::Number>();
-        // verify pointers on nullptr
-        if (ptr_lhs_n && ptr_rhs_n) {
-            auto l_num = ptr_lhs_n->GetValue();
-            auto r_num = ptr_rhs_n->GetValue();
-
-            if (r_num == 0) {
-                throw std::runtime_error("Division by zero"s);
-            }
-
-            return ObjectHolder::Own(runtime::Number{ l_num / r_num });
-        }
-
-        throw std::runtime_error("Division operands are illegal"s);
+        return runtime::Div(obj_lhs, obj_rhs);
     }
 
     void Compound::AddStatement(std::unique_ptr<Statement> stmt) {
@@ -260,6 +159,7 @@ namespace ast {
 
     ObjectHolder Compound::Execute(Closure& closure, Context& context) {
         for (const auto& statement : statements_) {
+            context.ChargeStep();
             statement->Execute(closure, context);
         }
 
@@ -287,16 +187,9 @@ namespace ast {
     }
 
     ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
-
-        auto* cls = object_.Execute(closure, context).TryAs<runtime::ClassInstance>();
-
-        if (cls) {
-            auto& fields = cls->Fields();
-
-            fields[field_name_] = rv_->Execute(closure, context);
-            return fields[field_name_];
-        }
-        throw std::runtime_error("Attempting to access a non-instance class field");
+        const ObjectHolder object = object_.Execute(closure, context);
+        runtime::CheckFieldOwner(object);
+        return runtime::SetField(object, field_name_, rv_->Execute(closure, context));
     }
 
     IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
@@ -321,45 +214,23 @@ namespace ast {
     }
 
     ObjectHolder Or::Execute(Closure& closure, Context& context) {
-        ObjectHolder lhs_arg = GetLhs()->Execute(closure, context);
-
-        if (auto inst_Ptr = lhs_arg.TryAs<runtime::Bool>()) {
-            return MakeOperation(inst_Ptr, closure, context);
-        }
-        else if (auto inst_Ptr = lhs_arg.TryAs<runtime::Number>()) {
-            return MakeOperation(inst_Ptr, closure, context);
+        // Результат - значение lhs либо rhs, поэтому lhs вычисляется повторно
+        if (runtime::LogicalValue(GetLhs()->Execute(closure, context))) {
+            return GetLhs()->Execute(closure, context);
         }
-        else {
-            throw std::runtime_error("Value does not bool value");
-        }
-
+        return GetRhs()->Execute(closure, context);
     }
 
     ObjectHolder And::Execute(Closure& closure, Context& context) {
-        ObjectHolder lhs_arg = GetLhs()->Execute(closure, context);
-        if (auto inst_Ptr = lhs_arg.TryAs<runtime::Bool>()) {
-            return MakeOperation(inst_Ptr, closure, context);
-        }
-        else if (auto inst_Ptr = lhs_arg.TryAs<runtime::Number>()) {
-            return MakeOperation(inst_Ptr, closure, context);
+        if (!runtime::LogicalValue(GetLhs()->Execute(closure, context))) {
+            return GetLhs()->Execute(closure, context);
         }
-        else {
-            throw std::runtime_error("Value does not bool value");
-        }
-
+        return GetRhs()->Execute(closure, context);
     }
 
     ObjectHolder Not::Execute(Closure& closure, Context& context) {
-        const auto arg = GetArg()->Execute(closure, context);
-        if (auto inst_Ptr = arg.TryAs<runtime::Bool>()) {
-            return  ObjectHolder::Own(runtime::Bool{ !inst_Ptr->GetValue() });
-        }
-        else if (auto inst_Ptr = arg.TryAs<runtime::Number>()) {
-            return  ObjectHolder::Own(runtime::Bool{ !inst_Ptr->GetValue() });
-        }
-        else {
-            throw std::runtime_error("Value does not bool value");
-        }
+        return ObjectHolder::Own(
+            runtime::Bool{ !runtime::LogicalValue(GetArg()->Execute(closure, context)) });
     }
 
 
@@ -411,4 +282,60 @@ namespace ast {
         return result;
     }
 
-}  // namespace ast
\ No newline at end of file
+    ProfiledStatement::ProfiledStatement(profile::Profiler* profiler, int line,
+        std::unique_ptr<Statement> statement)
+        : profiler_(profiler)
+        , line_(line)
+        , statement_(std::move(statement)) {
+    }
+
+    ObjectHolder ProfiledStatement::Execute(Closure& closure, Context& context) {
+        if (profiler_ != nullptr) {
+            profiler_->CountLine(line_);
+        }
+        profile::LineScope line_scope(line_);
+        return statement_->Execute(closure, context);
+    }
+
+    ProfiledFrame::ProfiledFrame(profile::Profiler& profiler, size_t frame_id,
+        std::unique_ptr<Statement> body)
+        : profiler_(profiler)
+        , frame_id_(frame_id)
+        , body_(std::move(body)) {
+    }
+
+    ObjectHolder ProfiledFrame::Execute(Closure& closure, Context& context) {
+        profile::FrameGuard guard(profiler_, frame_id_);
+        return body_->Execute(closure, context);
+    }
+
+    LazyMethodBody::LazyMethodBody(Parser parser)
+        : parser_(std::move(parser)) {
+    }
+
+    Statement& LazyMethodBody::Resolve() {
+        std::call_once(parsed_, [this] {
+            body_ = parser_();
+            // Лексемы тела больше не нужны
+            parser_ = nullptr;
+            resolved_.store(true, std::memory_order_release);
+        });
+        return *body_;
+    }
+
+    bool LazyMethodBody::IsResolved() const {
+        return resolved_.load(std::memory_order_acquire);
+    }
+
+    ObjectHolder LazyMethodBody::Execute(Closure& closure, Context& context) {
+        return Resolve().Execute(closure, context);
+    }
+
+    Statement& GetMethodBody(const runtime::Method& method) {
+        if (auto* lazy = dynamic_cast<LazyMethodBody*>(method.body.get())) {
+            return lazy->Resolve();
+        }
+        return *method.body;
+    }
+
+}  // namespace ast
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "native.h"
+#include "profiler.h"
 #include "runtime.h"
 
+#include <atomic>
 #include <functional>
+#include <mutex>
 
 namespace ast {
 
@@ -17,13 +21,20 @@ namespace ast {
             : value_(std::move(v)) {
         }
 
+        // Каждое выполнение возвращает собственную копию значения: узел не изменяется,
+        // потоки не разделяют счётчик ссылок, а значение остаётся валидным
+        // даже после уничтожения дерева программы
         runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
             runtime::Context& /*context*/) override {
-            return runtime::ObjectHolder::Share(value_);
+            return runtime::ObjectHolder::Own(T(value_));
+        }
+
+        const T& GetValue() const {
+            return value_;
         }
 
     private:
-        T value_;
+        const T value_;
     };
 
     using NumericConst = ValueStatement<runtime::Number>;
@@ -43,6 +54,10 @@ namespace ast {
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::vector<std::string>& GetDottedIds() const {
+            return dotted_ids_;
+        }
+
     private:
         std::vector<std::string> dotted_ids_;
     };
@@ -55,6 +70,14 @@ namespace ast {
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::string& GetVar() const {
+            return var_;
+        }
+
+        const std::unique_ptr<Statement>& GetValue() const {
+            return rv_;
+        }
+
     private:
         std::string var_;
         std::unique_ptr<Statement> rv_;
@@ -68,6 +91,18 @@ namespace ast {
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const VariableValue& GetObject() const {
+            return object_;
+        }
+
+        const std::string& GetFieldName() const {
+            return field_name_;
+        }
+
+        const std::unique_ptr<Statement>& GetValue() const {
+            return rv_;
+        }
+
     private:
         VariableValue object_;
         std::string field_name_;
@@ -99,6 +134,10 @@ namespace ast {
         // context.GetOutputStream()
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+            return args_;
+        }
+
     private:
         std::vector<std::unique_ptr<Statement>> args_;
     };
@@ -112,12 +151,51 @@ namespace ast {
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::unique_ptr<Statement>& GetObject() const {
+            return object_;
+        }
+
+        const std::string& GetMethod() const {
+            return method_;
+        }
+
+        const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+            return args_;
+        }
+
     private:
         std::unique_ptr<Statement> object_;
         std::string method_;
         std::vector<std::unique_ptr<Statement>> args_;
     };
 
+    /*
+    Вызывает нативную функцию function со списком параметров args.
+    Функция найдена в реестре при разборе программы, а количество параметров проверено,
+    поэтому во время выполнения не нужны ни поиск по имени, ни создание Closure.
+    Если значение параметра не соответствует подсказке о типе, выбрасывается runtime_error
+    */
+    class NativeCall : public Statement {
+
+    public:
+        NativeCall(std::shared_ptr<const runtime::NativeFunction> function,
+            std::vector<std::unique_ptr<Statement>> args);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        const runtime::NativeFunction& GetFunction() const {
+            return *function_;
+        }
+
+        const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+            return args_;
+        }
+
+    private:
+        std::shared_ptr<const runtime::NativeFunction> function_;
+        std::vector<std::unique_ptr<Statement>> args_;
+    };
+
     /*
     Создаёт новый экземпляр класса class_, передавая его конструктору набор параметров args.
     Если в классе отсутствует метод __init__ с заданным количеством аргументов,
@@ -139,6 +217,14 @@ namespace ast {
         // Возвращает объект, содержащий значение типа ClassInstance
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const runtime::Class& GetClass() const {
+            return class__;
+        }
+
+        const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+            return args_;
+        }
+
     private:
         const runtime::Class& class__;
         std::vector<std::unique_ptr<Statement>> args_;
@@ -179,7 +265,6 @@ namespace ast {
             // Реализуйте метод самостоятельно
         }
 
-    protected:
         const std::unique_ptr<Statement>& GetLhs() const {
             return lhs_;
         }
@@ -248,16 +333,6 @@ namespace ast {
         // Значение аргумента rhs вычисляется, только если значение lhs
         // после приведения к Bool равно False
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-    private:
-        template<typename ObjPtr>
-        runtime::ObjectHolder MakeOperation(const ObjPtr& obj_ptr, runtime::Closure& closure, runtime::Context& context) {
-            if (obj_ptr->GetValue())
-            {
-                return GetLhs()->Execute(closure, context);
-            }
-            return GetRhs()->Execute(closure, context);
-        }
     };
 
     // Возвращает результат вычисления логической операции and над lhs и rhs
@@ -267,15 +342,6 @@ namespace ast {
         // Значение аргумента rhs вычисляется, только если значение lhs
         // после приведения к Bool равно True
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-
-    private:
-        template<typename ObjPtr>
-        runtime::ObjectHolder MakeOperation(const ObjPtr& obj_ptr, runtime::Closure& closure, runtime::Context& context) {
-            if (!obj_ptr->GetValue()) {
-                return GetLhs()->Execute(closure, context);
-            }
-            return GetRhs()->Execute(closure, context);
-        }
     };
 
     // Возвращает результат вычисления логической операции not над единственным аргументом операции
@@ -300,6 +366,10 @@ namespace ast {
         void AddStatement(std::unique_ptr<Statement> stmt);
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::vector<std::unique_ptr<Statement>>& GetStatements() const {
+            return statements_;
+        }
+
     private:
         template <typename T0, typename... Ts>
         void CompoundImpl(T0&& v0, Ts&&... vs) {
@@ -324,6 +394,10 @@ namespace ast {
         // В противном случае возвращает None
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::unique_ptr<Statement>& GetBody() const {
+            return body_;
+        }
+
     private:
         std::unique_ptr<Statement> body_;
     };
@@ -340,6 +414,10 @@ namespace ast {
         // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::unique_ptr<Statement>& GetStatement() const {
+            return statement_;
+        }
+
     private:
         std::unique_ptr<Statement> statement_;
     };
@@ -355,6 +433,14 @@ namespace ast {
         // конструктор
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const runtime::Class& GetClass() const {
+            return static_cast<const runtime::Class&>(*cls_);
+        }
+
+        const runtime::ObjectHolder& GetClassObject() const {
+            return cls_;
+        }
+
     private:
         runtime::ObjectHolder cls_;
     };
@@ -369,6 +455,19 @@ namespace ast {
 
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+        const std::unique_ptr<Statement>& GetCondition() const {
+            return condition_;
+        }
+
+        const std::unique_ptr<Statement>& GetIfBody() const {
+            return if_body_;
+        }
+
+        // Возвращает nullptr, если ветка else отсутствует
+        const std::unique_ptr<Statement>& GetElseBody() const {
+            return else_body_;
+        }
+
     private:
         std::unique_ptr<Statement> condition_;
         std::unique_ptr<Statement> if_body_;
@@ -387,8 +486,75 @@ namespace ast {
         // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
         // приведённый к типу runtime::Bool
         runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+        const Comparator& GetComparator() const {
+            return cmp_;
+        }
+
     private:
         Comparator cmp_;
     };
 
-}  // namespace ast
\ No newline at end of file
+    // Инструкция, расположенная в строке line. На время выполнения устанавливает
+    // profile::current_line, а если задан профилировщик, учитывает в нём выполнение строки.
+    // Создаётся парсером только в режимах профилирования и отслеживания строк
+    class ProfiledStatement : public Statement {
+
+    public:
+        // Параметр profiler может быть равен nullptr
+        ProfiledStatement(profile::Profiler* profiler, int line, std::unique_ptr<Statement> statement);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    private:
+        profile::Profiler* profiler_;
+        int line_;
+        std::unique_ptr<Statement> statement_;
+    };
+
+    // Тело метода либо программы, время выполнения которого учитывается профилировщиком.
+    // Создаётся парсером только в режиме профилирования
+    class ProfiledFrame : public Statement {
+
+    public:
+        ProfiledFrame(profile::Profiler& profiler, size_t frame_id, std::unique_ptr<Statement> body);
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    private:
+        profile::Profiler& profiler_;
+        size_t frame_id_;
+        std::unique_ptr<Statement> body_;
+    };
+
+    // Тело метода, разбор которого отложен до первого обращения (см. ParseOptions::lazy_methods).
+    // Создаётся парсером только в режиме отложенного разбора
+    class LazyMethodBody : public Statement {
+
+    public:
+        // Функция, разбирающая тело метода. Выбрасывает ParseError либо parse::LexerError
+        using Parser = std::function<std::unique_ptr<Statement>()>;
+
+        explicit LazyMethodBody(Parser parser);
+
+        // Возвращает разобранное тело, при первом обращении разбирая его. Если разбор
+        // не удался, ошибка выбрасывается при каждом обращении. Может вызываться
+        // одновременно из нескольких потоков
+        Statement& Resolve();
+
+        // Разобрано ли тело
+        [[nodiscard]] bool IsResolved() const;
+
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    private:
+        Parser parser_;
+        std::once_flag parsed_;
+        std::unique_ptr<Statement> body_;
+        std::atomic<bool> resolved_ = false;
+    };
+
+    // Возвращает тело метода method. Отложенное тело (LazyMethodBody) при этом разбирается
+    Statement& GetMethodBody(const runtime::Method& method);
+
+}  // namespace ast
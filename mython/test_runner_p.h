@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -23,6 +30,19 @@ std::ostream& PrintMap(std::ostream& os, const Map& m) {
     }
     return os << "}";
 }
+
+inline std::string FormatDuration(std::chrono::duration<double, std::nano> d) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3);
+    if (d.count() < 1e3) {
+        os << d.count() << " ns";
+    } else if (d.count() < 1e6) {
+        os << d.count() / 1e3 << " us";
+    } else {
+        os << d.count() / 1e6 << " ms";
+    }
+    return os.str();
+}
 }  // namespace TestRunnerPrivate
 
 template <class T>
@@ -81,22 +101,76 @@ inline void Assert(bool b, const std::string& hint) {
 
 class TestRunner {
 public:
+    using Clock = std::chrono::steady_clock;
+
+    // Тесты, выполняющиеся дольше threshold, помечаются как медленные
+    void SetSlowTestThreshold(Clock::duration threshold) {
+        slow_threshold = threshold;
+    }
+
+    // Включает замеры в RUN_BENCH. Без них тело бенчмарка выполняется один раз, как обычный тест
+    void SetBenchmarksEnabled(bool enabled) {
+        benchmarks_enabled = enabled;
+    }
+
+    /*
+     * Задаёт число потоков для выполнения тестов. При jobs > 1 тесты только регистрируются,
+     * а выполняются в RunPending либо в деструкторе: подряд идущие обычные тесты - одновременно,
+     * тесты из RUN_SERIAL_TEST и бенчмарки - по одному, когда других тестов не выполняется.
+     * Результаты выводятся в порядке регистрации тестов
+     */
+    void SetJobs(size_t jobs) {
+        RunPending();
+        this->jobs = std::max<size_t>(jobs, 1);
+    }
+
     template <class TestFunc>
     void RunTest(TestFunc func, const std::string& test_name) {
-        try {
-            func();
-            std::cerr << test_name << " OK" << std::endl;
-        } catch (std::exception& e) {
-            ++fail_count;
-            std::cerr << test_name << " fail: " << e.what() << std::endl;
-        } catch (...) {
-            ++fail_count;
-            std::cerr << "Unknown exception caught" << std::endl;
+        Schedule({func, test_name, false, false});
+    }
+
+    // Выполняет тест, который использует глобальное состояние, отдельно от остальных тестов
+    template <class TestFunc>
+    void RunSerialTest(TestFunc func, const std::string& test_name) {
+        Schedule({func, test_name, true, false});
+    }
+
+    /*
+     * Многократно выполняет func и выводит медиану и 99-й перцентиль времени одного выполнения.
+     * Замеры ведутся сериями, пока медианы двух последовательных серий не совпадут
+     * с точностью до 1% либо не истечёт отведённое на бенчмарк время.
+     * Бенчмарки всегда выполняются отдельно от остальных тестов
+     */
+    template <class BenchFunc>
+    void RunBench(BenchFunc func, const std::string& bench_name) {
+        Schedule({func, bench_name, benchmarks_enabled, benchmarks_enabled});
+    }
+
+    // Выполняет зарегистрированные, но ещё не выполненные тесты
+    void RunPending() {
+        size_t begin = 0;
+        while (begin < pending.size()) {
+            if (pending[begin].serial) {
+                Report(Execute(pending[begin++]));
+                continue;
+            }
+            size_t end = begin;
+            while (end < pending.size() && !pending[end].serial) {
+                ++end;
+            }
+            ExecuteConcurrently(begin, end);
+            begin = end;
         }
+        pending.clear();
     }
 
     ~TestRunner() {
+        RunPending();
         std::cerr.flush();
+        if (slow_count > 0) {
+            std::cerr << slow_count << " unit tests ran longer than "
+                      << TestRunnerPrivate::FormatDuration(slow_threshold) << std::endl;
+        }
         if (fail_count > 0) {
             std::cerr << fail_count << " unit tests failed. Terminate" << std::endl;
             exit(1);
@@ -104,7 +178,142 @@ public:
     }
 
 private:
+    struct Test {
+        std::function<void()> func;
+        std::string name;
+        bool serial = false;
+        bool bench = false;
+    };
+
+    // Результат выполнения теста. Вывод теста накапливается здесь,
+    // чтобы тесты, выполняемые одновременно, не перемешивали свои сообщения
+    struct Outcome {
+        std::string report;
+        bool failed = false;
+        bool slow = false;
+    };
+
+    static constexpr auto MIN_SAMPLE_TIME = std::chrono::microseconds(200);
+    static constexpr size_t SAMPLES_PER_ROUND = 32;
+    static constexpr auto MAX_BENCH_TIME = std::chrono::seconds(2);
+
+    void Schedule(Test test) {
+        if (jobs > 1) {
+            pending.push_back(std::move(test));
+        } else {
+            Report(Execute(test));
+        }
+    }
+
+    void Report(const Outcome& outcome) {
+        fail_count += outcome.failed;
+        slow_count += outcome.slow;
+        std::cerr << outcome.report << std::flush;
+    }
+
+    Outcome Execute(const Test& test) const {
+        Outcome outcome;
+        std::ostringstream os;
+        const auto start = Clock::now();
+        try {
+            if (test.bench) {
+                os << test.name << " BENCH " << Measure(test.func) << std::endl;
+            } else {
+                test.func();
+                const auto elapsed = Clock::now() - start;
+                os << test.name << " OK [" << TestRunnerPrivate::FormatDuration(elapsed) << "]";
+                if (elapsed > slow_threshold) {
+                    outcome.slow = true;
+                    os << " SLOW";
+                }
+                os << std::endl;
+            }
+        } catch (std::exception& e) {
+            outcome.failed = true;
+            os << test.name << " fail: " << e.what() << std::endl;
+        } catch (...) {
+            outcome.failed = true;
+            os << "Unknown exception caught" << std::endl;
+        }
+        outcome.report = os.str();
+        return outcome;
+    }
+
+    void ExecuteConcurrently(size_t begin, size_t end) {
+        std::vector<Outcome> outcomes(end - begin);
+        std::atomic<size_t> next{begin};
+        const auto worker = [this, end, begin, &next, &outcomes] {
+            for (size_t i; (i = next++) < end;) {
+                outcomes[i - begin] = Execute(pending[i]);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(jobs, end - begin); ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& outcome : outcomes) {
+            Report(outcome);
+        }
+    }
+
+    // Возвращает описание медианы и 99-го перцентиля времени выполнения func
+    static std::string Measure(const std::function<void()>& func) {
+        // Одно выполнение может быть короче разрешения часов,
+        // поэтому каждый замер охватывает batch выполнений
+        size_t batch = 1;
+        for (;;) {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < batch; ++i) {
+                func();
+            }
+            if (Clock::now() - start >= MIN_SAMPLE_TIME) {
+                break;
+            }
+            batch *= 2;
+        }
+
+        std::vector<double> samples;
+        double previous_median = 0;
+        bool stable = false;
+        const auto deadline = Clock::now() + MAX_BENCH_TIME;
+        while (!stable && Clock::now() < deadline) {
+            for (size_t round = 0; round < SAMPLES_PER_ROUND; ++round) {
+                const auto start = Clock::now();
+                for (size_t i = 0; i < batch; ++i) {
+                    func();
+                }
+                const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+                samples.push_back(elapsed.count() / batch);
+            }
+            std::vector<double> sorted = samples;
+            std::sort(sorted.begin(), sorted.end());
+            const double median = sorted[sorted.size() / 2];
+            stable = previous_median > 0
+                     && std::abs(median - previous_median) <= previous_median * 0.01;
+            previous_median = median;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        using Nanoseconds = std::chrono::duration<double, std::nano>;
+        const double median = samples[samples.size() / 2];
+        const double p99 = samples[(samples.size() * 99 + 99) / 100 - 1];
+        std::ostringstream os;
+        os << "median " << TestRunnerPrivate::FormatDuration(Nanoseconds(median)) << ", p99 "
+           << TestRunnerPrivate::FormatDuration(Nanoseconds(p99)) << " (" << samples.size()
+           << " samples x " << batch << " runs" << (stable ? "" : ", unstable") << ")";
+        return os.str();
+    }
+
     int fail_count = 0;
+    int slow_count = 0;
+    Clock::duration slow_threshold = std::chrono::seconds(1);
+    bool benchmarks_enabled = false;
+    size_t jobs = 1;
+    std::vector<Test> pending;
 };
 
 #ifndef FILE_NAME
@@ -127,6 +336,10 @@ private:
 
 #define RUN_TEST(tr, func) tr.RunTest(func, #func)
 
+#define RUN_SERIAL_TEST(tr, func) tr.RunSerialTest(func, #func)
+
+#define RUN_BENCH(tr, func) tr.RunBench(func, #func)
+
 #define ASSERT_THROWS(expr, expected_exception)                                                   \
     {                                                                                             \
         bool __assert_private_flag = true;                                                        \
@@ -0,0 +1,157 @@
+#include "tiering.h"
+
+#include <iomanip>
+#include <ostream>
+#include <utility>
+
+using namespace std;
+
+namespace jit {
+
+namespace {
+
+string_view TierName(Tier tier) {
+    switch (tier) {
+        case Tier::Interpreter:
+            return "interpreter"sv;
+        case Tier::Bytecode:
+            return "bytecode"sv;
+        case Tier::Native:
+            return "native"sv;
+    }
+    return "unknown"sv;
+}
+
+double ToMilliseconds(chrono::steady_clock::duration duration) {
+    return chrono::duration<double, milli>(duration).count();
+}
+
+}  // namespace
+
+TieredExecution::TieredExecution(TierPolicy policy, JitOptions jit_options,
+                                 vm::VmOptions vm_options)
+    : policy_(policy)
+    , jit_(jit_options)
+    , vm_(vm_options)
+    , start_(chrono::steady_clock::now()) {
+}
+
+optional<runtime::ObjectHolder> TieredExecution::TryCall(runtime::ClassInstance& self,
+                                                         const runtime::Method& method,
+                                                         const vector<runtime::ObjectHolder>& args,
+                                                         runtime::Context& context) {
+    const runtime::MethodRuntimeData& data = method.runtime_data;
+    if (data.GetCode(runtime::CodeKind::Native) == nullptr) {
+        if (data.GetBackedgeCount() >= policy_.backedge_threshold) {
+            TierUp(self.GetClass(), method, "backedges"s);
+        } else if (data.GetCallCount() >= policy_.invocation_threshold) {
+            TierUp(self.GetClass(), method, "calls"s);
+        }
+    }
+    if (data.GetCode(runtime::CodeKind::Native) != nullptr) {
+        if (auto result = jit_.TryCall(self, method, args, context)) {
+            return result;
+        }
+    }
+    if (data.GetCode(runtime::CodeKind::Bytecode) == nullptr) {
+        if (data.GetBackedgeCount() >= policy_.bytecode_threshold) {
+            TierUpToBytecode(self.GetClass(), method, "backedges"s);
+        } else if (data.GetCallCount() >= policy_.bytecode_threshold) {
+            TierUpToBytecode(self.GetClass(), method, "calls"s);
+        } else {
+            return nullopt;
+        }
+    }
+    return vm_.Run(self, method, args, context);
+}
+
+vector<TierUpEvent> TieredExecution::GetEvents() const {
+    lock_guard lock(mutex_);
+    return events_;
+}
+
+JitStats TieredExecution::GetJitStats() const {
+    return jit_.GetStats();
+}
+
+vm::VmStats TieredExecution::GetVmStats() const {
+    return vm_.GetStats();
+}
+
+void TieredExecution::PrintReport(ostream& out) const {
+    const vector<TierUpEvent> events = GetEvents();
+    const JitStats stats = GetJitStats();
+    const vm::VmStats vm_stats = GetVmStats();
+    out << "Tier-ups:\n"sv;
+    out << setw(12) << "time ms"sv << setw(13) << "tier"sv << setw(10) << "calls"sv << setw(11)
+        << "backedges"sv << "  method (trigger)\n"sv;
+    out << fixed << setprecision(3);
+    for (const auto& event : events) {
+        out << setw(12) << ToMilliseconds(event.time) << setw(13) << TierName(event.tier)
+            << setw(10) << event.calls << setw(11) << event.backedges << "  "sv << event.method
+            << " ("sv << event.trigger << ')';
+        if (!event.rejection.empty()) {
+            out << " rejected: "sv << event.rejection;
+        }
+        out << '\n';
+    }
+    out << "\nBytecode:\n"sv;
+    out << "  compiled methods: "sv << vm_stats.compiled_methods << '\n';
+    out << "  rejected methods: "sv << vm_stats.rejected_methods << '\n';
+    out << "  instructions: "sv << vm_stats.code_size << '\n';
+    out << "  bytecode calls: "sv << vm_stats.calls << '\n';
+    out << "\nNative code:\n"sv;
+    out << "  compiled methods: "sv << stats.compiled_methods << '\n';
+    out << "  rejected methods: "sv << stats.rejected_methods << '\n';
+    out << "  code bytes: "sv << stats.code_bytes << '\n';
+    out << "  native calls: "sv << stats.native_calls << '\n';
+    out << "  bailouts: "sv << stats.bailouts << '\n';
+}
+
+void TieredExecution::TierUp(const runtime::Class& cls, const runtime::Method& method,
+                             string trigger) {
+    lock_guard lock(mutex_);
+    // Метод мог перейти на новый уровень в другом потоке
+    if (method.runtime_data.GetCode(runtime::CodeKind::Native) != nullptr) {
+        return;
+    }
+    const auto time = chrono::steady_clock::now() - start_;
+    const CompileResult result = jit_.Compile(cls, method);
+    if (!result.rejection.empty()) {
+        const Tier tier = vm::FindFunction(method) != nullptr ? Tier::Bytecode : Tier::Interpreter;
+        AddEvent(cls, method, tier, time, std::move(trigger), result.rejection);
+        return;
+    }
+    for (const runtime::Method* compiled : result.compiled) {
+        AddEvent(cls, *compiled, Tier::Native, time,
+                 compiled == &method ? trigger : "with "s + cls.GetName() + "."s + method.name);
+    }
+}
+
+void TieredExecution::TierUpToBytecode(const runtime::Class& cls, const runtime::Method& method,
+                                       string trigger) {
+    lock_guard lock(mutex_);
+    if (method.runtime_data.GetCode(runtime::CodeKind::Bytecode) != nullptr) {
+        return;
+    }
+    const auto time = chrono::steady_clock::now() - start_;
+    const vm::Function& function = vm_.Compile(cls, method);
+    AddEvent(cls, method, function.rejection.empty() ? Tier::Bytecode : Tier::Interpreter, time,
+             std::move(trigger), function.rejection);
+}
+
+void TieredExecution::AddEvent(const runtime::Class& cls, const runtime::Method& method,
+                               Tier tier, chrono::steady_clock::duration time, string trigger,
+                               string rejection) {
+    TierUpEvent event;
+    event.method = cls.GetName() + "."s + method.name;
+    event.tier = tier;
+    event.time = time;
+    event.calls = method.runtime_data.GetCallCount();
+    event.backedges = method.runtime_data.GetBackedgeCount();
+    event.trigger = std::move(trigger);
+    event.rejection = std::move(rejection);
+    events_.push_back(std::move(event));
+}
+
+}  // namespace jit
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "jit.h"
+#include "runtime.h"
+#include "vm.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace jit {
+
+    // Уровень выполнения метода
+    enum class Tier {
+        // Обход дерева
+        Interpreter,
+        // Байт-код виртуальной машины (см. vm::BytecodeVm)
+        Bytecode,
+        // Машинный код (см. MethodJit)
+        Native,
+    };
+
+    // Пороги перехода метода на уровни байт-кода и машинного кода.
+    // Метод переходит на уровень, как только достигнут любой из его порогов
+    struct TierPolicy {
+        // Порог, который никогда не достигается. Отключает уровень
+        static constexpr std::uint64_t NEVER = std::numeric_limits<std::uint64_t>::max();
+
+        // Число вызовов либо обратных дуг метода для перехода на уровень байт-кода
+        std::uint64_t bytecode_threshold = 2;
+        // Число вызовов метода
+        std::uint64_t invocation_threshold = 1000;
+        // Число вызовов метода из него самого (см. runtime::MethodRuntimeData::CountBackedge).
+        // Рекурсивные методы заменяют в Mython циклы, поэтому переводятся раньше остальных
+        std::uint64_t backedge_threshold = 100;
+    };
+
+    // Переход метода на следующий уровень
+    struct TierUpEvent {
+        // Имя метода в виде Class.method
+        std::string method;
+        // Уровень, на который перешёл метод. Если метод не удалось скомпилировать,
+        // он остаётся на прежнем уровне
+        Tier tier = Tier::Interpreter;
+        // Время перехода от создания TieredExecution
+        std::chrono::steady_clock::duration time{};
+        // Значения счётчиков метода в момент перехода
+        std::uint64_t calls = 0;
+        std::uint64_t backedges = 0;
+        // Причина перехода: calls, backedges либо "with <метод>", если метод скомпилирован
+        // вместе с вызывающим его методом
+        std::string trigger;
+        // Причина, по которой метод не скомпилирован
+        std::string rejection;
+    };
+
+    /*
+     * Многоуровневое выполнение методов. Методы начинают работу на уровне обхода дерева,
+     * а ClassInstance::Call ведёт для каждого метода счётчики вызовов и обратных дуг.
+     * Когда счётчики метода достигают порогов TierPolicy, метод переводится в байт-код,
+     * а затем компилируется в машинный код, и последующие вызовы выполняются на новом
+     * уровне. Вызов, который не может выполнить машинный код (например, с параметрами-
+     * строками), выполняется байт-кодом, а при его отсутствии - обходом дерева.
+     * Выполняющиеся в момент перехода вызовы завершаются на прежнем уровне
+     * (замена на стеке не выполняется). Вызовы внутри машинного кода не проходят
+     * через ClassInstance::Call и не увеличивают счётчики.
+     * Может использоваться одновременно из нескольких потоков
+     */
+    class TieredExecution : public runtime::CallAccelerator {
+    public:
+        explicit TieredExecution(TierPolicy policy = {}, JitOptions jit_options = {},
+                                 vm::VmOptions vm_options = {});
+
+        std::optional<runtime::ObjectHolder> TryCall(runtime::ClassInstance& self,
+            const runtime::Method& method, const std::vector<runtime::ObjectHolder>& args,
+            runtime::Context& context) override;
+
+        // Возвращает переходы методов в порядке их выполнения
+        [[nodiscard]] std::vector<TierUpEvent> GetEvents() const;
+
+        [[nodiscard]] JitStats GetJitStats() const;
+
+        [[nodiscard]] vm::VmStats GetVmStats() const;
+
+        // Выводит переходы методов и статистику байт-кода и JIT-компилятора
+        void PrintReport(std::ostream& out) const;
+
+    private:
+        void TierUp(const runtime::Class& cls, const runtime::Method& method,
+                    std::string trigger);
+        void TierUpToBytecode(const runtime::Class& cls, const runtime::Method& method,
+                              std::string trigger);
+        void AddEvent(const runtime::Class& cls, const runtime::Method& method, Tier tier,
+                      std::chrono::steady_clock::duration time, std::string trigger,
+                      std::string rejection = {});
+
+        TierPolicy policy_;
+        MethodJit jit_;
+        vm::BytecodeVm vm_;
+        std::chrono::steady_clock::time_point start_;
+        mutable std::mutex mutex_;
+        std::vector<TierUpEvent> events_;
+    };
+
+}  // namespace jit
@@ -0,0 +1,215 @@
+#include "program.h"
+#include "test_runner_p.h"
+#include "tiering.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+namespace jit {
+
+namespace {
+
+const string FIB_PROGRAM = R"(
+class Math:
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+m = Math()
+print m.fib(10)
+)"s;
+
+const string DRIVER_PROGRAM = R"(
+class Math:
+  def twice(n):
+    return n * 2
+
+class Driver:
+  def run(m, n):
+    if n > 0:
+      m.twice(n)
+      self.run(m, n - 1)
+
+d = Driver()
+m = Math()
+d.run(m, 20)
+print m.twice(21)
+)"s;
+
+struct RunResult {
+    string output;
+    vector<TierUpEvent> events;
+    string report;
+};
+
+RunResult Run(const string& source, TierPolicy policy) {
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    TieredExecution tiered_execution(policy);
+    runtime::DummyContext context;
+    context.SetCallAccelerator(&tiered_execution);
+    program.Run(context);
+
+    ostringstream report;
+    tiered_execution.PrintReport(report);
+    return {context.output.str(), tiered_execution.GetEvents(), report.str()};
+}
+
+const TierUpEvent* FindEvent(const vector<TierUpEvent>& events, const string& method) {
+    const auto it = find_if(events.begin(), events.end(), [&method](const TierUpEvent& event) {
+        return event.method == method;
+    });
+    return it == events.end() ? nullptr : &*it;
+}
+
+void TestCallMaintainsCounters() {
+    istringstream input(FIB_PROGRAM);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    runtime::Closure closure;
+    runtime::DummyContext context;
+    program.Run(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "55\n"s);
+    const auto* math = closure.at("Math"s).TryAs<runtime::Class>();
+    const runtime::MethodRuntimeData& data = math->GetMethod("fib"s)->runtime_data;
+    ASSERT_EQUAL(data.GetCallCount(), 177U);
+    // Все вызовы, кроме первого, выполнены из самого fib
+    ASSERT_EQUAL(data.GetBackedgeCount(), 176U);
+}
+
+void TestBackedgesPromoteRecursiveMethods() {
+    TierPolicy policy;
+    policy.bytecode_threshold = TierPolicy::NEVER;
+    policy.invocation_threshold = 1'000'000;
+    policy.backedge_threshold = 10;
+    const RunResult result = Run(FIB_PROGRAM, policy);
+
+    ASSERT_EQUAL(result.output, "55\n"s);
+    ASSERT_EQUAL(result.events.size(), 1U);
+    const TierUpEvent& event = result.events.front();
+    ASSERT_EQUAL(event.method, "Math.fib"s);
+    ASSERT_EQUAL(event.trigger, "backedges"s);
+    ASSERT_EQUAL(event.calls, 11U);
+    ASSERT_EQUAL(event.backedges, 10U);
+    if (IsSupported()) {
+        ASSERT(event.tier == Tier::Native);
+        ASSERT(event.rejection.empty());
+    }
+}
+
+void TestInvocationsPromoteCalledMethods() {
+    TierPolicy policy;
+    policy.bytecode_threshold = TierPolicy::NEVER;
+    policy.invocation_threshold = 5;
+    policy.backedge_threshold = 1000;
+    const RunResult result = Run(DRIVER_PROGRAM, policy);
+
+    ASSERT_EQUAL(result.output, "42\n"s);
+    ASSERT_EQUAL(result.events.size(), 2U);
+    // run вызывает методы другого объекта, поэтому остаётся на уровне обхода дерева
+    const TierUpEvent* run = FindEvent(result.events, "Driver.run"s);
+    ASSERT(run != nullptr);
+    ASSERT(run->tier == Tier::Interpreter);
+    ASSERT(!run->rejection.empty());
+    ASSERT_EQUAL(run->trigger, "calls"s);
+
+    const TierUpEvent* twice = FindEvent(result.events, "Math.twice"s);
+    ASSERT(twice != nullptr);
+    ASSERT_EQUAL(twice->trigger, "calls"s);
+    ASSERT_EQUAL(twice->calls, 5U);
+    if (IsSupported()) {
+        ASSERT(twice->tier == Tier::Native);
+    }
+}
+
+void TestColdMethodsStayInTreeWalker() {
+    TierPolicy policy;
+    policy.bytecode_threshold = TierPolicy::NEVER;
+    const RunResult result = Run(DRIVER_PROGRAM, policy);
+    ASSERT_EQUAL(result.output, "42\n"s);
+    ASSERT(result.events.empty());
+}
+
+void TestBytecodePrecedesNativeCode() {
+    TierPolicy policy;
+    policy.bytecode_threshold = 2;
+    policy.invocation_threshold = 1'000'000;
+    policy.backedge_threshold = 10;
+    const RunResult result = Run(FIB_PROGRAM, policy);
+
+    ASSERT_EQUAL(result.output, "55\n"s);
+    ASSERT_EQUAL(result.events.size(), 2U);
+    const TierUpEvent& bytecode = result.events.front();
+    ASSERT_EQUAL(bytecode.method, "Math.fib"s);
+    ASSERT(bytecode.tier == Tier::Bytecode);
+    ASSERT_EQUAL(bytecode.trigger, "calls"s);
+    ASSERT_EQUAL(bytecode.calls, 2U);
+
+    const TierUpEvent& native = result.events.back();
+    ASSERT_EQUAL(native.backedges, 10U);
+    ASSERT(native.tier == (IsSupported() ? Tier::Native : Tier::Bytecode));
+}
+
+void TestBytecodeRunsCallsRejectedByNativeCode() {
+    const string source = R"(
+class Text:
+  def join(a, b):
+    return a + b
+
+  def repeat(s, n):
+    if n == 0:
+      return ''
+    return self.join(s, self.repeat(s, n - 1))
+
+t = Text()
+print t.repeat('ab', 5), t.join(1, 2)
+)"s;
+    TierPolicy policy;
+    policy.bytecode_threshold = 2;
+    policy.invocation_threshold = 3;
+    const RunResult result = Run(source, policy);
+
+    ASSERT_EQUAL(result.output, "ababababab 3\n"s);
+    const TierUpEvent* join = FindEvent(result.events, "Text.join"s);
+    ASSERT(join != nullptr);
+    ASSERT(join->tier == Tier::Bytecode);
+    // Строки не поддерживаются машинным кодом, и repeat остаётся на уровне байт-кода
+    const auto rejected = find_if(result.events.begin(), result.events.end(),
+                                  [](const TierUpEvent& event) {
+                                      return event.method == "Text.repeat"s
+                                             && !event.rejection.empty();
+                                  });
+    ASSERT(rejected != result.events.end());
+    ASSERT(rejected->tier == Tier::Bytecode);
+    ASSERT(result.report.find("bytecode calls: "s) != string::npos);
+}
+
+void TestReportShowsTierUps() {
+    TierPolicy policy;
+    policy.bytecode_threshold = TierPolicy::NEVER;
+    policy.backedge_threshold = 10;
+    const RunResult result = Run(FIB_PROGRAM, policy);
+
+    ASSERT(result.report.find("Math.fib (backedges)"s) != string::npos);
+    ASSERT(result.report.find("native calls: "s) != string::npos);
+    if (IsSupported()) {
+        ASSERT(result.report.find("native"s) < result.report.find("Math.fib"s));
+    }
+}
+
+}  // namespace
+
+void RunTieringTests(TestRunner& tr) {
+    RUN_TEST(tr, TestCallMaintainsCounters);
+    RUN_TEST(tr, TestBackedgesPromoteRecursiveMethods);
+    RUN_TEST(tr, TestInvocationsPromoteCalledMethods);
+    RUN_TEST(tr, TestColdMethodsStayInTreeWalker);
+    RUN_TEST(tr, TestBytecodePrecedesNativeCode);
+    RUN_TEST(tr, TestBytecodeRunsCallsRejectedByNativeCode);
+    RUN_TEST(tr, TestReportShowsTierUps);
+}
+
+}  // namespace jit
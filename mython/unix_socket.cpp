@@ -0,0 +1,177 @@
+#include "unix_socket.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t READ_CHUNK = 64 * 1024;
+
+[[noreturn]] void ThrowErrno(const char* what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+sockaddr_un MakeAddress(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Socket path is too long: "s + path);
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+int MakeSocket() {
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowErrno("socket");
+    }
+    return fd;
+}
+
+}  // namespace
+
+UnixSocket::UnixSocket(int fd)
+    : fd_(fd) {
+}
+
+UnixSocket::UnixSocket(UnixSocket&& other) noexcept
+    : fd_(exchange(other.fd_, -1))
+    , buffer_(std::move(other.buffer_))
+    , buffer_pos_(exchange(other.buffer_pos_, 0)) {
+}
+
+UnixSocket& UnixSocket::operator=(UnixSocket&& other) noexcept {
+    if (this != &other) {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        fd_ = exchange(other.fd_, -1);
+        buffer_ = std::move(other.buffer_);
+        buffer_pos_ = exchange(other.buffer_pos_, 0);
+    }
+    return *this;
+}
+
+UnixSocket::~UnixSocket() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+UnixSocket UnixSocket::Listen(const string& path, int backlog) {
+    const sockaddr_un address = MakeAddress(path);
+    UnixSocket result(MakeSocket());
+    unlink(path.c_str());
+    if (bind(result.fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ThrowErrno("bind");
+    }
+    if (listen(result.fd_, backlog) != 0) {
+        ThrowErrno("listen");
+    }
+    return result;
+}
+
+UnixSocket UnixSocket::Connect(const string& path) {
+    const sockaddr_un address = MakeAddress(path);
+    UnixSocket result(MakeSocket());
+    if (connect(result.fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ThrowErrno("connect");
+    }
+    return result;
+}
+
+UnixSocket UnixSocket::Accept() {
+    for (;;) {
+        const int fd = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            return UnixSocket(fd);
+        }
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+        if (errno == EINVAL) {
+            // Сокет закрыт вызовом Shutdown
+            return UnixSocket();
+        }
+        ThrowErrno("accept");
+    }
+}
+
+bool UnixSocket::Fill() {
+    if (buffer_pos_ > 0) {
+        buffer_.erase(0, buffer_pos_);
+        buffer_pos_ = 0;
+    }
+    const size_t old_size = buffer_.size();
+    buffer_.resize(old_size + READ_CHUNK);
+    for (;;) {
+        const ssize_t n = read(fd_, buffer_.data() + old_size, READ_CHUNK);
+        if (n >= 0) {
+            buffer_.resize(old_size + n);
+            return n > 0;
+        }
+        if (errno != EINTR) {
+            buffer_.resize(old_size);
+            if (errno == ECONNRESET) {
+                return false;
+            }
+            ThrowErrno("read");
+        }
+    }
+}
+
+bool UnixSocket::ReadLine(string& line) {
+    // Число байт после buffer_pos_, в которых уже нет перевода строки
+    for (size_t scanned = 0;;) {
+        const size_t end = buffer_.find('\n', buffer_pos_ + scanned);
+        if (end != string::npos) {
+            line.assign(buffer_, buffer_pos_, end - buffer_pos_);
+            buffer_pos_ = end + 1;
+            return true;
+        }
+        scanned = buffer_.size() - buffer_pos_;
+        if (!Fill()) {
+            return false;
+        }
+    }
+}
+
+string UnixSocket::ReadExactly(size_t size) {
+    while (buffer_.size() - buffer_pos_ < size) {
+        if (!Fill()) {
+            throw runtime_error("Connection closed"s);
+        }
+    }
+    string result = buffer_.substr(buffer_pos_, size);
+    buffer_pos_ += size;
+    return result;
+}
+
+void UnixSocket::WriteAll(string_view data) {
+    while (!data.empty()) {
+        const ssize_t n = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno("send");
+        }
+        data.remove_prefix(n);
+    }
+}
+
+void UnixSocket::Shutdown() {
+    if (fd_ >= 0) {
+        shutdown(fd_, SHUT_RDWR);
+    }
+}
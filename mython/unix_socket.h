@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/*
+ * Соединение через сокет домена Unix с буферизованным чтением.
+ * Ошибки системных вызовов сообщаются исключением std::system_error
+ */
+class UnixSocket {
+public:
+    UnixSocket() = default;
+    explicit UnixSocket(int fd);
+
+    UnixSocket(UnixSocket&& other) noexcept;
+    UnixSocket& operator=(UnixSocket&& other) noexcept;
+    UnixSocket(const UnixSocket&) = delete;
+    UnixSocket& operator=(const UnixSocket&) = delete;
+
+    ~UnixSocket();
+
+    // Создаёт слушающий сокет по пути path. Существующий файл по этому пути удаляется
+    static UnixSocket Listen(const std::string& path, int backlog = 128);
+    static UnixSocket Connect(const std::string& path);
+
+    // Принимает соединение. Если сокет закрыт вызовом Shutdown, возвращает невалидный сокет
+    UnixSocket Accept();
+
+    // Читает строку до '\n', не включая его. Возвращает false, если соединение закрыто
+    // до конца строки
+    bool ReadLine(std::string& line);
+    // Читает ровно size байт. Если соединение закрыто раньше, выбрасывает std::runtime_error
+    std::string ReadExactly(size_t size);
+
+    void WriteAll(std::string_view data);
+
+    // Прерывает ожидающие операции чтения и приёма соединений в других потоках
+    void Shutdown();
+
+    [[nodiscard]] bool IsValid() const {
+        return fd_ >= 0;
+    }
+
+    [[nodiscard]] int GetFd() const {
+        return fd_;
+    }
+
+private:
+    // Дочитывает данные в буфер. Возвращает false при закрытии соединения
+    bool Fill();
+
+    int fd_ = -1;
+    std::string buffer_;
+    size_t buffer_pos_ = 0;
+};
@@ -0,0 +1,881 @@
+#include "vm.h"
+
+#include "native.h"
+#include "operations.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+using runtime::CodeKind;
+using runtime::ObjectHolder;
+
+const string INIT_METHOD = "__init__"s;
+
+// Регистры кадров виртуальной машины одного потока. Кадры создаются и освобождаются
+// в порядке стека и размещаются в блоках, которые не перемещаются при росте
+template <typename Value>
+class RegisterStack {
+public:
+    struct Mark {
+        size_t block = 0;
+        size_t top = 0;
+    };
+
+    [[nodiscard]] Mark GetMark() const {
+        return {block_, top_};
+    }
+
+    Value* Allocate(size_t count) {
+        if (block_ >= blocks_.size() || top_ + count > blocks_[block_].size) {
+            const size_t next = block_ < blocks_.size() && top_ > 0 ? block_ + 1 : block_;
+            if (next >= blocks_.size()) {
+                blocks_.resize(next + 1);
+            }
+            // Блоки после текущего свободны, поэтому слишком маленький блок можно заменить
+            if (blocks_[next].size < count) {
+                blocks_[next].size = max(BLOCK_SIZE, count);
+                blocks_[next].data = make_unique<Value[]>(blocks_[next].size);
+            }
+            block_ = next;
+            top_ = 0;
+        }
+        Value* registers = blocks_[block_].data.get() + top_;
+        top_ += count;
+        return registers;
+    }
+
+    void Release(Mark mark) noexcept {
+        block_ = mark.block;
+        top_ = mark.top;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 16 * 1024;
+
+    struct Block {
+        unique_ptr<Value[]> data;
+        size_t size = 0;
+    };
+
+    vector<Block> blocks_;
+    size_t block_ = 0;
+    size_t top_ = 0;
+};
+
+thread_local RegisterStack<ObjectHolder> register_stack;
+thread_local RegisterStack<int> int_register_stack;
+
+// Регистры кадра метода. При выходе из метода значения регистров освобождаются
+class Frame {
+public:
+    explicit Frame(size_t count)
+        : mark_(register_stack.GetMark())
+        , int_mark_(int_register_stack.GetMark())
+        , count_(count)
+        , registers_(register_stack.Allocate(count))
+        , int_registers_(int_register_stack.Allocate(count)) {
+    }
+
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+    ~Frame() {
+        for (size_t i = 0; i < count_; ++i) {
+            registers_[i] = ObjectHolder::None();
+        }
+        register_stack.Release(mark_);
+        int_register_stack.Release(int_mark_);
+    }
+
+    [[nodiscard]] ObjectHolder* Registers() const {
+        return registers_;
+    }
+
+    // Регистры-числа не требуют освобождения и не заполняются при создании кадра
+    [[nodiscard]] int* IntRegisters() const {
+        return int_registers_;
+    }
+
+private:
+    RegisterStack<ObjectHolder>::Mark mark_;
+    RegisterStack<int>::Mark int_mark_;
+    size_t count_;
+    ObjectHolder* registers_;
+    int* int_registers_;
+};
+
+// Диспетчеризация шитым кодом: каждый обработчик сам переходит к обработчику следующей
+// инструкции по адресу метки (расширение labels-as-values GCC и Clang), поэтому у каждого
+// обработчика своя инструкция перехода и своя история предсказаний. Другие компиляторы
+// используют общий switch
+#if defined(__GNUC__)
+#define MYTHON_VM_THREADED 1
+#else
+#define MYTHON_VM_THREADED 0
+#endif
+
+// Счётчики выполнения одного вызова
+struct DispatchCounts {
+    uint64_t dispatches = 0;
+    uint64_t tree_nodes = 0;
+    // Считается всегда, а не только при VmOptions::count_dispatches
+    uint64_t guard_failures = 0;
+    // Счётчики пар инструкций, следующих в коде друг за другом (см. BytecodeVm::GetPairCounts)
+    atomic<uint64_t>* pairs = nullptr;
+    const Instruction* previous = nullptr;
+
+    void Count(const Instruction* instruction) {
+        ++dispatches;
+        tree_nodes += instruction->nodes;
+        if (previous + 1 == instruction) {
+            pairs[static_cast<size_t>(previous->op) * OPCODE_COUNT
+                  + static_cast<size_t>(instruction->op)]
+                .fetch_add(1, memory_order_relaxed);
+        }
+        previous = instruction;
+    }
+
+    // Учитывает вторую инструкцию суперинструкции, выполненную без диспетчеризации
+    void CountFused(const Instruction* instruction) {
+        tree_nodes += instruction->nodes;
+        previous = instruction;
+    }
+};
+
+// Типы операндов специализированных инструкций доказаны компилятором, поэтому значения
+// извлекаются без проверок
+int IntOf(const ObjectHolder& value) {
+    return static_cast<const runtime::Number*>(value.Get())->GetValue();
+}
+
+const string& StrOf(const ObjectHolder& value) {
+    return static_cast<const runtime::String*>(value.Get())->GetValue();
+}
+
+ObjectHolder MakeInt(int value) {
+    return ObjectHolder::Own(runtime::Number{value});
+}
+
+ObjectHolder MakeBool(bool value) {
+    return ObjectHolder::Own(runtime::Bool{value});
+}
+
+const ObjectHolder& GetSelfField(runtime::ClassInstance& self, const string& name) {
+    const auto it = self.Fields().find(name);
+    if (it == self.Fields().end()) {
+        throw runtime_error("Accessing a non-existent field"s);
+    }
+    return it->second;
+}
+
+// Проверяет, что байт-код собирает профиль мест вызова
+bool IsProfiling(const Function& function) {
+    return function.profile && !function.profile->used.load(memory_order_relaxed);
+}
+
+// Запоминает класс получателя cls в профиле места вызова site.
+// nullptr обозначает получателя, не являющегося экземпляром класса
+void RecordReceiver(FunctionProfile& profile, size_t site, const runtime::Class* cls) {
+    SiteProfile& site_profile = profile.sites[site];
+    if (cls != nullptr) {
+        const runtime::Class* seen = site_profile.receiver.load(memory_order_relaxed);
+        if (seen == nullptr) {
+            // При неудаче seen получает класс, записанный другим потоком
+            site_profile.receiver.compare_exchange_strong(seen, cls, memory_order_relaxed);
+            if (seen == nullptr) {
+                return;
+            }
+        }
+        if (seen == cls) {
+            return;
+        }
+    }
+    site_profile.polymorphic.store(true, memory_order_relaxed);
+}
+
+vector<ObjectHolder> CollectArgs(const CallSite& site, const ObjectHolder* registers) {
+    vector<ObjectHolder> args;
+    args.reserve(site.args.size());
+    for (const uint16_t reg : site.args) {
+        args.push_back(registers[reg]);
+    }
+    return args;
+}
+
+void CheckNativeArg(const runtime::NativeFunction& function, size_t index,
+                    const ObjectHolder& value) {
+    const auto hint = function.param_types[index];
+    if (!runtime::MatchesHint(value, hint)) {
+        throw runtime_error("Argument "s + to_string(index + 1) + " of "s + function.name
+                            + "() must be "s + string(runtime::HintName(hint)));
+    }
+}
+
+template <bool COUNT>
+ObjectHolder Execute(const Function& function, runtime::ClassInstance& self,
+                     const vector<ObjectHolder>& args, runtime::Context& context,
+                     DispatchCounts& counts) {
+    Frame frame(function.register_count);
+    ObjectHolder* const r = frame.Registers();
+    int* const n = frame.IntRegisters();
+    if (function.uses_self_value) {
+        r[0] = ObjectHolder::Share(self);
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+        r[i + 1] = args[i];
+    }
+
+    const Instruction* const code = function.code.data();
+    const Instruction* ip = code;
+    const Instruction* in = nullptr;
+
+#define FETCH()            \
+    in = ip++;             \
+    if constexpr (COUNT) { \
+        counts.Count(in);  \
+    }
+
+#if MYTHON_VM_THREADED
+    // Адреса обработчиков в порядке OpCode
+    static const void* const HANDLERS[] = {
+        &&op_Nop,
+        &&op_LoadConst,
+        &&op_LoadNone,
+        &&op_Move,
+        &&op_GetField,
+        &&op_GetSelfField,
+        &&op_SetField,
+        &&op_SetSelfField,
+        &&op_CheckFieldOwner,
+        &&op_Add,
+        &&op_Sub,
+        &&op_Mult,
+        &&op_Div,
+        &&op_AddInt,
+        &&op_SubInt,
+        &&op_MultInt,
+        &&op_DivInt,
+        &&op_AddStr,
+        &&op_Equal,
+        &&op_NotEqual,
+        &&op_Less,
+        &&op_Greater,
+        &&op_LessOrEqual,
+        &&op_GreaterOrEqual,
+        &&op_EqualInt,
+        &&op_NotEqualInt,
+        &&op_LessInt,
+        &&op_GreaterInt,
+        &&op_LessOrEqualInt,
+        &&op_GreaterOrEqualInt,
+        &&op_EqualStr,
+        &&op_NotEqualStr,
+        &&op_LessStr,
+        &&op_GreaterStr,
+        &&op_LessOrEqualStr,
+        &&op_GreaterOrEqualStr,
+        &&op_LoadInt,
+        &&op_Box,
+        &&op_Unbox,
+        &&op_MoveInt,
+        &&op_AddUnboxed,
+        &&op_SubUnboxed,
+        &&op_MultUnboxed,
+        &&op_DivUnboxed,
+        &&op_EqualUnboxed,
+        &&op_NotEqualUnboxed,
+        &&op_LessUnboxed,
+        &&op_GreaterUnboxed,
+        &&op_LessOrEqualUnboxed,
+        &&op_GreaterOrEqualUnboxed,
+        &&op_Not,
+        &&op_Stringify,
+        &&op_Jump,
+        &&op_JumpIfFalse,
+        &&op_JumpIfLogical,
+        &&op_Print,
+        &&op_PrintNewline,
+        &&op_Call,
+        &&op_CallSelf,
+        &&op_CallNative,
+        &&op_CheckNativeArg,
+        &&op_NewInstance,
+        &&op_GuardClass,
+        &&op_GuardSelfClass,
+        &&op_Return,
+        &&op_ReturnNone,
+        &&op_EqualJumpIfFalse,
+        &&op_LessJumpIfFalse,
+        &&op_LessOrEqualJumpIfFalse,
+        &&op_EqualUnboxedJumpIfFalse,
+        &&op_LessUnboxedJumpIfFalse,
+        &&op_LessOrEqualUnboxedJumpIfFalse,
+        &&op_GetSelfFieldCall,
+        &&op_GetSelfFieldGetField,
+        &&op_LoadConstReturn,
+        &&op_LoadConstAdd,
+        &&op_LoadConstSub,
+        &&op_CallSelfReturn,
+        &&op_AddReturn,
+    };
+    static_assert(size(HANDLERS) == OPCODE_COUNT);
+
+#define DISPATCH()                                   \
+    do {                                             \
+        FETCH();                                     \
+        goto* HANDLERS[static_cast<size_t>(in->op)]; \
+    } while (false)
+#else
+#define DISPATCH() continue
+#endif
+
+    // Метка op_<код> позволяет суперинструкции перейти к обработчику своей второй инструкции
+#define TARGET(op)   \
+    case OpCode::op: \
+    op_##op:
+
+    // Переходит ко второй инструкции суперинструкции без диспетчеризации
+#define FUSE_NEXT()            \
+    in = ip++;                 \
+    if constexpr (COUNT) {     \
+        counts.CountFused(in); \
+    }
+
+    // Первая инструкция выбирается через switch, дальше при шитом коде обработчики
+    // переходят друг к другу сами
+    while (true) {
+        FETCH();
+        switch (in->op) {
+            TARGET(Nop)
+                DISPATCH();
+            TARGET(LoadConst)
+                r[in->a] = function.constants[in->b];
+                DISPATCH();
+            TARGET(LoadNone)
+                r[in->a] = ObjectHolder::None();
+                DISPATCH();
+            TARGET(Move)
+                r[in->a] = r[in->b];
+                DISPATCH();
+            TARGET(GetField)
+                r[in->a] = runtime::GetField(r[in->b], function.names[in->c]);
+                DISPATCH();
+            TARGET(GetSelfField)
+                r[in->a] = GetSelfField(self, function.names[in->c]);
+                DISPATCH();
+            TARGET(SetField)
+                runtime::SetField(r[in->a], function.names[in->c], r[in->b]);
+                DISPATCH();
+            TARGET(SetSelfField)
+                self.Fields()[function.names[in->c]] = r[in->b];
+                DISPATCH();
+            TARGET(CheckFieldOwner)
+                runtime::CheckFieldOwner(r[in->a]);
+                DISPATCH();
+            TARGET(Add)
+                r[in->a] = runtime::Add(r[in->b], r[in->c], context);
+                DISPATCH();
+            TARGET(Sub)
+                r[in->a] = runtime::Sub(r[in->b], r[in->c]);
+                DISPATCH();
+            TARGET(Mult)
+                r[in->a] = runtime::Mult(r[in->b], r[in->c]);
+                DISPATCH();
+            TARGET(Div)
+                r[in->a] = runtime::Div(r[in->b], r[in->c]);
+                DISPATCH();
+            TARGET(AddInt)
+                r[in->a] = MakeInt(IntOf(r[in->b]) + IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(SubInt)
+                r[in->a] = MakeInt(IntOf(r[in->b]) - IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(MultInt)
+                r[in->a] = MakeInt(IntOf(r[in->b]) * IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(DivInt) {
+                const int divisor = IntOf(r[in->c]);
+                if (divisor == 0) {
+                    throw runtime_error("Division by zero"s);
+                }
+                r[in->a] = MakeInt(IntOf(r[in->b]) / divisor);
+                DISPATCH();
+            }
+            TARGET(AddStr)
+                r[in->a] = ObjectHolder::Own(runtime::String{StrOf(r[in->b]) + StrOf(r[in->c])});
+                DISPATCH();
+            TARGET(Equal)
+                r[in->a] = MakeBool(runtime::Equal(r[in->b], r[in->c], context));
+                DISPATCH();
+            TARGET(NotEqual)
+                r[in->a] = MakeBool(runtime::NotEqual(r[in->b], r[in->c], context));
+                DISPATCH();
+            TARGET(Less)
+                r[in->a] = MakeBool(runtime::Less(r[in->b], r[in->c], context));
+                DISPATCH();
+            TARGET(Greater)
+                r[in->a] = MakeBool(runtime::Greater(r[in->b], r[in->c], context));
+                DISPATCH();
+            TARGET(LessOrEqual)
+                r[in->a] = MakeBool(runtime::LessOrEqual(r[in->b], r[in->c], context));
+                DISPATCH();
+            TARGET(GreaterOrEqual)
+                r[in->a] = MakeBool(runtime::GreaterOrEqual(r[in->b], r[in->c], context));
+                DISPATCH();
+            TARGET(EqualInt)
+                r[in->a] = MakeBool(IntOf(r[in->b]) == IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(NotEqualInt)
+                r[in->a] = MakeBool(IntOf(r[in->b]) != IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(LessInt)
+                r[in->a] = MakeBool(IntOf(r[in->b]) < IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(GreaterInt)
+                r[in->a] = MakeBool(IntOf(r[in->b]) > IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(LessOrEqualInt)
+                r[in->a] = MakeBool(IntOf(r[in->b]) <= IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(GreaterOrEqualInt)
+                r[in->a] = MakeBool(IntOf(r[in->b]) >= IntOf(r[in->c]));
+                DISPATCH();
+            TARGET(EqualStr)
+                r[in->a] = MakeBool(StrOf(r[in->b]) == StrOf(r[in->c]));
+                DISPATCH();
+            TARGET(NotEqualStr)
+                r[in->a] = MakeBool(StrOf(r[in->b]) != StrOf(r[in->c]));
+                DISPATCH();
+            TARGET(LessStr)
+                r[in->a] = MakeBool(StrOf(r[in->b]) < StrOf(r[in->c]));
+                DISPATCH();
+            TARGET(GreaterStr)
+                r[in->a] = MakeBool(StrOf(r[in->b]) > StrOf(r[in->c]));
+                DISPATCH();
+            TARGET(LessOrEqualStr)
+                r[in->a] = MakeBool(StrOf(r[in->b]) <= StrOf(r[in->c]));
+                DISPATCH();
+            TARGET(GreaterOrEqualStr)
+                r[in->a] = MakeBool(StrOf(r[in->b]) >= StrOf(r[in->c]));
+                DISPATCH();
+            TARGET(LoadInt)
+                n[in->a] = static_cast<int>(in->b | uint32_t{in->c} << 16);
+                DISPATCH();
+            TARGET(Box)
+                r[in->a] = MakeInt(n[in->b]);
+                DISPATCH();
+            TARGET(Unbox)
+                n[in->a] = IntOf(r[in->b]);
+                DISPATCH();
+            TARGET(MoveInt)
+                n[in->a] = n[in->b];
+                DISPATCH();
+            TARGET(AddUnboxed)
+                n[in->a] = n[in->b] + n[in->c];
+                DISPATCH();
+            TARGET(SubUnboxed)
+                n[in->a] = n[in->b] - n[in->c];
+                DISPATCH();
+            TARGET(MultUnboxed)
+                n[in->a] = n[in->b] * n[in->c];
+                DISPATCH();
+            TARGET(DivUnboxed)
+                if (n[in->c] == 0) {
+                    throw runtime_error("Division by zero"s);
+                }
+                n[in->a] = n[in->b] / n[in->c];
+                DISPATCH();
+            TARGET(EqualUnboxed)
+                r[in->a] = MakeBool(n[in->b] == n[in->c]);
+                DISPATCH();
+            TARGET(NotEqualUnboxed)
+                r[in->a] = MakeBool(n[in->b] != n[in->c]);
+                DISPATCH();
+            TARGET(LessUnboxed)
+                r[in->a] = MakeBool(n[in->b] < n[in->c]);
+                DISPATCH();
+            TARGET(GreaterUnboxed)
+                r[in->a] = MakeBool(n[in->b] > n[in->c]);
+                DISPATCH();
+            TARGET(LessOrEqualUnboxed)
+                r[in->a] = MakeBool(n[in->b] <= n[in->c]);
+                DISPATCH();
+            TARGET(GreaterOrEqualUnboxed)
+                r[in->a] = MakeBool(n[in->b] >= n[in->c]);
+                DISPATCH();
+            TARGET(Not)
+                r[in->a] = MakeBool(!runtime::LogicalValue(r[in->b]));
+                DISPATCH();
+            TARGET(Stringify)
+                r[in->a] = runtime::Stringify(r[in->b], context);
+                DISPATCH();
+            TARGET(Jump)
+                ip = code + in->a;
+                DISPATCH();
+            TARGET(JumpIfFalse)
+                if (!runtime::IsTrue(r[in->a])) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            TARGET(JumpIfLogical)
+                if (runtime::LogicalValue(r[in->a]) == (in->c != 0)) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            TARGET(Print)
+                if (in->b != 0) {
+                    context.GetOutputStream() << ' ';
+                }
+                runtime::PrintValue(r[in->a], context);
+                DISPATCH();
+            TARGET(PrintNewline)
+                context.GetOutputStream() << '\n';
+                DISPATCH();
+            TARGET(Call) {
+                const CallSite& site = function.call_sites[in->c];
+                if (IsProfiling(function)) {
+                    const auto* instance = r[in->b].TryAs<runtime::ClassInstance>();
+                    RecordReceiver(*function.profile, in->c,
+                                   instance != nullptr ? &instance->GetClass() : nullptr);
+                }
+                r[in->a] = runtime::CallMethod(r[in->b], function.names[site.name],
+                                              CollectArgs(site, r), context);
+                DISPATCH();
+            }
+            TARGET(CallSelf) {
+                const CallSite& site = function.call_sites[in->c];
+                if (IsProfiling(function)) {
+                    RecordReceiver(*function.profile, in->c, &self.GetClass());
+                }
+                r[in->a] = self.Call(function.names[site.name], CollectArgs(site, r), context);
+                DISPATCH();
+            }
+            TARGET(CallNative) {
+                const CallSite& site = function.call_sites[in->c];
+                vector<ObjectHolder> native_args = CollectArgs(site, r);
+                for (size_t i = 0; i < native_args.size(); ++i) {
+                    CheckNativeArg(*site.function, i, native_args[i]);
+                }
+                r[in->a] = site.function->body(native_args, context);
+                DISPATCH();
+            }
+            TARGET(CheckNativeArg)
+                CheckNativeArg(*function.call_sites[in->c].function, in->b, r[in->a]);
+                DISPATCH();
+            TARGET(NewInstance) {
+                const CallSite& site = function.call_sites[in->c];
+                ObjectHolder instance = ObjectHolder::Own(runtime::ClassInstance(*site.cls));
+                if (site.has_init) {
+                    static_cast<runtime::ClassInstance*>(instance.Get())
+                        ->Call(INIT_METHOD, CollectArgs(site, r), context);
+                }
+                r[in->a] = std::move(instance);
+                DISPATCH();
+            }
+            TARGET(GuardClass) {
+                const auto* instance = r[in->a].TryAs<runtime::ClassInstance>();
+                if (instance == nullptr
+                    || &instance->GetClass() != function.call_sites[in->c].cls) {
+                    ++counts.guard_failures;
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            }
+            TARGET(GuardSelfClass)
+                if (&self.GetClass() != function.call_sites[in->c].cls) {
+                    ++counts.guard_failures;
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            TARGET(Return)
+                return r[in->a];
+            TARGET(ReturnNone)
+                return ObjectHolder::None();
+            TARGET(EqualJumpIfFalse) {
+                const bool value = runtime::Equal(r[in->b], r[in->c], context);
+                FUSE_NEXT();
+                if (!value) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            }
+            TARGET(LessJumpIfFalse) {
+                const bool value = runtime::Less(r[in->b], r[in->c], context);
+                FUSE_NEXT();
+                if (!value) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            }
+            TARGET(LessOrEqualJumpIfFalse) {
+                const bool value = runtime::LessOrEqual(r[in->b], r[in->c], context);
+                FUSE_NEXT();
+                if (!value) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            }
+            TARGET(EqualUnboxedJumpIfFalse) {
+                const bool value = n[in->b] == n[in->c];
+                FUSE_NEXT();
+                if (!value) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            }
+            TARGET(LessUnboxedJumpIfFalse) {
+                const bool value = n[in->b] < n[in->c];
+                FUSE_NEXT();
+                if (!value) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            }
+            TARGET(LessOrEqualUnboxedJumpIfFalse) {
+                const bool value = n[in->b] <= n[in->c];
+                FUSE_NEXT();
+                if (!value) {
+                    ip = code + in->b;
+                }
+                DISPATCH();
+            }
+            TARGET(GetSelfFieldCall)
+                r[in->a] = GetSelfField(self, function.names[in->c]);
+                FUSE_NEXT();
+                goto op_Call;
+            TARGET(GetSelfFieldGetField)
+                r[in->a] = GetSelfField(self, function.names[in->c]);
+                FUSE_NEXT();
+                goto op_GetField;
+            TARGET(LoadConstReturn)
+                r[in->a] = function.constants[in->b];
+                FUSE_NEXT();
+                goto op_Return;
+            TARGET(LoadConstAdd)
+                r[in->a] = function.constants[in->b];
+                FUSE_NEXT();
+                goto op_Add;
+            TARGET(LoadConstSub)
+                r[in->a] = function.constants[in->b];
+                FUSE_NEXT();
+                goto op_Sub;
+            TARGET(CallSelfReturn) {
+                const CallSite& site = function.call_sites[in->c];
+                if (IsProfiling(function)) {
+                    RecordReceiver(*function.profile, in->c, &self.GetClass());
+                }
+                r[in->a] = self.Call(function.names[site.name], CollectArgs(site, r), context);
+                FUSE_NEXT();
+                goto op_Return;
+            }
+            TARGET(AddReturn)
+                r[in->a] = runtime::Add(r[in->b], r[in->c], context);
+                FUSE_NEXT();
+                goto op_Return;
+        }
+    }
+
+#undef FUSE_NEXT
+#undef TARGET
+#undef DISPATCH
+#undef FETCH
+}
+
+}  // namespace
+
+const Function* FindFunction(const runtime::Method& method) noexcept {
+    // Код вида Bytecode создаёт только виртуальная машина
+    const auto* function =
+        static_cast<const Function*>(method.runtime_data.GetCode(CodeKind::Bytecode));
+    if (function == nullptr || !function->rejection.empty()) {
+        return nullptr;
+    }
+    return function;
+}
+
+BytecodeVm::BytecodeVm(VmOptions options)
+    : options_(options) {
+    if (options_.count_dispatches) {
+        pair_counts_ = make_unique<atomic<uint64_t>[]>(OPCODE_COUNT * OPCODE_COUNT);
+    }
+}
+
+optional<ObjectHolder> BytecodeVm::TryCall(runtime::ClassInstance& self,
+                                           const runtime::Method& method,
+                                           const vector<ObjectHolder>& args,
+                                           runtime::Context& context) {
+    if (method.runtime_data.GetCode(CodeKind::Bytecode) == nullptr) {
+        if (method.runtime_data.GetCallCount() < options_.threshold) {
+            return nullopt;
+        }
+        Compile(self.GetClass(), method);
+    }
+    return Run(self, method, args, context);
+}
+
+const Function& BytecodeVm::Compile(const runtime::Class& cls, const runtime::Method& method) {
+    if (const runtime::MethodCode* code = method.runtime_data.GetCode(CodeKind::Bytecode)) {
+        return static_cast<const Function&>(*code);
+    }
+    unique_ptr<Function> function;
+    try {
+        function = make_unique<Function>(
+            CompileMethod(cls, method, {}, options_.scalar_replacement));
+        if (options_.superinstructions) {
+            FuseInstructions(*function);
+        }
+        if (options_.inline_threshold != NEVER && !function->call_sites.empty()) {
+            function->profile = make_unique<FunctionProfile>(function->call_sites.size());
+        }
+    } catch (const UnsupportedMethod& e) {
+        function = make_unique<Function>();
+        function->name = cls.GetName() + "."s + method.name;
+        function->rejection = e.what();
+    }
+    const Function* created = function.get();
+    // Метод мог быть переведён одновременно в другом потоке, тогда используется его код
+    const auto* installed = static_cast<const Function*>(
+        method.runtime_data.SetCode(CodeKind::Bytecode, std::move(function)));
+    if (installed == created) {
+        if (installed->rejection.empty()) {
+            compiled_methods_.fetch_add(1, memory_order_relaxed);
+            code_size_.fetch_add(installed->code.size(), memory_order_relaxed);
+            replaced_instances_.fetch_add(installed->replaced_instances, memory_order_relaxed);
+        } else {
+            rejected_methods_.fetch_add(1, memory_order_relaxed);
+        }
+    }
+    return *installed;
+}
+
+optional<ObjectHolder> BytecodeVm::Run(runtime::ClassInstance& self,
+                                       const runtime::Method& method,
+                                       const vector<ObjectHolder>& args,
+                                       runtime::Context& context) {
+    // Инструкции не расходуют шаги бюджета
+    if (context.GetBudget() != nullptr) {
+        return nullopt;
+    }
+    const Function* function = FindFunction(method);
+    if (function == nullptr) {
+        return nullopt;
+    }
+    if (function->profile && method.runtime_data.GetCallCount() >= options_.inline_threshold
+        && !function->profile->used.exchange(true, memory_order_relaxed)) {
+        function = InlineCalls(self.GetClass(), method, *function);
+    }
+    calls_.fetch_add(1, memory_order_relaxed);
+
+    // Счётчики учитываются и при выходе из метода по исключению
+    struct CountsFlush {
+        BytecodeVm& vm;
+        DispatchCounts counts;
+
+        ~CountsFlush() {
+            if (counts.guard_failures > 0) {
+                vm.guard_failures_.fetch_add(counts.guard_failures, memory_order_relaxed);
+            }
+            if (vm.options_.count_dispatches) {
+                vm.dispatches_.fetch_add(counts.dispatches, memory_order_relaxed);
+                vm.tree_nodes_.fetch_add(counts.tree_nodes, memory_order_relaxed);
+            }
+        }
+    } flush{*this, {}};
+    if (!options_.count_dispatches) {
+        return Execute<false>(*function, self, args, context, flush.counts);
+    }
+    flush.counts.pairs = pair_counts_.get();
+    return Execute<true>(*function, self, args, context, flush.counts);
+}
+
+const Function* BytecodeVm::InlineCalls(const runtime::Class& cls, const runtime::Method& method,
+                                        const Function& function) {
+    InlinePlan plan;
+    vector<unique_ptr<Function>> callees;
+    for (size_t i = 0; i < function.call_sites.size(); ++i) {
+        const SiteProfile& site_profile = function.profile->sites[i];
+        const runtime::Class* receiver = site_profile.receiver.load(memory_order_relaxed);
+        if (receiver == nullptr || site_profile.polymorphic.load(memory_order_relaxed)) {
+            continue;
+        }
+        const CallSite& site = function.call_sites[i];
+        const runtime::Method* callee = receiver->GetMethod(function.names[site.name]);
+        if (callee == nullptr || callee->formal_params.size() != site.args.size()) {
+            continue;
+        }
+        try {
+            auto compiled = make_unique<Function>(
+                CompileMethod(*receiver, *callee, {}, options_.scalar_replacement));
+            if (CanInline(*compiled, options_.max_inline_size)) {
+                plan[i] = InlineTarget{receiver, compiled.get()};
+                callees.push_back(std::move(compiled));
+            }
+        } catch (const UnsupportedMethod&) {
+        }
+    }
+    if (plan.empty()) {
+        return &function;
+    }
+
+    unique_ptr<Function> optimized;
+    try {
+        optimized = make_unique<Function>(
+            CompileMethod(cls, method, plan, options_.scalar_replacement));
+    } catch (const UnsupportedMethod&) {
+        // Встроенный код может не поместиться в ограничения на размер метода
+        return &function;
+    }
+    if (options_.superinstructions) {
+        FuseInstructions(*optimized);
+    }
+    const Function* created = optimized.get();
+    if (!method.runtime_data.ReplaceCode(CodeKind::Bytecode, &function, std::move(optimized))) {
+        return &function;
+    }
+    inlined_calls_.fetch_add(created->inlined_calls, memory_order_relaxed);
+    code_size_.fetch_add(created->code.size() - function.code.size(), memory_order_relaxed);
+    return created;
+}
+
+VmStats BytecodeVm::GetStats() const {
+    VmStats stats;
+    stats.compiled_methods = compiled_methods_.load(memory_order_relaxed);
+    stats.rejected_methods = rejected_methods_.load(memory_order_relaxed);
+    stats.code_size = code_size_.load(memory_order_relaxed);
+    stats.calls = calls_.load(memory_order_relaxed);
+    stats.dispatches = dispatches_.load(memory_order_relaxed);
+    stats.tree_nodes = tree_nodes_.load(memory_order_relaxed);
+    stats.inlined_calls = inlined_calls_.load(memory_order_relaxed);
+    stats.guard_failures = guard_failures_.load(memory_order_relaxed);
+    stats.replaced_instances = replaced_instances_.load(memory_order_relaxed);
+    return stats;
+}
+
+vector<OpCodePairCount> BytecodeVm::GetPairCounts() const {
+    vector<OpCodePairCount> result;
+    if (!pair_counts_) {
+        return result;
+    }
+    for (size_t i = 0; i < OPCODE_COUNT * OPCODE_COUNT; ++i) {
+        if (const uint64_t count = pair_counts_[i].load(memory_order_relaxed); count > 0) {
+            result.push_back({static_cast<OpCode>(i / OPCODE_COUNT),
+                              static_cast<OpCode>(i % OPCODE_COUNT), count});
+        }
+    }
+    sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.count > rhs.count;
+    });
+    return result;
+}
+
+}  // namespace vm
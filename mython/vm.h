@@ -0,0 +1,134 @@
+#pragma once
+
+#include "bytecode.h"
+#include "runtime.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace vm {
+
+    // Порог, который никогда не достигается
+    inline constexpr std::uint64_t NEVER = std::numeric_limits<std::uint64_t>::max();
+
+    // Параметры виртуальной машины
+    struct VmOptions {
+        // Число вызовов метода, после которого метод переводится в байт-код
+        std::uint64_t threshold = 1;
+        // Число вызовов метода, после которого он переводится в байт-код повторно
+        // со встроенными вызовами небольших методов. До этого байт-код собирает
+        // классы получателей в местах вызова. NEVER отключает встраивание
+        std::uint64_t inline_threshold = 64;
+        // Наибольшее число инструкций встраиваемого метода
+        std::size_t max_inline_size = 12;
+        // Подсчитывать выполненные инструкции, узлы дерева, которые они заменили,
+        // и пары инструкций, выполненных подряд
+        bool count_dispatches = false;
+        // Заменять частые пары инструкций суперинструкциями (см. FuseInstructions)
+        bool superinstructions = true;
+        // Не создавать экземпляры, которые метод использует только для обращения
+        // к полям, а хранить их поля в регистрах (см. CompileMethod)
+        bool scalar_replacement = true;
+    };
+
+    // Статистика виртуальной машины
+    struct VmStats {
+        // Методов, переведённых в байт-код
+        std::uint64_t compiled_methods = 0;
+        // Методов, которые не удалось перевести
+        std::uint64_t rejected_methods = 0;
+        // Инструкций во всех переведённых методах
+        std::uint64_t code_size = 0;
+        // Вызовов, выполненных виртуальной машиной
+        std::uint64_t calls = 0;
+        // Выполненных инструкций (диспетчеризаций). Считаются при VmOptions::count_dispatches
+        std::uint64_t dispatches = 0;
+        // Вызовов Execute, которые выполнил бы для тех же вызовов обход дерева
+        std::uint64_t tree_nodes = 0;
+        // Мест вызова, в которые встроены вызываемые методы
+        std::uint64_t inlined_calls = 0;
+        // Вызовов, выполненных обычным путём из-за несовпадения класса получателя
+        // с классом, для которого метод встроен
+        std::uint64_t guard_failures = 0;
+        // Мест создания экземпляров в переведённых методах, где экземпляр заменён
+        // регистрами полей
+        std::uint64_t replaced_instances = 0;
+    };
+
+    // Сколько раз инструкция second выполнялась сразу после предшествующей ей в коде first
+    struct OpCodePairCount {
+        OpCode first = OpCode::Nop;
+        OpCode second = OpCode::Nop;
+        std::uint64_t count = 0;
+    };
+
+    /*
+     * Регистровая виртуальная машина для методов Mython.
+     *
+     * Когда число вызовов метода достигает VmOptions::threshold, тело метода переводится
+     * в байт-код (см. bytecode.h): последовательность инструкций с тремя операндами-регистрами.
+     * Кадр метода - массив регистров фиксированного размера, поэтому вызов не создаёт Closure,
+     * а return не выбрасывает исключение. Операции над значениями, тип которых известен
+     * при компиляции, выполняются специализированными инструкциями без проверок типов.
+     *
+     * Методы, читающие переменные до присваивания либо использующие конструкции
+     * режима профилирования, выполняются обходом дерева. Вызовы с бюджетом выполнения
+     * тоже выполняются обходом дерева, так как инструкции не расходуют шаги бюджета.
+     * Вызовы методов из байт-кода проходят через ClassInstance::Call. Исключение -
+     * небольшие методы, которые после VmOptions::inline_threshold вызовов встраиваются
+     * в места вызова с единственным наблюдавшимся классом получателя. Встроенный код
+     * защищён проверкой класса и при её неудаче уступает обычному вызову. Экземпляры,
+     * которые метод создаёт только для обращения к их полям, не создаются.
+     * Может использоваться одновременно из нескольких потоков
+     */
+    class BytecodeVm : public runtime::CallAccelerator {
+    public:
+        explicit BytecodeVm(VmOptions options = {});
+
+        std::optional<runtime::ObjectHolder> TryCall(runtime::ClassInstance& self,
+            const runtime::Method& method, const std::vector<runtime::ObjectHolder>& args,
+            runtime::Context& context) override;
+
+        // Переводит метод method класса cls в байт-код независимо от числа вызовов и
+        // возвращает результат. Если метод не переведён, Function::rejection содержит причину
+        const Function& Compile(const runtime::Class& cls, const runtime::Method& method);
+
+        // Выполняет байт-код метода, если он создан, иначе возвращает nullopt
+        std::optional<runtime::ObjectHolder> Run(runtime::ClassInstance& self,
+            const runtime::Method& method, const std::vector<runtime::ObjectHolder>& args,
+            runtime::Context& context);
+
+        [[nodiscard]] VmStats GetStats() const;
+
+        // Возвращает счётчики пар инструкций по убыванию. Пары считаются
+        // при VmOptions::count_dispatches и служат для выбора суперинструкций
+        [[nodiscard]] std::vector<OpCodePairCount> GetPairCounts() const;
+
+    private:
+        // Переводит метод повторно, встраивая методы, вызываемые в местах вызова
+        // с единственным классом получателя, и возвращает новый байт-код
+        const Function* InlineCalls(const runtime::Class& cls, const runtime::Method& method,
+                                    const Function& function);
+
+        VmOptions options_;
+        std::atomic<std::uint64_t> compiled_methods_ = 0;
+        std::atomic<std::uint64_t> rejected_methods_ = 0;
+        std::atomic<std::uint64_t> code_size_ = 0;
+        std::atomic<std::uint64_t> calls_ = 0;
+        std::atomic<std::uint64_t> dispatches_ = 0;
+        std::atomic<std::uint64_t> tree_nodes_ = 0;
+        std::atomic<std::uint64_t> inlined_calls_ = 0;
+        std::atomic<std::uint64_t> guard_failures_ = 0;
+        std::atomic<std::uint64_t> replaced_instances_ = 0;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> pair_counts_;
+    };
+
+    // Возвращает байт-код метода method либо nullptr, если он не создан или метод отклонён
+    [[nodiscard]] const Function* FindFunction(const runtime::Method& method) noexcept;
+
+}  // namespace vm
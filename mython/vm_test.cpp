@@ -0,0 +1,606 @@
+#include "native.h"
+#include "program.h"
+#include "test_runner_p.h"
+#include "vm.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+const string FEATURES_PROGRAM = R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __add__(other):
+    return self.x + other.x + self.y + other.y
+
+  def __eq__(other):
+    return self.x == other.x and self.y == other.y
+
+  def __lt__(other):
+    return self.x < other.x
+
+  def __str__():
+    return '(' + str(self.x) + ', ' + str(self.y) + ')'
+
+  def norm1():
+    total = self.x
+    if self.y < 0:
+      total = total - self.y
+    else:
+      total = total + self.y
+    return total
+
+class Box:
+  def __init__(p):
+    self.p = p
+
+  def moved(dx):
+    self.p.x = self.p.x + dx
+    return self.p.x
+
+  def describe(name, n):
+    print 'box', name, n, self.p
+    return name + ':' + str(n)
+
+  def pick(a, b):
+    return a or b
+
+  def both(a, b):
+    return a and b
+
+  def negate(v):
+    return not v
+
+  def text(s, t):
+    u = s + t
+    if u == 'ab':
+      return u + '!'
+    return u < t
+
+  def nothing():
+    x = None
+    return x
+
+  def no_return(v):
+    v = v * 2
+
+  def me():
+    return self
+
+  def arith(a, b):
+    q = a / b
+    r = a - q * b
+    return q * 10 + r
+
+p = Point(1, -2)
+q = Point(3, 4)
+b = Box(p)
+m = b.me()
+print p + q, p == q, p < q, p.norm1(), q.norm1()
+print b.moved(5), p.x, m.p.x
+print b.describe('n', 7)
+print b.pick(0, 5), b.pick(3, 5), b.both(0, 5), b.both(2, 5), b.negate(0), b.negate(True)
+print b.text('a', 'b'), b.text('b', 'c'), b.nothing(), b.no_return(3), b.arith(47, 5)
+)"s;
+
+struct RunResult {
+    string output;
+    string error;
+};
+
+RunResult Run(const string& source, runtime::CallAccelerator* accelerator,
+              const runtime::NativeRegistry* natives = nullptr) {
+    istringstream input(source);
+    ParseOptions options;
+    options.natives = natives;
+    const CompiledProgram program = CompiledProgram::Compile(input, options);
+    runtime::DummyContext context;
+    context.SetCallAccelerator(accelerator);
+    RunResult result;
+    try {
+        program.Run(context);
+    } catch (const runtime_error& e) {
+        result.error = e.what();
+    }
+    result.output = context.output.str();
+    return result;
+}
+
+// Возвращает байт-код метода method класса cls программы source
+string DisassembleMethod(const string& source, const string& cls, const string& method,
+                         string* rejection = nullptr) {
+    istringstream input(source);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    runtime::Closure closure;
+    runtime::DummyContext context;
+    program.Run(closure, context);
+    const auto* program_class = closure.at(cls).TryAs<runtime::Class>();
+    BytecodeVm bytecode_vm;
+    const Function& function = bytecode_vm.Compile(*program_class,
+                                                   *program_class->GetMethod(method));
+    if (rejection != nullptr) {
+        *rejection = function.rejection;
+    }
+    ostringstream out;
+    Disassemble(function, out);
+    return out.str();
+}
+
+void TestVmMatchesTreeWalker() {
+    const RunResult expected = Run(FEATURES_PROGRAM, nullptr);
+    ASSERT_EQUAL(expected.error, ""s);
+    ASSERT_EQUAL(expected.output,
+                 "6 False True 3 7\n6 6 6\nbox n 7 (6, -2)\nn:7\n5 3 0 5 True False\n"
+                 "ab! True None None 92\n"s);
+
+    BytecodeVm bytecode_vm;
+    const RunResult actual = Run(FEATURES_PROGRAM, &bytecode_vm);
+    ASSERT_EQUAL(actual.output, expected.output);
+    ASSERT_EQUAL(actual.error, ""s);
+
+    const VmStats stats = bytecode_vm.GetStats();
+    ASSERT_EQUAL(stats.compiled_methods, 17U);
+    ASSERT_EQUAL(stats.rejected_methods, 0U);
+    ASSERT(stats.calls >= 20);
+}
+
+void TestSpecializedInstructions() {
+    const string source = R"(
+class Calc:
+  def run(n):
+    a = 2
+    self.square = a * a
+    print a > 1
+    b = a * 3 + 1
+    s = 'x'
+    t = s + 'y'
+    if b > a:
+      self.total = b
+    return self.total + n
+)"s;
+    const string code = DisassembleMethod(source, "Calc"s, "run"s);
+    ASSERT(code.find("Calc.run: 1 params"s) == 0);
+    // Пока число a есть только в объекте, одна операция над числами выполняется
+    // над объектами
+    ASSERT(code.find("mult_int"s) != string::npos);
+    ASSERT(code.find("gt_int"s) != string::npos);
+    // Результат выражения, присваиваемый переменной, и операции над ним не упаковываются
+    ASSERT(code.find("mult_unboxed"s) != string::npos);
+    ASSERT(code.find("add_unboxed"s) != string::npos);
+    ASSERT(code.find("gt_unboxed"s) != string::npos);
+    ASSERT(code.find("box"s) != string::npos);
+    ASSERT(code.find("add_str"s) != string::npos);
+    ASSERT(code.find("set_self_field"s) != string::npos);
+    ASSERT(code.find("get_self_field"s) != string::npos);
+    // Тип параметра n неизвестен, поэтому последнее сложение проверяет типы.
+    // Оно объединено с возвратом результата в суперинструкцию
+    ASSERT(code.find("add_return "s) != string::npos);
+}
+
+// Возвращает число инструкций op в байт-коде code
+size_t CountInstructions(const string& code, const string& op) {
+    size_t count = 0;
+    for (size_t pos = code.find("  "s + op + ' '); pos != string::npos;
+         pos = code.find("  "s + op + ' ', pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+void TestUnboxedArithmetic() {
+    const string source = R"(
+class Calc:
+  def poly(x):
+    y = x * x
+    z = y * 3 + x * 2 - 7
+    if z > 100:
+      z = z / 2
+    else:
+      if z < 0:
+        z = 'neg'
+      else:
+        z = z + 1
+    w = y + 1
+    if y < 50:
+      w = w * 2
+    return str(z) + ' ' + str(w + y)
+
+c = Calc()
+print c.poly(1), c.poly(5), c.poly(10), c.poly(0)
+print c.poly(2), c.poly(3)
+)"s;
+    const RunResult expected = Run(source, nullptr);
+    ASSERT_EQUAL(expected.output, "neg 5 79 77 156 201 neg 2\n10 14 27 29\n"s);
+    BytecodeVm bytecode_vm;
+    ASSERT_EQUAL(Run(source, &bytecode_vm).output, expected.output);
+
+    const string code = DisassembleMethod(source, "Calc"s, "poly"s);
+    // Тип x неизвестен до первого умножения, после него x и y - числа
+    ASSERT(code.find("  mult 2 1 1\n"s) != string::npos);
+    ASSERT_EQUAL(CountInstructions(code, "unbox"s), 2U);
+    ASSERT(code.find("sub_unboxed"s) != string::npos);
+    ASSERT(code.find("div_unboxed"s) != string::npos);
+    ASSERT(code.find("lt_unboxed_jump_if_false"s) != string::npos);
+    // z упаковывается в конце числовых ветвей, где её тип объединяется со строкой,
+    // а w + y - перед передачей в str
+    ASSERT_EQUAL(CountInstructions(code, "box"s), 3U);
+    ASSERT_EQUAL(CountInstructions(code, "add_int"s) + CountInstructions(code, "mult_int"s), 0U);
+}
+
+void TestMethodsReadingUnassignedVariablesUseTreeWalker() {
+    const string source = R"(
+class Maybe:
+  def get(c):
+    if c:
+      x = 1
+    return x
+
+m = Maybe()
+print m.get(True)
+)"s;
+    string rejection;
+    DisassembleMethod(source, "Maybe"s, "get"s, &rejection);
+    ASSERT_EQUAL(rejection, "Variable x may be read before assignment"s);
+
+    BytecodeVm bytecode_vm;
+    ASSERT_EQUAL(Run(source, &bytecode_vm).output, "1\n"s);
+    ASSERT_EQUAL(bytecode_vm.GetStats().rejected_methods, 1U);
+    ASSERT_EQUAL(bytecode_vm.GetStats().calls, 0U);
+}
+
+void TestErrorsMatchTreeWalker() {
+    const vector<string> sources = {
+        "class A:\n  def f(a, b):\n    print 'before'\n    return a / b\n\na = A()\nprint a.f(1, 0)\n"s,
+        "class A:\n  def f():\n    return self.missing\n\na = A()\nprint a.f()\n"s,
+        "class A:\n  def f(x):\n    return x.g()\n\na = A()\nprint a.f(1)\n"s,
+        "class A:\n  def f(x):\n    return not x\n\na = A()\nprint a.f('s')\n"s,
+        "class A:\n  def f(x):\n    x.y = 1\n\na = A()\nprint a.f(1)\n"s,
+        "class A:\n  def f(a, b):\n    return a - b\n\na = A()\nprint a.f('a', 'b')\n"s,
+        // Деление чисел без упаковки
+        "class A:\n  def f(a, b):\n    c = a * 2 / (b - b)\n    return c\n\na = A()\nprint a.f(1, 2)\n"s,
+    };
+    for (const string& source : sources) {
+        const RunResult expected = Run(source, nullptr);
+        ASSERT(!expected.error.empty());
+        BytecodeVm bytecode_vm;
+        const RunResult actual = Run(source, &bytecode_vm);
+        ASSERT_EQUAL(actual.output, expected.output);
+        ASSERT_EQUAL(actual.error, expected.error);
+        ASSERT_EQUAL(bytecode_vm.GetStats().calls, 1U);
+    }
+}
+
+void TestNativeCallsCheckArguments() {
+    runtime::NativeRegistry registry;
+    registry.Register("square"s, {runtime::TypeHint::Number}, runtime::TypeHint::Number,
+                      [](const vector<runtime::ObjectHolder>& args, runtime::Context&) {
+                          const int value = args[0].TryAs<runtime::Number>()->GetValue();
+                          return runtime::ObjectHolder::Own(runtime::Number{value * value});
+                      });
+    const string source = R"(
+class A:
+  def f(x):
+    return square(x) + 1
+
+a = A()
+print a.f(3)
+print a.f('s')
+)"s;
+    const RunResult expected = Run(source, nullptr, &registry);
+    BytecodeVm bytecode_vm;
+    const RunResult actual = Run(source, &bytecode_vm, &registry);
+    ASSERT_EQUAL(actual.output, "10\n"s);
+    ASSERT_EQUAL(actual.output, expected.output);
+    ASSERT_EQUAL(actual.error, "Argument 1 of square() must be Number"s);
+    ASSERT_EQUAL(actual.error, expected.error);
+}
+
+void TestCountsDispatchesAndTreeNodes() {
+    const string source = R"(
+class Counter:
+  def twice(n):
+    return n * 2
+
+c = Counter()
+print c.twice(1), c.twice(2), c.twice(3), c.twice(4)
+)"s;
+    VmOptions options;
+    options.count_dispatches = true;
+    BytecodeVm bytecode_vm(options);
+    ASSERT_EQUAL(Run(source, &bytecode_vm).output, "2 4 6 8\n"s);
+    const VmStats stats = bytecode_vm.GetStats();
+    // MethodBody, Compound, Return, Mult, n и 2 заменены инструкциями load_const, mult, return
+    ASSERT_EQUAL(stats.calls, 4U);
+    ASSERT_EQUAL(stats.tree_nodes, 24U);
+    ASSERT_EQUAL(stats.dispatches, 12U);
+}
+
+void TestSuperinstructions() {
+    const string source = R"(
+class Node:
+  def __init__(value):
+    self.value = value
+
+  def get():
+    return self.value
+
+class Walker:
+  def __init__(node):
+    self.node = node
+
+  def count(n):
+    if n == 0:
+      return 0
+    return self.count(n - 1) + 1
+
+  def sum(n):
+    if n <= 0:
+      return 0
+    return n + self.sum(n - 1)
+
+  def total(n):
+    return self.sum(n)
+
+  def node_value():
+    return self.node.get()
+
+  def raw_value():
+    return self.node.value
+
+  def compare(a, b):
+    if a < b:
+      return 'less'
+    equal = a == b
+    if equal:
+      return 'equal'
+    return 'greater'
+
+w = Walker(Node(7))
+print w.count(10), w.total(10), w.node_value(), w.raw_value()
+print w.compare(1, 2), w.compare(2, 2), w.compare(3, 2), w.compare('a', 'b')
+)"s;
+    const RunResult expected = Run(source, nullptr);
+    ASSERT_EQUAL(expected.output, "10 55 7 7\nless equal greater less\n"s);
+
+    VmOptions options;
+    options.count_dispatches = true;
+    options.superinstructions = false;
+    BytecodeVm plain_vm(options);
+    ASSERT_EQUAL(Run(source, &plain_vm).output, expected.output);
+
+    options.superinstructions = true;
+    BytecodeVm fused_vm(options);
+    ASSERT_EQUAL(Run(source, &fused_vm).output, expected.output);
+
+    // Суперинструкции сокращают число диспетчеризаций, не меняя число заменённых узлов
+    ASSERT_EQUAL(fused_vm.GetStats().tree_nodes, plain_vm.GetStats().tree_nodes);
+    ASSERT(fused_vm.GetStats().dispatches < plain_vm.GetStats().dispatches);
+    ASSERT(!plain_vm.GetPairCounts().empty());
+    ASSERT(plain_vm.GetPairCounts().front().count >= plain_vm.GetPairCounts().back().count);
+
+    const string count = DisassembleMethod(source, "Walker"s, "count"s);
+    ASSERT(count.find("eq_jump_if_false"s) != string::npos);
+    ASSERT(count.find("load_const_sub"s) != string::npos);
+    ASSERT(count.find("load_const_add"s) != string::npos);
+    ASSERT(DisassembleMethod(source, "Walker"s, "sum"s).find("le_jump_if_false"s)
+           != string::npos);
+    ASSERT(DisassembleMethod(source, "Walker"s, "total"s).find("call_self_return"s)
+           != string::npos);
+    ASSERT(DisassembleMethod(source, "Walker"s, "node_value"s).find("get_self_field_call"s)
+           != string::npos);
+    ASSERT(DisassembleMethod(source, "Walker"s, "raw_value"s).find("get_self_field_get_field"s)
+           != string::npos);
+    // Результат сравнения, сохранённый в переменной, остаётся в регистре
+    const string compare = DisassembleMethod(source, "Walker"s, "compare"s);
+    ASSERT(compare.find("lt_jump_if_false"s) != string::npos);
+    ASSERT(compare.find("eq_jump_if_false"s) == string::npos);
+}
+
+const string GETTERS_PROGRAM = R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def get_x():
+    return self.x
+
+  def get_y():
+    return self.y
+
+  def scaled(k):
+    k = k * 2
+    return self.x * k
+
+  def sum():
+    return self.get_x() + self.get_y()
+
+class Shifted(Point):
+  def get_x():
+    return self.x + 100
+
+class Walker:
+  def __init__():
+    self.total = 0
+
+  def visit(p, k):
+    self.total = self.total + p.get_x() + p.get_y() + p.sum()
+    scaled = p.scaled(k)
+    return scaled + k
+
+  def walk(p, n):
+    if n == 0:
+      return self.total
+    self.visit(p, 3)
+    return self.walk(p, n - 1)
+
+w = Walker()
+print w.walk(Point(1, 2), 40), w.visit(Point(1, 2), 3)
+print w.walk(Shifted(1, 2), 10), w.visit(Shifted(1, 2), 3)
+)"s;
+
+void TestInlinesMonomorphicCalls() {
+    const RunResult expected = Run(GETTERS_PROGRAM, nullptr);
+    ASSERT_EQUAL(expected.output, "240 9\n2306 9\n"s);
+
+    VmOptions options;
+    options.inline_threshold = 8;
+    BytecodeVm bytecode_vm(options);
+    ASSERT_EQUAL(Run(GETTERS_PROGRAM, &bytecode_vm).output, expected.output);
+
+    const VmStats stats = bytecode_vm.GetStats();
+    // В Walker.visit встроены p.get_x(), p.get_y() и p.scaled(k), в Point.sum - оба вызова
+    // метода self. Вызов p.sum() не встроен, так как sum сам вызывает методы
+    ASSERT_EQUAL(stats.inlined_calls, 5U);
+    // Экземпляры Shifted не проходят проверку класса в Walker.visit и Point.sum
+    ASSERT(stats.guard_failures > 0);
+}
+
+void TestInliningDisabled() {
+    VmOptions options;
+    options.inline_threshold = NEVER;
+    BytecodeVm bytecode_vm(options);
+    ASSERT_EQUAL(Run(GETTERS_PROGRAM, &bytecode_vm).output, "240 9\n2306 9\n"s);
+    ASSERT_EQUAL(bytecode_vm.GetStats().inlined_calls, 0U);
+    ASSERT_EQUAL(bytecode_vm.GetStats().guard_failures, 0U);
+}
+
+const string INSTANCES_PROGRAM = R"(
+class Vec:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+    self.sum = self.x + self.y
+
+class Pair:
+  def __init__(first, second):
+    self.first = first
+    self.second = second
+
+class Flagged:
+  def __init__(v):
+    if v:
+      self.v = 1
+    else:
+      self.v = 2
+
+class Empty:
+  def get():
+    return 1
+
+class Geo:
+  def cross(ax, ay, bx, by):
+    a = Vec(ax, ay)
+    b = Vec(bx, by)
+    return a.x * b.y - a.y * b.x + a.sum
+
+  def maybe(c):
+    e = Empty()
+    if c:
+      e.f = 5
+    return e.f
+
+  def escape(x):
+    v = Vec(x, x)
+    return v
+
+  def reassign(x):
+    v = Vec(x, 1)
+    s = v.x
+    v = Vec(v.y, x)
+    v.z = s * 2
+    w = Flagged(x)
+    return v.x + v.y + v.z + w.v
+
+  def nested(p):
+    h = Pair(p, Pair(3, 4))
+    h.second.first = 10
+    return h.second.first + h.first.first
+
+g = Geo()
+e = g.escape(3)
+print g.cross(1, 2, 3, 4), g.maybe(True), e.sum, g.reassign(7), g.nested(Pair(1, 2))
+)"s;
+
+void TestReplacesNonEscapingInstances() {
+    // Ошибка в операции над полями экземпляра, заменённого регистрами
+    const string source = INSTANCES_PROGRAM + "print g.cross('a', 'b', 'c', 'd')\n"s;
+    const RunResult expected = Run(source, nullptr);
+    ASSERT_EQUAL(expected.output, "1 5 6 23 11\n"s);
+    ASSERT_EQUAL(expected.error, "Multiply operands are illegal"s);
+
+    BytecodeVm bytecode_vm;
+    const RunResult actual = Run(source, &bytecode_vm);
+    ASSERT_EQUAL(actual.output, expected.output);
+    ASSERT_EQUAL(actual.error, expected.error);
+    // a и b в cross, оба экземпляра в v в reassign и h в nested. Экземпляр в e может
+    // остаться без поля, v в escape возвращается, а __init__ класса Flagged ветвится
+    ASSERT_EQUAL(bytecode_vm.GetStats().replaced_instances, 5U);
+
+    ASSERT(DisassembleMethod(INSTANCES_PROGRAM, "Geo"s, "cross"s).find("new"s) == string::npos);
+    ASSERT(DisassembleMethod(INSTANCES_PROGRAM, "Geo"s, "maybe"s).find("new"s) != string::npos);
+    ASSERT(DisassembleMethod(INSTANCES_PROGRAM, "Geo"s, "escape"s).find("new"s) != string::npos);
+    const string reassign = DisassembleMethod(INSTANCES_PROGRAM, "Geo"s, "reassign"s);
+    ASSERT_EQUAL(CountInstructions(reassign, "new"s), 1U);
+
+    VmOptions options;
+    options.scalar_replacement = false;
+    BytecodeVm plain_vm(options);
+    ASSERT_EQUAL(Run(source, &plain_vm).output, expected.output);
+    ASSERT_EQUAL(plain_vm.GetStats().replaced_instances, 0U);
+}
+
+void TestBudgetUsesTreeWalker() {
+    istringstream input(FEATURES_PROGRAM);
+    const CompiledProgram program = CompiledProgram::Compile(input);
+    BytecodeVm bytecode_vm;
+    runtime::DummyContext context;
+    context.SetCallAccelerator(&bytecode_vm);
+    runtime::ExecutionBudget budget(1'000'000);
+    context.SetBudget(&budget);
+    program.Run(context);
+    ASSERT_EQUAL(bytecode_vm.GetStats().calls, 0U);
+}
+
+void BenchVmFib() {
+    const string source = R"(
+class Math:
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+m = Math()
+print m.fib(20)
+)"s;
+    BytecodeVm bytecode_vm;
+    ASSERT_EQUAL(Run(source, &bytecode_vm).output, "6765\n"s);
+}
+
+}  // namespace
+
+void RunVmTests(TestRunner& tr) {
+    RUN_TEST(tr, TestVmMatchesTreeWalker);
+    RUN_TEST(tr, TestSpecializedInstructions);
+    RUN_TEST(tr, TestUnboxedArithmetic);
+    RUN_TEST(tr, TestMethodsReadingUnassignedVariablesUseTreeWalker);
+    RUN_TEST(tr, TestErrorsMatchTreeWalker);
+    RUN_TEST(tr, TestNativeCallsCheckArguments);
+    RUN_TEST(tr, TestCountsDispatchesAndTreeNodes);
+    RUN_TEST(tr, TestSuperinstructions);
+    RUN_TEST(tr, TestInlinesMonomorphicCalls);
+    RUN_TEST(tr, TestInliningDisabled);
+    RUN_TEST(tr, TestReplacesNonEscapingInstances);
+    RUN_TEST(tr, TestBudgetUsesTreeWalker);
+    RUN_BENCH(tr, BenchVmFib);
+}
+
+}  // namespace vm
@@ -0,0 +1,128 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Пул и номер очереди текущего потока, если он принадлежит пулу
+thread_local const WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = max(thread::hardware_concurrency(), 1U);
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(make_unique<Queue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i] {
+            WorkerLoop(i);
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        unique_lock lock(mutex_);
+        all_done_.wait(lock, [this] {
+            return unfinished_ == 0;
+        });
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (auto& t : threads_) {
+        t.join();
+    }
+}
+
+void WorkStealingPool::Submit(Task task) {
+    const size_t index = current_pool == this ? current_queue
+                                              : next_queue_++ % queues_.size();
+    ++unfinished_;
+    ++queued_;
+    {
+        lock_guard lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Захват мьютекса не даёт уведомлению потеряться между проверкой условия
+        // и засыпанием потока
+        lock_guard lock(mutex_);
+    }
+    work_available_.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+    unique_lock lock(mutex_);
+    all_done_.wait(lock, [this] {
+        return unfinished_ == 0;
+    });
+    if (error_) {
+        rethrow_exception(exchange(error_, nullptr));
+    }
+}
+
+size_t WorkStealingPool::GetThreadCount() const {
+    return threads_.size();
+}
+
+bool WorkStealingPool::TryPop(size_t index, Task& task) {
+    {
+        auto& own = *queues_[index];
+        lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        auto& victim = *queues_[(index + i) % queues_.size()];
+        lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_queue = index;
+    for (;;) {
+        Task task;
+        if (TryPop(index, task)) {
+            --queued_;
+            try {
+                task();
+            } catch (...) {
+                lock_guard lock(mutex_);
+                if (!error_) {
+                    error_ = current_exception();
+                }
+            }
+            task = nullptr;
+            if (--unfinished_ == 0) {
+                lock_guard lock(mutex_);
+                all_done_.notify_all();
+            }
+            continue;
+        }
+
+        unique_lock lock(mutex_);
+        work_available_.wait(lock, [this] {
+            return stopping_ || queued_ > 0;
+        });
+        if (stopping_) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Пул потоков с перехватом задач.
+ * У каждого потока своя очередь: поток берёт задачи с конца своей очереди, а когда она пуста,
+ * перехватывает задачи из начала очередей других потоков. Задачи, поставленные из потока пула,
+ * попадают в его собственную очередь, остальные распределяются по очередям по кругу
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // Создаёт thread_count потоков. При thread_count == 0 - по числу процессоров
+    explicit WorkStealingPool(size_t thread_count = 0);
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Дожидается выполнения всех задач и останавливает потоки
+    ~WorkStealingPool();
+
+    void Submit(Task task);
+
+    // Дожидается выполнения всех поставленных задач. Если какая-либо задача выбросила
+    // исключение, выбрасывает первое из них. Нельзя вызывать из задачи
+    void Wait();
+
+    [[nodiscard]] size_t GetThreadCount() const;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(size_t index);
+    bool TryPop(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable all_done_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> unfinished_{0};
+    std::atomic<size_t> next_queue_{0};
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};